@@ -167,6 +167,10 @@ struct nta_agent_s
   uint64_t              sa_branch; /**< Generator for branch parameters */
   uint64_t              sa_tags;   /**< Generator for tag parameters */
 
+  unsigned              sa_shard;  /**< Index of this agent in shard group */
+  unsigned              sa_shards; /**< Number of agents in shard group */
+  nta_shard_group_t    *sa_shard_group; /**< Agents sharing our port */
+
 #if HAVE_SOFIA_SRESOLV
   sres_resolver_t      *sa_resolver; /**< DNS resolver */
   enum nta_res_order_e  sa_res_order;  /** Resolving order (AAAA/A) */
@@ -656,6 +660,13 @@ static char const * stateful_branch(su_home_t *home, nta_agent_t *);
 static char const * stateless_branch(nta_agent_t *, msg_t *, sip_t const *,
 				    tp_name_t const *tp);
 
+/** Length of the shard marker in tags and branches */
+#define AGENT_SHARD_MARKER 4
+su_inline size_t agent_shard_marker(nta_agent_t const *sa,
+				    char b[AGENT_SHARD_MARKER]);
+static int agent_recv_forward(nta_agent_t *agent, tport_t *tport,
+			      msg_t *msg, sip_t const *sip);
+
 #define NTA_BRANCH_PRIME SU_U64_C(0xB9591D1C361C6521)
 #define NTA_TAG_PRIME    SU_U64_C(0xB9591D1C361C6521)
 
@@ -759,6 +770,13 @@ union sm_arg_u {
 
   incoming_queue_t a_incoming_queue[1];
   outgoing_queue_t a_outgoing_queue[1];
+
+  struct agent_forward_s {
+    nta_agent_t    *agent;
+    nta_shard_group_t *group;
+    unsigned        index;
+    msg_t          *msg;
+  } a_forward[1];
 };
 
 /* Global module data */
@@ -1020,6 +1038,9 @@ void nta_agent_destroy(nta_agent_t *agent)
     leg_htable_t *lht;
     nta_leg_t *leg;
 
+    /* No agent in our shard group may queue anything for us any more */
+    nta_agent_set_shard(agent, NULL, 0);
+
     for (i = 0, lht = agent->sa_dialogs; i < lht->lht_size; i++) {
       if ((leg = lht->lht_table[i])) {
 	SU_DEBUG_3(("nta_agent_destroy: destroying dialog with <"
@@ -1917,6 +1938,186 @@ int nta_agent_get_stats(nta_agent_t *agent,
   return n;
 }
 
+/** Group of agents sharing the same transport port.
+ *
+ * The slots and the count of forwarded messages still queued for each
+ * agent are protected by the lock of g_home, as forwarding agents look up
+ * their targets from their own threads.
+ */
+struct nta_shard_group_s
+{
+  su_home_t     g_home[1];
+  unsigned      g_count;
+  nta_agent_t **g_agents;	/**< NULL when agent is not available */
+  unsigned     *g_pending;	/**< Forwarded messages not yet delivered */
+};
+
+/** Create a group for @a count agents sharing the same transport port.
+ *
+ * @return A pointer to the group, or NULL upon an error.
+ *
+ * @sa nta_agent_set_shard(), nta_shard_group_destroy()
+ *
+ * @NEW_UNRELEASED.
+ */
+nta_shard_group_t *nta_shard_group_create(unsigned count)
+{
+  nta_shard_group_t *group;
+
+  if (count < 2 || count > 256)
+    return su_seterrno(EINVAL), NULL;
+
+  if (!(group = su_home_new(sizeof *group)))
+    return NULL;
+
+  if (su_home_threadsafe(group->g_home) < 0 ||
+      !(group->g_agents = su_zalloc(group->g_home,
+				    count * sizeof *group->g_agents)) ||
+      !(group->g_pending = su_zalloc(group->g_home,
+				     count * sizeof *group->g_pending))) {
+    su_home_unref(group->g_home);
+    return NULL;
+  }
+
+  group->g_count = count;
+
+  return group;
+}
+
+/** Destroy a shard group.
+ *
+ * The group must be destroyed only after every agent has left it and
+ * nta_agent_shard_pending() has returned 0 for each of them.
+ *
+ * @NEW_UNRELEASED.
+ */
+void nta_shard_group_destroy(nta_shard_group_t *group)
+{
+  if (group)
+    su_home_unref(group->g_home);
+}
+
+/** Join or leave a group of agents sharing the same transport port.
+ *
+ * When several agents bind the same address and port with
+ * TPTAG_REUSEPORT(), the kernel picks the agent receiving each datagram
+ * from the addresses involved, not from the dialog or transaction the
+ * datagram belongs to. After joining @a group at @a index, the tags and
+ * branches generated by @a agent are marked with its index, and requests
+ * with a marked @To tag and responses with a marked @Via branch received
+ * over datagram transports are passed to the agent owning the marker in
+ * its own thread.
+ *
+ * Use @a group NULL to leave the group. Once this returns, no other agent
+ * queues new messages for @a agent and messages for its dialogs are
+ * processed by whoever receives them. Messages already queued are
+ * delivered when the agent's root runs, so keep stepping it until
+ * nta_agent_shard_pending() returns 0 before destroying the agent.
+ *
+ * This must be called from the thread running @a agent.
+ *
+ * @retval 0 when successful
+ * @retval -1 upon an error
+ *
+ * @NEW_UNRELEASED.
+ */
+int nta_agent_set_shard(nta_agent_t *agent,
+			nta_shard_group_t *group,
+			unsigned index)
+{
+  nta_shard_group_t *old;
+
+  if (agent == NULL || (group && index >= group->g_count))
+    return su_seterrno(EINVAL);
+
+  if ((old = agent->sa_shard_group) && (old != group || index != agent->sa_shard)) {
+    su_home_lock(old->g_home);
+    if (old->g_agents[agent->sa_shard] == agent)
+      old->g_agents[agent->sa_shard] = NULL;
+    su_home_unlock(old->g_home);
+  }
+
+  if (group) {
+    su_home_lock(group->g_home);
+    group->g_agents[index] = agent;
+    su_home_unlock(group->g_home);
+
+    agent->sa_shard = index;
+    agent->sa_shards = group->g_count;
+    agent->sa_shard_group = group;
+  }
+  else {
+    /* Keep the group and index so pending forwards can still be counted */
+    agent->sa_shards = 0;
+  }
+
+  return 0;
+}
+
+/** Return number of messages forwarded to @a agent and not yet delivered.
+ *
+ * @NEW_UNRELEASED.
+ */
+unsigned nta_agent_shard_pending(nta_agent_t const *agent)
+{
+  nta_shard_group_t *group;
+  unsigned n;
+
+  if (agent == NULL || !(group = agent->sa_shard_group))
+    return 0;
+
+  su_home_lock(group->g_home);
+  n = group->g_pending[agent->sa_shard];
+  su_home_unlock(group->g_home);
+
+  return n;
+}
+
+/** Write shard marker ("sXX.") of @a sa to @a b, return its length */
+su_inline
+size_t agent_shard_marker(nta_agent_t const *sa, char b[AGENT_SHARD_MARKER])
+{
+  static char const hex[] = "0123456789abcdef";
+
+  if (sa->sa_shards <= 1)
+    return 0;
+
+  b[0] = 's';
+  b[1] = hex[(sa->sa_shard >> 4) & 15];
+  b[2] = hex[sa->sa_shard & 15];
+  b[3] = '.';
+
+  return AGENT_SHARD_MARKER;
+}
+
+su_inline
+int agent_shard_hexdigit(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/** Return shard index from a marked tag or branch, -1 if not marked */
+su_inline
+int agent_shard_of(char const *s)
+{
+  int hi, lo;
+
+  if (s == NULL || (s[0] != 's' && s[0] != 'S'))
+    return -1;
+  if ((hi = agent_shard_hexdigit(s[1])) < 0 ||
+      (lo = agent_shard_hexdigit(s[2])) < 0 ||
+      s[3] != '.')
+    return -1;
+
+  return hi * 16 + lo;
+}
+
 /**Calculate a new unique tag.
  *
  * This function generates a series of 2**64 unique tags for @From or @To
@@ -1926,7 +2127,8 @@ int nta_agent_get_stats(nta_agent_t *agent,
  */
 char const *nta_agent_newtag(su_home_t *home, char const *fmt, nta_agent_t *sa)
 {
-  char tag[(8 * 8 + 4)/ 5 + 1];
+  char tag[AGENT_SHARD_MARKER + (8 * 8 + 4)/ 5 + 1];
+  size_t n;
 
   if (sa == NULL)
     return su_seterrno(EINVAL), NULL;
@@ -1934,7 +2136,9 @@ char const *nta_agent_newtag(su_home_t *home, char const *fmt, nta_agent_t *sa)
   /* XXX - use a cryptographically safe func here? */
   sa->sa_tags += NTA_TAG_PRIME;
 
-  msg_random_token(tag, sizeof(tag) - 1, &sa->sa_tags, sizeof(sa->sa_tags));
+  n = agent_shard_marker(sa, tag);
+  msg_random_token(tag + n, sizeof(tag) - AGENT_SHARD_MARKER - 1,
+		   &sa->sa_tags, sizeof(sa->sa_tags));
 
   if (fmt && fmt[0])
     return su_sprintf(home, fmt, tag);
@@ -1947,12 +2151,14 @@ char const *nta_agent_newtag(su_home_t *home, char const *fmt, nta_agent_t *sa)
  */
 static char const *stateful_branch(su_home_t *home, nta_agent_t *sa)
 {
-  char branch[(8 * 8 + 4)/ 5 + 1];
+  char branch[AGENT_SHARD_MARKER + (8 * 8 + 4)/ 5 + 1];
+  size_t n;
 
   /* XXX - use a cryptographically safe func here? */
   sa->sa_branch += NTA_BRANCH_PRIME;
 
-  msg_random_token(branch, sizeof(branch) - 1,
+  n = agent_shard_marker(sa, branch);
+  msg_random_token(branch + n, sizeof(branch) - AGENT_SHARD_MARKER - 1,
 		   &sa->sa_branch, sizeof(sa->sa_branch));
 
   return su_sprintf(home, "branch=z9hG4bK%s", branch);
@@ -2138,6 +2344,7 @@ int nta_agent_add_tport(nta_agent_t *self,
   char tp[32];
   char maddr[256];
   char comp[32];
+  char *tps[9] = {0};
   tp_name_t tpn[1] = {{ NULL }};
   char const * const * tports = tports_sip;
   int error;
@@ -2187,7 +2394,7 @@ int nta_agent_add_tport(nta_agent_t *self,
   if (url->url_params) {
     if (url_param(url->url_params, "transport", tp, sizeof(tp)) > 0) {
       if (strchr(tp, ',')) {
-		  int i; char *t, *tps[9] = {0};
+	int i; char *t;
 
 	/* Split tp into transports */
 	for (i = 0, t = tp; t && i < 8; i++) {
@@ -2776,6 +2983,10 @@ void agent_recv_message(nta_agent_t *agent,
 {
   sip_t *sip = sip_object(msg);
 
+  if (agent->sa_shards > 1 && sip &&
+      agent_recv_forward(agent, tport, msg, sip))
+    return;
+
   if (sip && sip->sip_request) {
     agent_recv_request(agent, msg, sip, tport);
   }
@@ -2787,6 +2998,116 @@ void agent_recv_message(nta_agent_t *agent,
   }
 }
 
+/** Destroy a forwarded message that was not delivered, release target */
+static
+void agent_forward_deinit(union sm_arg_u *u)
+{
+  nta_shard_group_t *group = u->a_forward->group;
+
+  msg_destroy(u->a_forward->msg), u->a_forward->msg = NULL;
+
+  su_home_lock(group->g_home);
+  group->g_pending[u->a_forward->index]--;
+  su_home_unlock(group->g_home);
+}
+
+/** Deliver a message forwarded by another agent in the shard group. */
+static
+void agent_recv_forwarded(su_root_magic_t *rm,
+			  su_msg_r m,
+			  union sm_arg_u *u)
+{
+  nta_agent_t *agent = u->a_forward->agent;
+  msg_t *msg = u->a_forward->msg;
+  su_sockaddr_t const *su = msg_addr(msg);
+  tport_t *tp;
+
+  for (tp = tport_primaries(agent->sa_tports); tp; tp = tport_next(tp)) {
+    su_addrinfo_t const *ai = tport_get_address(tp);
+
+    if (tport_is_udp(tp) && ai && ai->ai_family == su->su_family)
+      break;
+  }
+
+  if (tp == NULL) {
+    SU_DEBUG_3(("nta: no transport for forwarded message\n" VA_NONE));
+    return;			/* Deinitializer destroys message */
+  }
+
+  u->a_forward->msg = NULL;
+  tport_deliver_forwarded(tp, msg);
+}
+
+/** Pass message to the agent in the shard group that owns the dialog.
+ *
+ * @retval 1 if message was forwarded
+ * @retval 0 if message should be processed locally
+ */
+static
+int agent_recv_forward(nta_agent_t *agent, tport_t *tport,
+		       msg_t *msg, sip_t const *sip)
+{
+  char const *marked = NULL;
+  nta_shard_group_t *group = agent->sa_shard_group;
+  nta_agent_t *target;
+  su_msg_r m = SU_MSG_R_INIT;
+  int shard, created = 0;
+
+  /* Connections stay in the agent that accepted or opened them */
+  if (tport_is_stream(tport))
+    return 0;
+
+  if (sip->sip_request) {
+    if (sip->sip_to)
+      marked = sip->sip_to->a_tag;
+  }
+  else if (sip->sip_status && sip->sip_via && sip->sip_via->v_branch) {
+    if (su_casenmatch(sip->sip_via->v_branch, "z9hG4bK", 7))
+      marked = sip->sip_via->v_branch + 7;
+  }
+
+  shard = agent_shard_of(marked);
+
+  if (shard < 0 || (unsigned)shard == agent->sa_shard ||
+      (unsigned)shard >= agent->sa_shards)
+    return 0;
+
+  /* The target cannot leave and go away while we hold the lock, and after
+     that it waits for the pending count we add to drop back to zero */
+  su_home_lock(group->g_home);
+
+  target = group->g_agents[shard];
+
+  if (target && target != agent &&
+      su_msg_create(m,
+		    su_root_task(target->sa_root),
+		    su_root_task(agent->sa_root),
+		    agent_recv_forwarded,
+		    sizeof(struct agent_forward_s)) == SU_SUCCESS) {
+    group->g_pending[shard]++;
+    created = 1;
+  }
+
+  su_home_unlock(group->g_home);
+
+  if (!created)
+    return 0;
+
+  su_msg_data(m)->a_forward->agent = target;
+  su_msg_data(m)->a_forward->group = group;
+  su_msg_data(m)->a_forward->index = (unsigned)shard;
+  su_msg_data(m)->a_forward->msg = msg;
+  su_msg_deinitializer(m, agent_forward_deinit);
+
+  SU_DEBUG_7(("nta: forwarding %s to agent %u\n",
+	      sip->sip_request ? "request" : "response", (unsigned)shard));
+
+  /* On failure the deinitializer destroys the message */
+  su_msg_send(m);
+
+  return 1;
+}
+
 /** @internal Handle incoming requests. */
 static
 void agent_recv_request(nta_agent_t *agent,
@@ -59,6 +59,8 @@ typedef struct nta_leg_s        nta_leg_t;
 typedef struct nta_outgoing_s   nta_outgoing_t;
 /** NTA incoming request */
 typedef struct nta_incoming_s   nta_incoming_t;
+/** NTA agents sharing a transport port */
+typedef struct nta_shard_group_s nta_shard_group_t;
 
 #ifndef NTA_AGENT_MAGIC_T
 /** Default type of application context for NTA agents.
@@ -156,6 +158,16 @@ SOFIAPUBFUN int nta_agent_get_params(nta_agent_t *agent,
 SOFIAPUBFUN int nta_agent_get_stats(nta_agent_t *agent,
 				    tag_type_t tag, tag_value_t value, ...);
 
+SOFIAPUBFUN nta_shard_group_t *nta_shard_group_create(unsigned count);
+
+SOFIAPUBFUN void nta_shard_group_destroy(nta_shard_group_t *group);
+
+SOFIAPUBFUN int nta_agent_set_shard(nta_agent_t *agent,
+				    nta_shard_group_t *group,
+				    unsigned index);
+
+SOFIAPUBFUN unsigned nta_agent_shard_pending(nta_agent_t const *agent);
+
 /* ----------------------------------------------------------------------
  * 4) Message-level prototypes
  */
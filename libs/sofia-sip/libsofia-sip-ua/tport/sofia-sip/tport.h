@@ -331,6 +331,9 @@ TPORT_DLL tport_t *tport_by_name(tport_t const *self, tp_name_t const  *);
 TPORT_DLL int tport_name_by_url(su_home_t *, tp_name_t *,
 				url_string_t const *us);
 
+/** Deliver a datagram received by another transport master */
+TPORT_DLL void tport_deliver_forwarded(tport_t *self, msg_t *msg);
+
 /** Return source transport object for delivered message */
 TPORT_DLL tport_t *tport_delivered_by(tport_t const *tp, msg_t const *msg);
 
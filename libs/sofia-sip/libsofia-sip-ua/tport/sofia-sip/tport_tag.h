@@ -160,6 +160,12 @@ TPORT_DLL extern tag_typedef_t tptag_pong2ping;
 TPORT_DLL extern tag_typedef_t tptag_pong2ping_ref;
 #define TPTAG_PONG2PING_REF(x) tptag_pong2ping_ref, tag_bool_vr(&(x))
 
+TPORT_DLL extern tag_typedef_t tptag_reuseport;
+#define TPTAG_REUSEPORT(x) tptag_reuseport, tag_bool_v((x))
+
+TPORT_DLL extern tag_typedef_t tptag_reuseport_ref;
+#define TPTAG_REUSEPORT_REF(x) tptag_reuseport_ref, tag_bool_vr(&(x))
+
 TPORT_DLL extern tag_typedef_t tptag_sigcomp_lifetime;
 #define TPTAG_SIGCOMP_LIFETIME(x) tptag_sigcomp_lifetime, tag_uint_v((x))
 
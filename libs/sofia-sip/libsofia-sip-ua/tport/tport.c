@@ -365,6 +365,22 @@ void tport_set_tos(su_socket_t socket, su_addrinfo_t *ai, int tos)
   }
 }
 
+/** Allow several sockets to bind the same port (SO_REUSEPORT) */
+void tport_set_reuseport(su_socket_t socket, int reuseport)
+{
+#if defined(SO_REUSEPORT)
+  int one = 1;
+
+  if (reuseport &&
+      setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, (const void*)&one, sizeof(one)) < 0) {
+    SU_DEBUG_3(("tport: setsockopt(SO_REUSEPORT): %s\n",
+		su_strerror(su_errno())));
+  }
+#else
+  (void)socket; (void)reuseport;
+#endif
+}
+
 static
 tport_t *tport_connect(tport_primary_t *pri, su_addrinfo_t *ai,
 		       tp_name_t const *tpn);
@@ -523,6 +539,7 @@ tport_t *tport_tcreate(tp_stack_t *stack,
   tpp->tpp_keepalive = 0;
   tpp->tpp_pingpong = 0;
   tpp->tpp_pong2ping = 0;
+  tpp->tpp_reuseport = 0;
   tpp->tpp_stun_server = 1;
   tpp->tpp_tos = -1;                  /* set invalid, valid values are 0-255 */
 
@@ -1222,6 +1239,7 @@ int tport_get_params(tport_t const *self,
 	       TPTAG_KEEPALIVE(tpp->tpp_keepalive),
 	       TPTAG_PINGPONG(tpp->tpp_pingpong),
 	       TPTAG_PONG2PING(tpp->tpp_pong2ping),
+	       TPTAG_REUSEPORT(tpp->tpp_reuseport),
 	       TPTAG_SDWN_ERROR(tpp->tpp_sdwn_error),
 	       TPTAG_DEBUG_DROP(tpp->tpp_drop),
 	       TPTAG_THRPSIZE(tpp->tpp_thrpsize),
@@ -1253,7 +1271,7 @@ int tport_get_params(tport_t const *self,
  * TPTAG_KEEPALIVE(), TPTAG_PINGPONG(), TPTAG_PONG2PING(),
  * TPTAG_DEBUG_DROP(), TPTAG_THRPSIZE(), TPTAG_THRPRQSIZE(),
  * TPTAG_SIGCOMP_LIFETIME(), TPTAG_CONNECT(), TPTAG_SDWN_ERROR(),
- * TPTAG_REUSE(), TPTAG_STUN_SERVER(), and TPTAG_TOS().
+ * TPTAG_REUSE(), TPTAG_REUSEPORT(), TPTAG_STUN_SERVER(), and TPTAG_TOS().
  */
 int tport_set_params(tport_t *self,
 		     tag_type_t tag, tag_value_t value, ...)
@@ -1263,7 +1281,7 @@ int tport_set_params(tport_t *self,
   tport_params_t tpp[1], *tpp0;
 
   usize_t mtu;
-  int connect, sdwn_error, reusable, stun_server, pong2ping;
+  int connect, sdwn_error, reusable, stun_server, pong2ping, reuseport;
 
   if (self == NULL)
     return su_seterrno(EINVAL);
@@ -1276,6 +1294,7 @@ int tport_set_params(tport_t *self,
   reusable = self->tp_reusable;
   stun_server = tpp->tpp_stun_server;
   pong2ping = tpp->tpp_pong2ping;
+  reuseport = tpp->tpp_reuseport;
 
   ta_start(ta, tag, value);
 
@@ -1287,6 +1306,7 @@ int tport_set_params(tport_t *self,
 	      TPTAG_KEEPALIVE_REF(tpp->tpp_keepalive),
 	      TPTAG_PINGPONG_REF(tpp->tpp_pingpong),
 	      TPTAG_PONG2PING_REF(pong2ping),
+	      TPTAG_REUSEPORT_REF(reuseport),
 	      TPTAG_DEBUG_DROP_REF(tpp->tpp_drop),
 	      TPTAG_THRPSIZE_REF(tpp->tpp_thrpsize),
 	      TPTAG_THRPRQSIZE_REF(tpp->tpp_thrprqsize),
@@ -1328,6 +1348,7 @@ int tport_set_params(tport_t *self,
   self->tp_reusable = reusable;
   tpp->tpp_stun_server = stun_server;
   tpp->tpp_pong2ping = pong2ping;
+  tpp->tpp_reuseport = reuseport;
 
   if (memcmp(tpp0, tpp, sizeof tpp) == 0)
     return n + m;
@@ -3043,6 +3064,26 @@ tport_base_deliver(tport_t *self, msg_t *msg, su_time_t now)
   STACK_RECV(self, msg, now);
 }
 
+/** Deliver a message received by another transport master.
+ *
+ * Pass a datagram message, received and parsed by another transport
+ * master (usually one running in another thread and sharing the same port
+ * with SO_REUSEPORT), to the stack of primary transport @a self as if it
+ * had been received by @a self. The source address is taken from the
+ * message.
+ *
+ * @NEW_UNRELEASED.
+ */
+void tport_deliver_forwarded(tport_t *self, msg_t *msg)
+{
+  if (self == NULL || msg == NULL || !tport_is_primary(self)) {
+    msg_destroy(msg);
+    return;
+  }
+
+  tport_deliver(self, msg, NULL, NULL, su_now());
+}
+
 /** Return source transport object for delivered message */
 tport_t *tport_delivered_by(tport_t const *tp, msg_t const *msg)
 {
@@ -122,6 +122,7 @@ typedef struct {
   unsigned tpp_sdwn_error:1;	/**< If true, shutdown is error. */
   unsigned tpp_stun_server:1;	/**< If true, use stun server */
   unsigned tpp_pong2ping:1;	/**< If true, respond with pong to ping */
+  unsigned tpp_reuseport:1;	/**< If true, bind with SO_REUSEPORT */
 
   unsigned :0;
 
@@ -408,6 +409,7 @@ int tport_primary_compression(tport_primary_t *pri,
 			      tagi_t const *tl);
 
 void tport_set_tos(su_socket_t socket, su_addrinfo_t *ai, int tos);
+void tport_set_reuseport(su_socket_t socket, int reuseport);
 
 tport_t *tport_base_connect(tport_primary_t *pri,
 			    su_addrinfo_t *ai,
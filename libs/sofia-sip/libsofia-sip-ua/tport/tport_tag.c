@@ -239,6 +239,25 @@ tag_typedef_t tptag_pingpong = UINTTAG_TYPEDEF(pingpong);
  */
 tag_typedef_t tptag_pong2ping = BOOLTAG_TYPEDEF(pong2ping);
 
+/**@def TPTAG_REUSEPORT(x)
+ *
+ * Share the listening port with other sockets.
+ *
+ * If true, set SO_REUSEPORT on primary sockets before binding them, so
+ * that several transport masters (usually one per thread) can bind the
+ * same address and port, and the kernel spreads incoming datagrams and
+ * connections between them. Default value is 0 (false). Ignored on
+ * platforms without SO_REUSEPORT.
+ *
+ * Use with tport_tcreate(), tport_tbind(), nua_create(),
+ * nta_agent_create() or nta_agent_add_tport().
+ *
+ * @sa TPTAG_REUSE()
+ *
+ * @NEW_UNRELEASED.
+ */
+tag_typedef_t tptag_reuseport = BOOLTAG_TYPEDEF(reuseport);
+
 /**@def TPTAG_SIGCOMP_LIFETIME(x)
  *
  * Default SigComp lifetime in seconds.
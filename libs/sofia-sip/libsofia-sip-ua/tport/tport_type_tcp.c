@@ -149,6 +149,8 @@ int tport_stream_init_primary(tport_primary_t *pri,
   su_setreuseaddr(socket, 1);
 #endif
 
+  tport_set_reuseport(socket, pri->pri_params->tpp_reuseport);
+
   if (tport_bind_socket(socket, ai, return_culprit) == -1)
     return -1;
 
@@ -139,6 +139,8 @@ int tport_udp_init_primary(tport_primary_t *pri,
 
   pri->pri_primary->tp_socket = s;
 
+  tport_set_reuseport(s, pri->pri_params->tpp_reuseport);
+
   if (tport_bind_socket(s, ai, return_culprit) < 0)
     return -1;
 
@@ -47,6 +47,13 @@
 #include "aes.h"
 #include "err.h"
 
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+    && (defined(__x86_64__) || defined(__i386__)) && !defined(SRTP_NO_AESNI)
+#define AES_HAVE_AESNI 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif
+
 /* 
  * we use the tables T0, T1, T2, T3, and T4 to compute AES, and 
  * the tables U0, U1, U2, and U4 to compute its inverse
@@ -1998,9 +2005,108 @@ aes_inv_final_round(v128_t *state, const v128_t *round_key) {
 #endif  /* CPU type */
 
 
+/*
+ * on x86 cpus with the AES instructions the block functions below
+ * hand off to AES-NI; the round keys need no conversion since the
+ * decryption schedule is already in equivalent inverse cipher form
+ */
+
+#ifdef AES_HAVE_AESNI
+
+static int aesni_available = -1;
+
+static int
+aes_has_aesni(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (aesni_available < 0) {
+    aesni_available = (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES)) ? 1 : 0;
+  }
+
+  return aesni_available;
+}
+
+static __attribute__((target("aes,sse2"))) void
+aes_encrypt_aesni(v128_t *block, const aes_expanded_key_t *exp_key) {
+  const __m128i *rk = (const __m128i *) exp_key->round;
+  __m128i s;
+  int i;
+
+  s = _mm_xor_si128(_mm_loadu_si128((const __m128i *) block), _mm_loadu_si128(rk));
+  for (i = 1; i < exp_key->num_rounds; i++)
+    s = _mm_aesenc_si128(s, _mm_loadu_si128(rk + i));
+  s = _mm_aesenclast_si128(s, _mm_loadu_si128(rk + exp_key->num_rounds));
+  _mm_storeu_si128((__m128i *) block, s);
+}
+
+static __attribute__((target("aes,sse2"))) void
+aes_decrypt_aesni(v128_t *block, const aes_expanded_key_t *exp_key) {
+  const __m128i *rk = (const __m128i *) exp_key->round;
+  __m128i s;
+  int i;
+
+  s = _mm_xor_si128(_mm_loadu_si128((const __m128i *) block), _mm_loadu_si128(rk));
+  for (i = 1; i < exp_key->num_rounds; i++)
+    s = _mm_aesdec_si128(s, _mm_loadu_si128(rk + i));
+  s = _mm_aesdeclast_si128(s, _mm_loadu_si128(rk + exp_key->num_rounds));
+  _mm_storeu_si128((__m128i *) block, s);
+}
+
+/* four independent blocks in flight hide the aesenc latency */
+static __attribute__((target("aes,sse2"))) void
+aes_encrypt_4_aesni(v128_t *blocks, const aes_expanded_key_t *exp_key) {
+  const __m128i *rk = (const __m128i *) exp_key->round;
+  __m128i k, s0, s1, s2, s3;
+  int i;
+
+  k = _mm_loadu_si128(rk);
+  s0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &blocks[0]), k);
+  s1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &blocks[1]), k);
+  s2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &blocks[2]), k);
+  s3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &blocks[3]), k);
+
+  for (i = 1; i < exp_key->num_rounds; i++) {
+    k = _mm_loadu_si128(rk + i);
+    s0 = _mm_aesenc_si128(s0, k);
+    s1 = _mm_aesenc_si128(s1, k);
+    s2 = _mm_aesenc_si128(s2, k);
+    s3 = _mm_aesenc_si128(s3, k);
+  }
+
+  k = _mm_loadu_si128(rk + exp_key->num_rounds);
+  _mm_storeu_si128((__m128i *) &blocks[0], _mm_aesenclast_si128(s0, k));
+  _mm_storeu_si128((__m128i *) &blocks[1], _mm_aesenclast_si128(s1, k));
+  _mm_storeu_si128((__m128i *) &blocks[2], _mm_aesenclast_si128(s2, k));
+  _mm_storeu_si128((__m128i *) &blocks[3], _mm_aesenclast_si128(s3, k));
+}
+
+#endif /* AES_HAVE_AESNI */
+
+void
+aes_encrypt_blocks(v128_t *blocks, int num_blocks, const aes_expanded_key_t *exp_key) {
+  int i = 0;
+
+#ifdef AES_HAVE_AESNI
+  if (aes_has_aesni()) {
+    for (; i + 4 <= num_blocks; i += 4)
+      aes_encrypt_4_aesni(&blocks[i], exp_key);
+  }
+#endif
+
+  for (; i < num_blocks; i++)
+    aes_encrypt(&blocks[i], exp_key);
+}
+
 void
 aes_encrypt(v128_t *plaintext, const aes_expanded_key_t *exp_key) {
 
+#ifdef AES_HAVE_AESNI
+  if (aes_has_aesni()) {
+    aes_encrypt_aesni(plaintext, exp_key);
+    return;
+  }
+#endif
+
   /* add in the subkey */
   v128_xor_eq(plaintext, &exp_key->round[0]);
 
@@ -2034,6 +2140,13 @@ aes_encrypt(v128_t *plaintext, const aes_expanded_key_t *exp_key) {
 void
 aes_decrypt(v128_t *plaintext, const aes_expanded_key_t *exp_key) {
 
+#ifdef AES_HAVE_AESNI
+  if (aes_has_aesni()) {
+    aes_decrypt_aesni(plaintext, exp_key);
+    return;
+  }
+#endif
+
   /* add in the subkey */
   v128_xor_eq(plaintext, &exp_key->round[0]);
 
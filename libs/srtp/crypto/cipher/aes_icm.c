@@ -377,6 +377,28 @@ aes_icm_encrypt_ismacryp(aes_icm_ctx_t *c,
 
   }
   
+  /* generate keystream four blocks at a time while we can */
+  if (!forIsmacryp) {
+    v128_t ks[4];
+    unsigned int j;
+
+    while (bytes_to_encr >= 4 * sizeof(v128_t)) {
+      for (j = 0; j < 4; j++) {
+        v128_copy(&ks[j], &c->counter);
+        if (!++(c->counter.v8[15]))
+          ++(c->counter.v8[14]);
+      }
+
+      aes_encrypt_blocks(ks, 4, &c->expanded_key);
+
+      for (j = 0; j < 4 * sizeof(v128_t); j++)
+        buf[j] ^= ((uint8_t *) ks)[j];
+
+      buf += 4 * sizeof(v128_t);
+      bytes_to_encr -= 4 * sizeof(v128_t);
+    }
+  }
+
   /* now loop over entire 16-byte blocks of keystream */
   for (i=0; i < (bytes_to_encr/sizeof(v128_t)); i++) {
 
@@ -75,6 +75,14 @@ aes_encrypt(v128_t *plaintext, const aes_expanded_key_t *exp_key);
 void
 aes_decrypt(v128_t *plaintext, const aes_expanded_key_t *exp_key);
 
+/*
+ * aes_encrypt_blocks(blocks, n, key) encrypts n independent blocks in
+ * place, several at a time when the cpu has AES instructions
+ */
+
+void
+aes_encrypt_blocks(v128_t *blocks, int num_blocks, const aes_expanded_key_t *exp_key);
+
 #if 0
 /*
  * internal functions 
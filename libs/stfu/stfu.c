@@ -60,6 +60,35 @@ struct stfu_queue {
 };
 typedef struct stfu_queue stfu_queue_t;
 
+/* adaptive engine: frames live in a ring indexed by seq so insert and lookup are O(1),
+   the playout delay follows an RFC 3550 style interarrival jitter estimate */
+#define STFU_ADAPT_MIN_RING 16
+#define STFU_ADAPT_SHRINK_READS 50
+#define STFU_ADAPT_CALM_READS 500
+
+struct stfu_adaptive {
+    struct stfu_frame *ring;
+    uint32_t ring_size;
+    uint32_t count;
+    uint16_t next_seq;
+    uint16_t high_seq;
+    uint32_t next_ts;
+    uint8_t playing;
+    uint32_t clock;
+    uint32_t last_arrival;
+    uint32_t last_ts;
+    uint32_t jitter;
+    uint32_t target;
+    uint32_t max_target;
+    uint32_t spike;
+    uint32_t calm_reads;
+    uint32_t over_reads;
+    uint32_t late_count;
+    uint32_t lost_count;
+    uint32_t dropped_count;
+};
+typedef struct stfu_adaptive stfu_adaptive_t;
+
 struct stfu_instance {
 	struct stfu_queue a_queue;
 	struct stfu_queue b_queue;
@@ -125,6 +154,8 @@ struct stfu_instance {
     char *name;
     stfu_n_call_me_t callback;
     void *udata;
+
+    stfu_adaptive_t *adaptive;
 };
 
 static void stfu_n_reset_counters(stfu_instance_t *i);
@@ -213,6 +244,10 @@ void stfu_n_destroy(stfu_instance_t **i)
 		free(ii->a_queue.array);
 		free(ii->b_queue.array);
 		free(ii->c_queue.array);
+        if (ii->adaptive) {
+            free(ii->adaptive->ring);
+            free(ii->adaptive);
+        }
 		free(ii);
 	}
 }
@@ -230,6 +265,303 @@ void stfu_n_debug(stfu_instance_t *i, const char *name)
     }
 }
 
+
+static uint32_t stfu_a_ring_size(uint32_t max_qlen)
+{
+    uint32_t size = STFU_ADAPT_MIN_RING;
+
+    while (size < max_qlen + 1 && size < 32768) {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+static void stfu_a_reset(stfu_instance_t *i)
+{
+    stfu_adaptive_t *a = i->adaptive;
+    uint32_t x;
+
+    for (x = 0; x < a->ring_size; x++) {
+        a->ring[x].was_read = 1;
+    }
+
+    a->count = 0;
+    a->playing = 0;
+    a->over_reads = 0;
+    a->last_arrival = 0;
+    a->last_ts = 0;
+    i->miss_count = 0;
+    i->last_frame = NULL;
+}
+
+static void stfu_a_update_target(stfu_instance_t *i)
+{
+    stfu_adaptive_t *a = i->adaptive;
+    uint32_t spp = least1(i->samples_per_packet);
+    uint32_t target;
+
+    /* one packet plus three times the smoothed interarrival jitter, plus whatever recent late packets asked for */
+    target = 1 + (a->jitter * 3 + spp / 2) / spp + a->spike;
+
+    if (target > a->max_target) {
+        target = a->max_target;
+    }
+
+    if (target != a->target && stfu_log != null_logger && i->debug) {
+        stfu_log(STFU_LOG_EMERG, "%s ADAPT target %u -> %u jitter %u spike %u\n", i->name, a->target, target, a->jitter, a->spike);
+    }
+
+    a->target = i->qlen = target;
+
+    if (target > i->most_qlen) {
+        i->most_qlen = target;
+    }
+}
+
+stfu_status_t stfu_n_set_adaptive(stfu_instance_t *i, int adaptive)
+{
+    stfu_adaptive_t *a;
+
+    if (!adaptive) {
+        if (i->adaptive) {
+            free(i->adaptive->ring);
+            free(i->adaptive);
+            i->adaptive = NULL;
+            i->qlen = i->orig_qlen;
+            stfu_n_reset(i);
+        }
+        return STFU_IT_WORKED;
+    }
+
+    if (i->adaptive) {
+        return STFU_IT_WORKED;
+    }
+
+    if (!(a = calloc(1, sizeof(*a)))) {
+        return STFU_IT_FAILED;
+    }
+
+    a->ring_size = stfu_a_ring_size(i->max_qlen > i->qlen ? i->max_qlen : i->qlen);
+
+    if (!(a->ring = calloc(a->ring_size, sizeof(struct stfu_frame)))) {
+        free(a);
+        return STFU_IT_FAILED;
+    }
+
+    a->max_target = a->ring_size - 1;
+    if (i->max_qlen && i->max_qlen < a->max_target) {
+        a->max_target = i->max_qlen;
+    }
+
+    a->target = i->qlen ? i->qlen : 1;
+    i->adaptive = a;
+    stfu_a_reset(i);
+
+    return STFU_IT_WORKED;
+}
+
+static stfu_status_t stfu_a_add_data(stfu_instance_t *i, uint32_t ts, uint16_t seq, uint32_t pt, void *data, size_t datalen, uint32_t timer_ts)
+{
+    stfu_adaptive_t *a = i->adaptive;
+    stfu_frame_t *frame;
+    uint32_t now = timer_ts ? timer_ts : a->clock;
+    size_t cplen;
+    int16_t diff;
+
+    i->period_packet_in_count++;
+    i->session_packet_in_count++;
+
+    if (a->playing || a->count) {
+        diff = (int16_t)(seq - a->next_seq);
+
+        if (diff < 0) {
+            if (a->playing || (uint16_t)(a->high_seq - seq) >= a->ring_size) {
+                /* it missed its slot, make room for the next one like it */
+                a->late_count++;
+                a->calm_reads = 0;
+                if (a->spike < a->max_target) {
+                    a->spike++;
+                }
+                if (stfu_log != null_logger && i->debug) {
+                    stfu_log(STFU_LOG_EMERG, "%s TOO LATE !!! %u:%u\n", i->name, ts, seq);
+                }
+                return STFU_ITS_TOO_LATE;
+            }
+            a->next_seq = seq;
+        } else if ((uint32_t) diff >= a->ring_size) {
+            stfu_a_reset(i);
+        }
+    }
+
+    if (!a->playing && !a->count) {
+        a->next_seq = a->high_seq = seq;
+    }
+
+    frame = &a->ring[seq & (a->ring_size - 1)];
+
+    if (!frame->was_read) {
+        if (frame->seq == seq) {
+            return STFU_ITS_TOO_LATE;
+        }
+        a->count--;
+    }
+
+    if ((cplen = datalen) > sizeof(frame->data)) {
+        cplen = sizeof(frame->data);
+    }
+
+    memcpy(frame->data, data, cplen);
+    frame->pt = pt;
+    frame->ts = ts;
+    frame->seq = seq;
+    frame->dlen = cplen;
+    frame->was_read = 0;
+    frame->plc = 0;
+    a->count++;
+
+    if (a->last_ts && ts > a->last_ts) {
+        int32_t d = (int32_t)(now - a->last_arrival) - (int32_t)(ts - a->last_ts);
+        int32_t cap = (int32_t)(i->samples_per_packet * a->max_target);
+
+        if (d < 0) {
+            d = -d;
+        }
+        if (d > cap) {
+            d = cap;
+        }
+        a->jitter = (uint32_t)((int32_t) a->jitter + (d - (int32_t) a->jitter) / 16);
+    }
+
+    if (seq == (uint16_t)(a->high_seq + 1)) {
+        i->period_clean_count++;
+        i->session_clean_count++;
+    }
+
+    if ((int16_t)(seq - a->high_seq) >= 0) {
+        a->high_seq = seq;
+        a->last_ts = ts;
+        a->last_arrival = now;
+    }
+
+    i->last_rd_ts = ts;
+    i->packet_count++;
+
+    return STFU_IT_WORKED;
+}
+
+static stfu_frame_t *stfu_a_read_a_frame(stfu_instance_t *i)
+{
+    stfu_adaptive_t *a = i->adaptive;
+    uint32_t mask = a->ring_size - 1;
+    stfu_frame_t *frame;
+
+    a->clock += i->samples_per_packet;
+
+    if (a->spike && ++a->calm_reads >= STFU_ADAPT_CALM_READS) {
+        a->spike--;
+        a->calm_reads = 0;
+    }
+
+    stfu_a_update_target(i);
+
+    if (!a->playing) {
+        if (!a->count || (uint32_t)(uint16_t)(a->high_seq - a->next_seq) + 1 < a->target) {
+            return NULL;
+        }
+        a->playing = 1;
+        a->over_reads = 0;
+        a->next_ts = a->ring[a->next_seq & mask].ts;
+    }
+
+    /* sitting above target for a while means we are carrying latency we do not need, drop the oldest frame */
+    if (a->count > a->target) {
+        if (++a->over_reads >= STFU_ADAPT_SHRINK_READS) {
+            frame = &a->ring[a->next_seq & mask];
+            if (!frame->was_read && frame->seq == a->next_seq) {
+                frame->was_read = 1;
+                a->count--;
+            }
+            a->next_seq++;
+            a->next_ts += i->samples_per_packet;
+            a->dropped_count++;
+            a->over_reads = 0;
+        }
+    } else {
+        a->over_reads = 0;
+    }
+
+    frame = &a->ring[a->next_seq & mask];
+
+    /* holes we already concealed while stalled on them are skipped rather than concealed twice */
+    while ((frame->was_read || frame->seq != a->next_seq) && a->count && i->miss_count) {
+        a->lost_count++;
+        a->next_seq++;
+        a->next_ts += i->samples_per_packet;
+        i->miss_count--;
+        frame = &a->ring[a->next_seq & mask];
+    }
+
+    if (!frame->was_read && frame->seq == a->next_seq) {
+        frame->was_read = 1;
+        a->count--;
+        a->next_seq++;
+        a->next_ts = frame->ts + i->samples_per_packet;
+
+        i->consecutive_good_count++;
+        i->period_good_count++;
+        i->consecutive_bad_count = 0;
+        i->period_packet_out_count++;
+        i->session_packet_out_count++;
+        i->miss_count = 0;
+        i->last_frame = frame;
+        i->last_wr_ts = frame->ts;
+        if (frame->dlen) {
+            i->plc_len = frame->dlen;
+        }
+        i->plc_pt = frame->pt;
+
+        return frame;
+    }
+
+    i->consecutive_bad_count++;
+    i->period_bad_count++;
+    i->consecutive_good_count = 0;
+    i->period_missing_count++;
+    i->session_missing_count++;
+
+    if (!i->plc_len) {
+        return NULL;
+    }
+
+    frame = &i->out_queue->int_frame;
+    frame->dlen = i->plc_len;
+    frame->pt = i->plc_pt;
+    frame->ts = a->next_ts;
+    frame->seq = a->next_seq;
+
+    if (a->count) {
+        /* a real hole, conceal it and move on */
+        a->lost_count++;
+        a->next_seq++;
+        a->next_ts += i->samples_per_packet;
+        i->miss_count = 0;
+    } else if (++i->miss_count > i->max_plc + a->target) {
+        /* dried up, start buffering again */
+        stfu_a_reset(i);
+        return NULL;
+    }
+
+    /* on an underrun next_seq stays put so the concealed frame stretches the playout delay */
+    i->last_wr_ts = frame->ts;
+
+    if (stfu_log != null_logger && i->debug) {
+        stfu_log(STFU_LOG_EMERG, "%s PLC %u %u:%u count %u target %u\n", i->name, i->miss_count, frame->ts, frame->seq, a->count, a->target);
+    }
+
+    return frame;
+}
+
 void stfu_n_report(stfu_instance_t *i, stfu_report_t *r)
 {
     stfu_assert(i);
@@ -244,6 +576,11 @@ stfu_status_t stfu_n_resize(stfu_instance_t *i, uint32_t qlen)
 {
     stfu_status_t s;
 
+    if (i->adaptive) {
+        i->adaptive->target = i->qlen = qlen > i->adaptive->max_target ? i->adaptive->max_target : qlen;
+        return STFU_IT_WORKED;
+    }
+
     if (i->qlen == i->max_qlen) {
         return STFU_IT_FAILED;
     }
@@ -345,6 +682,12 @@ void stfu_n_reset(stfu_instance_t *i)
         stfu_log(STFU_LOG_EMERG, "%s RESET\n", i->name);
     }
 
+    if (i->adaptive) {
+        stfu_n_reset_counters(i);
+        stfu_a_reset(i);
+        return;
+    }
+
     i->ready = 0;
 	i->in_queue = &i->a_queue;
 	i->out_queue = &i->b_queue;
@@ -374,6 +717,12 @@ void stfu_n_reset(stfu_instance_t *i)
 stfu_status_t stfu_n_sync(stfu_instance_t *i, uint32_t packets)
 {
 
+    if (i->adaptive) {
+        /* the socket was flushed, whatever we hold is stale */
+        stfu_a_reset(i);
+        return STFU_IT_WORKED;
+    }
+
     if (packets > i->qlen) {
         stfu_n_reset(i);
     } else {
@@ -432,6 +781,13 @@ stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint16_t seq, uin
             return STFU_IT_FAILED;
         }
     }
+
+    if (i->adaptive) {
+        if (last) {
+            return STFU_IM_DONE;
+        }
+        return stfu_a_add_data(i, ts, seq, pt, data, datalen, timer_ts);
+    }
  
     if (timer_ts) {
         if (ts && !i->ts_offset) {
@@ -642,6 +998,10 @@ stfu_frame_t *stfu_n_read_a_frame(stfu_instance_t *i)
 	if (!i->samples_per_packet) {
         return NULL;
     }
+
+    if (i->adaptive) {
+        return stfu_a_read_a_frame(i);
+    }
     
     if (!i->ready) {
         if (stfu_log != null_logger && i->debug) {
@@ -825,11 +1185,19 @@ STFU_DECLARE(int32_t) stfu_n_copy_next_frame(stfu_instance_t *jb, uint32_t times
 
 	uint32_t target_ts = 0;
 
-#ifdef WIN32
-	UNREFERENCED_PARAMETER(seq);
-#endif
 	if (!next_frame) return 0;
 
+	if (jb->adaptive) {
+		uint16_t want = (uint16_t)(seq + distance);
+
+		frame = &jb->adaptive->ring[want & (jb->adaptive->ring_size - 1)];
+		if (!frame->was_read && frame->seq == want) {
+			memcpy(next_frame, frame, sizeof(stfu_frame_t));
+			return 1;
+		}
+		return 0;
+	}
+
 	target_ts = timestamp + (distance - 1) * jb->samples_per_packet;
 
 	for (i = 0; i < sizeof(queues)/sizeof(queues[0]); i++) {
@@ -0,0 +1,247 @@
+/*
+ * Trace replay harness for the stfu jitter buffer.
+ *
+ * Feeds recorded (or generated) packet arrival patterns through the classic and the
+ * adaptive engine on a fixed playout clock and reports delay and loss for both.
+ */
+#include "stfu.h"
+#include <math.h>
+
+typedef struct {
+	double arrival;				/* seconds */
+	uint16_t seq;
+	uint32_t ts;
+} packet_t;
+
+typedef struct {
+	packet_t *packets;
+	int count;
+	int alloc;
+} trace_t;
+
+typedef struct {
+	long frames;
+	long played;
+	long concealed;
+	long silent;
+	double delay_sum;
+	double delay_max;
+	double *delays;
+} result_t;
+
+static uint32_t rate = 8000;
+static uint32_t ptime = 20;
+static unsigned int seed = 42;
+
+static double rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) & 0xffffff) / 16777216.0;
+}
+
+static void trace_add(trace_t *trace, double arrival, uint16_t seq, uint32_t ts)
+{
+	if (trace->count == trace->alloc) {
+		trace->alloc = trace->alloc ? trace->alloc * 2 : 1024;
+		trace->packets = realloc(trace->packets, trace->alloc * sizeof(packet_t));
+		assert(trace->packets);
+	}
+
+	trace->packets[trace->count].arrival = arrival;
+	trace->packets[trace->count].seq = seq;
+	trace->packets[trace->count].ts = ts;
+	trace->count++;
+}
+
+static int by_arrival(const void *a, const void *b)
+{
+	double d = ((const packet_t *) a)->arrival - ((const packet_t *) b)->arrival;
+	return d < 0 ? -1 : d > 0;
+}
+
+static int by_double(const void *a, const void *b)
+{
+	double d = *(const double *) a - *(const double *) b;
+	return d < 0 ? -1 : d > 0;
+}
+
+static int trace_load(trace_t *trace, const char *path)
+{
+	FILE *f;
+	char line[256];
+	double arrival;
+	unsigned int seq;
+	unsigned long ts;
+
+	if (!(f = fopen(path, "r"))) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (*line == '#' || sscanf(line, "%lf %u %lu", &arrival, &seq, &ts) != 3) {
+			continue;
+		}
+		trace_add(trace, arrival, (uint16_t) seq, (uint32_t) ts);
+	}
+
+	fclose(f);
+
+	return trace->count ? 0 : -1;
+}
+
+/* 15000 packets with 1% loss and a 50ms network delay on top of the given jitter pattern */
+static void trace_generate(trace_t *trace, int pattern)
+{
+	uint32_t spp = rate * ptime / 1000;
+	int n;
+
+	seed = 42;
+
+	for (n = 0; n < 15000; n++) {
+		double jitter;
+
+		if (rnd() < 0.01) {
+			continue;
+		}
+
+		switch (pattern) {
+		case 0:
+			jitter = rnd() * 2;
+			break;
+		case 1:
+			jitter = rnd() * 40;
+			break;
+		case 2:
+			jitter = rnd() * 2 + (rnd() < 0.02 ? rnd() * 150 : 0);
+			break;
+		default:
+			jitter = (n / 1500) % 2 ? rnd() * 60 : rnd() * 2;
+			break;
+		}
+
+		trace_add(trace, (n * ptime + 50 + jitter) / 1000.0, (uint16_t) (n + 1000), n * spp + 5000);
+	}
+
+	qsort(trace->packets, trace->count, sizeof(packet_t), by_arrival);
+}
+
+static void replay(trace_t *trace, int adaptive, result_t *r)
+{
+	uint32_t spp = rate * ptime / 1000, ts0 = trace->packets[0].ts, clock_ts;
+	double start = trace->packets[0].arrival, base = 1e9, end, now;
+	uint8_t data[1920] = { 0 };
+	stfu_instance_t *jb;
+	int i, k = 0;
+
+	/* the fastest packet sets the network delay, everything on top of it is jitter buffer delay */
+	for (i = 0; i < trace->count; i++) {
+		double sent = (int32_t) (trace->packets[i].ts - ts0) / (double) rate;
+		if (trace->packets[i].arrival - start - sent < base) {
+			base = trace->packets[i].arrival - start - sent;
+		}
+	}
+
+	memset(r, 0, sizeof(*r));
+	r->delays = calloc(trace->count, sizeof(double));
+	assert(r->delays);
+
+	jb = stfu_n_init(3, 50, spp, rate, 0);
+	if (adaptive) {
+		stfu_n_set_adaptive(jb, 1);
+	}
+
+	end = trace->packets[trace->count - 1].arrival + 1.0;
+
+	for (now = start, clock_ts = 0; now < end; now += ptime / 1000.0, clock_ts += spp) {
+		stfu_frame_t *frame;
+
+		while (k < trace->count && trace->packets[k].arrival <= now) {
+			stfu_n_eat(jb, trace->packets[k].ts, trace->packets[k].seq, 0, data, spp * 2, clock_ts);
+			k++;
+		}
+
+		r->frames++;
+
+		if (!(frame = stfu_n_read_a_frame(jb))) {
+			r->silent++;
+		} else if (frame->plc) {
+			r->concealed++;
+		} else {
+			double delay = (now - start) - (int32_t) (frame->ts - ts0) / (double) rate - base;
+
+			r->delays[r->played++] = delay;
+			r->delay_sum += delay;
+			if (delay > r->delay_max) {
+				r->delay_max = delay;
+			}
+		}
+	}
+
+	stfu_n_destroy(&jb);
+}
+
+static void report(const char *name, trace_t *trace)
+{
+	int adaptive;
+
+	for (adaptive = 0; adaptive < 2; adaptive++) {
+		result_t r;
+		double p95 = 0;
+
+		replay(trace, adaptive, &r);
+
+		if (r.played) {
+			qsort(r.delays, r.played, sizeof(double), by_double);
+			p95 = r.delays[(long) (r.played * 0.95)];
+		}
+
+		printf("%-12s %-8s packets %6d played %6ld lost %5.2f%% concealed %5ld silent %5ld delay avg %6.1f p95 %6.1f max %6.1f ms\n",
+			   name, adaptive ? "adaptive" : "classic", trace->count, r.played,
+			   100.0 * (trace->count - r.played) / trace->count, r.concealed, r.silent,
+			   1000 * r.delay_sum / (r.played ? r.played : 1), 1000 * p95, 1000 * r.delay_max);
+
+		free(r.delays);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *patterns[] = { "clean", "jitter40", "spikes150", "alternating" };
+	trace_t trace;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+			rate = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+			ptime = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [-r rate] [-p ptime_ms] [trace.txt ...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (i == argc) {
+		for (i = 0; i < 4; i++) {
+			memset(&trace, 0, sizeof(trace));
+			trace_generate(&trace, i);
+			report(patterns[i], &trace);
+			free(trace.packets);
+		}
+		return 0;
+	}
+
+	for (; i < argc; i++) {
+		memset(&trace, 0, sizeof(trace));
+		if (trace_load(&trace, argv[i])) {
+			fprintf(stderr, "%s: no packets\n", argv[i]);
+			continue;
+		}
+		qsort(trace.packets, trace.count, sizeof(packet_t), by_arrival);
+		report(argv[i], &trace);
+		free(trace.packets);
+	}
+
+	return 0;
+}
@@ -88,5 +88,94 @@ uint8_t ulaw_to_alaw(uint8_t ulaw)
 	return ulaw_to_alaw_table[ulaw];
 }
 
+/*- End of function --------------------------------------------------------*/
+
+/* Whole-range linear to law tables, indexed by the 16 bit sample taken as unsigned, and the 256 entry law to linear
+   tables.  Filled in once by g711_tables_init(). */
+static uint8_t linear_to_ulaw_table[65536];
+static uint8_t linear_to_alaw_table[65536];
+static int16_t ulaw_to_linear_table[256];
+static int16_t alaw_to_linear_table[256];
+static int g711_tables_ready = 0;
+
+void g711_tables_init(void)
+{
+	int i;
+
+	if (g711_tables_ready) {
+		return;
+	}
+
+	for (i = 0; i < 65536; i++) {
+		linear_to_ulaw_table[i] = linear_to_ulaw((int16_t) i);
+		linear_to_alaw_table[i] = linear_to_alaw((int16_t) i);
+	}
+
+	for (i = 0; i < 256; i++) {
+		ulaw_to_linear_table[i] = ulaw_to_linear((uint8_t) i);
+		alaw_to_linear_table[i] = alaw_to_linear((uint8_t) i);
+	}
+
+	g711_tables_ready = 1;
+}
+
+/*- End of function --------------------------------------------------------*/
+
+/* Byte table lookups gain nothing from SIMD gathers, so the block loops are kept
+   branch free and unrolled four wide to keep the loads pipelined instead. */
+#define G711_BLOCK(_table, _idx_t, _src, _dst, _len) \
+	do { \
+		int _i = 0; \
+		for (; _i + 4 <= (_len); _i += 4) { \
+			(_dst)[_i] = _table[(_idx_t) (_src)[_i]]; \
+			(_dst)[_i + 1] = _table[(_idx_t) (_src)[_i + 1]]; \
+			(_dst)[_i + 2] = _table[(_idx_t) (_src)[_i + 2]]; \
+			(_dst)[_i + 3] = _table[(_idx_t) (_src)[_i + 3]]; \
+		} \
+		for (; _i < (_len); _i++) { \
+			(_dst)[_i] = _table[(_idx_t) (_src)[_i]]; \
+		} \
+	} while (0)
+
+void ulaw_encode_block(const int16_t *linear, uint8_t *ulaw, int samples)
+{
+	G711_BLOCK(linear_to_ulaw_table, uint16_t, linear, ulaw, samples);
+}
+
+/*- End of function --------------------------------------------------------*/
+
+void alaw_encode_block(const int16_t *linear, uint8_t *alaw, int samples)
+{
+	G711_BLOCK(linear_to_alaw_table, uint16_t, linear, alaw, samples);
+}
+
+/*- End of function --------------------------------------------------------*/
+
+void ulaw_decode_block(const uint8_t *ulaw, int16_t *linear, int samples)
+{
+	G711_BLOCK(ulaw_to_linear_table, uint8_t, ulaw, linear, samples);
+}
+
+/*- End of function --------------------------------------------------------*/
+
+void alaw_decode_block(const uint8_t *alaw, int16_t *linear, int samples)
+{
+	G711_BLOCK(alaw_to_linear_table, uint8_t, alaw, linear, samples);
+}
+
+/*- End of function --------------------------------------------------------*/
+
+void ulaw_to_alaw_block(const uint8_t *ulaw, uint8_t *alaw, int samples)
+{
+	G711_BLOCK(ulaw_to_alaw_table, uint8_t, ulaw, alaw, samples);
+}
+
+/*- End of function --------------------------------------------------------*/
+
+void alaw_to_ulaw_block(const uint8_t *alaw, uint8_t *ulaw, int samples)
+{
+	G711_BLOCK(alaw_to_ulaw_table, uint8_t, alaw, ulaw, samples);
+}
+
 /*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -335,6 +335,31 @@ extern "C" {
 */
 	uint8_t ulaw_to_alaw(uint8_t ulaw);
 
+/*! \brief Build the lookup tables used by the block routines below.  Must be called once before they are used. */
+	void g711_tables_init(void);
+
+/*! \brief Encode a block of linear samples to u-law by table lookup.
+    \param linear The linear samples.
+    \param ulaw The u-law output.
+    \param samples The number of samples.
+*/
+	void ulaw_encode_block(const int16_t *linear, uint8_t *ulaw, int samples);
+
+/*! \brief Encode a block of linear samples to A-law by table lookup. */
+	void alaw_encode_block(const int16_t *linear, uint8_t *alaw, int samples);
+
+/*! \brief Decode a block of u-law samples to linear by table lookup. */
+	void ulaw_decode_block(const uint8_t *ulaw, int16_t *linear, int samples);
+
+/*! \brief Decode a block of A-law samples to linear by table lookup. */
+	void alaw_decode_block(const uint8_t *alaw, int16_t *linear, int samples);
+
+/*! \brief Transcode a block of u-law samples straight to A-law, using the G.711 tables. */
+	void ulaw_to_alaw_block(const uint8_t *ulaw, uint8_t *alaw, int samples);
+
+/*! \brief Transcode a block of A-law samples straight to u-law, using the G.711 tables. */
+	void alaw_to_ulaw_block(const uint8_t *alaw, uint8_t *ulaw, int samples);
+
 #ifdef __cplusplus
 }
 #endif
@@ -87,6 +87,7 @@
 
 #define SWITCH_BUFFER_BLOCK_FRAMES 25
 #define SWITCH_BUFFER_START_FRAMES 50
+#define SWITCH_BUG_RING_FRAMES 128
 
 typedef enum {
 	SSF_NONE = 0,
@@ -104,6 +105,8 @@ typedef enum {
 } switch_session_flag_t;
 
 
+typedef struct switch_media_bug_ring switch_media_bug_ring_t;
+
 struct switch_core_session {
 	switch_memory_pool_t *pool;
 	switch_thread_t *thread;
@@ -152,6 +155,8 @@ struct switch_core_session {
 	switch_queue_t *private_event_queue_pri;
 	switch_thread_rwlock_t *bug_rwlock;
 	switch_media_bug_t *bugs;
+	switch_media_bug_ring_t *bug_read_ring;
+	switch_media_bug_ring_t *bug_write_ring;
 	switch_app_log_t *app_log;
 	uint32_t stack_count;
 
@@ -180,9 +185,21 @@ struct switch_core_session {
 	switch_media_handle_t *media_handle;
 };
 
+/* audio seen by the bugs on a session, written once per frame and
+   consumed by each attached bug through its own read_pos/write_pos */
+struct switch_media_bug_ring {
+	uint8_t *data;
+	switch_size_t size;
+	switch_size_t head;
+	switch_mutex_t *mutex;
+};
+
 struct switch_media_bug {
+	/* private copies, only for bugs that can't share the session ring */
 	switch_buffer_t *raw_write_buffer;
 	switch_buffer_t *raw_read_buffer;
+	switch_size_t read_pos;
+	switch_size_t write_pos;
 	switch_frame_t *read_replace_frame_in;
 	switch_frame_t *read_replace_frame_out;
 	switch_frame_t *write_replace_frame_in;
@@ -276,6 +293,16 @@ struct switch_runtime {
 	char *core_db_inner_pre_trans_execute;
 	char *core_db_inner_post_trans_execute;
 	int events_use_dispatch;
+	char *prompt_cache_dir;
+	uint32_t prompt_cache_max_sec;
+	uint32_t prompt_cache_max_mb;
+	uint32_t prompt_cache_max_entries;
+	char *recovery_journal;
+	uint32_t recovery_journal_size_mb;
+	char *recovery_journal_listen;
+	char *recovery_journal_standby;
+	char *recovery_journal_acl;
+	char *recovery_journal_secret;
 };
 
 extern struct switch_runtime runtime;
@@ -311,3 +338,20 @@ void switch_core_session_uninit(void);
 void switch_core_state_machine_init(switch_memory_pool_t *pool);
 switch_memory_pool_t *switch_core_memory_init(void);
 void switch_core_memory_stop(void);
+void switch_ivr_record_async_init(switch_memory_pool_t *pool);
+void switch_ivr_record_async_shutdown(void);
+switch_size_t switch_core_media_bug_ring_push(switch_media_bug_ring_t *ring, const void *data, switch_size_t len);
+void switch_core_media_bug_ring_deliver(switch_media_bug_t *bug, switch_media_bug_flag_t stream, switch_size_t mark,
+										 const void *data, switch_size_t len, switch_bool_t own);
+void switch_core_media_bug_ring_skip(switch_media_bug_t *bug, switch_media_bug_flag_t stream, switch_size_t mark);
+switch_bool_t switch_core_prompt_cache_ready(void);
+void switch_core_recovery_journal_init(void);
+void switch_core_recovery_journal_shutdown(void);
+switch_bool_t switch_core_recovery_journal_ready(void);
+void switch_core_recovery_journal_track(switch_core_session_t *session, const char *technology, const char *profile_name);
+void switch_core_recovery_journal_untrack(switch_core_session_t *session);
+void switch_core_recovery_journal_flush(const char *technology, const char *profile_name);
+int switch_core_recovery_journal_recover(const char *technology, const char *profile_name);
+int switch_core_recovery_resurrect(const char *technology, switch_xml_t xml);
+switch_bool_t switch_core_g711_transcode(const switch_codec_implementation_t *src_impl, const switch_codec_implementation_t *dst_impl,
+										  switch_frame_t *src, switch_frame_t *dst);
@@ -451,6 +451,21 @@ SWITCH_DECLARE(uint32_t) switch_atomic_read(volatile switch_atomic_t *mem);
  */
 SWITCH_DECLARE(void) switch_atomic_set(volatile switch_atomic_t *mem, uint32_t val);
 
+/**
+ * Read the uint32 value at mem with acquire ordering, nothing the caller reads afterwards
+ * can be satisfied before it.  Pairs with switch_atomic_set_release.
+ * @param mem The location of memory which stores the value to read.
+ */
+SWITCH_DECLARE(uint32_t) switch_atomic_read_acquire(volatile switch_atomic_t *mem);
+
+/**
+ * Set the uint32 value at mem with release ordering, everything the caller wrote before
+ * is visible to a thread that sees val through switch_atomic_read_acquire.
+ * @param mem The location of memory to set.
+ * @param val The uint32 value to set at the memory location.
+ */
+SWITCH_DECLARE(void) switch_atomic_set_release(volatile switch_atomic_t *mem, uint32_t val);
+
 /**
  * Uses an atomic operation to add the uint32 value to the value at the
  * specified location of memory.
@@ -1017,6 +1032,31 @@ SWITCH_DECLARE(switch_status_t) switch_threadattr_detach_set(switch_threadattr_t
 SWITCH_DECLARE(switch_status_t) switch_thread_create(switch_thread_t ** new_thread, switch_threadattr_t *attr,
 													 switch_thread_start_t func, void *data, switch_memory_pool_t *cont);
 
+/** Opaque thread private key structure. */
+	 typedef struct apr_threadkey_t switch_threadkey_t;
+
+/**
+ * Create and initialize a new thread private address space
+ * @param key The thread private handle.
+ * @param dest The destructor to use when freeing the private memory, may be NULL.
+ * @param pool The pool to use
+ */
+SWITCH_DECLARE(switch_status_t) switch_threadkey_private_create(switch_threadkey_t ** key, void (*dest) (void *), switch_memory_pool_t *pool);
+
+/**
+ * Get a pointer to the thread private memory
+ * @param new_mem The data stored in private memory
+ * @param key The handle for the desired thread private memory
+ */
+SWITCH_DECLARE(switch_status_t) switch_threadkey_private_get(void **new_mem, switch_threadkey_t *key);
+
+/**
+ * Set the data to be stored in thread private memory
+ * @param priv The data to be stored in private memory
+ * @param key The handle for the desired thread private memory
+ */
+SWITCH_DECLARE(switch_status_t) switch_threadkey_private_set(void *priv, switch_threadkey_t *key);
+
 /** @} */
 
 /**
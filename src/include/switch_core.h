@@ -228,6 +228,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_pop(switch_core_session_t
 								
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_exec_all(switch_core_session_t *orig_session, 
 															   const char *function, switch_media_bug_exec_cb_t cb, void *user_data);
+/*! \brief count the live media bugs on a session, all of them when function is NULL */
 SWITCH_DECLARE(uint32_t) switch_core_media_bug_count(switch_core_session_t *orig_session, const char *function);
 /*!
   \brief Add a media bug to the session
@@ -1833,6 +1834,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_close(_In_ switch_file_handle_t
 
 SWITCH_DECLARE(switch_status_t) switch_core_file_truncate(switch_file_handle_t *fh, int64_t offset);
 
+/*!
+  \brief Find the file mod_sndfile would play for a path, looking in the <dir>/<rate>/ sub directories first
+  \param path the path as given to playback
+  \param rate the preferred sample rate
+  \return the resolved path (malloc'd, free it), or a copy of path when no rate directory applies
+*/
+SWITCH_DECLARE(char *) switch_core_file_resolve_rate_path(const char *path, uint32_t rate);
+
 
 ///\}
 
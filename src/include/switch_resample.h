@@ -67,6 +67,8 @@ SWITCH_BEGIN_EXTERN_C
 	uint32_t to_len;
 	/*! the total size of the to buffer */
 	uint32_t to_size;
+	/*! fixed point polyphase state, used instead of resampler for integer rate ratios */
+	void *polyphase;
 
 } switch_audio_resampler_t;
 
@@ -167,6 +169,50 @@ SWITCH_DECLARE(void) switch_change_sln_volume(int16_t *data, uint32_t samples, i
   \param vol the volume factor -12 -> 12
  */
 SWITCH_DECLARE(void) switch_change_sln_volume_granular(int16_t *data, uint32_t samples, int32_t vol);
+
+/*!
+  \brief Sum of the absolute sample values of a signed linear frame
+  \param data the audio data
+  \param samples the number of samples to look at
+  \param stride the distance between two of those samples, the channel count for one channel of an interleaved frame
+  \return the sum
+ */
+SWITCH_DECLARE(uint32_t) switch_sln_energy(const int16_t *data, uint32_t samples, uint32_t stride);
+
+/*!
+  \brief Largest absolute sample value of a signed linear frame
+  \param data the audio data
+  \param samples the number of samples to look at
+  \param stride the distance between two of those samples
+  \return the peak, 0 -> 32768
+ */
+SWITCH_DECLARE(uint32_t) switch_sln_peak(const int16_t *data, uint32_t samples, uint32_t stride);
+
+/*!
+  \brief Root mean square of a signed linear frame
+  \param data the audio data
+  \param samples the number of samples to look at
+  \param stride the distance between two of those samples
+  \return the rms level
+ */
+SWITCH_DECLARE(uint32_t) switch_sln_rms(const int16_t *data, uint32_t samples, uint32_t stride);
+
+/*!
+  \brief Count the sign changes between neighbouring samples of a signed linear frame
+  \param data the audio data
+  \param samples the number of samples to look at
+  \param stride the distance between two of those samples
+  \return the number of zero crossings
+ */
+SWITCH_DECLARE(uint32_t) switch_sln_zero_crossings(const int16_t *data, uint32_t samples, uint32_t stride);
+
+/*!
+  \brief Multiply a signed linear frame by a factor, clamping to 16 bit
+  \param data the audio data
+  \param samples the number of 2 byte samples
+  \param factor the gain
+ */
+SWITCH_DECLARE(void) switch_sln_scale(int16_t *data, uint32_t samples, double factor);
 ///\}
 
 SWITCH_DECLARE(uint32_t) switch_merge_sln(int16_t *data, uint32_t samples, int16_t *other_data, uint32_t other_samples);
@@ -285,6 +285,14 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_deactivate_jitter_buffer(switch_rtp_t
 SWITCH_DECLARE(switch_status_t) switch_rtp_pause_jitter_buffer(switch_rtp_t *rtp_session, switch_bool_t pause);
 SWITCH_DECLARE(stfu_instance_t *) switch_rtp_get_jitter_buffer(switch_rtp_t *rtp_session);
 
+/*!
+  \brief Forward media received on one RTP session straight out of another
+  \param rtp_session the receiving RTP session
+  \param peer the session to send on, NULL to stop relaying
+  \return SWITCH_STATUS_SUCCESS if the relay was changed
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_set_relay(switch_rtp_t *rtp_session, switch_rtp_t *peer);
+
 /*!
   \brief Set an RTP Flag
   \param rtp_session the RTP session
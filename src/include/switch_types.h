@@ -576,6 +576,7 @@ typedef struct {
 	switch_size_t cng_packet_count;
 	switch_size_t flush_packet_count;
 	switch_size_t largest_jb_size;
+	switch_size_t relay_packet_count;
 } switch_rtp_numbers_t;
 
 
@@ -617,6 +618,7 @@ typedef enum {
 	SWITCH_RTP_FLAG_BUGGY_2833    - Emulate the bug in cisco equipment to allow interop
 	SWITCH_RTP_FLAG_PASS_RFC2833  - Pass 2833 (ignore it)
 	SWITCH_RTP_FLAG_AUTO_CNG      - Generate outbound CNG frames when idle    
+	SWITCH_RTP_FLAG_ADAPTIVE_JB   - Use the adaptive jitter buffer engine
 </pre>
  */
 typedef enum {
@@ -653,6 +655,7 @@ typedef enum {
 	SWITCH_RTP_FLAG_ENABLE_RTCP,
 	SWITCH_RTP_FLAG_RTCP_MUX,
 	SWITCH_RTP_FLAG_KILL_JB,
+	SWITCH_RTP_FLAG_ADAPTIVE_JB,
 	SWITCH_RTP_FLAG_INVALID
 } switch_rtp_flag_t;
 
@@ -1618,7 +1621,9 @@ typedef enum {
 	SWITCH_FILE_WRITE_APPEND = (1 << 15),
 	SWITCH_FILE_WRITE_OVER = (1 << 16),
 	SWITCH_FILE_NOMUX = (1 << 17),
-	SWITCH_FILE_BREAK_ON_CHANGE = (1 << 18)
+	SWITCH_FILE_BREAK_ON_CHANGE = (1 << 18),
+	SWITCH_FILE_NO_CACHE = (1 << 19),
+	SWITCH_FILE_PROMPT = (1 << 20)
 } switch_file_flag_enum_t;
 typedef uint32_t switch_file_flag_t;
 
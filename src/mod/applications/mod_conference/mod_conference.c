@@ -65,7 +65,18 @@ static int EC = 0;
 #define CONF_DBLOCK_SIZE CONF_BUFFER_SIZE
 #define CONF_DBUFFER_SIZE CONF_BUFFER_SIZE
 #define CONF_DBUFFER_MAX 0
+/* bytes in each member's audio hand-off ring, must be a power of two */
+#define CONF_RING_SIZE (1024 * 64)
+/* largest video packet the conference relays */
+#define CONF_VIDEO_FRAME_SIZE (1024 * 64)
+/* frames of mixed audio a recording can fall behind before frames are dropped (~10s at 20ms) */
+#define CONF_RECORD_RING_FRAMES 512
+/* frames handed to the file layer per write */
+#define CONF_RECORD_BATCH_FRAMES 50
 #define CONF_CHAT_PROTO "conf"
+/* nodes a cascaded call has already passed through, carried on the leg to the peer */
+#define CONF_CASCADE_VARIABLE "conference_cascade_path"
+#define CONF_CASCADE_SIP_HEADER "X-Conference-Cascade"
 
 #ifndef MIN
 #define MIN(a, b) ((a)<(b)?(a):(b))
@@ -121,7 +132,8 @@ typedef struct conference_cdr_node_s {
 typedef enum {
 	CDRR_LOCKED = 1,
 	CDRR_PIN,
-	CDRR_MAXMEMBERS
+	CDRR_MAXMEMBERS,
+	CDRR_CASCADE_LOOP
 } cdr_reject_reason_t;
 
 typedef struct conference_cdr_reject_s {
@@ -181,7 +193,7 @@ typedef enum {
 	MFLAG_NOMOH = (1 << 19),
 	MFLAG_VIDEO_BRIDGE = (1 << 20),
 	MFLAG_INDICATE_MUTE_DETECT = (1 << 21),
-	MFLAG_PAUSE_RECORDING = (1 << 22)
+	MFLAG_CASCADE = (1 << 22)
 } member_flag_t;
 
 typedef enum {
@@ -288,12 +300,83 @@ struct vid_helper {
 
 struct conference_obj;
 
+/* Member of a cascaded peer conference, learned from the peer's member events */
+typedef struct conference_remote_member {
+	char *node;
+	uint32_t id;
+	char *name;
+	char *uuid;
+	char *caller_id_name;
+	char *caller_id_number;
+	struct conference_remote_member *next;
+} conference_remote_member_t;
+
+/* Single producer / single consumer byte ring between a member's I/O threads and the conference thread.
+   head only moves on the producer side and tail only on the consumer side so neither ever takes a lock. */
+typedef struct conference_ring {
+	uint8_t *data;
+	uint32_t size;
+	volatile switch_atomic_t head;
+	volatile switch_atomic_t tail;
+} conference_ring_t;
+
+/* Copy-on-write snapshot of the member list, rebuilt on every add/del and read by the conference thread without locks */
+typedef struct conference_member_list {
+	uint32_t gen;
+	uint32_t count;
+	struct conference_member_list *next;
+	conference_member_t *members[1];
+} conference_member_list_t;
+
+/* Members whose codec rate differs from the conference rate are grouped by rate.  Each domain is summed at its own
+   rate and crosses the rate boundary once in each direction per tick instead of once per member.  Owned by the conference thread. */
+typedef struct conference_rate_domain {
+	uint32_t rate;
+	uint32_t samples;
+	uint32_t active;
+	int mixed;
+	switch_audio_resampler_t *up;
+	switch_audio_resampler_t *down;
+	int32_t sum[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	int16_t up_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	int16_t mix[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	struct conference_rate_domain *next;
+} conference_rate_domain_t;
+
+typedef enum {
+	RECFLAG_RUNNING = (1 << 0),
+	RECFLAG_STREAMING = (1 << 1),
+	RECFLAG_PAUSED = (1 << 2),
+	RECFLAG_BACKPRESSURE = (1 << 3)
+} record_flag_t;
+
+/* One file written from a recording's mix (a recording may have several, e.g. wav + mp3) */
+typedef struct conference_record_output {
+	char *path;
+	switch_file_handle_t fh;
+	struct conference_record_output *next;
+} conference_record_output_t;
+
 /* Record Node */
 typedef struct conference_record {
 	struct conference_obj *conference;
 	char *path;
 	switch_memory_pool_t *pool;
 	switch_bool_t autorec;
+	uint32_t flags;
+	switch_time_t start_time;
+	conference_record_output_t *outputs;
+	conference_cdr_node_t *cdr_node;
+	/* single producer (mixer) / single consumer (record thread) frame ring */
+	int16_t *ring;
+	int16_t *batch;
+	uint32_t ring_frames;
+	uint32_t frame_samples;
+	volatile switch_atomic_t ring_head;
+	volatile switch_atomic_t ring_tail;
+	volatile switch_atomic_t dropped;
+	uint32_t reported_dropped;
+	uint32_t written;
 	struct conference_record *next;
 } conference_record_t;
 
@@ -346,6 +429,19 @@ typedef struct conference_obj {
 	uint32_t interval;
 	switch_mutex_t *mutex;
 	conference_member_t *members;
+	conference_member_list_t *member_list;
+	conference_member_list_t *retired_lists;
+	uint32_t member_gen;
+	volatile switch_atomic_t mix_gen;
+	volatile switch_atomic_t mixing;
+	/* recordings the conference thread feeds, its own copy of rec_node_head refreshed when rec_gen moves */
+	conference_record_t **rec_feed;
+	uint32_t rec_feed_count;
+	uint32_t rec_feed_alloc;
+	uint32_t rec_feed_gen;
+	volatile switch_atomic_t rec_gen;
+	volatile switch_atomic_t rec_mix_gen;
+	conference_rate_domain_t *rate_domains;
 	conference_member_t *floor_holder;
 	conference_member_t *video_floor_holder;
 	switch_mutex_t *member_mutex;
@@ -397,6 +493,9 @@ typedef struct conference_obj {
 	struct vid_helper vh[2];
 	struct vid_helper mh;
 	conference_record_t *rec_node_head;
+	int cascade_count;
+	switch_event_t *cascade_nodes;
+	conference_remote_member_t *remote_members;
 } conference_obj_t;
 
 /* Relationship with another member */
@@ -413,8 +512,8 @@ struct conference_member {
 	switch_channel_t *channel;
 	conference_obj_t *conference;
 	switch_memory_pool_t *pool;
-	switch_buffer_t *audio_buffer;
-	switch_buffer_t *mux_buffer;
+	conference_ring_t in_ring;
+	conference_ring_t out_ring;
 	switch_buffer_t *resample_buffer;
 	uint32_t flags;
 	uint32_t score;
@@ -422,8 +521,6 @@ struct conference_member {
 	uint32_t score_iir;
 	switch_mutex_t *flag_mutex;
 	switch_mutex_t *write_mutex;
-	switch_mutex_t *audio_in_mutex;
-	switch_mutex_t *audio_out_mutex;
 	switch_mutex_t *read_mutex;
 	switch_mutex_t *fnode_mutex;
 	switch_thread_rwlock_t *rwlock;
@@ -431,9 +528,6 @@ struct conference_member {
 	switch_codec_implementation_t orig_read_impl;
 	switch_codec_t read_codec;
 	switch_codec_t write_codec;
-	char *rec_path;
-	switch_time_t rec_time;
-	conference_record_t *rec;
 	uint8_t *frame;
 	uint8_t *last_frame;
 	uint32_t frame_size;
@@ -449,9 +543,14 @@ struct conference_member {
 	switch_time_t join_time;
 	switch_time_t last_talking;
 	uint32_t native_rate;
+	/* rate the member trades audio with the mixer at, its own codec rate when that differs from the conference */
+	uint32_t mix_rate;
+	conference_rate_domain_t *domain;
+	/* conference rate copy of frame, used when relationships force per member mixing */
+	int16_t *mix_frame;
+	uint32_t mix_read;
 	switch_audio_resampler_t *read_resampler;
-	int16_t *resample_out;
-	uint32_t resample_out_len;
+	switch_audio_resampler_t *write_resampler;
 	conference_file_node_t *fnode;
 	conference_relationship_t *relationships;
 	switch_speech_handle_t lsh;
@@ -466,6 +565,7 @@ struct conference_member {
 	char *kicked_sound;
 	switch_queue_t *dtmf_queue;
 	switch_thread_t *input_thread;
+	char *cascade_path;
 };
 
 typedef enum {
@@ -535,7 +635,7 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_c
 static switch_status_t chat_send(switch_event_t *message_event);
 								 
 
-static void launch_conference_record_thread(conference_obj_t *conference, char *path, switch_bool_t autorec);
+static void launch_conference_record_thread(conference_obj_t *conference, char **paths, int npaths, switch_bool_t autorec);
 static int launch_conference_video_bridge_thread(conference_member_t *member_a, conference_member_t *member_b);
 
 typedef switch_status_t (*conf_api_args_cmd_t) (conference_obj_t *, switch_stream_handle_t *, int, char **);
@@ -583,7 +683,6 @@ static void conference_cdr_add(conference_member_t *member)
 	member->cdr_node->member = member;
 
 	if (!member->session) {
-		member->cdr_node->record_path = switch_core_strdup(member->conference->pool, member->rec_path);
 		return;
 	}
 
@@ -1021,6 +1120,8 @@ static void conference_cdr_render(conference_obj_t *conference)
 			switch_xml_set_txt_d(x_ptr, "max_members_reached");
 		} else 	if (rp->reason == CDRR_PIN) {
 			switch_xml_set_txt_d(x_ptr, "invalid_pin");
+		} else if (rp->reason == CDRR_CASCADE_LOOP) {
+			switch_xml_set_txt_d(x_ptr, "cascade_loop");
 		}
 
 		if (!(x_ptr = switch_xml_add_child_d(x_attempt, "reject_time", tag_off++))) {
@@ -1134,6 +1235,10 @@ static switch_status_t conference_add_event_member_data(conference_member_t *mem
 	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Energy-Level", "%d", member->energy_level);
 	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Current-Energy", "%d", member->score);
 
+	if (switch_test_flag(member, MFLAG_CASCADE)) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Cascade", "true");
+	}
+
 	return status;
 }
 
@@ -1221,24 +1326,50 @@ static conference_member_t *conference_member_get(conference_obj_t *conference,
 	return member;
 }
 
+/* match a recording by its full path string or by any one of its outputs */
+static switch_bool_t conference_record_match(conference_record_t *rec, const char *path)
+{
+	conference_record_output_t *op;
+
+	if (!path || !strcmp(path, rec->path)) {
+		return SWITCH_TRUE;
+	}
+
+	for (op = rec->outputs; op; op = op->next) {
+		if (!strcmp(path, op->path)) {
+			return SWITCH_TRUE;
+		}
+	}
+
+	return SWITCH_FALSE;
+}
+
+/* Note a change to the recording list or a recording's flags, flag_mutex must be held.
+   Returns the generation to hand conference_record_wait. */
+static uint32_t conference_record_publish(conference_obj_t *conference)
+{
+	switch_atomic_inc(&conference->rec_gen);
+	return switch_atomic_read(&conference->rec_gen);
+}
+
 /* stop the specified recording */
 static switch_status_t conference_record_stop(conference_obj_t *conference, switch_stream_handle_t *stream, char *path)
 {
-	conference_member_t *member = NULL;
+	conference_record_t *rec;
 	int count = 0;
 
 	switch_assert(conference != NULL);
-	switch_mutex_lock(conference->member_mutex);
-	for (member = conference->members; member; member = member->next) {
-		if (switch_test_flag(member, MFLAG_NOCHANNEL) && (!path || !strcmp(path, member->rec_path))) {
-			if (member->rec && member->rec->autorec) {
-				stream->write_function(stream, "Stopped AUTO recording file %s (Auto Recording Now Disabled)\n", member->rec_path);
+	switch_mutex_lock(conference->flag_mutex);
+	for (rec = conference->rec_node_head; rec; rec = rec->next) {
+		if (switch_test_flag(rec, RECFLAG_RUNNING) && conference_record_match(rec, path)) {
+			if (rec->autorec) {
+				stream->write_function(stream, "Stopped AUTO recording file %s (Auto Recording Now Disabled)\n", rec->path);
 				conference->auto_record = 0;
 			} else {
-				stream->write_function(stream, "Stopped recording file %s\n", member->rec_path);
+				stream->write_function(stream, "Stopped recording file %s\n", rec->path);
 			}
 
-			switch_clear_flag_locked(member, MFLAG_RUNNING);
+			switch_clear_flag(rec, RECFLAG_RUNNING);
 			count++;
 
 		}
@@ -1246,44 +1377,128 @@ static switch_status_t conference_record_stop(conference_obj_t *conference, swit
 
 	conference->record_count -= count;
 
-	switch_mutex_unlock(conference->member_mutex);
+	if (count) {
+		conference_record_publish(conference);
+	}
+
+	switch_mutex_unlock(conference->flag_mutex);
 	return count;
 }
 /* stop/pause/resume the specified recording */
 static switch_status_t conference_record_action(conference_obj_t *conference, char *path, recording_action_type_t action)
 {
-	conference_member_t *member = NULL;
+	conference_record_t *rec;
 	int count = 0;
-	//switch_file_handle_t *fh = NULL;
 
 	switch_assert(conference != NULL);
-	switch_mutex_lock(conference->member_mutex);
-	for (member = conference->members; member; member = member->next)
-	{
-		if (switch_test_flag(member, MFLAG_NOCHANNEL) && (!path || !strcmp(path, member->rec_path)))
-		{
-			//switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG,	"Action: %d\n", action);
-			switch (action)
-			{
-				case REC_ACTION_STOP:
-						switch_clear_flag_locked(member, MFLAG_RUNNING);
-						count++;
-						break;
-				case REC_ACTION_PAUSE:
-						switch_set_flag_locked(member, MFLAG_PAUSE_RECORDING);
-						count = 1;
-						break;
-				case REC_ACTION_RESUME:
-						switch_clear_flag_locked(member, MFLAG_PAUSE_RECORDING);
-						count = 1;
-						break;
-					}
-				}
+	switch_mutex_lock(conference->flag_mutex);
+	for (rec = conference->rec_node_head; rec; rec = rec->next) {
+		if (switch_test_flag(rec, RECFLAG_RUNNING) && conference_record_match(rec, path)) {
+			switch (action) {
+			case REC_ACTION_STOP:
+				switch_clear_flag(rec, RECFLAG_RUNNING);
+				count++;
+				break;
+			case REC_ACTION_PAUSE:
+				switch_set_flag(rec, RECFLAG_PAUSED);
+				count = 1;
+				break;
+			case REC_ACTION_RESUME:
+				switch_clear_flag(rec, RECFLAG_PAUSED);
+				count = 1;
+				break;
 			}
-	switch_mutex_unlock(conference->member_mutex);
+		}
+	}
+
+	if (count) {
+		conference_record_publish(conference);
+	}
+
+	switch_mutex_unlock(conference->flag_mutex);
 	return count;
 }
 
+/* Called by the conference thread every tick.  Only when rec_gen moved does it look at rec_node_head and
+   even then it never waits for flag_mutex, a busy mutex just means one more tick on the old copy. */
+static void conference_record_feed_acquire(conference_obj_t *conference)
+{
+	conference_record_t *rec;
+	uint32_t gen;
+
+	if (switch_atomic_read_acquire(&conference->rec_gen) == conference->rec_feed_gen) {
+		return;
+	}
+
+	if (switch_mutex_trylock(conference->flag_mutex) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	gen = switch_atomic_read(&conference->rec_gen);
+	conference->rec_feed_count = 0;
+
+	for (rec = conference->rec_node_head; rec; rec = rec->next) {
+		if (!switch_test_flag(rec, RECFLAG_STREAMING) || !switch_test_flag(rec, RECFLAG_RUNNING) || switch_test_flag(rec, RECFLAG_PAUSED)) {
+			continue;
+		}
+
+		if (conference->rec_feed_count == conference->rec_feed_alloc) {
+			conference->rec_feed_alloc = conference->rec_feed_alloc ? conference->rec_feed_alloc * 2 : 4;
+			conference->rec_feed = realloc(conference->rec_feed, conference->rec_feed_alloc * sizeof(*conference->rec_feed));
+			switch_assert(conference->rec_feed);
+		}
+
+		conference->rec_feed[conference->rec_feed_count++] = rec;
+	}
+
+	switch_mutex_unlock(conference->flag_mutex);
+
+	conference->rec_feed_gen = gen;
+	switch_atomic_set_release(&conference->rec_mix_gen, gen);
+}
+
+/* Wait until the conference thread has picked up generation gen (or stopped), after that it no longer
+   touches a recording that stopped streaming before gen was published. */
+static void conference_record_wait(conference_obj_t *conference, uint32_t gen)
+{
+	while (switch_atomic_read(&conference->mixing) && (int32_t) (switch_atomic_read_acquire(&conference->rec_mix_gen) - gen) < 0) {
+		switch_cond_next();
+	}
+}
+
+/* Hand one mixed frame (or silence when data is NULL) to every streaming recording.
+   Called once per tick from the conference thread; it only copies into each ring and never waits on disk. */
+static void conference_record_feed(conference_obj_t *conference, int16_t *data, uint32_t samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < conference->rec_feed_count; i++) {
+		conference_record_t *rec = conference->rec_feed[i];
+		uint32_t head, tail;
+		int16_t *slot;
+
+		/* only this thread moves head, the tail read pairs with the record thread's release */
+		head = switch_atomic_read(&rec->ring_head);
+		tail = switch_atomic_read_acquire(&rec->ring_tail);
+
+		if (head - tail >= rec->ring_frames) {
+			/* the writer is behind, drop the frame rather than stall the mix */
+			switch_atomic_inc(&rec->dropped);
+			continue;
+		}
+
+		slot = rec->ring + (head % rec->ring_frames) * rec->frame_samples;
+
+		if (data) {
+			memcpy(slot, data, MIN(samples, rec->frame_samples) * sizeof(int16_t));
+		} else {
+			memset(slot, 0, rec->frame_samples * sizeof(int16_t));
+		}
+
+		/* the slot must be visible to the record thread before the new head is */
+		switch_atomic_set_release(&rec->ring_head, head + 1);
+	}
+}
 
 /* Add a custom relationship to a member */
 static conference_relationship_t *member_add_relationship(conference_member_t *member, uint32_t id)
@@ -1423,6 +1638,397 @@ static void send_conference_notify(conference_obj_t *conference, const char *sta
 }
 
 
+/* add or remove every node of a cascade path from the set of nodes this conference already reaches */
+static void conference_cascade_nodes_set(conference_obj_t *conference, const char *path, switch_bool_t add)
+{
+	char *dup, *argv[64] = { 0 };
+	int argc, x;
+
+	if (zstr(path) || !(dup = strdup(path))) {
+		return;
+	}
+
+	argc = switch_separate_string(dup, ',', argv, (sizeof(argv) / sizeof(argv[0])));
+
+	for (x = 0; x < argc; x++) {
+		if (zstr(argv[x])) {
+			continue;
+		}
+
+		if (add) {
+			if (!conference->cascade_nodes) {
+				switch_event_create_plain(&conference->cascade_nodes, SWITCH_EVENT_CHANNEL_DATA);
+			}
+			if (!switch_event_get_header(conference->cascade_nodes, argv[x])) {
+				switch_event_add_header_string(conference->cascade_nodes, SWITCH_STACK_BOTTOM, argv[x], "true");
+			}
+		} else if (conference->cascade_nodes) {
+			switch_event_del_header(conference->cascade_nodes, argv[x]);
+		}
+	}
+
+	free(dup);
+}
+
+/* the path sent to a peer: this node followed by every node already reached through other cascades */
+static char *conference_cascade_outbound_path(conference_obj_t *conference)
+{
+	switch_stream_handle_t stream = { 0 };
+	switch_event_header_t *hp;
+
+	SWITCH_STANDARD_STREAM(stream);
+	stream.write_function(&stream, "%s", switch_core_get_switchname());
+
+	switch_mutex_lock(conference->member_mutex);
+	if (conference->cascade_nodes) {
+		for (hp = conference->cascade_nodes->headers; hp; hp = hp->next) {
+			if (strcasecmp(hp->name, switch_core_get_switchname())) {
+				stream.write_function(&stream, ",%s", hp->name);
+			}
+		}
+	}
+	switch_mutex_unlock(conference->member_mutex);
+
+	return (char *) stream.data;
+}
+
+/* forget the remote members of one peer node, or of all of them when node is NULL.  member_mutex must be held. */
+static void conference_cascade_forget(conference_obj_t *conference, const char *node, uint32_t id)
+{
+	conference_remote_member_t *rp, *last = NULL, *next;
+
+	for (rp = conference->remote_members; rp; rp = next) {
+		next = rp->next;
+
+		if (node && (strcasecmp(rp->node, node) || (id && rp->id != id))) {
+			last = rp;
+			continue;
+		}
+
+		if (last) {
+			last->next = next;
+		} else {
+			conference->remote_members = next;
+		}
+
+		switch_safe_free(rp->node);
+		switch_safe_free(rp->name);
+		switch_safe_free(rp->uuid);
+		switch_safe_free(rp->caller_id_name);
+		switch_safe_free(rp->caller_id_number);
+		free(rp);
+	}
+}
+
+/* announce every local member to the peers so their member lists include ours */
+static void conference_cascade_sync(conference_obj_t *conference)
+{
+	conference_member_t *member;
+	switch_event_t *event;
+
+	switch_mutex_lock(conference->member_mutex);
+	for (member = conference->members; member; member = member->next) {
+		if (switch_test_flag(member, MFLAG_NOCHANNEL) || switch_test_flag(member, MFLAG_CASCADE)) {
+			continue;
+		}
+
+		if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+			conference_add_event_member_data(member, event);
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "cascade-member");
+			switch_event_fire(&event);
+		}
+	}
+	switch_mutex_unlock(conference->member_mutex);
+}
+
+/* Pick up the cascade path of a member's leg.  Inbound cascades that would reach a node
+   this conference already reaches (or this node itself) are refused to keep the cascade a tree. */
+static switch_status_t conference_cascade_check(conference_obj_t *conference, conference_member_t *member)
+{
+	const char *path, *local = switch_core_get_switchname();
+	char *dup, *argv[64] = { 0 };
+	int argc, x;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	if (!(path = switch_channel_get_variable(member->channel, CONF_CASCADE_VARIABLE))) {
+		path = switch_channel_get_variable(member->channel, "sip_h_" CONF_CASCADE_SIP_HEADER);
+	}
+
+	if (zstr(path)) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_set_flag(member, MFLAG_CASCADE);
+
+	/* our own leg towards a peer carries our path, nothing to check */
+	if (switch_channel_direction(member->channel) != SWITCH_CALL_DIRECTION_INBOUND) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	member->cascade_path = switch_core_session_strdup(member->session, path);
+
+	if (!(dup = strdup(path))) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	argc = switch_separate_string(dup, ',', argv, (sizeof(argv) / sizeof(argv[0])));
+
+	switch_mutex_lock(conference->member_mutex);
+	for (x = 0; x < argc; x++) {
+		if (!strcasecmp(argv[x], local) || (conference->cascade_nodes && switch_event_get_header(conference->cascade_nodes, argv[x]))) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_WARNING,
+							  "Cascade [%s] into %s would loop through %s, refusing it\n", path, conference->name, argv[x]);
+			status = SWITCH_STATUS_FALSE;
+			break;
+		}
+	}
+	switch_mutex_unlock(conference->member_mutex);
+
+	free(dup);
+
+	return status;
+}
+
+/* a cascade leg joined, called with conference->mutex held */
+static void conference_cascade_add(conference_obj_t *conference, conference_member_t *member)
+{
+	switch_event_t *event;
+
+	switch_mutex_lock(conference->member_mutex);
+	conference->cascade_count++;
+	conference_cascade_nodes_set(conference, member->cascade_path, SWITCH_TRUE);
+	switch_mutex_unlock(conference->member_mutex);
+
+	/* the peer sends a mix that is already gated by its own members' energy levels */
+	member->energy_level = 0;
+
+	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+		conference_add_event_member_data(member, event);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "cascade-join");
+		switch_event_fire(&event);
+	}
+
+	conference_cascade_sync(conference);
+}
+
+/* a cascade leg left, called with conference->mutex held */
+static void conference_cascade_del(conference_obj_t *conference, conference_member_t *member)
+{
+	switch_mutex_lock(conference->member_mutex);
+	conference_cascade_nodes_set(conference, member->cascade_path, SWITCH_FALSE);
+
+	if (!--conference->cascade_count) {
+		conference_cascade_forget(conference, NULL, 0);
+		switch_event_destroy(&conference->cascade_nodes);
+	}
+	switch_mutex_unlock(conference->member_mutex);
+}
+
+/* Track the members of cascaded peers from their conference::maintenance events (relayed e.g. by mod_event_multicast) */
+static void conference_cascade_event_handler(switch_event_t *event)
+{
+	const char *node = switch_event_get_header(event, "FreeSWITCH-Switchname");
+	const char *action = switch_event_get_header(event, "Action");
+	const char *name = switch_event_get_header(event, "Conference-Name");
+	const char *id_str = switch_event_get_header(event, "Member-ID");
+	uint32_t id = id_str ? (uint32_t) atoi(id_str) : 0;
+	conference_obj_t *conference;
+
+	if (zstr(node) || zstr(action) || zstr(name) || !strcasecmp(node, switch_core_get_switchname())) {
+		return;
+	}
+
+	if (!(conference = conference_find((char *) name, NULL))) {
+		return;
+	}
+
+	if (!conference->cascade_count) {
+		goto done;
+	}
+
+	if (!strcasecmp(action, "cascade-join")) {
+		conference_cascade_sync(conference);
+		goto done;
+	}
+
+	switch_mutex_lock(conference->member_mutex);
+	if (!strcasecmp(action, "add-member") || !strcasecmp(action, "cascade-member")) {
+		/* the peer's own cascade legs carry our audio, they are not members */
+		if (id && !switch_true(switch_event_get_header(event, "Cascade"))) {
+			conference_remote_member_t *rp;
+
+			conference_cascade_forget(conference, node, id);
+
+			switch_zmalloc(rp, sizeof(*rp));
+			rp->node = strdup(node);
+			rp->id = id;
+			rp->name = strdup(switch_str_nil(switch_event_get_header(event, "Channel-Name")));
+			rp->uuid = strdup(switch_str_nil(switch_event_get_header(event, "Unique-ID")));
+			rp->caller_id_name = strdup(switch_str_nil(switch_event_get_header(event, "Caller-Caller-ID-Name")));
+			rp->caller_id_number = strdup(switch_str_nil(switch_event_get_header(event, "Caller-Caller-ID-Number")));
+			rp->next = conference->remote_members;
+			conference->remote_members = rp;
+		}
+		conference_cascade_nodes_set(conference, node, SWITCH_TRUE);
+	} else if (!strcasecmp(action, "del-member")) {
+		if (id) {
+			conference_cascade_forget(conference, node, id);
+		}
+	} else if (!strcasecmp(action, "conference-destroy")) {
+		conference_cascade_forget(conference, node, 0);
+		conference_cascade_nodes_set(conference, node, SWITCH_FALSE);
+	}
+	switch_mutex_unlock(conference->member_mutex);
+
+  done:
+
+	switch_thread_rwlock_unlock(conference->rwlock);
+}
+
+static switch_status_t conference_ring_init(conference_ring_t *ring, uint32_t size, switch_memory_pool_t *pool)
+{
+	if (!(ring->data = switch_core_alloc(pool, size))) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	ring->size = size;
+	switch_atomic_set(&ring->head, 0);
+	switch_atomic_set(&ring->tail, 0);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static uint32_t conference_ring_inuse(conference_ring_t *ring)
+{
+	return switch_atomic_read(&ring->head) - switch_atomic_read(&ring->tail);
+}
+
+/* Producer side.  All or nothing: returns 0 without writing when the consumer has fallen too far behind.
+   The acquire on tail keeps the copy below from landing on bytes the consumer is still reading and the
+   release on head keeps the consumer from seeing the new head before the bytes. */
+static uint32_t conference_ring_write(conference_ring_t *ring, const void *data, uint32_t len)
+{
+	uint32_t head = switch_atomic_read(&ring->head);
+	uint32_t tail = switch_atomic_read_acquire(&ring->tail);
+	uint32_t off, chunk;
+
+	if (!len || len > ring->size - (head - tail)) {
+		return 0;
+	}
+
+	off = head & (ring->size - 1);
+	chunk = MIN(len, ring->size - off);
+	memcpy(ring->data + off, data, chunk);
+	memcpy(ring->data, (const uint8_t *) data + chunk, len - chunk);
+	switch_atomic_set_release(&ring->head, head + len);
+
+	return len;
+}
+
+/* Consumer side, the mirror image of conference_ring_write */
+static uint32_t conference_ring_read(conference_ring_t *ring, void *data, uint32_t len)
+{
+	uint32_t head = switch_atomic_read_acquire(&ring->head);
+	uint32_t tail = switch_atomic_read(&ring->tail);
+	uint32_t off, chunk;
+
+	if ((len = MIN(len, head - tail)) == 0) {
+		return 0;
+	}
+
+	off = tail & (ring->size - 1);
+	chunk = MIN(len, ring->size - off);
+	memcpy(data, ring->data + off, chunk);
+	memcpy((uint8_t *) data + chunk, ring->data, len - chunk);
+	switch_atomic_set_release(&ring->tail, tail + len);
+
+	return len;
+}
+
+/* Consumer side, drop everything queued so far */
+static void conference_ring_flush(conference_ring_t *ring)
+{
+	switch_atomic_set_release(&ring->tail, switch_atomic_read_acquire(&ring->head));
+}
+
+/* Rebuild the member snapshot the conference thread mixes from.  member_mutex must be held.
+   A snapshot the conference thread may still be walking is parked on retired_lists for it to free. */
+static void conference_member_list_publish(conference_obj_t *conference)
+{
+	conference_member_list_t *list, *old;
+	conference_member_t *imember;
+	uint32_t count = 0;
+
+	for (imember = conference->members; imember; imember = imember->next) {
+		count++;
+	}
+
+	switch_zmalloc(list, sizeof(*list) + count * sizeof(list->members[0]));
+
+	for (imember = conference->members; imember; imember = imember->next) {
+		list->members[list->count++] = imember;
+	}
+
+	list->gen = ++conference->member_gen;
+	old = conference->member_list;
+	conference->member_list = list;
+
+	if (old) {
+		if (switch_atomic_read(&conference->mixing)) {
+			old->next = conference->retired_lists;
+			conference->retired_lists = old;
+		} else {
+			free(old);
+		}
+	}
+}
+
+/* Called by the conference thread at the top of every tick.  It never waits for member_mutex: if somebody
+   is busy with the member list it simply keeps mixing from the snapshot it already has. */
+static conference_member_list_t *conference_member_list_acquire(conference_obj_t *conference, conference_member_list_t *list)
+{
+	conference_member_list_t *dead;
+
+	if (switch_mutex_trylock(conference->member_mutex) != SWITCH_STATUS_SUCCESS) {
+		return list;
+	}
+
+	if ((list = conference->member_list)) {
+		switch_atomic_set_release(&conference->mix_gen, list->gen);
+	}
+
+	while ((dead = conference->retired_lists)) {
+		conference->retired_lists = dead->next;
+		free(dead);
+	}
+
+	switch_mutex_unlock(conference->member_mutex);
+
+	return list;
+}
+
+/* Wait until the conference thread has moved on to snapshot gen (or stopped), after which it no longer
+   references anything that was unlinked before gen was published. */
+static void conference_member_list_wait(conference_obj_t *conference, uint32_t gen)
+{
+	while (switch_atomic_read(&conference->mixing) && switch_atomic_read_acquire(&conference->mix_gen) < gen) {
+		switch_cond_next();
+	}
+}
+
+static void conference_member_list_destroy(conference_obj_t *conference)
+{
+	conference_member_list_t *dead;
+
+	switch_mutex_lock(conference->member_mutex);
+	while ((dead = conference->retired_lists)) {
+		conference->retired_lists = dead->next;
+		free(dead);
+	}
+	switch_safe_free(conference->member_list);
+	switch_mutex_unlock(conference->member_mutex);
+}
+
 /* Gain exclusive access and add the member to the list */
 static switch_status_t conference_add_member(conference_obj_t *conference, conference_member_t *member)
 {
@@ -1437,8 +2043,6 @@ static switch_status_t conference_add_member(conference_obj_t *conference, confe
 	switch_assert(member != NULL);
 
 	switch_mutex_lock(conference->mutex);
-	switch_mutex_lock(member->audio_in_mutex);
-	switch_mutex_lock(member->audio_out_mutex);
 	lock_member(member);
 	switch_mutex_lock(conference->member_mutex);
 
@@ -1452,6 +2056,7 @@ static switch_status_t conference_add_member(conference_obj_t *conference, confe
 	switch_queue_create(&member->dtmf_queue, 100, member->pool);
 	conference->members = member;
 	switch_set_flag_locked(member, MFLAG_INTREE);
+	conference_member_list_publish(conference);
 	switch_mutex_unlock(conference->member_mutex);
 	conference_cdr_add(member);
 
@@ -1473,6 +2078,10 @@ static switch_status_t conference_add_member(conference_obj_t *conference, confe
 		switch_channel_set_variable(channel, "conference_recording", conference->record_filename);
 		switch_channel_set_variable(channel, CONFERENCE_UUID_VARIABLE, conference->uuid_str);
 
+		if (switch_test_flag(member, MFLAG_CASCADE)) {
+			conference_cascade_add(conference, member);
+		}
+
 		if (switch_channel_test_flag(channel, CF_VIDEO)) {
 			if (switch_test_flag(conference, CFLAG_VIDEO_BRIDGE)) {
 				switch_channel_set_flag(channel, CF_VIDEO_ECHO);
@@ -1582,8 +2191,6 @@ static switch_status_t conference_add_member(conference_obj_t *conference, confe
 		
 	}
 	unlock_member(member);
-	switch_mutex_unlock(member->audio_out_mutex);
-	switch_mutex_unlock(member->audio_in_mutex);
 
 	send_rfc_event(conference);
 
@@ -1741,6 +2348,7 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 	conference_file_node_t *member_fnode;
 	switch_speech_handle_t *member_sh;
 	const char *exit_sound = NULL;
+	uint32_t gen;
 
 	switch_assert(conference != NULL);
 	switch_assert(member != NULL);
@@ -1771,8 +2379,6 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 
 	switch_mutex_lock(conference->mutex);
 	switch_mutex_lock(conference->member_mutex);
-	switch_mutex_lock(member->audio_in_mutex);
-	switch_mutex_lock(member->audio_out_mutex);
 	lock_member(member);
 	switch_clear_flag(member, MFLAG_INTREE);
 
@@ -1788,6 +2394,9 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 		last = imember;
 	}
 
+	conference_member_list_publish(conference);
+	gen = conference->member_gen;
+
 	switch_thread_rwlock_unlock(member->rwlock);
 	
 	/* Close Unused Handles */
@@ -1839,6 +2448,10 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 		conference_send_presence(conference);
 		switch_channel_set_variable(channel, "conference_call_key", NULL);
 
+		if (switch_test_flag(member, MFLAG_CASCADE)) {
+			conference_cascade_del(conference, member);
+		}
+
 		if ((conference->min && switch_test_flag(conference, CFLAG_ENFORCE_MIN) && conference->count < conference->min)
 			|| (switch_test_flag(conference, CFLAG_DYNAMIC) && conference->count == 0)) {
 			switch_set_flag(conference, CFLAG_DESTRUCT);
@@ -1862,14 +2475,16 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 	}
 	switch_mutex_unlock(conference->member_mutex);
 	unlock_member(member);
-	switch_mutex_unlock(member->audio_out_mutex);
-	switch_mutex_unlock(member->audio_in_mutex);
 
 
 	send_rfc_event(conference);
 	
 
 	switch_mutex_unlock(conference->mutex);
+
+	/* the caller is about to tear the member down, make sure the mixer is done with it */
+	conference_member_list_wait(conference, gen);
+
 	status = SWITCH_STATUS_SUCCESS;
 
 	return status;
@@ -1945,9 +2560,16 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 	int want_refresh = 0;
 	int yield = 0;
 	switch_core_session_t *session;
-	char buf[65536];
+	switch_frame_t relay_frame = { 0 };
+	uint8_t *relay_packet, *relay_data, *relay_copy;
 	conference_member_t *floor_holder = NULL;
 
+	/* The floor holder's frame belongs to its session and is only valid while we hold its read lock, so it is copied
+	   once into buffers owned by this thread and reused for every frame and every member for the life of the thread. */
+	relay_packet = switch_core_alloc(conference->pool, CONF_VIDEO_FRAME_SIZE);
+	relay_data = switch_core_alloc(conference->pool, CONF_VIDEO_FRAME_SIZE);
+	relay_copy = switch_core_alloc(conference->pool, CONF_VIDEO_FRAME_SIZE);
+
 	conference->video_running = 1;
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Video thread started for conference %s\n", conference->name);
 
@@ -1985,6 +2607,25 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 			} else {
 				status = switch_core_session_read_video_frame(session, &vid_frame, SWITCH_IO_FLAG_NONE, 0);
 			}
+
+			if (SWITCH_READ_ACCEPTABLE(status) && vid_frame && !switch_test_flag(vid_frame, SFF_CNG)) {
+				if (vid_frame->packetlen > CONF_VIDEO_FRAME_SIZE || vid_frame->datalen > CONF_VIDEO_FRAME_SIZE) {
+					status = SWITCH_STATUS_FALSE;
+				} else {
+					relay_frame = *vid_frame;
+					relay_frame.packet = relay_packet;
+					memcpy(relay_copy, vid_frame->packet, vid_frame->packetlen);
+
+					if (vid_frame->data >= vid_frame->packet &&
+						(uint8_t *) vid_frame->data < (uint8_t *) vid_frame->packet + vid_frame->packetlen) {
+						relay_frame.data = relay_packet + ((uint8_t *) vid_frame->data - (uint8_t *) vid_frame->packet);
+					} else if (vid_frame->data) {
+						relay_frame.data = relay_data;
+						memcpy(relay_data, vid_frame->data, vid_frame->datalen);
+					}
+				}
+			}
+
 			switch_mutex_lock(conference->mutex);
 			switch_core_session_rwunlock(session);
 		}
@@ -1999,8 +2640,6 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 			goto do_continue;
 		}
 
-		memcpy(buf, vid_frame->packet, vid_frame->packetlen);
-		
 		switch_mutex_unlock(conference->mutex);
 		switch_mutex_lock(conference->mutex);
 		want_refresh = 0;
@@ -2025,8 +2664,9 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 			}
 
 			if (isession && switch_channel_test_flag(ichannel, CF_VIDEO)) {
-				memcpy(vid_frame->packet, buf, vid_frame->packetlen);
-				switch_core_session_write_video_frame(imember->session, vid_frame, SWITCH_IO_FLAG_NONE, 0);
+				/* the write may rewrite the packet in place (e.g. srtp), every member starts from the pristine copy */
+				memcpy(relay_packet, relay_copy, relay_frame.packetlen);
+				switch_core_session_write_video_frame(imember->session, &relay_frame, SWITCH_IO_FLAG_NONE, 0);
 			}
 
 			switch_core_session_rwunlock(isession);
@@ -2047,11 +2687,73 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 	return NULL;
 }
 
+/* Find or create the rate domain for rate, only called from the conference thread */
+static conference_rate_domain_t *conference_rate_domain_get(conference_obj_t *conference, uint32_t rate)
+{
+	conference_rate_domain_t *domain;
+
+	for (domain = conference->rate_domains; domain; domain = domain->next) {
+		if (domain->rate == rate) {
+			return domain;
+		}
+	}
+
+	switch_zmalloc(domain, sizeof(*domain));
+	domain->rate = rate;
+	domain->samples = switch_samples_per_packet(rate, conference->interval);
+
+	if (domain->samples > SWITCH_RECOMMENDED_BUFFER_SIZE / 2 ||
+		switch_resample_create(&domain->up, rate, conference->rate, SWITCH_RECOMMENDED_BUFFER_SIZE, SWITCH_RESAMPLE_QUALITY, 1) != SWITCH_STATUS_SUCCESS ||
+		switch_resample_create(&domain->down, conference->rate, rate, SWITCH_RECOMMENDED_BUFFER_SIZE, SWITCH_RESAMPLE_QUALITY, 1) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Conference %s: unable to create a %uhz rate domain!\n", conference->name, rate);
+		switch_resample_destroy(&domain->up);
+		free(domain);
+		return NULL;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Conference %s: new %uhz rate domain\n", conference->name, rate);
+
+	domain->next = conference->rate_domains;
+	conference->rate_domains = domain;
+
+	return domain;
+}
+
+static void conference_rate_domains_destroy(conference_obj_t *conference)
+{
+	conference_rate_domain_t *domain;
+
+	while ((domain = conference->rate_domains)) {
+		conference->rate_domains = domain->next;
+		switch_resample_destroy(&domain->up);
+		switch_resample_destroy(&domain->down);
+		free(domain);
+	}
+}
+
+/* Run one tick through a resampler and hand back exactly out_samples, the resampler may be a sample short or over */
+static void conference_resample_frame(switch_audio_resampler_t *resampler, int16_t *in, uint32_t in_samples, int16_t *out, uint32_t out_samples)
+{
+	uint32_t got = switch_resample_process(resampler, in, in_samples);
+
+	if (got > out_samples) {
+		got = out_samples;
+	}
+
+	memcpy(out, resampler->to, got * sizeof(int16_t));
+
+	if (got < out_samples) {
+		memset(out + got, 0, (out_samples - got) * sizeof(int16_t));
+	}
+}
+
 /* Main monitor thread (1 per distinct conference room) */
 static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *obj)
 {
 	conference_obj_t *conference = (conference_obj_t *) obj;
 	conference_member_t *imember, *omember;
+	conference_member_list_t *list = NULL;
+	uint32_t count = 0;
 	uint32_t samples = switch_samples_per_packet(conference->rate, conference->interval);
 	uint32_t bytes = samples * 2;
 	uint8_t ready = 0, total = 0;
@@ -2093,12 +2795,17 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 	switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "conference-create");
 	switch_event_fire(&event);
 
+	switch_atomic_set(&conference->mixing, 1);
+
 	while (globals.running && !switch_test_flag(conference, CFLAG_DESTRUCT)) {
 		switch_size_t file_sample_len = samples;
 		switch_size_t file_data_len = samples * 2;
 		int has_file_data = 0, members_with_video = 0;
 		uint32_t conf_energy = 0;
 		int nomoh = 0;
+		int rel_mode = 0;
+		uint32_t i, j, member_bytes;
+		conference_rate_domain_t *domain;
 		conference_member_t *floor_holder, *video_bridge_members[2] = { 0 };
 		
 		/* Sync the conference to a single timing source */
@@ -2107,16 +2814,37 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 			break;
 		}
 
-		switch_mutex_lock(conference->mutex);
+		list = conference_member_list_acquire(conference, list);
+		count = list ? list->count : 0;
+		conference_record_feed_acquire(conference);
 		has_file_data = ready = total = 0;
 
+		/* relationships need every member at the conference rate so rate domains are bypassed while there are any */
+		rel_mode = conference->relationship_total ? 1 : 0;
+
+		for (domain = conference->rate_domains; domain; domain = domain->next) {
+			if (domain->active) {
+				memset(domain->sum, 0, domain->samples * sizeof(domain->sum[0]));
+			}
+			domain->active = 0;
+			domain->mixed = 0;
+		}
+
 		floor_holder = conference->floor_holder;
 		
 		/* Read one frame of audio from each member channel and save it for redistribution */
-		for (imember = conference->members; imember; imember = imember->next) {
+		for (i = 0; i < count; i++) {
 			uint32_t buf_read = 0;
+
+			imember = list->members[i];
+			imember->read = imember->mix_read = 0;
+			switch_clear_flag_locked(imember, MFLAG_HAS_AUDIO);
+
+			if (!switch_test_flag(imember, MFLAG_INTREE)) {
+				continue;
+			}
+
 			total++;
-			imember->read = 0;
 
 			if (switch_test_flag(imember, MFLAG_RUNNING) && imember->session) {
 				switch_channel_t *channel = switch_core_session_get_channel(imember->session);
@@ -2143,173 +2871,233 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 				}
 			}
 
-			switch_clear_flag_locked(imember, MFLAG_HAS_AUDIO);
-			switch_mutex_lock(imember->audio_in_mutex);
+			member_bytes = bytes;
+
+			if (imember->mix_rate != conference->rate) {
+				if (!imember->domain && !(imember->domain = conference_rate_domain_get(conference, imember->mix_rate))) {
+					continue;
+				}
+				member_bytes = imember->domain->samples * 2;
+			}
 
-			if (switch_buffer_inuse(imember->audio_buffer) >= bytes
-				&& (buf_read = (uint32_t) switch_buffer_read(imember->audio_buffer, imember->frame, bytes))) {
+			if (conference_ring_inuse(&imember->in_ring) >= member_bytes
+				&& (buf_read = conference_ring_read(&imember->in_ring, imember->frame, member_bytes))) {
 				imember->read = buf_read;
 				switch_set_flag_locked(imember, MFLAG_HAS_AUDIO);
 				ready++;
+
+				if (!(domain = imember->domain)) {
+					imember->mix_read = buf_read;
+				} else if (rel_mode) {
+					conference_resample_frame(imember->read_resampler, (int16_t *) imember->frame, buf_read / 2, imember->mix_frame, samples);
+					imember->mix_read = bytes;
+				} else {
+					bptr = (int16_t *) imember->frame;
+					for (x = 0; x < buf_read / 2; x++) {
+						domain->sum[x] += (int32_t) bptr[x];
+					}
+					domain->active++;
+				}
 			}
-			switch_mutex_unlock(imember->audio_in_mutex);
-		}
-		
-		if (floor_holder != conference->floor_holder) {
-			conference_set_floor_holder(conference, floor_holder);
 		}
 
-		if (conference->perpetual_sound && !conference->async_fnode) {
-			conference_play_file(conference, conference->perpetual_sound, CONF_DEFAULT_LEADIN, NULL, 1);
-		} else if (conference->moh_sound && ((nomoh == 0 && conference->count == 1) 
-											 || switch_test_flag(conference, CFLAG_WAIT_MOD)) && !conference->async_fnode) {
-			conference_play_file(conference, conference->moh_sound, CONF_DEFAULT_LEADIN, NULL, 1);
-		}
+		/* Everything else that touches shared conference state is done under conference->mutex, but only if we can
+		   get it right away.  When an api call or a join is holding it we mix the members now and catch up next tick. */
+		if (switch_mutex_trylock(conference->mutex) == SWITCH_STATUS_SUCCESS) {
+			if (floor_holder != conference->floor_holder && (!floor_holder || switch_test_flag(floor_holder, MFLAG_INTREE))) {
+				conference_set_floor_holder(conference, floor_holder);
+			}
+
+			if (conference->perpetual_sound && !conference->async_fnode) {
+				conference_play_file(conference, conference->perpetual_sound, CONF_DEFAULT_LEADIN, NULL, 1);
+			} else if (conference->moh_sound && ((nomoh == 0 && conference->count == 1) 
+												 || switch_test_flag(conference, CFLAG_WAIT_MOD)) && !conference->async_fnode) {
+				conference_play_file(conference, conference->moh_sound, CONF_DEFAULT_LEADIN, NULL, 1);
+			}
 
 
-		/* Find if no one talked for more than x number of second */
-		if (conference->terminate_on_silence && conference->count > 1) {
-			int is_talking = 0;
+			/* Find if no one talked for more than x number of second */
+			if (conference->terminate_on_silence && conference->count > 1) {
+				int is_talking = 0;
 
-			for (imember = conference->members; imember; imember = imember->next) {
-				if (switch_epoch_time_now(NULL) - imember->join_time <= conference->terminate_on_silence) {
-					is_talking++;
-				} else if (imember->last_talking != 0 && switch_epoch_time_now(NULL) - imember->last_talking <= conference->terminate_on_silence) {
-					is_talking++;
+				for (i = 0; i < count; i++) {
+					imember = list->members[i];
+					if (!switch_test_flag(imember, MFLAG_INTREE)) {
+						continue;
+					}
+					if (switch_epoch_time_now(NULL) - imember->join_time <= conference->terminate_on_silence) {
+						is_talking++;
+					} else if (imember->last_talking != 0 && switch_epoch_time_now(NULL) - imember->last_talking <= conference->terminate_on_silence) {
+						is_talking++;
+					}
+				}
+				if (is_talking == 0) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Conference has been idle for over %d seconds, terminating\n", conference->terminate_on_silence);
+					switch_set_flag(conference, CFLAG_DESTRUCT);
 				}
 			}
-			if (is_talking == 0) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Conference has been idle for over %d seconds, terminating\n", conference->terminate_on_silence);
-				switch_set_flag(conference, CFLAG_DESTRUCT);
-			}
-		}
 
-		/* Start recording if there's more than one participant. */
-		if (conference->auto_record && !conference->auto_recording && conference->count > 1) {
-			conference->auto_recording++;
-			conference->record_count++;
-			imember = conference->members;
-			if (imember) {
-				switch_channel_t *channel = switch_core_session_get_channel(imember->session);
-				char *rfile = switch_channel_expand_variables(channel, conference->auto_record);
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Auto recording file: %s\n", rfile);
-				launch_conference_record_thread(conference, rfile, SWITCH_TRUE);
-				if (rfile != conference->auto_record) {
-					conference->record_filename = switch_core_strdup(conference->pool, rfile);
-					switch_safe_free(rfile);
+			/* Start recording if there's more than one participant. */
+			if (conference->auto_record && !conference->auto_recording && conference->count > 1) {
+				conference->auto_recording++;
+				conference->record_count++;
+				imember = conference->members;
+				if (imember) {
+					switch_channel_t *channel = switch_core_session_get_channel(imember->session);
+					char *rfile = switch_channel_expand_variables(channel, conference->auto_record);
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Auto recording file: %s\n", rfile);
+					launch_conference_record_thread(conference, &rfile, 1, SWITCH_TRUE);
+					if (rfile != conference->auto_record) {
+						conference->record_filename = switch_core_strdup(conference->pool, rfile);
+						switch_safe_free(rfile);
+					} else {
+						conference->record_filename = switch_core_strdup(conference->pool, conference->auto_record);
+					}
+					/* Set the conference recording variable for each member */
+					for (omember = conference->members; omember; omember = omember->next) {
+						channel = switch_core_session_get_channel(omember->session);
+						switch_channel_set_variable(channel, "conference_recording", conference->record_filename);
+					}
 				} else {
-					conference->record_filename = switch_core_strdup(conference->pool, conference->auto_record);
-				}
-				/* Set the conference recording variable for each member */
-				for (omember = conference->members; omember; omember = omember->next) {
-					channel = switch_core_session_get_channel(omember->session);
-					switch_channel_set_variable(channel, "conference_recording", conference->record_filename);
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Auto Record Failed.  No members in conference.\n");
 				}
-			} else {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Auto Record Failed.  No members in conference.\n");
 			}
-		}
 
 
-		if (members_with_video) {
-			if (conference->video_running != 1) {
-				if (!switch_test_flag(conference, CFLAG_VIDEO_BRIDGE)) {
-					launch_conference_video_thread(conference);	
+			if (members_with_video) {
+				if (conference->video_running != 1) {
+					if (!switch_test_flag(conference, CFLAG_VIDEO_BRIDGE)) {
+						launch_conference_video_thread(conference);	
+					}
 				}
-			}
 
-			if (conference->vh[0].up == 0 && 
-				conference->vh[1].up == 0 && 
-				video_bridge_members[0] && 
-				video_bridge_members[1] &&
-				switch_test_flag(video_bridge_members[0], MFLAG_RUNNING) && 
-				switch_test_flag(video_bridge_members[1], MFLAG_RUNNING) && 
-				switch_channel_ready(switch_core_session_get_channel(video_bridge_members[0]->session)) &&
-				switch_channel_ready(switch_core_session_get_channel(video_bridge_members[1]->session)) 
-				) {
-				conference->mh.up = 2;
-				if (launch_conference_video_bridge_thread(video_bridge_members[0], video_bridge_members[1])) {
-					conference->mh.up = 1;
-				} else {
-					conference->mh.up = -1;
+				if (conference->vh[0].up == 0 && 
+					conference->vh[1].up == 0 && 
+					video_bridge_members[0] && 
+					video_bridge_members[1] &&
+					switch_test_flag(video_bridge_members[0], MFLAG_RUNNING) && 
+					switch_test_flag(video_bridge_members[1], MFLAG_RUNNING) && 
+					switch_channel_ready(switch_core_session_get_channel(video_bridge_members[0]->session)) &&
+					switch_channel_ready(switch_core_session_get_channel(video_bridge_members[1]->session)) 
+					) {
+					conference->mh.up = 2;
+					if (launch_conference_video_bridge_thread(video_bridge_members[0], video_bridge_members[1])) {
+						conference->mh.up = 1;
+					} else {
+						conference->mh.up = -1;
+					}
 				}
 			}
-		}
 
-		/* If a file or speech event is being played */
-		if (conference->fnode && !switch_test_flag(conference->fnode, NFLAG_PAUSE)) {
-			/* Lead in time */
-			if (conference->fnode->leadin) {
-				conference->fnode->leadin--;
-			} else if (!conference->fnode->done) {
-				file_sample_len = samples;
-				if (conference->fnode->type == NODE_TYPE_SPEECH) {
-					switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_BLOCKING;
+			/* If a file or speech event is being played */
+			if (conference->fnode && !switch_test_flag(conference->fnode, NFLAG_PAUSE)) {
+				/* Lead in time */
+				if (conference->fnode->leadin) {
+					conference->fnode->leadin--;
+				} else if (!conference->fnode->done) {
+					file_sample_len = samples;
+					if (conference->fnode->type == NODE_TYPE_SPEECH) {
+						switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_BLOCKING;
+
+						if (switch_core_speech_read_tts(conference->fnode->sh, file_frame, &file_data_len, &flags) == SWITCH_STATUS_SUCCESS) {
+							file_sample_len = file_data_len / 2;
+						} else {
+							file_sample_len = file_data_len = 0;
+						}
+					} else if (conference->fnode->type == NODE_TYPE_FILE) {
+						switch_core_file_read(&conference->fnode->fh, file_frame, &file_sample_len);
+					}
+
+					if (file_sample_len <= 0) {
+						if (test_eflag(conference, EFLAG_PLAY_FILE_DONE) &&
+							switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+							conference_add_event_data(conference, event);
+							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "play-file-done");
+							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "File", conference->fnode->file);
+							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Async", "true");
+							switch_event_fire(&event);
+						}
 
-					if (switch_core_speech_read_tts(conference->fnode->sh, file_frame, &file_data_len, &flags) == SWITCH_STATUS_SUCCESS) {
-						file_sample_len = file_data_len / 2;
+						conference->fnode->done++;
 					} else {
-						file_sample_len = file_data_len = 0;
+						has_file_data = 1;
 					}
-				} else if (conference->fnode->type == NODE_TYPE_FILE) {
-					switch_core_file_read(&conference->fnode->fh, file_frame, &file_sample_len);
 				}
+			}
 
-				if (file_sample_len <= 0) {
-					if (test_eflag(conference, EFLAG_PLAY_FILE_DONE) &&
-						switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
-						conference_add_event_data(conference, event);
-						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "play-file-done");
-						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "File", conference->fnode->file);
-						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Async", "true");
-						switch_event_fire(&event);
+			if (conference->async_fnode) {
+				/* Lead in time */
+				if (conference->async_fnode->leadin) {
+					conference->async_fnode->leadin--;
+				} else if (!conference->async_fnode->done) {
+					file_sample_len = samples;
+					switch_core_file_read(&conference->async_fnode->fh, async_file_frame, &file_sample_len);
+
+					if (file_sample_len <= 0) {
+						if (test_eflag(conference, EFLAG_PLAY_FILE) &&
+							switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+							conference_add_event_data(conference, event);
+							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "play-file-done");
+							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "File", conference->async_fnode->file);
+							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Async", "true");
+							switch_event_fire(&event);
+						}
+						conference->async_fnode->done++;
+					} else {
+						if (has_file_data) {
+							switch_size_t x;
+
+							for (x = 0; x < file_sample_len; x++) {
+								int32_t z;
+								int16_t *muxed;
+
+								muxed = (int16_t *) file_frame;
+								bptr = (int16_t *) async_file_frame;
+								z = muxed[x] + bptr[x];
+								switch_normalize_to_16bit(z);
+								muxed[x] = (int16_t) z;
+							}
+						} else {
+							memcpy(file_frame, async_file_frame, file_sample_len * 2);
+							has_file_data = 1;
+						}
 					}
-
-					conference->fnode->done++;
-				} else {
-					has_file_data = 1;
 				}
 			}
-		}
 
-		if (conference->async_fnode) {
-			/* Lead in time */
-			if (conference->async_fnode->leadin) {
-				conference->async_fnode->leadin--;
-			} else if (!conference->async_fnode->done) {
-				file_sample_len = samples;
-				switch_core_file_read(&conference->async_fnode->fh, async_file_frame, &file_sample_len);
-
-				if (file_sample_len <= 0) {
-					if (test_eflag(conference, EFLAG_PLAY_FILE) &&
-						switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
-						conference_add_event_data(conference, event);
-						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "play-file-done");
-						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "File", conference->async_fnode->file);
-						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Async", "true");
-						switch_event_fire(&event);
-					}
-					conference->async_fnode->done++;
-				} else {
-					if (has_file_data) {
-						switch_size_t x;
+			/* the file audio is already in file_frame so finished nodes can go now */
+			if (conference->async_fnode && conference->async_fnode->done) {
+				switch_memory_pool_t *pool;
+				switch_core_file_close(&conference->async_fnode->fh);
+				pool = conference->async_fnode->pool;
+				conference->async_fnode = NULL;
+				switch_core_destroy_memory_pool(&pool);
+			}
 
-						for (x = 0; x < file_sample_len; x++) {
-							int32_t z;
-							int16_t *muxed;
+			if (conference->fnode && conference->fnode->done) {
+				conference_file_node_t *fnode;
+				switch_memory_pool_t *pool;
 
-							muxed = (int16_t *) file_frame;
-							bptr = (int16_t *) async_file_frame;
-							z = muxed[x] + bptr[x];
-							switch_normalize_to_16bit(z);
-							muxed[x] = (int16_t) z;
-						}
-					} else {
-						memcpy(file_frame, async_file_frame, file_sample_len * 2);
-						has_file_data = 1;
-					}
+				if (conference->fnode->type != NODE_TYPE_SPEECH) {
+					switch_core_file_close(&conference->fnode->fh);
 				}
+
+				fnode = conference->fnode;
+				conference->fnode = conference->fnode->next;
+
+				pool = fnode->pool;
+				fnode = NULL;
+				switch_core_destroy_memory_pool(&pool);
 			}
+
+			if (!conference->end_count && conference->endconf_time &&
+					switch_epoch_time_now(NULL) - conference->endconf_time > conference->endconf_grace_time) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Conference %s: endconf grace time exceeded (%u)\n",
+						conference->name, conference->endconf_grace_time);
+				switch_set_flag(conference, CFLAG_DESTRUCT | CFLAG_ENDCONF_FORCED);
+			}
+
+			switch_mutex_unlock(conference->mutex);
 		}
 
 		if (ready || has_file_data) {
@@ -2336,7 +3124,8 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 
 
 			/* Copy audio from every member known to be producing audio into the main frame. */
-			for (omember = conference->members; omember; omember = omember->next) {
+			for (i = 0; i < count; i++) {
+				omember = list->members[i];
 				conference->member_loop_count++;
 				
 				if (!(switch_test_flag(omember, MFLAG_RUNNING) && switch_test_flag(omember, MFLAG_HAS_AUDIO))) {
@@ -2350,12 +3139,33 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 					}
 				}
 				
-				bptr = (int16_t *) omember->frame;
-				for (x = 0; x < omember->read / 2; x++) {
+				/* rate domain members are added below, a domain at a time */
+				bptr = omember->mix_frame;
+				for (x = 0; x < omember->mix_read / 2; x++) {
 					main_frame[x] += (int32_t) bptr[x];
 				}
 			}
 
+			for (domain = conference->rate_domains; domain; domain = domain->next) {
+				int16_t domain_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+
+				if (!domain->active) {
+					continue;
+				}
+
+				for (x = 0; x < domain->samples; x++) {
+					z = domain->sum[x];
+					switch_normalize_to_16bit(z);
+					domain_frame[x] = (int16_t) z;
+				}
+
+				conference_resample_frame(domain->up, domain_frame, domain->samples, domain->up_frame, samples);
+
+				for (x = 0; x < samples; x++) {
+					main_frame[x] += (int32_t) domain->up_frame[x];
+				}
+			}
+
 			if (conference->agc_level && conference->member_loop_count) {
 				conf_energy = 0;
 			
@@ -2371,16 +3181,27 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 				conference->avg_score = conference->avg_tally / ++conference->avg_itt;
 				if (!conference->avg_itt) conference->avg_tally = conference->score;
 			}
+
+			/* Recordings take the whole mix straight from the main frame. */
+			if (conference->rec_feed_count) {
+				for (x = 0; x < bytes / 2; x++) {
+					z = main_frame[x];
+					switch_normalize_to_16bit(z);
+					write_frame[x] = (int16_t) z;
+				}
+
+				conference_record_feed(conference, write_frame, bytes / 2);
+			}
 			
 			/* Create write frame once per member who is not deaf for each sample in the main frame
 			   check if our audio is involved and if so, subtract it from the sample so we don't hear ourselves.
 			   Since main frame was 32 bit int, we did not lose any detail, now that we have to convert to 16 bit we can
 			   cut it off at the min and max range if need be and write the frame to the output buffer.
 			 */
-			for (omember = conference->members; omember; omember = omember->next) {
-				switch_size_t ok = 1;
+			for (i = 0; i < count; i++) {
+				omember = list->members[i];
 
-				if (!switch_test_flag(omember, MFLAG_RUNNING)) {
+				if (!switch_test_flag(omember, MFLAG_INTREE) || !switch_test_flag(omember, MFLAG_RUNNING)) {
 					continue;
 				}
 
@@ -2388,23 +3209,61 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 					continue;
 				}
 
-				bptr = (int16_t *) omember->frame;
+				if (omember->mix_rate != conference->rate && !omember->domain) {
+					continue;
+				}
+
+				if ((domain = omember->domain) && !rel_mode) {
+					/* Everything outside the domain crosses down once, then each member gets the rest of its own domain minus itself */
+					if (!domain->mixed) {
+						for (x = 0; x < bytes / 2; x++) {
+							z = main_frame[x];
+							if (domain->active) {
+								z -= (int32_t) domain->up_frame[x];
+							}
+							switch_normalize_to_16bit(z);
+							write_frame[x] = (int16_t) z;
+						}
+
+						conference_resample_frame(domain->down, write_frame, bytes / 2, domain->mix, domain->samples);
+						domain->mixed = 1;
+					}
+
+					bptr = (int16_t *) omember->frame;
+					for (x = 0; x < domain->samples; x++) {
+						z = domain->mix[x];
+						if (domain->active) {
+							z += domain->sum[x];
+						}
+						if (switch_test_flag(omember, MFLAG_HAS_AUDIO) && x < omember->read / 2) {
+							z -= (int32_t) bptr[x];
+						}
+						switch_normalize_to_16bit(z);
+						write_frame[x] = (int16_t) z;
+					}
+
+					conference_ring_write(&omember->out_ring, write_frame, domain->samples * 2);
+					continue;
+				}
+
+				bptr = omember->mix_frame;
 				for (x = 0; x < bytes / 2; x++) {
 					z = main_frame[x];
 					/* bptr[x] represents my own contribution to this audio sample */
-					if (switch_test_flag(omember, MFLAG_HAS_AUDIO) && x <= omember->read / 2) {
+					if (switch_test_flag(omember, MFLAG_HAS_AUDIO) && x <= omember->mix_read / 2) {
 						z -= (int32_t) bptr[x];
 					}
 
 					/* when there are relationships, we have to do more work by scouring all the members to see if there are any 
 					   reasons why we should not be hearing a paticular member, and if not, delete their samples as well.
 					 */
-					if (conference->relationship_total) {
-						for (imember = conference->members; imember; imember = imember->next) {
+					if (rel_mode) {
+						for (j = 0; j < count; j++) {
+							imember = list->members[j];
 							if (imember != omember && switch_test_flag(imember, MFLAG_HAS_AUDIO)) {
 								conference_relationship_t *rel;
 								switch_size_t found = 0;
-								int16_t *rptr = (int16_t *) imember->frame;
+								int16_t *rptr = imember->mix_frame;
 								for (rel = imember->relationships; rel; rel = rel->next) {
 									if ((rel->id == omember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_SPEAK)) {
 										z -= (int32_t) rptr[x];
@@ -2430,52 +3289,28 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 					write_frame[x] = (int16_t) z;
 				}
 				
-				switch_mutex_lock(omember->audio_out_mutex);
-				ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes);
-				switch_mutex_unlock(omember->audio_out_mutex);
+				if (domain) {
+					int16_t member_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
 
-				if (!ok) {
-					switch_mutex_unlock(conference->mutex);
-					goto end;
+					conference_resample_frame(omember->write_resampler, write_frame, bytes / 2, member_frame, domain->samples);
+					conference_ring_write(&omember->out_ring, member_frame, domain->samples * 2);
+					continue;
 				}
-			}
-		}
-
-		if (conference->async_fnode && conference->async_fnode->done) {
-			switch_memory_pool_t *pool;
-			switch_core_file_close(&conference->async_fnode->fh);
-			pool = conference->async_fnode->pool;
-			conference->async_fnode = NULL;
-			switch_core_destroy_memory_pool(&pool);
-		}
-
-		if (conference->fnode && conference->fnode->done) {
-			conference_file_node_t *fnode;
-			switch_memory_pool_t *pool;
 
-			if (conference->fnode->type != NODE_TYPE_SPEECH) {
-				switch_core_file_close(&conference->fnode->fh);
+				/* a full ring means that member's output thread is stuck; it flushes once it catches up */
+				conference_ring_write(&omember->out_ring, write_frame, bytes);
 			}
-
-			fnode = conference->fnode;
-			conference->fnode = conference->fnode->next;
-
-			pool = fnode->pool;
-			fnode = NULL;
-			switch_core_destroy_memory_pool(&pool);
-		}
-
-		if (!conference->end_count && conference->endconf_time &&
-				switch_epoch_time_now(NULL) - conference->endconf_time > conference->endconf_grace_time) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Conference %s: endconf grace time exceeded (%u)\n",
-					conference->name, conference->endconf_grace_time);
-			switch_set_flag(conference, CFLAG_DESTRUCT | CFLAG_ENDCONF_FORCED);
+		} else if (conference->rec_feed_count) {
+			/* keep the recordings on the conference timeline through silence */
+			conference_record_feed(conference, NULL, bytes / 2);
 		}
-
-		switch_mutex_unlock(conference->mutex);
 	}
 	/* Rinse ... Repeat */
-  end:
+
+	switch_atomic_set(&conference->mixing, 0);
+	conference_rate_domains_destroy(conference);
+	switch_safe_free(conference->rec_feed);
+	conference->rec_feed_count = conference->rec_feed_alloc = 0;
 
 	if (switch_test_flag(conference, CFLAG_OUTCALL)) {
 		conference->cancel_cause = SWITCH_CAUSE_ORIGINATOR_CANCEL;
@@ -2590,6 +3425,11 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 	conference->end_time = switch_epoch_time_now(NULL);
 	conference_cdr_render(conference);
 
+	conference_cascade_forget(conference, NULL, 0);
+	switch_event_destroy(&conference->cascade_nodes);
+
+	conference_member_list_destroy(conference);
+
 	if (conference->pool) {
 		switch_memory_pool_t *pool = conference->pool;
 		switch_core_destroy_memory_pool(&pool);
@@ -3296,7 +4136,7 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 		/* if the member can speak, compute the audio energy level and */
 		/* generate events when the level crosses the threshold        */
 		if ((switch_test_flag(member, MFLAG_CAN_SPEAK) || switch_test_flag(member, MFLAG_MUTE_DETECT))) {
-			uint32_t energy = 0, i = 0, samples = 0, j = 0;
+			uint32_t energy = 0, samples = 0;
 			int16_t *data;
 			int agc_period = (member->read_impl.actual_samples_per_second / member->read_impl.samples_per_packet) / 4;
 			
@@ -3312,12 +4152,8 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 				switch_change_sln_volume_granular(read_frame->data, read_frame->datalen / 2, member->agc_volume_in_level);
 			}
 			
-			if ((samples = read_frame->datalen / sizeof(*data))) {
-				for (i = 0; i < samples; i++) {
-					energy += abs(data[j]);
-					j += member->read_impl.number_of_channels;
-				}
-				
+			if ((samples = read_frame->datalen / sizeof(*data) / member->read_impl.number_of_channels)) {
+				energy = switch_sln_energy(data, samples, member->read_impl.number_of_channels);
 				member->score = energy / samples;
 			}
 
@@ -3440,36 +4276,10 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 		/* skip frames that are not actual media or when we are muted or silent */
 		if ((switch_test_flag(member, MFLAG_TALKING) || member->energy_level == 0 || switch_test_flag(member->conference, CFLAG_AUDIO_ALWAYS)) 
 			&& switch_test_flag(member, MFLAG_CAN_SPEAK) &&	!switch_test_flag(member->conference, CFLAG_WAIT_MOD) && member->conference->count > 1) {
-			switch_audio_resampler_t *read_resampler = member->read_resampler;
-			void *data;
-			uint32_t datalen;
-
-			if (read_resampler) {
-				int16_t *bptr = (int16_t *) read_frame->data;
-				int len = (int) read_frame->datalen;
-
-				switch_resample_process(read_resampler, bptr, len / 2);
-				memcpy(member->resample_out, read_resampler->to, read_resampler->to_len * 2);
-				len = read_resampler->to_len * 2;
-				datalen = len;
-				data = member->resample_out;
-			} else {
-				data = read_frame->data;
-				datalen = read_frame->datalen;
-			}
-
 
-			if (datalen) {
-				switch_size_t ok = 1;
-
-				/* Write the audio into the input buffer */
-				switch_mutex_lock(member->audio_in_mutex);
-				ok = switch_buffer_write(member->audio_buffer, data, datalen);
-				switch_mutex_unlock(member->audio_in_mutex);
-				if (!ok) {
-					switch_mutex_unlock(member->read_mutex);
-					break;
-				}
+			/* Hand the audio to the conference thread at the member's own rate, if it is that far behind the frame is dropped */
+			if (read_frame->datalen) {
+				conference_ring_write(&member->in_ring, read_frame->data, read_frame->datalen);
 			}
 		}
 
@@ -3490,7 +4300,6 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 	}
 
 
-	switch_resample_destroy(&member->read_resampler);
 	switch_core_session_rwunlock(session);
 
  end:
@@ -3623,7 +4432,7 @@ static void conference_loop_output(conference_member_t *member)
 
 	channel = switch_core_session_get_channel(member->session);
 	interval = read_impl.microseconds_per_packet / 1000;
-	samples = switch_samples_per_packet(member->conference->rate, interval);
+	samples = switch_samples_per_packet(member->mix_rate, interval);
 	//csamples = samples;
 	tsamples = member->orig_read_impl.samples_per_packet;
 	flush_len = 0;
@@ -3636,7 +4445,7 @@ static void conference_loop_output(conference_member_t *member)
 
 	switch_assert(member->conference != NULL);
 
-	flush_len = switch_samples_per_packet(member->conference->rate, member->conference->interval) * 10;
+	flush_len = switch_samples_per_packet(member->mix_rate, member->conference->interval) * 10;
 
 	if (switch_core_timer_init(&timer, member->conference->timer_name, interval, tsamples, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_ERROR, "Timer Setup Failed.  Conference Cannot Start\n");
@@ -3743,7 +4552,6 @@ static void conference_loop_output(conference_member_t *member)
 		   && switch_channel_ready(channel)) {
 		switch_event_t *event;
 		int use_timer = 0;
-		switch_buffer_t *use_buffer = NULL;
 		uint32_t mux_used = 0;
 
 		switch_mutex_lock(member->write_mutex);
@@ -3784,8 +4592,7 @@ static void conference_loop_output(conference_member_t *member)
 			}
 		}
 
-		use_buffer = NULL;
-		mux_used = (uint32_t) switch_buffer_inuse(member->mux_buffer);
+		mux_used = conference_ring_inuse(&member->out_ring);
 		
 		use_timer = 1;
 		
@@ -3805,11 +4612,9 @@ static void conference_loop_output(conference_member_t *member)
 			switch_set_flag_locked(member, MFLAG_FLUSH_BUFFER);
 		} else if (mux_used >= bytes) {
 			/* Flush the output buffer and write all the data (presumably muxed) back to the channel */
-			switch_mutex_lock(member->audio_out_mutex);
 			write_frame.data = data;
-			use_buffer = member->mux_buffer;
 			low_count = 0;
-			if ((write_frame.datalen = (uint32_t) switch_buffer_read(use_buffer, write_frame.data, bytes))) {
+			if ((write_frame.datalen = conference_ring_read(&member->out_ring, write_frame.data, bytes))) {
 				if (write_frame.datalen) {
 					write_frame.samples = write_frame.datalen / 2;
 				   
@@ -3827,13 +4632,10 @@ static void conference_loop_output(conference_member_t *member)
 						member_add_file_data(member, write_frame.data, write_frame.datalen);
 					}
 					if (switch_core_session_write_frame(member->session, &write_frame, SWITCH_IO_FLAG_NONE, 0) != SWITCH_STATUS_SUCCESS) {
-						switch_mutex_unlock(member->audio_out_mutex);
 						break;
 					}
 				}
 			}
-
-			switch_mutex_unlock(member->audio_out_mutex);
 		} else if (member->fnode) {
 			write_frame.datalen = bytes;
 			write_frame.samples = samples;
@@ -3863,11 +4665,7 @@ static void conference_loop_output(conference_member_t *member)
 		}
 
 		if (switch_test_flag(member, MFLAG_FLUSH_BUFFER)) {
-			if (switch_buffer_inuse(member->mux_buffer)) {
-				switch_mutex_lock(member->audio_out_mutex);
-				switch_buffer_zero(member->mux_buffer);
-				switch_mutex_unlock(member->audio_out_mutex);
-			}
+			conference_ring_flush(&member->out_ring);
 			switch_clear_flag_locked(member, MFLAG_FLUSH_BUFFER);
 		}
 
@@ -3948,208 +4746,233 @@ static void conference_loop_output(conference_member_t *member)
 	}
 }
 
-/* Sub-Routine called by a record entity inside a conference */
-static void *SWITCH_THREAD_FUNC conference_record_thread_run(switch_thread_t *thread, void *obj)
+/* Copy up to max_frames frames out of a recording ring into the batch buffer without consuming them */
+static uint32_t conference_record_peek(conference_record_t *rec, uint32_t max_frames)
 {
-	int16_t *data_buf;
-	switch_file_handle_t fh = { 0 };
-	conference_member_t smember = { 0 }, *member;
-	conference_record_t *rp, *last = NULL, *rec = (conference_record_t *) obj;
-	conference_obj_t *conference = rec->conference;
-	uint32_t samples = switch_samples_per_packet(conference->rate, conference->interval);
-	uint32_t mux_used;
-	char *vval;
-	switch_timer_t timer = { 0 };
-	uint32_t rlen;
-	switch_size_t data_buf_len;
-	switch_event_t *event;
-	int no_data = 0;
-	int lead_in = 20;
-	switch_size_t len = 0;
+	uint32_t head, tail, frames, idx, chunk;
+	switch_size_t frame_bytes = rec->frame_samples * sizeof(int16_t);
 
-	data_buf_len = samples * sizeof(int16_t);
+	head = switch_atomic_read_acquire(&rec->ring_head);
+	tail = switch_atomic_read(&rec->ring_tail);
 
-	switch_zmalloc(data_buf, data_buf_len);
+	if ((frames = head - tail) > max_frames) {
+		frames = max_frames;
+	}
 
-	if (switch_thread_rwlock_tryrdlock(conference->rwlock) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Read Lock Fail\n");
-		return NULL;
+	if (frames) {
+		/* at most two pieces when the batch straddles the end of the ring */
+		idx = tail % rec->ring_frames;
+		chunk = MIN(frames, rec->ring_frames - idx);
+		memcpy(rec->batch, rec->ring + idx * rec->frame_samples, chunk * frame_bytes);
+		if (chunk < frames) {
+			memcpy(rec->batch + chunk * rec->frame_samples, rec->ring, (frames - chunk) * frame_bytes);
+		}
 	}
 
-	switch_mutex_lock(globals.hash_mutex);
-	globals.threads++;
-	switch_mutex_unlock(globals.hash_mutex);
+	return frames;
+}
 
-	member = &smember;
+/* Write one batch of the recording ring to every output, returns the number of frames consumed */
+static uint32_t conference_record_drain(conference_record_t *rec, uint32_t min_frames)
+{
+	conference_record_output_t *op;
+	uint32_t head, tail, frames;
+	switch_size_t len;
+	int open_outputs = 0;
 
-	member->flags = MFLAG_CAN_HEAR | MFLAG_NOCHANNEL | MFLAG_RUNNING;
+	head = switch_atomic_read_acquire(&rec->ring_head);
+	tail = switch_atomic_read(&rec->ring_tail);
 
-	member->conference = conference;
-	member->native_rate = conference->rate;
-	member->rec_path = rec->path;
-	member->rec_time = switch_epoch_time_now(NULL);
-	fh.channels = 1;
-	fh.samplerate = conference->rate;
-	member->id = next_member_id();
-	member->pool = rec->pool;
-	member->rec = rec;
-	member->frame_size = SWITCH_RECOMMENDED_BUFFER_SIZE;
-	member->frame = switch_core_alloc(member->pool, member->frame_size);
-	member->mux_frame = switch_core_alloc(member->pool, member->frame_size);
-
-
-	switch_mutex_init(&member->write_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->flag_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->fnode_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->audio_in_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->audio_out_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->read_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_thread_rwlock_create(&member->rwlock, rec->pool);
-
-	/* Setup an audio buffer for the incoming audio */
-	if (switch_buffer_create_dynamic(&member->audio_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, 0) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
-		goto end;
+	if (!(frames = head - tail) || frames < min_frames) {
+		return 0;
 	}
 
-	/* Setup an audio buffer for the outgoing audio */
-	if (switch_buffer_create_dynamic(&member->mux_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, 0) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
-		goto end;
-	}
+	for (op = rec->outputs; op; op = op->next) {
+		if (!switch_test_flag((&op->fh), SWITCH_FILE_OPEN)) {
+			continue;
+		}
 
-	if (conference_add_member(conference, member) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Joining Conference\n");
-		goto end;
+		/* refill the batch for each output, switch_core_file_write may resample in place */
+		frames = conference_record_peek(rec, CONF_RECORD_BATCH_FRAMES);
+		len = (switch_size_t) frames * rec->frame_samples;
+
+		if (switch_core_file_write(&op->fh, rec->batch, &len) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Write Failed [%s]\n", op->path);
+			switch_core_file_close(&op->fh);
+			continue;
+		}
+
+		open_outputs++;
 	}
 
-	fh.pre_buffer_datalen = SWITCH_DEFAULT_FILE_BUFFER_LEN;
+	if (!open_outputs) {
+		switch_mutex_lock(rec->conference->flag_mutex);
+		switch_clear_flag(rec, RECFLAG_RUNNING);
+		conference_record_publish(rec->conference);
+		switch_mutex_unlock(rec->conference->flag_mutex);
+	}
 
-	if (switch_core_file_open(&fh,
-							  rec->path, (uint8_t) 1, conference->rate, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT,
-							  rec->pool) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening File [%s]\n", rec->path);
-		goto end;
+	if (frames > CONF_RECORD_BATCH_FRAMES) {
+		frames = CONF_RECORD_BATCH_FRAMES;
 	}
 
+	/* done reading those slots, the mixer may reuse them */
+	switch_atomic_set_release(&rec->ring_tail, tail + frames);
+	rec->written += frames;
 
-	if (switch_core_timer_init(&timer, conference->timer_name, conference->interval, samples, rec->pool) == SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Setup timer success interval: %u  samples: %u\n", conference->interval, samples);
-	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Timer Setup Failed.  Conference Cannot Start\n");
-		goto end;
+	return frames;
+}
+
+/* Report when the ring fills up faster than storage can take it */
+static void conference_record_check_backlog(conference_record_t *rec)
+{
+	conference_obj_t *conference = rec->conference;
+	uint32_t backlog = switch_atomic_read(&rec->ring_head) - switch_atomic_read(&rec->ring_tail);
+	uint32_t dropped = switch_atomic_read(&rec->dropped);
+	switch_event_t *event;
+	switch_log_level_t level = SWITCH_LOG_WARNING;
+	const char *action = NULL;
+
+	switch_mutex_lock(conference->flag_mutex);
+	if (!switch_test_flag(rec, RECFLAG_BACKPRESSURE) && (backlog >= (rec->ring_frames / 4) * 3 || dropped > rec->reported_dropped)) {
+		switch_set_flag(rec, RECFLAG_BACKPRESSURE);
+		action = "recording-backpressure";
+	} else if (switch_test_flag(rec, RECFLAG_BACKPRESSURE) && backlog < rec->ring_frames / 4) {
+		switch_clear_flag(rec, RECFLAG_BACKPRESSURE);
+		action = "recording-backpressure-cleared";
+		level = SWITCH_LOG_INFO;
 	}
+	switch_mutex_unlock(conference->flag_mutex);
+
+	rec->reported_dropped = dropped;
 
-	if ((vval = switch_mprintf("Conference %s", conference->name))) {
-		switch_core_file_set_string(&fh, SWITCH_AUDIO_COL_STR_TITLE, vval);
-		switch_safe_free(vval);
+	if (!action) {
+		return;
 	}
 
-	switch_core_file_set_string(&fh, SWITCH_AUDIO_COL_STR_ARTIST, "FreeSWITCH mod_conference Software Conference Module");
+	switch_log_printf(SWITCH_CHANNEL_LOG, level,
+					  "Recording %s %s backlog: %u frames dropped: %u frames\n", rec->path, action, backlog, dropped);
 
 	if (test_eflag(conference, EFLAG_RECORD) &&
 			switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
 		conference_add_event_data(conference, event);
-		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "start-recording");
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", action);
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Path", rec->path);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Backlog-Frames", "%u", backlog);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Dropped-Frames", "%u", dropped);
 		switch_event_fire(&event);
 	}
+}
+
+/* Sub-Routine called by a record entity inside a conference.
+   The conference thread feeds the mix into rec->ring, this thread does all of the encoding and disk i/o. */
+static void *SWITCH_THREAD_FUNC conference_record_thread_run(switch_thread_t *thread, void *obj)
+{
+	conference_record_t *rp, *last = NULL, *rec = (conference_record_t *) obj;
+	conference_obj_t *conference = rec->conference;
+	conference_record_output_t *op;
+	char *vval;
+	switch_event_t *event;
+	int open_outputs = 0;
+	uint32_t idle_sleep = conference->interval * 1000 * (CONF_RECORD_BATCH_FRAMES / 5);
+	uint32_t gen;
+
+	if (switch_thread_rwlock_tryrdlock(conference->rwlock) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Read Lock Fail\n");
+		return NULL;
+	}
+
+	switch_mutex_lock(globals.hash_mutex);
+	globals.threads++;
+	switch_mutex_unlock(globals.hash_mutex);
 
-	while (switch_test_flag(member, MFLAG_RUNNING) && switch_test_flag(conference, CFLAG_RUNNING) && conference->count) {
+	vval = switch_mprintf("Conference %s", conference->name);
 
-		len = 0;
+	for (op = rec->outputs; op; op = op->next) {
+		op->fh.channels = 1;
+		op->fh.samplerate = conference->rate;
 
-		if (lead_in) {
-			lead_in--;
-			goto loop;
+		if (switch_core_file_open(&op->fh,
+								  op->path, (uint8_t) 1, conference->rate, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT,
+								  rec->pool) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening File [%s]\n", op->path);
+			continue;
 		}
-		
-		mux_used = (uint32_t) switch_buffer_inuse(member->mux_buffer);
 
-		if (switch_test_flag(member, MFLAG_FLUSH_BUFFER)) {
-			if (mux_used) {
-				switch_mutex_lock(member->audio_out_mutex);
-				switch_buffer_zero(member->mux_buffer);
-				switch_mutex_unlock(member->audio_out_mutex);
-				mux_used = 0;
-			}
-			switch_clear_flag_locked(member, MFLAG_FLUSH_BUFFER);
+		if (vval) {
+			switch_core_file_set_string(&op->fh, SWITCH_AUDIO_COL_STR_TITLE, vval);
 		}
 
-	again:
+		switch_core_file_set_string(&op->fh, SWITCH_AUDIO_COL_STR_ARTIST, "FreeSWITCH mod_conference Software Conference Module");
+		open_outputs++;
+	}
 
-		if (switch_test_flag((&fh), SWITCH_FILE_PAUSE)) {
-			switch_set_flag_locked(member, MFLAG_FLUSH_BUFFER);
-			goto loop;
-		}
+	switch_safe_free(vval);
 
-		if (mux_used >= data_buf_len) {
-			/* Flush the output buffer and write all the data (presumably muxed) to the file */
-			switch_mutex_lock(member->audio_out_mutex);
-			//low_count = 0;
+	if (!open_outputs) {
+		goto end;
+	}
 
-			if ((rlen = (uint32_t) switch_buffer_read(member->mux_buffer, data_buf, data_buf_len))) {
-				len = (switch_size_t) rlen / sizeof(int16_t);
-				no_data = 0;
-			}
-			switch_mutex_unlock(member->audio_out_mutex);
-		}
+	switch_mutex_lock(conference->mutex);
+	rec->cdr_node = switch_core_alloc(conference->pool, sizeof(*rec->cdr_node));
+	rec->cdr_node->join_time = switch_epoch_time_now(NULL);
+	rec->cdr_node->record_path = switch_core_strdup(conference->pool, rec->path);
+	rec->cdr_node->next = conference->cdr_nodes;
+	conference->cdr_nodes = rec->cdr_node;
+	switch_mutex_unlock(conference->mutex);
 
-		if (len == 0) {
-			mux_used = (uint32_t) switch_buffer_inuse(member->mux_buffer);
-				
-			if (mux_used >= data_buf_len) {
-				goto again;
-			}
+	if (test_eflag(conference, EFLAG_RECORD) &&
+			switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+		conference_add_event_data(conference, event);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "start-recording");
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Path", rec->path);
+		switch_event_fire(&event);
+	}
 
-			if (++no_data < 2) {
-				goto loop;
-			}
+	/* from here on the conference thread starts filling the ring */
+	switch_mutex_lock(conference->flag_mutex);
+	switch_set_flag(rec, RECFLAG_STREAMING);
+	conference_record_publish(conference);
+	switch_mutex_unlock(conference->flag_mutex);
 
-			memset(data_buf, 255, (switch_size_t) data_buf_len);
-			len = (switch_size_t) samples;
+	while (switch_test_flag(rec, RECFLAG_RUNNING) && switch_test_flag(conference, CFLAG_RUNNING) && conference->count) {
+		if (!conference_record_drain(rec, CONF_RECORD_BATCH_FRAMES)) {
+			switch_yield(idle_sleep);
 		}
 
-		if (!switch_test_flag(member, MFLAG_PAUSE_RECORDING)) {
-			if (!len || switch_core_file_write(&fh, data_buf, &len) != SWITCH_STATUS_SUCCESS) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write Failed\n");
-				switch_clear_flag_locked(member, MFLAG_RUNNING);
-			}
-		}
+		conference_record_check_backlog(rec);
+	}							/* Rinse ... Repeat */
+
+	switch_mutex_lock(conference->flag_mutex);
+	switch_clear_flag(rec, RECFLAG_STREAMING);
+	gen = conference_record_publish(conference);
+	switch_mutex_unlock(conference->flag_mutex);
 
-	loop:
+	/* once the mixer drops rec from its copy nothing else lands in the ring */
+	conference_record_wait(conference, gen);
 
-		switch_core_timer_next(&timer);
-	}							/* Rinse ... Repeat */
+	/* flush whatever is left in the ring */
+	while (conference_record_drain(rec, 1));
 
   end:
 
-	while(!no_data) {
-		switch_mutex_lock(member->audio_out_mutex);
-		if ((rlen = (uint32_t) switch_buffer_read(member->mux_buffer, data_buf, data_buf_len))) {
-			len = (switch_size_t) rlen / sizeof(int16_t);
-			switch_core_file_write(&fh, data_buf, &len);
-		} else {
-			no_data = 1;
+	for (op = rec->outputs; op; op = op->next) {
+		if (switch_test_flag((&op->fh), SWITCH_FILE_OPEN)) {
+			switch_core_file_close(&op->fh);
 		}
-		switch_mutex_unlock(member->audio_out_mutex);
 	}
 
-	switch_safe_free(data_buf);
-	switch_core_timer_destroy(&timer);
-	conference_del_member(conference, member);
-
-	switch_buffer_destroy(&member->audio_buffer);
-	switch_buffer_destroy(&member->mux_buffer);
-	switch_clear_flag_locked(member, MFLAG_RUNNING);
-	if (switch_test_flag((&fh), SWITCH_FILE_OPEN)) {
-		switch_core_file_close(&fh);
+	if (rec->cdr_node) {
+		rec->cdr_node->leave_time = switch_epoch_time_now(NULL);
 	}
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Recording of %s Stopped\n", rec->path);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Recording of %s Stopped (%u frames written, %u dropped)\n",
+					  rec->path, rec->written, switch_atomic_read(&rec->dropped));
 	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
 		conference_add_event_data(conference, event);
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "stop-recording");
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Path", rec->path);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Dropped-Frames", "%u", switch_atomic_read(&rec->dropped));
 		switch_event_fire(&event);
 	}
 
@@ -4165,7 +4988,9 @@ static void *SWITCH_THREAD_FUNC conference_record_thread_run(switch_thread_t *th
 			} else {
 				conference->rec_node_head = rp->next;
 			}
+			break;
 		}
+		last = rp;
 	}
 	switch_mutex_unlock(conference->flag_mutex);
 
@@ -4452,7 +5277,7 @@ static switch_status_t conference_member_play_file(conference_member_t *member,
 	/* Open the file */
 	fnode->fh.pre_buffer_datalen = SWITCH_DEFAULT_FILE_BUFFER_LEN;
 	if (switch_core_file_open(&fnode->fh,
-							  file, (uint8_t) 1, member->conference->rate, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT,
+							  file, (uint8_t) 1, member->mix_rate, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT,
 							  pool) != SWITCH_STATUS_SUCCESS) {
 		switch_core_destroy_memory_pool(&pool);
 		status = SWITCH_STATUS_NOTFOUND;
@@ -4518,7 +5343,7 @@ static switch_status_t conference_member_say(conference_member_t *member, char *
 	if (!member->sh) {
 		memset(&member->lsh, 0, sizeof(member->lsh));
 		if (switch_core_speech_open(&member->lsh, conference->tts_engine, conference->tts_voice,
-									conference->rate, conference->interval, &flags, switch_core_session_get_pool(member->session)) !=
+									member->mix_rate, conference->interval, &flags, switch_core_session_get_pool(member->session)) !=
 			SWITCH_STATUS_SUCCESS) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_ERROR, "Invalid TTS module [%s]!\n", conference->tts_engine);
 			return SWITCH_STATUS_FALSE;
@@ -4756,6 +5581,7 @@ static void conference_list_pretty(conference_obj_t *conference, switch_stream_h
 static void conference_list(conference_obj_t *conference, switch_stream_handle_t *stream, char *delim)
 {
 	conference_member_t *member = NULL;
+	conference_remote_member_t *rp;
 
 	switch_assert(conference != NULL);
 	switch_assert(stream != NULL);
@@ -4807,6 +5633,11 @@ static void conference_list(conference_obj_t *conference, switch_stream_handle_t
 			count++;
 		}
 
+		if (switch_test_flag(member, MFLAG_CASCADE)) {
+			stream->write_function(stream, "%s%s", count ? "|" : "", "cascade");
+			count++;
+		}
+
 		stream->write_function(stream, "%s%d%s%d%s%d%s%d\n", delim,
 							   member->volume_in_level, 
 							   delim,
@@ -4814,6 +5645,13 @@ static void conference_list(conference_obj_t *conference, switch_stream_handle_t
 							   delim, member->volume_out_level, delim, member->energy_level);
 	}
 
+	/* members of cascaded peers, ids are prefixed with the peer's switchname */
+	for (rp = conference->remote_members; rp; rp = rp->next) {
+		stream->write_function(stream, "%s/%u%s%s%s%s%s%s%s%s%sremote%s0%s0%s0%s0\n",
+							   rp->node, rp->id, delim, rp->name, delim, rp->uuid, delim, rp->caller_id_name, delim, rp->caller_id_number, delim,
+							   delim, delim, delim, delim);
+	}
+
 	switch_mutex_unlock(conference->member_mutex);
 }
 
@@ -5441,6 +6279,7 @@ static switch_xml_t add_x_tag(switch_xml_t x_member, const char *name, const cha
 static void conference_xlist(conference_obj_t *conference, switch_xml_t x_conference, int off)
 {
 	conference_member_t *member = NULL;
+	conference_record_t *rec;
 	switch_xml_t x_member = NULL, x_members = NULL, x_flags;
 	int moff = 0;
 	char i[30] = "";
@@ -5537,6 +6376,35 @@ static void conference_xlist(conference_obj_t *conference, switch_xml_t x_confer
 	x_members = switch_xml_add_child_d(x_conference, "members", 0);
 	switch_assert(x_members);
 
+	switch_mutex_lock(conference->flag_mutex);
+
+	for (rec = conference->rec_node_head; rec; rec = rec->next) {
+		switch_xml_t x_tag;
+		uint32_t count = 0;
+		char tmp[30] = "";
+
+		x_member = switch_xml_add_child_d(x_members, "member", moff++);
+		switch_assert(x_member);
+		switch_xml_set_attr_d(x_member, "type", "recording_node");
+
+		x_tag = switch_xml_add_child_d(x_member, "record_path", count++);
+		if (switch_test_flag(rec, RECFLAG_PAUSED)) {
+			switch_xml_set_attr_d(x_tag, "status", "paused");
+		}
+		switch_snprintf(tmp, sizeof(tmp), "%u", switch_atomic_read(&rec->ring_head) - switch_atomic_read(&rec->ring_tail));
+		switch_xml_set_attr_d_buf(x_tag, "backlog", tmp);
+		switch_snprintf(tmp, sizeof(tmp), "%u", switch_atomic_read(&rec->dropped));
+		switch_xml_set_attr_d_buf(x_tag, "dropped", tmp);
+		switch_xml_set_txt_d(x_tag, rec->path);
+
+		x_tag = switch_xml_add_child_d(x_member, "join_time", count++);
+		switch_xml_set_attr_d(x_tag, "type", "UNIX-epoch");
+		switch_snprintf(i, sizeof(i), "%d", rec->start_time);
+		switch_xml_set_txt_d(x_tag, i);
+	}
+
+	switch_mutex_unlock(conference->flag_mutex);
+
 	switch_mutex_lock(conference->member_mutex);
 
 	for (member = conference->members; member; member = member->next) {
@@ -5550,25 +6418,6 @@ static void conference_xlist(conference_obj_t *conference, switch_xml_t x_confer
 		char tmp[50] = "";
 
 		if (switch_test_flag(member, MFLAG_NOCHANNEL)) {
-			if (member->rec_path) {
-				x_member = switch_xml_add_child_d(x_members, "member", moff++);
-				switch_assert(x_member);
-				switch_xml_set_attr_d(x_member, "type", "recording_node");
-				/* or:
-				x_member = switch_xml_add_child_d(x_members, "recording_node", moff++);
-				*/
-
-				x_tag = switch_xml_add_child_d(x_member, "record_path", count++);
-				if (switch_test_flag(member, MFLAG_PAUSE_RECORDING)) {
-					switch_xml_set_attr_d(x_tag, "status", "paused");
-				}
-				switch_xml_set_txt_d(x_tag, member->rec_path);
-
-				x_tag = switch_xml_add_child_d(x_member, "join_time", count++);
-				switch_xml_set_attr_d(x_tag, "type", "UNIX-epoch");
-				switch_snprintf(i, sizeof(i), "%d", member->rec_time);
-				switch_xml_set_txt_d(x_tag, i);
-			}
 			continue;
 		}
 
@@ -6213,7 +7062,38 @@ static switch_status_t conf_api_sub_bgdial(conference_obj_t *conference, switch_
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* join a peer conference as a single member carrying this conference's mix */
+static switch_status_t conf_api_sub_cascade(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
+{
+	switch_uuid_t uuid;
+	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	switch_event_t *var_event = NULL;
+	char *path;
+
+	switch_assert(conference != NULL);
+	switch_assert(stream != NULL);
+
+	if (argc <= 2) {
+		stream->write_function(stream, "Bad Args\n");
+		return SWITCH_STATUS_GENERR;
+	}
+
+	path = conference_cascade_outbound_path(conference);
+
+	switch_event_create_plain(&var_event, SWITCH_EVENT_CHANNEL_DATA);
+	switch_event_add_header_string(var_event, SWITCH_STACK_BOTTOM, CONF_CASCADE_VARIABLE, path);
+	switch_event_add_header_string(var_event, SWITCH_STACK_BOTTOM, "sip_h_" CONF_CASCADE_SIP_HEADER, path);
+
+	switch_uuid_get(&uuid);
+	switch_uuid_format(uuid_str, &uuid);
+
+	conference_outcall_bg(conference, NULL, NULL, argv[2], 60, "cascade|nomoh", conference->name, switch_core_get_switchname(), uuid_str, NULL, NULL, &var_event);
+
+	stream->write_function(stream, "OK Cascade [%s] Job-UUID: %s\n", path, uuid_str);
+	switch_safe_free(path);
 
+	return SWITCH_STATUS_SUCCESS;
+}
 
 static switch_status_t conf_api_sub_transfer(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
 {
@@ -6287,7 +7167,9 @@ static switch_status_t conf_api_sub_check_record(conference_obj_t *conference, s
 
 	switch_mutex_lock(conference->flag_mutex);
 	for (rec = conference->rec_node_head; rec; rec = rec->next) {
-		stream->write_function(stream, "Record file %s%s%s\n", rec->path, rec->autorec ? " " : "", rec->autorec ? "(Auto)" : "");
+		stream->write_function(stream, "Record file %s%s%s%s backlog: %u frames dropped: %u frames\n", rec->path, rec->autorec ? " " : "", rec->autorec ? "(Auto)" : "",
+							   switch_test_flag(rec, RECFLAG_PAUSED) ? " (Paused)" : "",
+							   switch_atomic_read(&rec->ring_head) - switch_atomic_read(&rec->ring_tail), switch_atomic_read(&rec->dropped));
 		x++;
 	}
 
@@ -6311,7 +7193,8 @@ static switch_status_t conf_api_sub_record(conference_obj_t *conference, switch_
 	stream->write_function(stream, "Record file %s\n", argv[2]);
 	conference->record_filename = switch_core_strdup(conference->pool, argv[2]);
 	conference->record_count++;
-	launch_conference_record_thread(conference, argv[2], SWITCH_FALSE);
+	/* every further argument is another output recorded from the same mix */
+	launch_conference_record_thread(conference, argv + 2, argc - 2, SWITCH_FALSE);
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -6408,9 +7291,7 @@ static switch_status_t conf_api_sub_recording(conference_obj_t *conference, swit
 	} else {
 		/* for new syntax call existing functions with fixed parameter list */
 		if (strcasecmp(argv[2], "start") == 0) {
-			argv[1] = argv[2];
-			argv[2] = argv[3];
-			return conf_api_sub_record(conference,stream,4,argv);
+			return conf_api_sub_record(conference,stream,argc - 1,argv + 1);
 		} else if (strcasecmp(argv[2], "stop") == 0) {
 			argv[1] = argv[2];
 			argv[2] = argv[3];
@@ -6608,8 +7489,9 @@ static api_command_t conf_api_sub_commands[] = {
 	{"agc", (void_fn_t) & conf_api_sub_agc, CONF_API_SUB_ARGS_SPLIT, "agc", ""},
 	{"dial", (void_fn_t) & conf_api_sub_dial, CONF_API_SUB_ARGS_SPLIT, "dial", "<endpoint_module_name>/<destination> <callerid number> <callerid name>"},
 	{"bgdial", (void_fn_t) & conf_api_sub_bgdial, CONF_API_SUB_ARGS_SPLIT, "bgdial", "<endpoint_module_name>/<destination> <callerid number> <callerid name>"},
+	{"cascade", (void_fn_t) & conf_api_sub_cascade, CONF_API_SUB_ARGS_SPLIT, "cascade", "<endpoint_module_name>/<destination of peer conference>"},
 	{"transfer", (void_fn_t) & conf_api_sub_transfer, CONF_API_SUB_ARGS_SPLIT, "transfer", "<conference_name> <member id> [...<member id>]"},
-	{"record", (void_fn_t) & conf_api_sub_record, CONF_API_SUB_ARGS_SPLIT, "record", "<filename>"},
+	{"record", (void_fn_t) & conf_api_sub_record, CONF_API_SUB_ARGS_SPLIT, "record", "<filename> [<filename>...]"},
 	{"chkrecord", (void_fn_t) & conf_api_sub_check_record, CONF_API_SUB_ARGS_SPLIT, "chkrecord", "<confname>"},
 	{"norecord", (void_fn_t) & conf_api_sub_norecord, CONF_API_SUB_ARGS_SPLIT, "norecord", "<[filename|all]>"},
 	{"pause", (void_fn_t) & conf_api_sub_pauserec, CONF_API_SUB_ARGS_SPLIT, "pause", "<filename>"},
@@ -7211,6 +8093,8 @@ static void set_mflags(const char *flags, member_flag_t *f)
 				*f |= MFLAG_MINTWO;
 			} else if (!strcasecmp(argv[i], "video-bridge")) {
 				*f |= MFLAG_VIDEO_BRIDGE;
+			} else if (!strcasecmp(argv[i], "cascade")) {
+				*f |= MFLAG_CASCADE;
 			}
 		}
 
@@ -7374,9 +8258,14 @@ static int setup_media(conference_member_t *member, conference_obj_t *conference
 		switch_resample_destroy(&member->read_resampler);
 	}
 
+	if (member->write_resampler) {
+		switch_resample_destroy(&member->write_resampler);
+	}
+
 
 	switch_core_session_get_read_impl(member->session, &member->orig_read_impl);
 	member->native_rate = read_impl.samples_per_second;
+	member->mix_rate = read_impl.actual_samples_per_second;
 
 	/* Setup a Signed Linear codec for reading audio. */
 	if (switch_core_codec_init(&member->read_codec,
@@ -7400,17 +8289,22 @@ static int setup_media(conference_member_t *member, conference_obj_t *conference
 		member->mux_frame = switch_core_alloc(member->pool, member->frame_size);
 	}
 
-	if (read_impl.actual_samples_per_second != conference->rate) {
+	member->mix_frame = (int16_t *) member->frame;
+
+	if (member->mix_rate != conference->rate) {
+		/* The member joins the rate domain for its own rate and normally never gets resampled on its own.
+		   These are only used by the mixer when relationships need a per member mix at the conference rate. */
 		if (switch_resample_create(&member->read_resampler,
-								   read_impl.actual_samples_per_second,
-								   conference->rate, member->frame_size, SWITCH_RESAMPLE_QUALITY, 1) != SWITCH_STATUS_SUCCESS) {
+								   member->mix_rate,
+								   conference->rate, member->frame_size, SWITCH_RESAMPLE_QUALITY, 1) != SWITCH_STATUS_SUCCESS ||
+			switch_resample_create(&member->write_resampler,
+								   conference->rate,
+								   member->mix_rate, member->frame_size, SWITCH_RESAMPLE_QUALITY, 1) != SWITCH_STATUS_SUCCESS) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_CRIT, "Unable to create resampler!\n");
 			goto done;
 		}
 
-
-		member->resample_out = switch_core_alloc(member->pool, member->frame_size);
-		member->resample_out_len = member->frame_size;
+		member->mix_frame = switch_core_alloc(member->pool, member->frame_size);
 
 		/* Setup an audio buffer for the resampled audio */
 		if (switch_buffer_create_dynamic(&member->resample_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_DBUFFER_MAX)
@@ -7425,25 +8319,25 @@ static int setup_media(conference_member_t *member, conference_obj_t *conference
 	if (switch_core_codec_init(&member->write_codec,
 							   "L16",
 							   NULL,
-							   conference->rate,
+							   member->mix_rate,
 							   read_impl.microseconds_per_packet / 1000,
 							   1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE, NULL, member->pool) == SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_DEBUG,
-						  "Raw Codec Activation Success L16@%uhz 1 channel %dms\n", conference->rate, read_impl.microseconds_per_packet / 1000);
+						  "Raw Codec Activation Success L16@%uhz 1 channel %dms\n", member->mix_rate, read_impl.microseconds_per_packet / 1000);
 	} else {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_DEBUG, "Raw Codec Activation Failed L16@%uhz 1 channel %dms\n",
-						  conference->rate, read_impl.microseconds_per_packet / 1000);
+						  member->mix_rate, read_impl.microseconds_per_packet / 1000);
 		goto codec_done2;
 	}
 
-	/* Setup an audio buffer for the incoming audio */
-	if (switch_buffer_create_dynamic(&member->audio_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_DBUFFER_MAX) != SWITCH_STATUS_SUCCESS) {
+	/* Setup a ring for the incoming audio */
+	if (conference_ring_init(&member->in_ring, CONF_RING_SIZE, member->pool) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
 		goto codec_done1;
 	}
 
-	/* Setup an audio buffer for the outgoing audio */
-	if (switch_buffer_create_dynamic(&member->mux_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_DBUFFER_MAX) != SWITCH_STATUS_SUCCESS) {
+	/* Setup a ring for the outgoing audio */
+	if (conference_ring_init(&member->out_ring, CONF_RING_SIZE, member->pool) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
 		goto codec_done1;
 	}
@@ -7938,8 +8832,6 @@ SWITCH_STANDARD_APP(conference_function)
 	switch_mutex_init(&member.write_mutex, SWITCH_MUTEX_NESTED, member.pool);
 	switch_mutex_init(&member.read_mutex, SWITCH_MUTEX_NESTED, member.pool);
 	switch_mutex_init(&member.fnode_mutex, SWITCH_MUTEX_NESTED, member.pool);
-	switch_mutex_init(&member.audio_in_mutex, SWITCH_MUTEX_NESTED, member.pool);
-	switch_mutex_init(&member.audio_out_mutex, SWITCH_MUTEX_NESTED, member.pool);
 	switch_thread_rwlock_create(&member.rwlock, member.pool);
 
 	/* Install our Signed Linear codec so we get the audio in that format */
@@ -7958,6 +8850,12 @@ SWITCH_STANDARD_APP(conference_function)
 		conference->min = 2;
 	}
 
+	if (conference_cascade_check(conference, &member) != SWITCH_STATUS_SUCCESS) {
+		conference_cdr_rejected(conference, channel, CDRR_CASCADE_LOOP);
+		switch_core_codec_destroy(&member.read_codec);
+		goto done;
+	}
+
 	/* Add the caller to the conference */
 	if (conference_add_member(conference, &member) != SWITCH_STATUS_SUCCESS) {
 		switch_core_codec_destroy(&member.read_codec);
@@ -7997,10 +8895,12 @@ SWITCH_STANDARD_APP(conference_function)
 		switch_resample_destroy(&member.read_resampler);
 	}
 
+	if (member.write_resampler) {
+		switch_resample_destroy(&member.write_resampler);
+	}
+
 	switch_event_destroy(&params);
 	switch_buffer_destroy(&member.resample_buffer);
-	switch_buffer_destroy(&member.audio_buffer);
-	switch_buffer_destroy(&member.mux_buffer);
 
 	if (conference) {
 		switch_mutex_lock(conference->mutex);
@@ -8135,16 +9035,18 @@ static int launch_conference_video_bridge_thread(conference_member_t *member_a,
 	
 }
 
-static void launch_conference_record_thread(conference_obj_t *conference, char *path, switch_bool_t autorec)
+static void launch_conference_record_thread(conference_obj_t *conference, char **paths, int npaths, switch_bool_t autorec)
 {
 	switch_thread_t *thread;
 	switch_threadattr_t *thd_attr = NULL;
 	switch_memory_pool_t *pool;
 	conference_record_t *rec;
+	int x;
 
 	/* Setup a memory pool to use. */
 	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Pool Failure\n");
+		return;
 	}
 
 	/* Create a node object */
@@ -8155,9 +9057,36 @@ static void launch_conference_record_thread(conference_obj_t *conference, char *
 	}
 
 	rec->conference = conference;
-	rec->path = switch_core_strdup(pool, path);
 	rec->pool = pool;
 	rec->autorec = autorec;
+	rec->start_time = switch_epoch_time_now(NULL);
+
+	/* each path is one output written from the same mix, taken as is so {var=val,...} prefixes and commas in paths keep working */
+	for (x = npaths - 1; x >= 0; x--) {
+		conference_record_output_t *op;
+
+		if (zstr(paths[x])) {
+			continue;
+		}
+
+		op = switch_core_alloc(pool, sizeof(*op));
+		op->path = switch_core_strdup(pool, paths[x]);
+		op->next = rec->outputs;
+		rec->outputs = op;
+		rec->path = rec->path ? switch_core_sprintf(pool, "%s %s", op->path, rec->path) : op->path;
+	}
+
+	if (!rec->outputs) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid record path\n");
+		switch_core_destroy_memory_pool(&pool);
+		return;
+	}
+
+	rec->frame_samples = switch_samples_per_packet(conference->rate, conference->interval);
+	rec->ring_frames = CONF_RECORD_RING_FRAMES;
+	rec->ring = switch_core_alloc(pool, rec->ring_frames * rec->frame_samples * sizeof(int16_t));
+	rec->batch = switch_core_alloc(pool, CONF_RECORD_BATCH_FRAMES * rec->frame_samples * sizeof(int16_t));
+	rec->flags = RECFLAG_RUNNING;
 
 	switch_mutex_lock(conference->flag_mutex);
 	rec->next = conference->rec_node_head;
@@ -9353,6 +10282,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_conference_load)
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't subscribe to conference data query events!\n");
 	}
 
+	if (switch_event_bind(modname, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT, conference_cascade_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't subscribe to conference cascade events!\n");
+	}
+
 	SWITCH_ADD_API(api_interface, "conference", "Conference module commands", conf_api_main, p);
 	SWITCH_ADD_APP(app_interface, global_app_name, global_app_name, NULL, conference_function, NULL, SAF_NONE);
 	SWITCH_ADD_APP(app_interface, "conference_set_auto_outcall", "conference_set_auto_outcall", NULL, conference_auto_function, NULL, SAF_NONE);
@@ -9384,6 +10317,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_conference_shutdown)
 		switch_event_unbind_callback(pres_event_handler);
 		switch_event_unbind_callback(conf_data_event_handler);
 		switch_event_unbind_callback(call_setup_event_handler);
+		switch_event_unbind_callback(conference_cascade_event_handler);
 		switch_event_free_subclass(CONF_EVENT_MAINT);
 
 		/* free api interface help ".syntax" field string */
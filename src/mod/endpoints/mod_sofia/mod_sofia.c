@@ -2576,6 +2576,16 @@ static switch_status_t cmd_status(char **argv, int argc, switch_stream_handle_t
 					stream->write_function(stream, "CALLS-OUT        \t%u\n", profile->ob_calls);
 					stream->write_function(stream, "FAILED-CALLS-OUT \t%u\n", profile->ob_failed_calls);
 					stream->write_function(stream, "REGISTRATIONS    \t%lu\n", sofia_profile_reg_count(profile));
+					stream->write_function(stream, "PING-CONTACTS    \t%u\n", sofia_reg_ping_count(profile));
+					stream->write_function(stream, "PRES-NOTIFIES    \t%u\n", profile->pres_notify_total);
+					stream->write_function(stream, "PRES-NOTIFY-RATE \t%u/sec\n", profile->pres_notify_rate);
+					stream->write_function(stream, "PRES-COALESCED   \t%u\n", mod_sofia_globals.presence_coalesced);
+					stream->write_function(stream, "OVERLOAD         \t%u%% (%u rejected, queue wait %" SWITCH_TIME_T_FMT "ms)\n",
+										   mod_sofia_globals.overload_level, mod_sofia_globals.overload_rejected, mod_sofia_globals.overload_wait / 1000);
+				}
+
+				if (argv[2] && !strcasecmp(argv[2], "stats")) {
+					sofia_stats_report(profile, stream, SWITCH_FALSE);
 				}
 
 				cb.profile = profile;
@@ -2699,6 +2709,17 @@ static switch_status_t cmd_status(char **argv, int argc, switch_stream_handle_t
 	switch_mutex_unlock(mod_sofia_globals.hash_mutex);
 	stream->write_function(stream, "%s\n", line);
 	stream->write_function(stream, "%d profile%s %d alias%s\n", c, c == 1 ? "" : "s", ac, ac == 1 ? "" : "es");
+	stream->write_function(stream, "\n%25s\t%10s\t%20s\t%15s\t%15s\n", "Message Thread", "Depth", "Events", "Avg Wait(us)", "Max Wait(us)");
+	stream->write_function(stream, "%s\n", line);
+	for (c = 0; c < mod_sofia_globals.msg_queue_len; c++) {
+		sofia_msg_worker_t *worker = &mod_sofia_globals.msg_worker[c];
+		uint64_t events = worker->events;
+
+		stream->write_function(stream, "%25d\t%10u\t%20" SWITCH_UINT64_T_FMT "\t%15" SWITCH_INT64_T_FMT "\t%15" SWITCH_INT64_T_FMT "\n",
+							   worker->id, worker->queue ? switch_queue_size(worker->queue) : 0, events,
+							   events ? (int64_t) (worker->wait_total / events) : (int64_t) 0, (int64_t) worker->wait_max);
+	}
+	stream->write_function(stream, "%s\n", line);
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -2854,6 +2875,14 @@ static switch_status_t cmd_xml_status(char **argv, int argc, switch_stream_handl
 					stream->write_function(stream, "    <failed-calls-in>%u</failed-calls-in>\n", profile->ib_failed_calls);
 					stream->write_function(stream, "    <failed-calls-out>%u</failed-calls-out>\n", profile->ob_failed_calls);
 					stream->write_function(stream, "    <registrations>%lu</registrations>\n", sofia_profile_reg_count(profile));
+					stream->write_function(stream, "    <presence-notifies>%u</presence-notifies>\n", profile->pres_notify_total);
+					stream->write_function(stream, "    <presence-notify-rate>%u</presence-notify-rate>\n", profile->pres_notify_rate);
+					stream->write_function(stream, "    <presence-coalesced>%u</presence-coalesced>\n", mod_sofia_globals.presence_coalesced);
+					stream->write_function(stream, "    <overload-level>%u</overload-level>\n", mod_sofia_globals.overload_level);
+					stream->write_function(stream, "    <overload-rejected>%u</overload-rejected>\n", mod_sofia_globals.overload_rejected);
+					if (argv[2] && !strcasecmp(argv[2], "stats")) {
+						sofia_stats_report(profile, stream, SWITCH_TRUE);
+					}
 					stream->write_function(stream, "  </profile-info>\n");
 				}
 
@@ -3488,6 +3517,10 @@ static void select_from_profile(sofia_profile_t *profile,
 	cb.stream = stream;
 	cb.dedup = dedup;
 
+	if (!exclude_contact && sofia_reg_cache_contacts(profile, user, domain, switch_str_nil(concat), contact_callback, &cb)) {
+		return;
+	}
+
 	if (exclude_contact) {
 		sql = switch_mprintf("select contact, profile_name, '%q' "
 							 "from sip_registrations where profile_name='%q' and sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%') "
@@ -3871,7 +3904,7 @@ SWITCH_STANDARD_API(sofia_function)
 		"                     siptrace <on|off>\n"
 		"                     capture  <on|off>\n"
 		"                     watchdog <on|off>\n\n"
-		"sofia <status|xmlstatus> profile <name> [reg [<contact str>]] | [pres <pres str>] | [user <user@domain>]\n"
+		"sofia <status|xmlstatus> profile <name> [reg [<contact str>]] | [pres <pres str>] | [user <user@domain>] | [stats]\n"
 		"sofia <status|xmlstatus> gateway <name>\n\n"
 		"sofia loglevel <all|default|tport|iptsec|nea|nta|nth_client|nth_server|nua|soa|sresolv|stun> [0-9]\n"
 		"sofia tracelevel <console|alert|crit|err|warning|notice|info|debug>\n\n"
@@ -5101,7 +5134,7 @@ static void general_event_handler(switch_event_t *event)
 			}
 
 			if (call_id) {
-				nh = nua_handle_by_call_id(profile->nua, call_id);
+				nh = sofia_nua_handle_by_call_id(profile, call_id);
 
 				if (!nh) {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid Call-ID %s\n", call_id);
@@ -5482,6 +5515,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_sofia_load)
 	switch_core_hash_init(&mod_sofia_globals.profile_hash, mod_sofia_globals.pool);
 	switch_core_hash_init(&mod_sofia_globals.gateway_hash, mod_sofia_globals.pool);
 	switch_mutex_init(&mod_sofia_globals.hash_mutex, SWITCH_MUTEX_NESTED, mod_sofia_globals.pool);
+	switch_mutex_init(&mod_sofia_globals.overload_mutex, SWITCH_MUTEX_NESTED, mod_sofia_globals.pool);
+	sofia_stats_init();
 
 	switch_mutex_lock(mod_sofia_globals.mutex);
 	mod_sofia_globals.running = 1;
@@ -5501,11 +5536,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_sofia_load)
 		mod_sofia_globals.max_msg_queues = SOFIA_MAX_MSG_QUEUE;
 	}
 
-	switch_queue_create(&mod_sofia_globals.msg_queue, SOFIA_MSG_QUEUE_SIZE * mod_sofia_globals.max_msg_queues, mod_sofia_globals.pool);
-
-	/* start one message thread */
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Starting initial message thread.\n");
-	sofia_msg_thread_start(0);
+	/* events are routed to a fixed queue per nua handle so all message threads have to exist up front */
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Starting %d message threads.\n", mod_sofia_globals.max_msg_queues);
+	sofia_msg_thread_start(mod_sofia_globals.max_msg_queues - 1);
 
 
 	if (sofia_init() != SWITCH_STATUS_SUCCESS) {
@@ -5698,14 +5731,14 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_sofia_shutdown)
 	}
 
 
-	for (i = 0; mod_sofia_globals.msg_queue_thread[i]; i++) {
-		switch_queue_push(mod_sofia_globals.msg_queue, NULL);
-		switch_queue_interrupt_all(mod_sofia_globals.msg_queue);
+	for (i = 0; i < SOFIA_MAX_MSG_QUEUE && mod_sofia_globals.msg_worker[i].thread; i++) {
+		switch_queue_push(mod_sofia_globals.msg_worker[i].queue, NULL);
+		switch_queue_interrupt_all(mod_sofia_globals.msg_worker[i].queue);
 	}
 
 
-	for (i = 0; mod_sofia_globals.msg_queue_thread[i]; i++) {
-		switch_thread_join(&st, mod_sofia_globals.msg_queue_thread[i]);
+	for (i = 0; i < SOFIA_MAX_MSG_QUEUE && mod_sofia_globals.msg_worker[i].thread; i++) {
+		switch_thread_join(&st, mod_sofia_globals.msg_worker[i].thread);
 	}
 
 	if (mod_sofia_globals.presence_thread) {
@@ -73,6 +73,9 @@ typedef struct sofia_profile sofia_profile_t;
 
 typedef struct sofia_private sofia_private_t;
 
+/* NAT keepalive wheel, see sofia_reg.c */
+typedef struct sofia_ping_wheel_s sofia_ping_wheel_t;
+
 struct private_object;
 typedef struct private_object private_object_t;
 #define NUA_HMAGIC_T sofia_private_t
@@ -93,6 +96,7 @@ typedef struct private_object private_object_t;
 #define MY_EVENT_RECOVERY_SEND "sofia::recovery_send"
 #define MY_EVENT_RECOVERY_RECOVERED "sofia::recovery_recovered"
 #define MY_EVENT_ERROR "sofia::error"
+#define MY_EVENT_PROFILE_STATS "sofia::profile_stats"
 
 #define MULTICAST_EVENT "multicast::event"
 #define SOFIA_REPLACES_HEADER "_sofia_replaces_"
@@ -159,6 +163,7 @@ typedef struct sofia_dispatch_event_s {
 	switch_core_session_t *session;
 	switch_core_session_t *init_session;
 	switch_memory_pool_t *pool;
+	switch_time_t queued;
 	struct sofia_dispatch_event_s *next;
 } sofia_dispatch_event_t;
 
@@ -192,6 +197,20 @@ struct sip_alias_node {
 
 typedef struct sip_alias_node sip_alias_node_t;
 
+struct sofia_shard {
+	sofia_profile_t *profile;
+	uint32_t index;
+	const char *supported;
+	su_root_t *s_root;
+	nua_t *nua;
+	switch_thread_t *thread;
+	int started;
+	int stop;
+	int shutdown;
+};
+
+typedef struct sofia_shard sofia_shard_t;
+
 typedef enum {
 	MFLAG_REFER = (1 << 0),
 	MFLAG_REGISTER = (1 << 1)
@@ -270,6 +289,7 @@ typedef enum {
 	PFLAG_TCP_KEEPALIVE,
 	PFLAG_TCP_PINGPONG,
 	PFLAG_TCP_PING2PONG,
+	PFLAG_STATELESS_NONCE,
 	/* No new flags below this line */
 	PFLAG_MAX
 } PFLAGS;
@@ -326,6 +346,17 @@ typedef enum {
 #define SOFIA_MAX_MSG_QUEUE 64
 #define SOFIA_MSG_QUEUE_SIZE 1000
 
+/* One dispatch queue per message thread, events of a nua handle always use the same one */
+typedef struct sofia_msg_worker_s {
+	int id;
+	switch_queue_t *queue;
+	switch_thread_t *thread;
+	uint64_t events;
+	switch_time_t wait_total;
+	switch_time_t wait_max;
+	switch_time_t wait_avg;
+} sofia_msg_worker_t;
+
 struct mod_sofia_globals {
 	switch_memory_pool_t *pool;
 	switch_hash_t *profile_hash;
@@ -340,8 +371,7 @@ struct mod_sofia_globals {
 	char guess_ip[80];
 	char hostname[512];
 	switch_queue_t *presence_queue;
-	switch_queue_t *msg_queue;
-	switch_thread_t *msg_queue_thread[SOFIA_MAX_MSG_QUEUE];
+	sofia_msg_worker_t msg_worker[SOFIA_MAX_MSG_QUEUE];
 	int msg_queue_len;
 	struct sofia_private destroy_private;
 	struct sofia_private keep_private;
@@ -356,8 +386,19 @@ struct mod_sofia_globals {
 	char *capture_server;
 	int rewrite_multicasted_fs_path;
 	int presence_flush;
+	uint32_t presence_coalesce_ms;
+	uint32_t presence_coalesced;
 	switch_thread_t *presence_thread;
 	uint32_t max_reg_threads;
+	switch_mutex_t *overload_mutex;
+	switch_time_t overload_wait_target;
+	switch_time_t overload_wait;
+	switch_time_t overload_next;
+	uint32_t overload_retry_after;
+	uint32_t overload_level;
+	uint32_t overload_seq;
+	uint32_t overload_rejected;
+	switch_threadkey_t *stats_method_key;
 };
 extern struct mod_sofia_globals mod_sofia_globals;
 
@@ -519,6 +560,51 @@ typedef enum {
 
 #define MAX_RTPIP 50
 
+typedef enum {
+	SOFIA_STATS_INVITE,
+	SOFIA_STATS_REGISTER,
+	SOFIA_STATS_SUBSCRIBE,
+	SOFIA_STATS_NOTIFY,
+	SOFIA_STATS_PUBLISH,
+	SOFIA_STATS_OPTIONS,
+	SOFIA_STATS_MESSAGE,
+	SOFIA_STATS_INFO,
+	SOFIA_STATS_REFER,
+	SOFIA_STATS_BYE,
+	SOFIA_STATS_OTHER,
+	SOFIA_STATS_METHOD_MAX
+} sofia_stats_method_t;
+
+/* <1ms <5ms <10ms <50ms <100ms <500ms <1s and the rest */
+#define SOFIA_STATS_BUCKETS 8
+
+typedef struct {
+	uint32_t buckets[SOFIA_STATS_BUCKETS];
+	uint32_t samples;
+	switch_time_t total;
+	switch_time_t max;
+} sofia_stats_hist_t;
+
+typedef struct {
+	uint32_t requests;
+	uint32_t requests_last;
+	uint32_t rate;
+	sofia_stats_hist_t wait;
+	sofia_stats_hist_t handler;
+	sofia_stats_hist_t db;
+	/* final responses to our own requests by class, [0] counts anything past 6xx */
+	uint32_t responses[7];
+} sofia_stats_method_stats_t;
+
+typedef struct {
+	switch_mutex_t *mutex;
+	sofia_stats_method_stats_t methods[SOFIA_STATS_METHOD_MAX];
+	sofia_stats_hist_t db;
+	switch_time_t started;
+	uint32_t event_interval;
+	uint32_t event_loops;
+} sofia_profile_stats_t;
+
 struct sofia_profile {
 	int debug;
 	char *name;
@@ -591,9 +677,32 @@ struct sofia_profile {
 	unsigned int mndlb;
 	uint32_t max_calls;
 	uint32_t nonce_ttl;
+	char *nonce_secret;
+	switch_mutex_t *nonce_mutex;
+	switch_hash_t *nonce_nc_hash[2];
+	time_t nonce_nc_rotated;
+	uint32_t nonce_nc_period;
+	int reg_cache_ttl;
+	switch_hash_t *reg_cache_hash;
+	switch_thread_rwlock_t *reg_cache_rwlock;
+	uint32_t reg_cache_gen;
+	time_t reg_cache_hold;
+	switch_hash_t *pres_watch_hash;
+	switch_mutex_t *pres_watch_mutex;
+	int pres_watch_loaded;
+	sofia_ping_wheel_t *ping_wheel;
+	switch_mutex_t *ping_mutex;
+	uint32_t pres_notify_total;
+	uint32_t pres_notify_last;
+	uint32_t pres_notify_rate;
+	sofia_profile_stats_t stats;
 	nua_t *nua;
 	switch_memory_pool_t *pool;
 	su_root_t *s_root;
+	uint32_t transport_threads;
+	sofia_shard_t *shards;
+	nta_shard_group_t *shard_group;
+	switch_thread_rwlock_t *shard_rwlock;
 	sip_alias_node_t *aliases;
 	switch_payload_t cng_pt;
 	uint32_t codec_flags;
@@ -925,6 +1034,19 @@ void sofia_glue_actually_execute_sql_trans(sofia_profile_t *profile, char *sql,
 void sofia_glue_execute_sql_now(sofia_profile_t *profile, char **sqlp, switch_bool_t sql_already_dynamic);
 void sofia_glue_execute_sql_soon(sofia_profile_t *profile, char **sqlp, switch_bool_t sql_already_dynamic);
 void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot);
+void sofia_reg_nonce_cache_destroy(sofia_profile_t *profile);
+void sofia_reg_cache_invalidate(sofia_profile_t *profile, const char *user);
+void sofia_reg_cache_invalidate_call_id(sofia_profile_t *profile, const char *call_id);
+void sofia_reg_cache_expire(sofia_profile_t *profile, time_t now);
+void sofia_reg_cache_destroy(sofia_profile_t *profile);
+switch_bool_t sofia_reg_cache_contacts(sofia_profile_t *profile, const char *user, const char *host, const char *extra,
+								 switch_core_db_callback_func_t callback, void *pArg);
+void sofia_reg_ping_add(sofia_profile_t *profile, const char *call_id, const char *user, const char *host,
+						const char *contact, const char *status, long expires);
+void sofia_reg_ping_del(sofia_profile_t *profile, const char *call_id);
+void sofia_reg_ping_flush(sofia_profile_t *profile);
+void sofia_reg_ping_tick(sofia_profile_t *profile, time_t now);
+uint32_t sofia_reg_ping_count(sofia_profile_t *profile);
 void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now);
 void sofia_sub_check_gateway(sofia_profile_t *profile, time_t now);
 void sofia_reg_unregister(sofia_profile_t *profile);
@@ -1098,10 +1220,19 @@ void sofia_glue_build_vid_refresh_message(switch_core_session_t *session, const
 char *sofia_glue_gen_contact_str(sofia_profile_t *profile, sip_t const *sip, nua_handle_t *nh, sofia_dispatch_event_t *de, sofia_nat_parse_t *np);
 void sofia_glue_pause_jitterbuffer(switch_core_session_t *session, switch_bool_t on);
 void sofia_process_dispatch_event(sofia_dispatch_event_t **dep);
+nua_handle_t *sofia_nua_handle_by_call_id(sofia_profile_t *profile, const char *call_id);
+nua_handle_t *sofia_nua_handle_by_replaces(sofia_profile_t *profile, sip_replaces_t const *replaces);
+void sofia_stats_init(void);
+void sofia_stats_db(sofia_profile_t *profile, switch_time_t elapsed);
+void sofia_stats_tick(sofia_profile_t *profile);
+void sofia_stats_report(sofia_profile_t *profile, switch_stream_handle_t *stream, switch_bool_t xml);
 void sofia_process_dispatch_event_in_thread(sofia_dispatch_event_t **dep);
 char *sofia_glue_get_host(const char *str, switch_memory_pool_t *pool);
 void sofia_presence_check_subscriptions(sofia_profile_t *profile, time_t now);
+void sofia_presence_watch_add(sofia_profile_t *profile, const char *user);
+void sofia_presence_watch_destroy(sofia_profile_t *profile);
 void sofia_msg_thread_start(int idx);
+switch_queue_t *sofia_msg_queue_by_handle(nua_handle_t *nh);
 void crtp_init(switch_loadable_module_interface_t *module_interface);
 int sofia_recover_callback(switch_core_session_t *session);
 void sofia_glue_set_name(private_object_t *tech_pvt, const char *channame);
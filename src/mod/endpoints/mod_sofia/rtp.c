@@ -640,6 +640,10 @@ static switch_status_t channel_receive_message(switch_core_session_t *session, s
 					if (maxqlen < qlen) {
 						maxqlen = qlen * 5;
 					}
+					if (switch_true(switch_channel_get_variable(tech_pvt->channel, "rtp_jitter_buffer_adaptive"))) {
+						switch_rtp_set_flag(tech_pvt->rtp_session, SWITCH_RTP_FLAG_ADAPTIVE_JB);
+					}
+
 					if (switch_rtp_activate_jitter_buffer(tech_pvt->rtp_session, qlen, maxqlen,
 														  tech_pvt->read_codec.implementation->samples_per_packet, 
 														  tech_pvt->read_codec.implementation->samples_per_second, max_drift) == SWITCH_STATUS_SUCCESS) {
@@ -1216,6 +1216,22 @@ static void our_sofia_event_callback(nua_event_t event,
 		break;
 	case nua_r_shutdown:
 		if (status >= 200) {
+			if (nua != profile->nua) {
+				uint32_t i;
+
+				if (!profile->shards) {
+					break;
+				}
+
+				switch_thread_rwlock_rdlock(profile->shard_rwlock);
+				for (i = 1; i < profile->transport_threads; i++) {
+					if (profile->shards[i].nua == nua) {
+						profile->shards[i].shutdown = 1;
+					}
+				}
+				switch_thread_rwlock_unlock(profile->shard_rwlock);
+				break;
+			}
 			sofia_set_pflag(profile, PFLAG_SHUTDOWN);
 			su_root_break(profile->s_root);
 		}
@@ -1433,6 +1449,7 @@ static void our_sofia_event_callback(nua_event_t event,
 
 
 				sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+				sofia_presence_watch_add(profile, to_user);
 
 				sip_to_tag(nh->nh_home, sip->sip_to, to_tag);
 			}
@@ -1460,6 +1477,8 @@ static void our_sofia_event_callback(nua_event_t event,
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "SOCKET DISCONNECT: %s %s:%s\n",
 								  sofia_private->call_id, sofia_private->network_ip, sofia_private->network_port);
 				sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+				sofia_reg_cache_invalidate_call_id(profile, sofia_private->call_id);
+				sofia_reg_ping_del(profile, sofia_private->call_id);
 
 
 				sofia_reg_check_socket(profile, sofia_private->call_id, sofia_private->network_ip, sofia_private->network_port);
@@ -1591,6 +1610,333 @@ void *SWITCH_THREAD_FUNC sofia_msg_thread_run_once(switch_thread_t *thread, void
 	return NULL;
 }
 
+/* Profile stats
+
+   Every dispatched event lands in a histogram of its method, one for the time it sat
+   in a queue and one for the time its handler took.  The blocking sql helpers in
+   sofia_glue.c feed the db histogram of the profile, and the one of the method whose
+   handler is running on the calling thread, found through a thread key the dispatcher sets.  All of it is a few adds under a mutex nothing
+   else takes, so it stays on. */
+
+static const char *sofia_stats_method_names[SOFIA_STATS_METHOD_MAX] = {
+	"INVITE", "REGISTER", "SUBSCRIBE", "NOTIFY", "PUBLISH", "OPTIONS", "MESSAGE", "INFO", "REFER", "BYE", "OTHER"
+};
+
+static const switch_time_t sofia_stats_limits[SOFIA_STATS_BUCKETS - 1] = { 1000, 5000, 10000, 50000, 100000, 500000, 1000000 };
+
+static const char *sofia_stats_bucket_names[SOFIA_STATS_BUCKETS] = {
+	"1ms", "5ms", "10ms", "50ms", "100ms", "500ms", "1s", "inf"
+};
+
+static sofia_stats_method_t sofia_stats_method(nua_event_t event, int *request)
+{
+	switch (event) {
+	case nua_i_invite:
+	case nua_i_register:
+	case nua_i_subscribe:
+	case nua_i_notify:
+	case nua_i_publish:
+	case nua_i_options:
+	case nua_i_message:
+	case nua_i_info:
+	case nua_i_refer:
+	case nua_i_bye:
+		*request = 1;
+		break;
+	default:
+		*request = 0;
+		break;
+	}
+
+	switch (event) {
+	case nua_i_invite:
+	case nua_r_invite:
+		return SOFIA_STATS_INVITE;
+	case nua_i_register:
+	case nua_r_register:
+	case nua_r_unregister:
+		return SOFIA_STATS_REGISTER;
+	case nua_i_subscribe:
+	case nua_r_subscribe:
+	case nua_r_unsubscribe:
+		return SOFIA_STATS_SUBSCRIBE;
+	case nua_i_notify:
+	case nua_r_notify:
+		return SOFIA_STATS_NOTIFY;
+	case nua_i_publish:
+	case nua_r_publish:
+	case nua_r_unpublish:
+		return SOFIA_STATS_PUBLISH;
+	case nua_i_options:
+	case nua_r_options:
+		return SOFIA_STATS_OPTIONS;
+	case nua_i_message:
+	case nua_r_message:
+		return SOFIA_STATS_MESSAGE;
+	case nua_i_info:
+	case nua_r_info:
+		return SOFIA_STATS_INFO;
+	case nua_i_refer:
+	case nua_r_refer:
+		return SOFIA_STATS_REFER;
+	case nua_i_bye:
+	case nua_r_bye:
+		return SOFIA_STATS_BYE;
+	default:
+		return SOFIA_STATS_OTHER;
+	}
+}
+
+static void sofia_stats_hist_add(sofia_stats_hist_t *hist, switch_time_t elapsed)
+{
+	int i;
+
+	for (i = 0; i < SOFIA_STATS_BUCKETS - 1; i++) {
+		if (elapsed < sofia_stats_limits[i]) {
+			break;
+		}
+	}
+
+	hist->buckets[i]++;
+	hist->samples++;
+	hist->total += elapsed;
+
+	if (elapsed > hist->max) {
+		hist->max = elapsed;
+	}
+}
+
+static void sofia_stats_event(sofia_profile_t *profile, nua_event_t event, int status, switch_time_t wait, switch_time_t handler)
+{
+	sofia_stats_method_stats_t *ms;
+	int request = 0;
+
+	if (!profile || !profile->stats.mutex) {
+		return;
+	}
+
+	ms = &profile->stats.methods[sofia_stats_method(event, &request)];
+
+	switch_mutex_lock(profile->stats.mutex);
+
+	if (request) {
+		ms->requests++;
+	} else if (status >= 200 && event != nua_i_state && event != nua_i_terminated) {
+		ms->responses[status < 700 ? status / 100 : 0]++;
+	}
+
+	sofia_stats_hist_add(&ms->wait, wait);
+	sofia_stats_hist_add(&ms->handler, handler);
+
+	switch_mutex_unlock(profile->stats.mutex);
+}
+
+void sofia_stats_init(void)
+{
+	if (switch_threadkey_private_create(&mod_sofia_globals.stats_method_key, NULL, mod_sofia_globals.pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot create stats thread key, db time will not be split per method\n");
+		mod_sofia_globals.stats_method_key = NULL;
+	}
+}
+
+/* the method being handled on this thread, stored as method + 1 so nothing set reads back as NULL */
+static void *sofia_stats_method_swap(void *method)
+{
+	void *prev = NULL;
+
+	if (mod_sofia_globals.stats_method_key) {
+		switch_threadkey_private_get(&prev, mod_sofia_globals.stats_method_key);
+		switch_threadkey_private_set(method, mod_sofia_globals.stats_method_key);
+	}
+
+	return prev;
+}
+
+void sofia_stats_db(sofia_profile_t *profile, switch_time_t elapsed)
+{
+	void *method = NULL;
+
+	if (!profile->stats.mutex) {
+		return;
+	}
+
+	if (mod_sofia_globals.stats_method_key) {
+		switch_threadkey_private_get(&method, mod_sofia_globals.stats_method_key);
+	}
+
+	switch_mutex_lock(profile->stats.mutex);
+	sofia_stats_hist_add(&profile->stats.db, elapsed);
+	if (method) {
+		sofia_stats_hist_add(&profile->stats.methods[(intptr_t) method - 1].db, elapsed);
+	}
+	switch_mutex_unlock(profile->stats.mutex);
+}
+
+static char *sofia_stats_hist_str(sofia_stats_hist_t *hist, char *buf, size_t len)
+{
+	int i;
+
+	*buf = '\0';
+
+	for (i = 0; i < SOFIA_STATS_BUCKETS; i++) {
+		switch_snprintf(buf + strlen(buf), len - strlen(buf), "%s%s:%u", i ? "," : "", sofia_stats_bucket_names[i], hist->buckets[i]);
+	}
+
+	return buf;
+}
+
+static switch_time_t sofia_stats_avg(sofia_stats_hist_t *hist)
+{
+	return hist->samples ? hist->total / hist->samples : 0;
+}
+
+static void sofia_stats_fire_event(sofia_profile_t *profile)
+{
+	switch_event_t *event;
+	sofia_profile_stats_t *stats = &profile->stats;
+	char buf[256], hdr[64];
+	int i, x;
+
+	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, MY_EVENT_PROFILE_STATS) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "profile-name", profile->name);
+
+	switch_mutex_lock(stats->mutex);
+
+	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "uptime", "%" SWITCH_TIME_T_FMT, (switch_micro_time_now() - stats->started) / 1000000);
+	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "cps", "%u", stats->methods[SOFIA_STATS_INVITE].rate);
+
+	for (i = 0; i < SOFIA_STATS_METHOD_MAX; i++) {
+		sofia_stats_method_stats_t *ms = &stats->methods[i];
+		const char *name = sofia_stats_method_names[i];
+
+		if (!ms->handler.samples) {
+			continue;
+		}
+
+		switch_snprintf(hdr, sizeof(hdr), "%s-requests", name);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, hdr, "total=%u;rate=%u;events=%u", ms->requests, ms->rate, ms->handler.samples);
+		switch_snprintf(hdr, sizeof(hdr), "%s-wait", name);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, hdr, "avg=%" SWITCH_TIME_T_FMT ";max=%" SWITCH_TIME_T_FMT ";%s",
+								sofia_stats_avg(&ms->wait), ms->wait.max, sofia_stats_hist_str(&ms->wait, buf, sizeof(buf)));
+		switch_snprintf(hdr, sizeof(hdr), "%s-handler", name);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, hdr, "avg=%" SWITCH_TIME_T_FMT ";max=%" SWITCH_TIME_T_FMT ";%s",
+								sofia_stats_avg(&ms->handler), ms->handler.max, sofia_stats_hist_str(&ms->handler, buf, sizeof(buf)));
+		switch_snprintf(hdr, sizeof(hdr), "%s-db", name);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, hdr, "calls=%u;avg=%" SWITCH_TIME_T_FMT ";max=%" SWITCH_TIME_T_FMT ";%s",
+								ms->db.samples, sofia_stats_avg(&ms->db), ms->db.max, sofia_stats_hist_str(&ms->db, buf, sizeof(buf)));
+
+		*buf = '\0';
+		for (x = 2; x < 7; x++) {
+			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "%s%dxx:%u", x > 2 ? "," : "", x, ms->responses[x]);
+		}
+		switch_snprintf(hdr, sizeof(hdr), "%s-responses", name);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, hdr, buf);
+	}
+
+	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "db", "calls=%u;avg=%" SWITCH_TIME_T_FMT ";max=%" SWITCH_TIME_T_FMT ";%s",
+							stats->db.samples, sofia_stats_avg(&stats->db), stats->db.max, sofia_stats_hist_str(&stats->db, buf, sizeof(buf)));
+
+	switch_mutex_unlock(stats->mutex);
+
+	switch_event_fire(&event);
+}
+
+/* called once a second from the profile worker */
+void sofia_stats_tick(sofia_profile_t *profile)
+{
+	sofia_profile_stats_t *stats = &profile->stats;
+	int i;
+
+	if (!stats->mutex) {
+		return;
+	}
+
+	switch_mutex_lock(stats->mutex);
+	for (i = 0; i < SOFIA_STATS_METHOD_MAX; i++) {
+		stats->methods[i].rate = stats->methods[i].requests - stats->methods[i].requests_last;
+		stats->methods[i].requests_last = stats->methods[i].requests;
+	}
+	switch_mutex_unlock(stats->mutex);
+
+	if (stats->event_interval && ++stats->event_loops >= stats->event_interval) {
+		stats->event_loops = 0;
+		sofia_stats_fire_event(profile);
+	}
+}
+
+void sofia_stats_report(sofia_profile_t *profile, switch_stream_handle_t *stream, switch_bool_t xml)
+{
+	sofia_profile_stats_t *stats = &profile->stats;
+	char buf[256];
+	int i, x;
+
+	if (!stats->mutex) {
+		return;
+	}
+
+	switch_mutex_lock(stats->mutex);
+
+	if (xml) {
+		stream->write_function(stream, "    <stats>\n");
+		stream->write_function(stream, "      <cps>%u</cps>\n", stats->methods[SOFIA_STATS_INVITE].rate);
+	} else {
+		stream->write_function(stream, "\nStats (times in usec, histogram buckets are upper bounds):\n");
+		stream->write_function(stream, "CPS              \t%u\n", stats->methods[SOFIA_STATS_INVITE].rate);
+	}
+
+	for (i = 0; i < SOFIA_STATS_METHOD_MAX; i++) {
+		sofia_stats_method_stats_t *ms = &stats->methods[i];
+		const char *name = sofia_stats_method_names[i];
+
+		if (!ms->handler.samples) {
+			continue;
+		}
+
+		if (xml) {
+			stream->write_function(stream, "      <method name=\"%s\" requests=\"%u\" rate=\"%u\" events=\"%u\">\n",
+								   name, ms->requests, ms->rate, ms->handler.samples);
+			stream->write_function(stream, "        <wait avg=\"%" SWITCH_TIME_T_FMT "\" max=\"%" SWITCH_TIME_T_FMT "\">%s</wait>\n",
+								   sofia_stats_avg(&ms->wait), ms->wait.max, sofia_stats_hist_str(&ms->wait, buf, sizeof(buf)));
+			stream->write_function(stream, "        <handler avg=\"%" SWITCH_TIME_T_FMT "\" max=\"%" SWITCH_TIME_T_FMT "\">%s</handler>\n",
+								   sofia_stats_avg(&ms->handler), ms->handler.max, sofia_stats_hist_str(&ms->handler, buf, sizeof(buf)));
+			stream->write_function(stream, "        <db calls=\"%u\" avg=\"%" SWITCH_TIME_T_FMT "\" max=\"%" SWITCH_TIME_T_FMT "\">%s</db>\n",
+								   ms->db.samples, sofia_stats_avg(&ms->db), ms->db.max, sofia_stats_hist_str(&ms->db, buf, sizeof(buf)));
+			stream->write_function(stream, "        <responses>");
+			for (x = 2; x < 7; x++) {
+				stream->write_function(stream, "%s%dxx:%u", x > 2 ? "," : "", x, ms->responses[x]);
+			}
+			stream->write_function(stream, "</responses>\n      </method>\n");
+		} else {
+			stream->write_function(stream, "%-17s\trequests %u, %u/sec, %u events\n", name, ms->requests, ms->rate, ms->handler.samples);
+			stream->write_function(stream, "  wait           \tavg %" SWITCH_TIME_T_FMT " max %" SWITCH_TIME_T_FMT " %s\n",
+								   sofia_stats_avg(&ms->wait), ms->wait.max, sofia_stats_hist_str(&ms->wait, buf, sizeof(buf)));
+			stream->write_function(stream, "  handler        \tavg %" SWITCH_TIME_T_FMT " max %" SWITCH_TIME_T_FMT " %s\n",
+								   sofia_stats_avg(&ms->handler), ms->handler.max, sofia_stats_hist_str(&ms->handler, buf, sizeof(buf)));
+			stream->write_function(stream, "  db             \tcalls %u avg %" SWITCH_TIME_T_FMT " max %" SWITCH_TIME_T_FMT " %s\n",
+								   ms->db.samples, sofia_stats_avg(&ms->db), ms->db.max, sofia_stats_hist_str(&ms->db, buf, sizeof(buf)));
+			stream->write_function(stream, "  responses      \t");
+			for (x = 2; x < 7; x++) {
+				stream->write_function(stream, "%s%dxx:%u", x > 2 ? "," : "", x, ms->responses[x]);
+			}
+			stream->write_function(stream, "\n");
+		}
+	}
+
+	if (xml) {
+		stream->write_function(stream, "      <db calls=\"%u\" avg=\"%" SWITCH_TIME_T_FMT "\" max=\"%" SWITCH_TIME_T_FMT "\">%s</db>\n",
+							   stats->db.samples, sofia_stats_avg(&stats->db), stats->db.max, sofia_stats_hist_str(&stats->db, buf, sizeof(buf)));
+		stream->write_function(stream, "    </stats>\n");
+	} else {
+		stream->write_function(stream, "DB               \tcalls %u avg %" SWITCH_TIME_T_FMT " max %" SWITCH_TIME_T_FMT " %s\n",
+							   stats->db.samples, sofia_stats_avg(&stats->db), stats->db.max, sofia_stats_hist_str(&stats->db, buf, sizeof(buf)));
+	}
+
+	switch_mutex_unlock(stats->mutex);
+}
+
 void sofia_process_dispatch_event_in_thread(sofia_dispatch_event_t **dep)
 {
 	sofia_dispatch_event_t *de = *dep;
@@ -1618,11 +1964,20 @@ void sofia_process_dispatch_event(sofia_dispatch_event_t **dep)
 	nua_t *nua = de->nua;
 	sofia_profile_t *profile = de->profile;
 	sofia_private_t *sofia_private = nua_handle_magic(de->nh);
+	switch_time_t start = switch_micro_time_now();
+	int request = 0;
+	void *prev_method;
 	*dep = NULL;
 
+	prev_method = sofia_stats_method_swap((void *) (intptr_t) (sofia_stats_method(de->data->e_event, &request) + 1));
+
 	our_sofia_event_callback(de->data->e_event, de->data->e_status, de->data->e_phrase, de->nua, de->profile,
 							 de->nh, sofia_private, de->sip, de, (tagi_t *) de->data->e_tags);
 
+	sofia_stats_method_swap(prev_method);
+
+	sofia_stats_event(profile, de->data->e_event, de->data->e_status, de->queued ? start - de->queued : 0, switch_micro_time_now() - start);
+
 	nua_destroy_event(de->event);
 	su_free(nh->nh_home, de);
 
@@ -1642,15 +1997,9 @@ static int msg_queue_threads = 0;
 void *SWITCH_THREAD_FUNC sofia_msg_thread_run(switch_thread_t *thread, void *obj)
 {
 	void *pop;
-	switch_queue_t *q = (switch_queue_t *) obj;
-	int my_id;
-
-
-	for (my_id = 0; my_id < mod_sofia_globals.msg_queue_len; my_id++) {
-		if (mod_sofia_globals.msg_queue_thread[my_id] == thread) {
-			break;
-		}
-	}
+	sofia_msg_worker_t *worker = (sofia_msg_worker_t *) obj;
+	switch_queue_t *q = worker->queue;
+	int my_id = worker->id;
 
 	switch_mutex_lock(mod_sofia_globals.mutex);
 	msg_queue_threads++;
@@ -1668,13 +2017,23 @@ void *SWITCH_THREAD_FUNC sofia_msg_thread_run(switch_thread_t *thread, void *obj
 
 		if (pop) {
 			sofia_dispatch_event_t *de = (sofia_dispatch_event_t *) pop;
+			switch_time_t wait = switch_micro_time_now() - de->queued;
+
+			/* only this thread writes its counters, readers can live with a torn value */
+			worker->events++;
+			worker->wait_total += wait;
+			worker->wait_avg += (wait - worker->wait_avg) / 8;
+			if (wait > worker->wait_max) {
+				worker->wait_max = wait;
+			}
+
 			sofia_process_dispatch_event(&de);
 		} else {
 			break;
 		}
 	}
 
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "MSG Thread Ended\n");
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "MSG Thread %d Ended\n", my_id);
 
 	switch_mutex_lock(mod_sofia_globals.mutex);
 	msg_queue_threads--;
@@ -1687,7 +2046,7 @@ void sofia_msg_thread_start(int idx)
 {
 
 	if (idx >= mod_sofia_globals.max_msg_queues ||
-		idx >= SOFIA_MAX_MSG_QUEUE || (idx < mod_sofia_globals.msg_queue_len && mod_sofia_globals.msg_queue_thread[idx])) {
+		idx >= SOFIA_MAX_MSG_QUEUE || (idx < mod_sofia_globals.msg_queue_len && mod_sofia_globals.msg_worker[idx].thread)) {
 		return;
 	}
 
@@ -1695,33 +2054,58 @@ void sofia_msg_thread_start(int idx)
 
 	if (idx >= mod_sofia_globals.msg_queue_len) {
 		int i;
-		mod_sofia_globals.msg_queue_len = idx + 1;
 
-		for (i = 0; i < mod_sofia_globals.msg_queue_len; i++) {
-			if (!mod_sofia_globals.msg_queue_thread[i]) {
+		for (i = 0; i <= idx; i++) {
+			sofia_msg_worker_t *worker = &mod_sofia_globals.msg_worker[i];
+
+			if (!worker->thread) {
 				switch_threadattr_t *thd_attr = NULL;
 
+				worker->id = i;
+				if (!worker->queue) {
+					switch_queue_create(&worker->queue, SOFIA_MSG_QUEUE_SIZE, mod_sofia_globals.pool);
+				}
+
 				switch_threadattr_create(&thd_attr, mod_sofia_globals.pool);
 				switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
 				//switch_threadattr_priority_set(thd_attr, SWITCH_PRI_REALTIME);
-				switch_thread_create(&mod_sofia_globals.msg_queue_thread[i],
+				switch_thread_create(&worker->thread,
 									 thd_attr,
 									 sofia_msg_thread_run,
-									 mod_sofia_globals.msg_queue,
+									 worker,
 									 mod_sofia_globals.pool);
 			}
 		}
+
+		/* routing depends on the number of queues, only publish it once they all exist */
+		mod_sofia_globals.msg_queue_len = idx + 1;
 	}
 
 	switch_mutex_unlock(mod_sofia_globals.mutex);
 }
 
+/* Events of one nua handle (one dialog or transaction) always land on the same
+   thread so they are processed in order and without contending with other dialogs */
+switch_queue_t *sofia_msg_queue_by_handle(nua_handle_t *nh)
+{
+	uintptr_t key = (uintptr_t) nh;
+	int len = mod_sofia_globals.msg_queue_len;
+
+	if (len <= 0) {
+		return NULL;
+	}
+
+	key = (key >> 4) * 2654435761U;
+
+	return mod_sofia_globals.msg_worker[(key >> 8) % (uintptr_t) len].queue;
+}
+
 //static int foo = 0;
 void sofia_queue_message(sofia_dispatch_event_t *de)
 {
-	int launch = 0;
+	switch_queue_t *q;
 
-	if (mod_sofia_globals.running == 0 || !mod_sofia_globals.msg_queue) {
+	if (mod_sofia_globals.running == 0 || !(q = sofia_msg_queue_by_handle(de->nh))) {
 		sofia_process_dispatch_event(&de);
 		return;
 	}
@@ -1733,19 +2117,118 @@ void sofia_queue_message(sofia_dispatch_event_t *de)
 		return;
 	}
 
+	de->queued = switch_micro_time_now();
+	switch_queue_push(q, de);
+}
+
+/* Overload control
+
+   New INVITEs and REGISTERs are turned away with a 503 before they get queued once the
+   msg queues fall behind.  Every 100ms the share turned away goes up 5 points if the
+   worst queue is waiting longer than overload-wait-target-ms or the session table is
+   95% full, and back down 1 point while the wait is under half the target, the loss
+   based scheme from RFC 7339.  In-dialog requests and BYE never count against it. */
+
+#define SOFIA_OVERLOAD_INTERVAL 100000
+#define SOFIA_OVERLOAD_STEP_UP 5
+#define SOFIA_OVERLOAD_STEP_DOWN 1
+
+static void sofia_overload_update(uint32_t sess_count, uint32_t sess_max)
+{
+	switch_time_t now = switch_micro_time_now();
+	switch_time_t wait = 0;
+	uint32_t level;
+	int i;
+
+	/* turning the controller off on a live box must also stop whatever rejecting it was doing */
+	if (!mod_sofia_globals.overload_wait_target) {
+		if ((mod_sofia_globals.overload_level || mod_sofia_globals.overload_wait) &&
+			switch_mutex_trylock(mod_sofia_globals.overload_mutex) == SWITCH_STATUS_SUCCESS) {
+			if (mod_sofia_globals.overload_level) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Overload control disabled, no longer rejecting new requests\n");
+			}
+			mod_sofia_globals.overload_level = 0;
+			mod_sofia_globals.overload_wait = 0;
+			mod_sofia_globals.overload_next = 0;
+			switch_mutex_unlock(mod_sofia_globals.overload_mutex);
+		}
+		return;
+	}
 
-	if ((switch_queue_size(mod_sofia_globals.msg_queue) > (SOFIA_MSG_QUEUE_SIZE * msg_queue_threads))) {
-		launch++;
+	if (now < mod_sofia_globals.overload_next || switch_mutex_trylock(mod_sofia_globals.overload_mutex) != SWITCH_STATUS_SUCCESS) {
+		return;
 	}
 
+	if (now >= mod_sofia_globals.overload_next) {
+		mod_sofia_globals.overload_next = now + SOFIA_OVERLOAD_INTERVAL;
+
+		for (i = 0; i < mod_sofia_globals.msg_queue_len; i++) {
+			sofia_msg_worker_t *worker = &mod_sofia_globals.msg_worker[i];
+
+			/* an empty queue is not behind, whatever its last events waited */
+			if (worker->queue && switch_queue_size(worker->queue) && worker->wait_avg > wait) {
+				wait = worker->wait_avg;
+			}
+		}
+
+		level = mod_sofia_globals.overload_level;
+
+		if (wait > mod_sofia_globals.overload_wait_target || (sess_max && sess_count * 100 >= sess_max * 95)) {
+			level = level + SOFIA_OVERLOAD_STEP_UP > 100 ? 100 : level + SOFIA_OVERLOAD_STEP_UP;
+		} else if (wait < mod_sofia_globals.overload_wait_target / 2) {
+			level = level > SOFIA_OVERLOAD_STEP_DOWN ? level - SOFIA_OVERLOAD_STEP_DOWN : 0;
+		}
 
-	if (launch) {
-		if (mod_sofia_globals.msg_queue_len < mod_sofia_globals.max_msg_queues) {
-			sofia_msg_thread_start(mod_sofia_globals.msg_queue_len + 1);
+		if (level != mod_sofia_globals.overload_level) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, level > mod_sofia_globals.overload_level ? SWITCH_LOG_WARNING : SWITCH_LOG_NOTICE,
+							  "Overload: queue wait %" SWITCH_TIME_T_FMT "ms, %u/%u sessions, rejecting %u%% of new requests\n",
+							  wait / 1000, sess_count, sess_max, level);
 		}
+
+		mod_sofia_globals.overload_wait = wait;
+		mod_sofia_globals.overload_level = level;
+	}
+
+	switch_mutex_unlock(mod_sofia_globals.overload_mutex);
+}
+
+static int sofia_overload_reject(void)
+{
+	uint32_t level = mod_sofia_globals.overload_level;
+
+	if (!level || !mod_sofia_globals.overload_wait_target) {
+		return 0;
+	}
+
+	/* several transport threads bump the counter, a lost increment only moves which request is picked */
+	if (level >= 100 || (mod_sofia_globals.overload_seq++ % 100) < level) {
+		mod_sofia_globals.overload_rejected++;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* RFC 7339 feedback for clients that put oc in their Via, NULL for everyone else */
+static sip_via_t *sofia_overload_via(su_home_t *home, sip_t const *sip)
+{
+	sip_via_t *via;
+	switch_time_t now = switch_micro_time_now();
+	char buf[64];
+
+	if (!sip || !sip->sip_via || !msg_params_find(sip->sip_via->v_params, "oc") || !(via = sip_via_copy(home, sip->sip_via))) {
+		return NULL;
 	}
 
-	switch_queue_push(mod_sofia_globals.msg_queue, de);
+	switch_snprintf(buf, sizeof(buf), "oc=%u", mod_sofia_globals.overload_level);
+	msg_header_replace_param(home, via->v_common, buf);
+	msg_header_replace_param(home, via->v_common, "oc-algo=\"loss\"");
+	switch_snprintf(buf, sizeof(buf), "oc-validity=%u", mod_sofia_globals.overload_retry_after * 1000);
+	msg_header_replace_param(home, via->v_common, buf);
+	switch_snprintf(buf, sizeof(buf), "oc-seq=%" SWITCH_TIME_T_FMT ".%03d", now / 1000000, (int) (now % 1000000) / 1000);
+	msg_header_replace_param(home, via->v_common, buf);
+
+	return via;
 }
 
 static void set_call_id(private_object_t *tech_pvt, sip_t const *sip)
@@ -1764,9 +2247,12 @@ void sofia_event_callback(nua_event_t event,
 						  tagi_t tags[])
 {
 	sofia_dispatch_event_t *de;
-	int critical = (((SOFIA_MSG_QUEUE_SIZE * mod_sofia_globals.max_msg_queues) * 900) / 1000);
+	int critical = ((SOFIA_MSG_QUEUE_SIZE * 900) / 1000);
+	int full = ((SOFIA_MSG_QUEUE_SIZE * 990) / 1000);
+	int in_dialog = 0;
 	uint32_t sess_count = switch_core_session_count();
 	uint32_t sess_max = switch_core_session_limit(0);
+	switch_queue_t *msg_queue;
 
 	switch(event) {
 	case nua_i_terminated:
@@ -1814,17 +2300,37 @@ void sofia_event_callback(nua_event_t event,
 	case nua_i_notify:
 	case nua_i_info:
 
-		if (sess_count >= sess_max || !sofia_test_pflag(profile, PFLAG_RUNNING) || !switch_core_ready_inbound()) {
+		/* requests inside a dialog do not start anything new, let them through as long as possible */
+		in_dialog = sip && sip->sip_to && sip->sip_to->a_tag;
+
+		if ((!in_dialog && sess_count >= sess_max) || !sofia_test_pflag(profile, PFLAG_RUNNING) || !switch_core_ready_inbound()) {
 			nua_respond(nh, 503, "Maximum Calls In Progress", SIPTAG_RETRY_AFTER_STR("300"), NUTAG_WITH_THIS(nua), TAG_END());
 			goto end;
 		}
 
 
-		if (switch_queue_size(mod_sofia_globals.msg_queue) > critical) {
+		if ((msg_queue = sofia_msg_queue_by_handle(nh)) && switch_queue_size(msg_queue) > (in_dialog ? full : critical)) {
 			nua_respond(nh, 503, "System Busy", SIPTAG_RETRY_AFTER_STR("300"), NUTAG_WITH_THIS(nua), TAG_END());
 			goto end;
 		}
 
+		sofia_overload_update(sess_count, sess_max);
+
+		if ((event == nua_i_invite || event == nua_i_register) && !in_dialog && sofia_overload_reject()) {
+			su_home_t *home = su_home_new(sizeof(*home));
+			sip_via_t *via;
+			char retry_after[16];
+
+			switch_assert(home != NULL);
+
+			via = sofia_overload_via(home, sip);
+			switch_snprintf(retry_after, sizeof(retry_after), "%u", mod_sofia_globals.overload_retry_after);
+			nua_respond(nh, 503, "Server Overloaded", SIPTAG_RETRY_AFTER_STR(retry_after), TAG_IF(via, SIPTAG_VIA(via)),
+						NUTAG_WITH_THIS(nua), TAG_END());
+			su_home_unref(home);
+			goto end;
+		}
+
 		if (sofia_test_pflag(profile, PFLAG_STANDBY)) {
 			nua_respond(nh, 503, "System Paused", NUTAG_WITH_THIS(nua), TAG_END());
 			goto end;
@@ -1848,6 +2354,7 @@ void sofia_event_callback(nua_event_t event,
 	de->sip = sip_object(de->data->e_msg);
 	de->profile = profile;
 	de->nua = nua_stack_ref(nua);
+	de->queued = switch_micro_time_now();
 
 	if (event == nua_i_invite && !sofia_private) {
 		switch_core_session_t *session;
@@ -2075,6 +2582,7 @@ void event_handler(switch_event_t *event)
 		}
 
 		sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+		sofia_reg_cache_invalidate(profile, from_user);
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Expired propagated registration for %s@%s->%s\n", from_user, from_host, contact_str);
 
 		if (profile) {
@@ -2190,6 +2698,7 @@ void event_handler(switch_event_t *event)
 
 		if (sql) {
 			sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+			sofia_reg_cache_invalidate(profile, from_user);
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Propagating registration for %s@%s->%s\n", from_user, from_host, contact_str);
 		}
 
@@ -2294,6 +2803,14 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 				ireg_loops = 0;
 			}
 
+			/* the loop ticks once a second */
+			profile->pres_notify_rate = profile->pres_notify_total - profile->pres_notify_last;
+			profile->pres_notify_last = profile->pres_notify_total;
+
+			sofia_stats_tick(profile);
+
+			sofia_reg_ping_tick(profile, switch_epoch_time_now(NULL));
+
 			if (++gateway_loops >= GATEWAY_SECONDS) {
 				sofia_reg_check_gateway(profile, switch_epoch_time_now(NULL));
 				gateway_loops = 0;
@@ -2398,6 +2915,283 @@ switch_thread_t *launch_sofia_worker_thread(sofia_profile_t *profile)
 	return thread;
 }
 
+/* Create a user agent bound to the profile addresses, running in root */
+static nua_t *sofia_profile_create_nua(sofia_profile_t *profile, su_root_t *root, const char *supported)
+{
+	nua_t *nua;
+
+	nua = nua_create(root,	/* Event loop */
+					sofia_event_callback,	/* Callback for processing events */
+					profile,	/* Additional data to pass to callback */
+					TAG_IF( ! sofia_test_pflag(profile, PFLAG_TLS) || ! profile->tls_only, NUTAG_URL(profile->bindurl)),
+					NTATAG_USER_VIA(1),
+					TPTAG_PONG2PING(1),
+					NUTAG_RETRY_AFTER_ENABLE(0),
+					TAG_IF(!strchr(profile->sipip, ':'),
+							 SOATAG_AF(SOA_AF_IP4_ONLY)),
+					TAG_IF(strchr(profile->sipip, ':'),
+							 SOATAG_AF(SOA_AF_IP6_ONLY)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
+							 NUTAG_SIPS_URL(profile->tls_bindurl)),
+					TAG_IF(profile->ws_bindurl,
+							 NUTAG_WS_URL(profile->ws_bindurl)),
+					TAG_IF(profile->wss_bindurl,
+							 NUTAG_WSS_URL(profile->wss_bindurl)),
+					TAG_IF(profile->tls_cert_dir,
+							 NUTAG_CERTIFICATE_DIR(profile->tls_cert_dir)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_passphrase,
+							TPTAG_TLS_PASSPHRASE(profile->tls_passphrase)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
+							 TPTAG_TLS_VERIFY_POLICY(profile->tls_verify_policy)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
+							 TPTAG_TLS_VERIFY_DEPTH(profile->tls_verify_depth)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
+							 TPTAG_TLS_VERIFY_DATE(profile->tls_verify_date)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_verify_in_subjects,
+							  TPTAG_TLS_VERIFY_SUBJECTS(profile->tls_verify_in_subjects)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
+							 TPTAG_TLS_VERSION(profile->tls_version)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_timeout,
+							 TPTAG_TLS_TIMEOUT(profile->tls_timeout)),
+					TAG_IF(!strchr(profile->sipip, ':'),
+							 NTATAG_UDP_MTU(65535)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_DISABLE_SRV),
+							 NTATAG_USE_SRV(0)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_DISABLE_NAPTR),
+							 NTATAG_USE_NAPTR(0)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TCP_PINGPONG),
+							 TPTAG_PINGPONG(profile->tcp_pingpong)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TCP_PING2PONG),
+							 TPTAG_PINGPONG(profile->tcp_ping2pong)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_DISABLE_SRV503),
+							 NTATAG_SRV_503(0)),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_TCP_KEEPALIVE),
+							 TPTAG_KEEPALIVE(profile->tcp_keepalive)),
+					NTATAG_DEFAULT_PROXY(profile->outbound_proxy),
+					NTATAG_SERVER_RPORT(profile->server_rport_level),
+					NTATAG_CLIENT_RPORT(profile->client_rport_level),
+					TPTAG_LOG(sofia_test_flag(profile, TFLAG_TPORT_LOG)),
+					TPTAG_CAPT(sofia_test_flag(profile, TFLAG_CAPTURE) ? mod_sofia_globals.capture_server : NULL),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_SIPCOMPACT),
+							 NTATAG_SIPFLAGS(MSG_DO_COMPACT)),
+					TAG_IF(profile->timer_t1, NTATAG_SIP_T1(profile->timer_t1)),
+					TAG_IF(profile->timer_t1x64, NTATAG_SIP_T1X64(profile->timer_t1x64)),
+					TAG_IF(profile->timer_t2, NTATAG_SIP_T2(profile->timer_t2)),
+					TAG_IF(profile->timer_t4, NTATAG_SIP_T4(profile->timer_t4)),
+					SIPTAG_ACCEPT_STR("application/sdp, multipart/mixed"),
+					TAG_IF(sofia_test_pflag(profile, PFLAG_NO_CONNECTION_REUSE),
+							TPTAG_REUSE(0)),
+					TAG_IF(profile->transport_threads > 1,
+							 TPTAG_REUSEPORT(1)),
+					TAG_END());	/* Last tag should always finish the sequence */
+
+	if (!nua) {
+		return NULL;
+	}
+
+	nua_set_params(nua,
+				   SIPTAG_ALLOW_STR("INVITE, ACK, BYE, CANCEL, OPTIONS, MESSAGE, INFO"),
+				   NUTAG_AUTOANSWER(0),
+				   NUTAG_AUTOACK(0),
+				   NUTAG_AUTOALERT(0),
+				   NUTAG_ENABLEMESSENGER(1),
+				   NTATAG_EXTRA_100(0),
+				   TAG_IF(sofia_test_pflag(profile, PFLAG_SEND_DISPLAY_UPDATE), NUTAG_ALLOW("UPDATE")),
+				   TAG_IF((profile->mflags & MFLAG_REGISTER), NUTAG_ALLOW("REGISTER")),
+				   TAG_IF((profile->mflags & MFLAG_REFER), NUTAG_ALLOW("REFER")),
+				   TAG_IF(!sofia_test_pflag(profile, PFLAG_DISABLE_100REL), NUTAG_ALLOW("PRACK")),
+				   NUTAG_ALLOW("INFO"),
+				   NUTAG_ALLOW("NOTIFY"),
+				   NUTAG_ALLOW_EVENTS("talk"),
+				   NUTAG_ALLOW_EVENTS("hold"),
+				   NUTAG_ALLOW_EVENTS("conference"),
+				   NUTAG_APPL_METHOD("OPTIONS"),
+				   NUTAG_APPL_METHOD("REFER"),
+				   NUTAG_APPL_METHOD("REGISTER"),
+				   NUTAG_APPL_METHOD("NOTIFY"), NUTAG_APPL_METHOD("INFO"), NUTAG_APPL_METHOD("ACK"), NUTAG_APPL_METHOD("SUBSCRIBE"),
+#ifdef MANUAL_BYE
+				   NUTAG_APPL_METHOD("BYE"),
+#endif
+				   NUTAG_APPL_METHOD("MESSAGE"),
+
+				   NUTAG_SESSION_TIMER(profile->session_timeout),
+				   NTATAG_MAX_PROCEEDING(profile->max_proceeding),
+				   TAG_IF(profile->pres_type, NUTAG_ALLOW("PUBLISH")),
+				   TAG_IF(profile->pres_type, NUTAG_ALLOW("SUBSCRIBE")),
+				   TAG_IF(profile->pres_type, NUTAG_ENABLEMESSAGE(1)),
+				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("presence")),
+				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("as-feature-event")),
+				   TAG_IF((profile->pres_type || sofia_test_pflag(profile, PFLAG_MANAGE_SHARED_APPEARANCE)), NUTAG_ALLOW_EVENTS("dialog")),
+				   TAG_IF((profile->pres_type || sofia_test_pflag(profile, PFLAG_MANAGE_SHARED_APPEARANCE)), NUTAG_ALLOW_EVENTS("line-seize")),
+				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("call-info")),
+				   TAG_IF((profile->pres_type || sofia_test_pflag(profile, PFLAG_MANAGE_SHARED_APPEARANCE)), NUTAG_ALLOW_EVENTS("sla")),
+				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("include-session-description")),
+				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("presence.winfo")),
+				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("message-summary")),
+				   TAG_IF(profile->pres_type == PRES_TYPE_PNP, NUTAG_ALLOW_EVENTS("ua-profile")),
+				   NUTAG_ALLOW_EVENTS("refer"), SIPTAG_SUPPORTED_STR(supported), SIPTAG_USER_AGENT_STR(profile->user_agent), TAG_END());
+
+	return nua;
+}
+
+/* Stop the other transport threads from handing us messages, then take the ones already on their way */
+static void sofia_profile_leave_shard(sofia_profile_t *profile, nua_t *nua, su_root_t *root)
+{
+	int sanity = 500;
+
+	nta_agent_set_shard(nua->nua_nta, NULL, 0);
+
+	while (nta_agent_shard_pending(nua->nua_nta) && --sanity) {
+		su_root_step(root, 10);
+	}
+
+	if (!sanity) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%u forwarded messages still queued for a transport thread of %s\n",
+						  nta_agent_shard_pending(nua->nua_nta), profile->name);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC sofia_shard_thread_run(switch_thread_t *thread, void *obj)
+{
+	sofia_shard_t *shard = (sofia_shard_t *) obj;
+	sofia_profile_t *profile = shard->profile;
+	nua_t *nua = NULL;
+	int sanity;
+
+	switch_mutex_lock(mod_sofia_globals.mutex);
+	mod_sofia_globals.threads++;
+	switch_mutex_unlock(mod_sofia_globals.mutex);
+
+	if ((shard->s_root = su_root_create(NULL))) {
+		nua = sofia_profile_create_nua(profile, shard->s_root, shard->supported);
+	}
+
+	if (!nua) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Creating SIP UA for transport thread %u of profile: %s\n",
+						  shard->index, profile->name);
+		shard->started = -1;
+		goto end;
+	}
+
+	switch_thread_rwlock_wrlock(profile->shard_rwlock);
+	shard->nua = nua;
+	switch_thread_rwlock_unlock(profile->shard_rwlock);
+
+	nta_agent_set_shard(nua->nua_nta, profile->shard_group, shard->index);
+	shard->started = 1;
+
+	while (mod_sofia_globals.running == 1 && !shard->stop) {
+		su_root_step(shard->s_root, 1000);
+	}
+
+	sofia_profile_leave_shard(profile, nua, shard->s_root);
+
+	nua_shutdown(nua);
+
+	sanity = 100;
+	while (!shard->shutdown) {
+		su_root_step(shard->s_root, 1000);
+		if (!--sanity) {
+			break;
+		}
+	}
+
+	/* nobody can look up our handles once this returns */
+	switch_thread_rwlock_wrlock(profile->shard_rwlock);
+	shard->nua = NULL;
+	switch_thread_rwlock_unlock(profile->shard_rwlock);
+
+	nua_destroy(nua);
+
+ end:
+
+	if (shard->s_root) {
+		su_root_destroy(shard->s_root);
+		shard->s_root = NULL;
+	}
+
+	switch_mutex_lock(mod_sofia_globals.mutex);
+	mod_sofia_globals.threads--;
+	switch_mutex_unlock(mod_sofia_globals.mutex);
+
+	return NULL;
+}
+
+/* Start transport-threads - 1 more agents sharing the profile ports with SO_REUSEPORT */
+static void sofia_profile_start_shards(sofia_profile_t *profile, const char *supported)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t i, started = 1;
+
+	if (!(profile->shard_group = nta_shard_group_create(profile->transport_threads))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create transport thread group for %s, using one thread\n", profile->name);
+		profile->transport_threads = 1;
+		return;
+	}
+
+	switch_thread_rwlock_create(&profile->shard_rwlock, profile->pool);
+	profile->shards = switch_core_alloc(profile->pool, sizeof(*profile->shards) * profile->transport_threads);
+
+	nta_agent_set_shard(profile->nua->nua_nta, profile->shard_group, 0);
+
+	switch_threadattr_create(&thd_attr, profile->pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	for (i = 1; i < profile->transport_threads; i++) {
+		sofia_shard_t *shard = &profile->shards[i];
+
+		shard->profile = profile;
+		shard->index = i;
+		shard->supported = supported;
+
+		if (switch_thread_create(&shard->thread, thd_attr, sofia_shard_thread_run, shard, profile->pool) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot start transport thread %u for %s\n", i, profile->name);
+			shard->thread = NULL;
+		}
+	}
+
+	for (i = 1; i < profile->transport_threads; i++) {
+		sofia_shard_t *shard = &profile->shards[i];
+		int sanity = 500;
+
+		while (shard->thread && !shard->started && --sanity) {
+			switch_yield(10000);
+		}
+
+		if (shard->started == 1) {
+			started++;
+		}
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Started %u of %u transport threads for %s\n",
+					  started, profile->transport_threads, profile->name);
+}
+
+/* Called once the sessions have been hung up, before the main agent shuts down */
+static void sofia_profile_stop_shards(sofia_profile_t *profile)
+{
+	switch_status_t st;
+	uint32_t i;
+
+	if (!profile->shards) {
+		return;
+	}
+
+	for (i = 1; i < profile->transport_threads; i++) {
+		profile->shards[i].stop = 1;
+	}
+
+	for (i = 1; i < profile->transport_threads; i++) {
+		if (profile->shards[i].thread) {
+			switch_thread_join(&st, profile->shards[i].thread);
+			profile->shards[i].thread = NULL;
+		}
+	}
+
+	/* every other agent is gone, this only takes what they queued for us before leaving */
+	sofia_profile_leave_shard(profile, profile->nua, profile->s_root);
+}
+
 void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void *obj)
 {
 	sofia_profile_t *profile = (sofia_profile_t *) obj;
@@ -2449,68 +3243,12 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 		profile->tls_verify_in_subjects = su_strlst_dup_split((su_home_t *)profile->nua, profile->tls_verify_in_subjects_str, "|");
 	}
 
-	profile->nua = nua_create(profile->s_root,	/* Event loop */
-							  sofia_event_callback,	/* Callback for processing events */
-							  profile,	/* Additional data to pass to callback */
-							  TAG_IF( ! sofia_test_pflag(profile, PFLAG_TLS) || ! profile->tls_only, NUTAG_URL(profile->bindurl)),
-							  NTATAG_USER_VIA(1),
-							  TPTAG_PONG2PING(1),
-							  NUTAG_RETRY_AFTER_ENABLE(0),
-							  TAG_IF(!strchr(profile->sipip, ':'),
-									 SOATAG_AF(SOA_AF_IP4_ONLY)),
-							  TAG_IF(strchr(profile->sipip, ':'),
-									 SOATAG_AF(SOA_AF_IP6_ONLY)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
-									 NUTAG_SIPS_URL(profile->tls_bindurl)),
-							  TAG_IF(profile->ws_bindurl,
-									 NUTAG_WS_URL(profile->ws_bindurl)),
-							  TAG_IF(profile->wss_bindurl,
-									 NUTAG_WSS_URL(profile->wss_bindurl)),
-							  TAG_IF(profile->tls_cert_dir,
-									 NUTAG_CERTIFICATE_DIR(profile->tls_cert_dir)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_passphrase,
-									TPTAG_TLS_PASSPHRASE(profile->tls_passphrase)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
-									 TPTAG_TLS_VERIFY_POLICY(profile->tls_verify_policy)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
-									 TPTAG_TLS_VERIFY_DEPTH(profile->tls_verify_depth)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
-									 TPTAG_TLS_VERIFY_DATE(profile->tls_verify_date)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_verify_in_subjects,
-									  TPTAG_TLS_VERIFY_SUBJECTS(profile->tls_verify_in_subjects)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
-									 TPTAG_TLS_VERSION(profile->tls_version)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_timeout,
-									 TPTAG_TLS_TIMEOUT(profile->tls_timeout)),
-							  TAG_IF(!strchr(profile->sipip, ':'),
-									 NTATAG_UDP_MTU(65535)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_DISABLE_SRV),
-									 NTATAG_USE_SRV(0)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_DISABLE_NAPTR),
-									 NTATAG_USE_NAPTR(0)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TCP_PINGPONG),
-									 TPTAG_PINGPONG(profile->tcp_pingpong)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TCP_PING2PONG),
-									 TPTAG_PINGPONG(profile->tcp_ping2pong)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_DISABLE_SRV503),
-									 NTATAG_SRV_503(0)),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_TCP_KEEPALIVE),
-									 TPTAG_KEEPALIVE(profile->tcp_keepalive)),
-							  NTATAG_DEFAULT_PROXY(profile->outbound_proxy),
-							  NTATAG_SERVER_RPORT(profile->server_rport_level),
-							  NTATAG_CLIENT_RPORT(profile->client_rport_level),
-							  TPTAG_LOG(sofia_test_flag(profile, TFLAG_TPORT_LOG)),
-							  TPTAG_CAPT(sofia_test_flag(profile, TFLAG_CAPTURE) ? mod_sofia_globals.capture_server : NULL),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_SIPCOMPACT),
-									 NTATAG_SIPFLAGS(MSG_DO_COMPACT)),
-							  TAG_IF(profile->timer_t1, NTATAG_SIP_T1(profile->timer_t1)),
-							  TAG_IF(profile->timer_t1x64, NTATAG_SIP_T1X64(profile->timer_t1x64)),
-							  TAG_IF(profile->timer_t2, NTATAG_SIP_T2(profile->timer_t2)),
-							  TAG_IF(profile->timer_t4, NTATAG_SIP_T4(profile->timer_t4)),
-							  SIPTAG_ACCEPT_STR("application/sdp, multipart/mixed"),
-							  TAG_IF(sofia_test_pflag(profile, PFLAG_NO_CONNECTION_REUSE),
-									TPTAG_REUSE(0)),
-							  TAG_END());	/* Last tag should always finish the sequence */
+	if (profile->transport_threads > 1 && sofia_test_pflag(profile, PFLAG_AUTO_ASSIGN_PORT)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "transport-threads needs a fixed sip-port, using one thread for %s\n", profile->name);
+		profile->transport_threads = 1;
+	}
+
+	profile->nua = sofia_profile_create_nua(profile, profile->s_root, supported);
 
 	if (!profile->nua) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Creating SIP UA for profile: %s (%s)\n"
@@ -2523,48 +3261,6 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Created agent for %s\n", profile->name);
 
-	nua_set_params(profile->nua,
-				   SIPTAG_ALLOW_STR("INVITE, ACK, BYE, CANCEL, OPTIONS, MESSAGE, INFO"),
-				   NUTAG_AUTOANSWER(0),
-				   NUTAG_AUTOACK(0),
-				   NUTAG_AUTOALERT(0),
-				   NUTAG_ENABLEMESSENGER(1),
-				   NTATAG_EXTRA_100(0),
-				   TAG_IF(sofia_test_pflag(profile, PFLAG_SEND_DISPLAY_UPDATE), NUTAG_ALLOW("UPDATE")),
-				   TAG_IF((profile->mflags & MFLAG_REGISTER), NUTAG_ALLOW("REGISTER")),
-				   TAG_IF((profile->mflags & MFLAG_REFER), NUTAG_ALLOW("REFER")),
-				   TAG_IF(!sofia_test_pflag(profile, PFLAG_DISABLE_100REL), NUTAG_ALLOW("PRACK")),
-				   NUTAG_ALLOW("INFO"),
-				   NUTAG_ALLOW("NOTIFY"),
-				   NUTAG_ALLOW_EVENTS("talk"),
-				   NUTAG_ALLOW_EVENTS("hold"),
-				   NUTAG_ALLOW_EVENTS("conference"),
-				   NUTAG_APPL_METHOD("OPTIONS"),
-				   NUTAG_APPL_METHOD("REFER"),
-				   NUTAG_APPL_METHOD("REGISTER"),
-				   NUTAG_APPL_METHOD("NOTIFY"), NUTAG_APPL_METHOD("INFO"), NUTAG_APPL_METHOD("ACK"), NUTAG_APPL_METHOD("SUBSCRIBE"),
-#ifdef MANUAL_BYE
-				   NUTAG_APPL_METHOD("BYE"),
-#endif
-				   NUTAG_APPL_METHOD("MESSAGE"),
-
-				   NUTAG_SESSION_TIMER(profile->session_timeout),
-				   NTATAG_MAX_PROCEEDING(profile->max_proceeding),
-				   TAG_IF(profile->pres_type, NUTAG_ALLOW("PUBLISH")),
-				   TAG_IF(profile->pres_type, NUTAG_ALLOW("SUBSCRIBE")),
-				   TAG_IF(profile->pres_type, NUTAG_ENABLEMESSAGE(1)),
-				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("presence")),
-				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("as-feature-event")),
-				   TAG_IF((profile->pres_type || sofia_test_pflag(profile, PFLAG_MANAGE_SHARED_APPEARANCE)), NUTAG_ALLOW_EVENTS("dialog")),
-				   TAG_IF((profile->pres_type || sofia_test_pflag(profile, PFLAG_MANAGE_SHARED_APPEARANCE)), NUTAG_ALLOW_EVENTS("line-seize")),
-				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("call-info")),
-				   TAG_IF((profile->pres_type || sofia_test_pflag(profile, PFLAG_MANAGE_SHARED_APPEARANCE)), NUTAG_ALLOW_EVENTS("sla")),
-				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("include-session-description")),
-				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("presence.winfo")),
-				   TAG_IF(profile->pres_type, NUTAG_ALLOW_EVENTS("message-summary")),
-				   TAG_IF(profile->pres_type == PRES_TYPE_PNP, NUTAG_ALLOW_EVENTS("ua-profile")),
-				   NUTAG_ALLOW_EVENTS("refer"), SIPTAG_SUPPORTED_STR(supported), SIPTAG_USER_AGENT_STR(profile->user_agent), TAG_END());
-
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Set params for %s\n", profile->name);
 
 	if (sofia_test_pflag(profile, PFLAG_AUTO_ASSIGN_PORT) || sofia_test_pflag(profile, PFLAG_AUTO_ASSIGN_TLS_PORT)) {
@@ -2647,6 +3343,10 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 
 	sofia_glue_add_profile(profile->name, profile);
 
+	if (profile->transport_threads > 1) {
+		sofia_profile_start_shards(profile, supported);
+	}
+
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Starting thread for %s\n", profile->name);
 
 	profile->started = switch_epoch_time_now(NULL);
@@ -2679,6 +3379,7 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 
 
 	sofia_reg_unregister(profile);
+	sofia_profile_stop_shards(profile);
 	nua_shutdown(profile->nua);
 
 	sanity = 100;
@@ -2710,6 +3411,11 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 	}
 	nua_destroy(profile->nua);
 
+	if (profile->shard_group) {
+		nta_shard_group_destroy(profile->shard_group);
+		profile->shard_group = NULL;
+	}
+
 	switch_mutex_lock(profile->ireg_mutex);
 	switch_mutex_unlock(profile->ireg_mutex);
 
@@ -2757,6 +3463,10 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 	switch_core_hash_destroy(&profile->chat_hash);
 	switch_core_hash_destroy(&profile->reg_nh_hash);
 	switch_core_hash_destroy(&profile->mwi_debounce_hash);
+	sofia_reg_nonce_cache_destroy(profile);
+	sofia_reg_cache_destroy(profile);
+	sofia_presence_watch_destroy(profile);
+	sofia_reg_ping_flush(profile);
 
 	switch_thread_rwlock_unlock(profile->rwlock);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write unlock %s\n", profile->name);
@@ -3591,6 +4301,9 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 	mod_sofia_globals.auto_restart = SWITCH_TRUE;
 	mod_sofia_globals.reg_deny_binding_fetch_and_no_lookup = SWITCH_FALSE; /* handle backwards compatilibity - by default use new behavior */
 	mod_sofia_globals.rewrite_multicasted_fs_path = SWITCH_FALSE;
+	mod_sofia_globals.presence_coalesce_ms = 100;
+	mod_sofia_globals.overload_wait_target = 200000;
+	mod_sofia_globals.overload_retry_after = 5;
 
 	if ((settings = switch_xml_child(cfg, "global_settings"))) {
 		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
@@ -3604,6 +4317,24 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 				mod_sofia_globals.debug_presence = atoi(val);
 			} else if (!strcasecmp(var, "debug-sla")) {
 				mod_sofia_globals.debug_sla = atoi(val);
+			} else if (!strcasecmp(var, "presence-coalesce-ms")) {
+				int x = atoi(val);
+
+				if (x >= 0 && x <= 5000) {
+					mod_sofia_globals.presence_coalesce_ms = x;
+				}
+			} else if (!strcasecmp(var, "overload-wait-target-ms")) {
+				int x = atoi(val);
+
+				if (x >= 0 && x <= 10000) {
+					mod_sofia_globals.overload_wait_target = x * 1000;
+				}
+			} else if (!strcasecmp(var, "overload-retry-after")) {
+				int x = atoi(val);
+
+				if (x > 0 && x <= 3600) {
+					mod_sofia_globals.overload_retry_after = x;
+				}
 			} else if (!strcasecmp(var, "max-reg-threads") && val) {
 				int x = atoi(val);
 
@@ -3700,6 +4431,16 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 					switch_core_hash_init(&profile->mwi_debounce_hash, profile->pool);
 					switch_thread_rwlock_create(&profile->rwlock, profile->pool);
 					switch_mutex_init(&profile->flag_mutex, SWITCH_MUTEX_NESTED, profile->pool);
+					switch_mutex_init(&profile->nonce_mutex, SWITCH_MUTEX_NESTED, profile->pool);
+					switch_core_hash_init(&profile->reg_cache_hash, NULL);
+					switch_core_hash_init_nocase(&profile->pres_watch_hash, NULL);
+					switch_mutex_init(&profile->pres_watch_mutex, SWITCH_MUTEX_NESTED, profile->pool);
+					switch_mutex_init(&profile->ping_mutex, SWITCH_MUTEX_NESTED, profile->pool);
+					switch_mutex_init(&profile->stats.mutex, SWITCH_MUTEX_NESTED, profile->pool);
+					profile->stats.started = switch_micro_time_now();
+					profile->stats.event_interval = 60;
+					switch_thread_rwlock_create(&profile->reg_cache_rwlock, profile->pool);
+					profile->reg_cache_ttl = -1;
 					profile->dtmf_duration = 100;
 					profile->rtp_digit_delay = 40;
 					profile->sip_force_expires = 0;
@@ -3780,6 +4521,15 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 					} else if (!strcasecmp(var, "tcp-ping2pong") && !zstr(val)) {
 						profile->tcp_ping2pong = atoi(val);
 						sofia_set_pflag(profile, PFLAG_TCP_PING2PONG);
+					} else if (!strcasecmp(var, "transport-threads") && !zstr(val)) {
+						int threads = atoi(val);
+
+						if (threads < 1) {
+							threads = 1;
+						} else if (threads > 64) {
+							threads = 64;
+						}
+						profile->transport_threads = threads;
 					} else if (!strcasecmp(var, "odbc-dsn") && !zstr(val)) {
 						profile->odbc_dsn = switch_core_strdup(profile->pool, val);
 					} else if (!strcasecmp(var, "db-pre-trans-execute") && !zstr(val)) {
@@ -4052,6 +4802,8 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 						profile->mndlb |= SM_NDLB_DISABLE_SRTP_AUTH;
 					} else if (!strcasecmp(var, "user-agent-filter")) {
 						profile->user_agent_filter = switch_core_strdup(profile->pool, val);
+					} else if (!strcasecmp(var, "nonce-secret") && !zstr(val)) {
+						profile->nonce_secret = switch_core_strdup(profile->pool, val);
 					} else if (!strcasecmp(var, "max-registrations-per-extension")) {
 						profile->max_registrations_perext = atoi(val);
 					} else if (!strcasecmp(var, "rfc2833-pt")) {
@@ -4411,6 +5163,17 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 						}
 					} else if (!strcasecmp(var, "nonce-ttl")) {
 						profile->nonce_ttl = atoi(val);
+					} else if (!strcasecmp(var, "registration-cache-ttl") && !zstr(val)) {
+						profile->reg_cache_ttl = atoi(val);
+					} else if (!strcasecmp(var, "stats-event-interval") && !zstr(val)) {
+						int tmp = atoi(val);
+						profile->stats.event_interval = tmp > 0 ? tmp : 0;
+					} else if (!strcasecmp(var, "stateless-nonces")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_STATELESS_NONCE);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_STATELESS_NONCE);
+						}
 					} else if (!strcasecmp(var, "accept-blind-reg")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_BLIND_REG);
@@ -4757,6 +5520,19 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 					profile->nonce_ttl = 60;
 				}
 
+				if (profile->reg_cache_ttl < 0) {
+					/* other boxes writing to a shared database would not invalidate our cache */
+					profile->reg_cache_ttl = profile->odbc_dsn ? 0 : 300;
+				}
+
+				if (sofia_test_pflag(profile, PFLAG_STATELESS_NONCE) && zstr(profile->nonce_secret)) {
+					char secret[33] = "";
+
+					/* only good for this box, set nonce-secret to the same value everywhere to share nonces between nodes */
+					switch_stun_random_string(secret, sizeof(secret) - 1, NULL);
+					profile->nonce_secret = switch_core_strdup(profile->pool, secret);
+				}
+
 				if (!profile->sdp_username) {
 					profile->sdp_username = switch_core_strdup(profile->pool, "FreeSWITCH");
 				}
@@ -5034,6 +5810,9 @@ static void sofia_handle_sip_r_options(switch_core_session_t *session, int statu
 		sql = switch_mprintf("update sip_registrations set expires=%ld where sip_user='%s' and sip_host='%s' and call_id='%q'",
 							 (long) now, sip->sip_to->a_url->url_user, sip->sip_to->a_url->url_host, call_id);
 		sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+		sofia_reg_ping_del(profile, call_id);
+		sofia_reg_cache_invalidate_call_id(profile, call_id);
+		sofia_reg_cache_invalidate(profile, sip->sip_to->a_url->url_user);
 	}
 }
 
@@ -6082,7 +6861,7 @@ static void sofia_handle_sip_i_state(switch_core_session_t *session, int status,
 							home = su_home_new(sizeof(*home));
 							switch_assert(home != NULL);
 							if ((replaces = sip_replaces_make(home, replaces_str))
-								&& (bnh = nua_handle_by_replaces(nua, replaces))) {
+								&& (bnh = sofia_nua_handle_by_replaces(profile, replaces))) {
 								sofia_private_t *b_private;
 
 								switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Processing Replaces Attended Transfer\n");
@@ -6785,6 +7564,47 @@ static switch_status_t xfer_hanguphook(switch_core_session_t *session)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* nua_handle_by_call_id() over the main agent and every transport thread of the profile */
+nua_handle_t *sofia_nua_handle_by_call_id(sofia_profile_t *profile, const char *call_id)
+{
+	nua_handle_t *nh;
+	uint32_t i;
+
+	if ((nh = nua_handle_by_call_id(profile->nua, call_id)) || !profile->shards) {
+		return nh;
+	}
+
+	switch_thread_rwlock_rdlock(profile->shard_rwlock);
+	for (i = 1; !nh && i < profile->transport_threads; i++) {
+		if (profile->shards[i].nua) {
+			nh = nua_handle_by_call_id(profile->shards[i].nua, call_id);
+		}
+	}
+	switch_thread_rwlock_unlock(profile->shard_rwlock);
+
+	return nh;
+}
+
+nua_handle_t *sofia_nua_handle_by_replaces(sofia_profile_t *profile, sip_replaces_t const *replaces)
+{
+	nua_handle_t *nh;
+	uint32_t i;
+
+	if ((nh = nua_handle_by_replaces(profile->nua, replaces)) || !profile->shards) {
+		return nh;
+	}
+
+	switch_thread_rwlock_rdlock(profile->shard_rwlock);
+	for (i = 1; !nh && i < profile->transport_threads; i++) {
+		if (profile->shards[i].nua) {
+			nh = nua_handle_by_replaces(profile->shards[i].nua, replaces);
+		}
+	}
+	switch_thread_rwlock_unlock(profile->shard_rwlock);
+
+	return nh;
+}
+
 nua_handle_t *sofia_global_nua_handle_by_replaces(sip_replaces_t *replaces)
 {
 	nua_handle_t *nh = NULL;
@@ -6798,8 +7618,8 @@ nua_handle_t *sofia_global_nua_handle_by_replaces(sip_replaces_t *replaces)
 		for (hi = switch_hash_first(NULL, mod_sofia_globals.profile_hash); hi; hi = switch_hash_next(hi)) {
 			switch_hash_this(hi, &var, NULL, &val);
 			if ((profile = (sofia_profile_t *) val)) {
-				if (!(nh = nua_handle_by_replaces(profile->nua, replaces))) {
-					nh = nua_handle_by_call_id(profile->nua, replaces->rp_call_id);
+				if (!(nh = sofia_nua_handle_by_replaces(profile, replaces))) {
+					nh = sofia_nua_handle_by_call_id(profile, replaces->rp_call_id);
 				}
 				if (nh)
 					break;
@@ -6897,8 +7717,8 @@ void sofia_handle_sip_i_refer(nua_t *nua, sofia_profile_t *profile, nua_handle_t
 				}
 
 				if ((replaces = sip_replaces_make(home, rep))) {
-					if (!(bnh = nua_handle_by_replaces(nua, replaces))) {
-						if (!(bnh = nua_handle_by_call_id(nua, replaces->rp_call_id))) {
+					if (!(bnh = sofia_nua_handle_by_replaces(profile, replaces))) {
+						if (!(bnh = sofia_nua_handle_by_call_id(profile, replaces->rp_call_id))) {
 							bnh = sofia_global_nua_handle_by_replaces(replaces);
 						}
 					}
@@ -8677,7 +9497,7 @@ void sofia_handle_sip_i_invite(switch_core_session_t *session, nua_t *nua, sofia
 				 switch_str_nil(p), user, host, user, host);
 
 			if ((str = sofia_glue_execute_sql2str(profile, profile->dbh_mutex, sql, cid, sizeof(cid)))) {
-				bnh = nua_handle_by_call_id(nua, str);
+				bnh = sofia_nua_handle_by_call_id(profile, str);
 			}
 
 			if (mod_sofia_globals.debug_sla > 1) {
@@ -8704,8 +9524,8 @@ void sofia_handle_sip_i_invite(switch_core_session_t *session, nua_t *nua, sofia
 	profile_dup_clean(destination_number, tech_pvt->caller_profile->destination_number, tech_pvt->caller_profile->pool);
 
 	if (!bnh && sip->sip_replaces) {
-		if (!(bnh = nua_handle_by_replaces(nua, sip->sip_replaces))) {
-			if (!(bnh = nua_handle_by_call_id(nua, sip->sip_replaces->rp_call_id))) {
+		if (!(bnh = sofia_nua_handle_by_replaces(profile, sip->sip_replaces))) {
+			if (!(bnh = sofia_nua_handle_by_call_id(profile, sip->sip_replaces->rp_call_id))) {
 				bnh = sofia_global_nua_handle_by_replaces(sip->sip_replaces);
 			}
 		}
@@ -2315,6 +2315,7 @@ switch_cache_db_handle_t *_sofia_glue_get_db_handle(sofia_profile_t *profile, co
 void sofia_glue_actually_execute_sql_trans(sofia_profile_t *profile, char *sql, switch_mutex_t *mutex)
 {
 	switch_cache_db_handle_t *dbh = NULL;
+	switch_time_t start = switch_micro_time_now();
 
 	if (mutex) {
 		switch_mutex_lock(mutex);
@@ -2336,6 +2337,8 @@ void sofia_glue_actually_execute_sql_trans(sofia_profile_t *profile, char *sql,
 
 	switch_cache_db_release_db_handle(&dbh);
 
+	sofia_stats_db(profile, switch_micro_time_now() - start);
+
  end:
 
 	if (mutex) {
@@ -2347,6 +2350,7 @@ void sofia_glue_actually_execute_sql(sofia_profile_t *profile, char *sql, switch
 {
 	switch_cache_db_handle_t *dbh = NULL;
 	char *err = NULL;
+	switch_time_t start = switch_micro_time_now();
 
 	if (mutex) {
 		switch_mutex_lock(mutex);
@@ -2368,6 +2372,8 @@ void sofia_glue_actually_execute_sql(sofia_profile_t *profile, char *sql, switch
 		switch_mutex_unlock(mutex);
 	}
 
+	sofia_stats_db(profile, switch_micro_time_now() - start);
+
 	if (err) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "SQL ERR: [%s]\n%s\n", err, sql);
 		free(err);
@@ -2382,6 +2388,7 @@ switch_bool_t sofia_glue_execute_sql_callback(sofia_profile_t *profile,
 	switch_bool_t ret = SWITCH_FALSE;
 	char *errmsg = NULL;
 	switch_cache_db_handle_t *dbh = NULL;
+	switch_time_t start = switch_micro_time_now();
 
 	if (mutex) {
 		switch_mutex_lock(mutex);
@@ -2403,6 +2410,8 @@ switch_bool_t sofia_glue_execute_sql_callback(sofia_profile_t *profile,
 		switch_mutex_unlock(mutex);
 	}
 
+	sofia_stats_db(profile, switch_micro_time_now() - start);
+
 	if (errmsg) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "SQL ERR: [%s] %s\n", sql, errmsg);
 		free(errmsg);
@@ -2421,6 +2430,7 @@ char *sofia_glue_execute_sql2str(sofia_profile_t *profile, switch_mutex_t *mutex
 	char *ret = NULL;
 	char *err = NULL;
 	switch_cache_db_handle_t *dbh = NULL;
+	switch_time_t start = switch_micro_time_now();
 
 	if (mutex) {
 		switch_mutex_lock(mutex);
@@ -2442,6 +2452,8 @@ char *sofia_glue_execute_sql2str(sofia_profile_t *profile, switch_mutex_t *mutex
 		switch_mutex_unlock(mutex);
 	}
 
+	sofia_stats_db(profile, switch_micro_time_now() - start);
+
 	if (err) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "SQL ERR: [%s]\n%s\n", err, sql);
 		free(err);
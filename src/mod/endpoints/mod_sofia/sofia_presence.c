@@ -56,6 +56,8 @@ static int broadsoft_sla_notify_callback(void *pArg, int argc, char **argv, char
 static int sync_sla(sofia_profile_t *profile, const char *to_user, const char *to_host, switch_bool_t clear, switch_bool_t unseize, const char *call_id);
 static int sofia_dialog_probe_callback(void *pArg, int argc, char **argv, char **columnNames);
 static int sofia_dialog_probe_notify_callback(void *pArg, int argc, char **argv, char **columnNames);
+static switch_bool_t sofia_presence_watched(sofia_profile_t *profile, const char *user);
+static void sofia_presence_watch_reload(sofia_profile_t *profile);
 
 struct pres_sql_cb {
 	sofia_profile_t *profile;
@@ -1335,6 +1337,12 @@ static switch_event_t *actual_sofia_presence_event_handler(switch_event_t *event
 					proto = SOFIA_CHAT_PROTO;
 				}
 
+				if (zstr(call_id) && !sofia_presence_watched(profile, euser)) {
+					/* no subscriber to notify on this profile, spare the joins */
+					sofia_glue_release_profile(profile);
+					continue;
+				}
+
 				if (zstr(uuid)) {
 
 					sql = switch_mprintf("select state,status,rpid,presence_id,uuid from sip_dialogs "
@@ -1562,6 +1570,21 @@ static switch_event_t *actual_sofia_presence_event_handler(switch_event_t *event
 static int EVENT_THREAD_RUNNING = 0;
 static int EVENT_THREAD_STARTED = 0;
 
+/* presence events held back for presence-coalesce-ms, a newer event for the same
+   presentity and call replaces the held one so a flapping line costs one fan-out */
+typedef struct presence_pending_node_s {
+	char *key;
+	switch_event_t *event;
+	switch_time_t due;
+	struct presence_pending_node_s *next;
+} presence_pending_node_t;
+
+struct presence_pending {
+	switch_hash_t *hash;
+	presence_pending_node_t *head;
+	presence_pending_node_t *tail;
+};
+
 static void do_flush(void)
 {
 	void *pop = NULL;
@@ -1573,10 +1596,107 @@ static void do_flush(void)
 
 }
 
+static void presence_dispatch(switch_event_t *event)
+{
+	switch(event->event_id) {
+	case SWITCH_EVENT_MESSAGE_WAITING:
+		actual_sofia_presence_mwi_event_handler(event);
+		break;
+	case SWITCH_EVENT_CONFERENCE_DATA:
+		conference_data_event_handler(event);
+		break;
+	default:
+		do {
+			switch_event_t *ievent = event;
+			event = actual_sofia_presence_event_handler(ievent);
+			switch_event_destroy(&ievent);
+		} while (event);
+		break;
+	}
+
+	switch_event_destroy(&event);
+}
+
+static char *presence_coalesce_key(switch_event_t *event)
+{
+	const char *from = switch_event_get_header(event, "from");
+
+	if (!mod_sofia_globals.presence_coalesce_ms || zstr(from)) {
+		return NULL;
+	}
+
+	if (event->event_id != SWITCH_EVENT_PRESENCE_IN && event->event_id != SWITCH_EVENT_PRESENCE_OUT) {
+		return NULL;
+	}
+
+	/* line seizes need every transition */
+	if (switch_event_get_header(event, "presence-call-info")) {
+		return NULL;
+	}
+
+	return switch_mprintf("%s|%s|%s|%s|%s", from,
+						  switch_event_get_header_nil(event, "proto"),
+						  switch_event_get_header_nil(event, "event_type"),
+						  switch_event_get_header_nil(event, "unique-id"),
+						  switch_event_get_header_nil(event, "call-id"));
+}
+
+static void presence_pending_add(struct presence_pending *pending, char *key, switch_event_t *event)
+{
+	presence_pending_node_t *node;
+
+	if ((node = switch_core_hash_find(pending->hash, key))) {
+		switch_event_destroy(&node->event);
+		node->event = event;
+		mod_sofia_globals.presence_coalesced++;
+		free(key);
+		return;
+	}
+
+	switch_zmalloc(node, sizeof(*node));
+	node->key = key;
+	node->event = event;
+	node->due = switch_micro_time_now() + (mod_sofia_globals.presence_coalesce_ms * 1000);
+
+	if (pending->tail) {
+		pending->tail->next = node;
+	} else {
+		pending->head = node;
+	}
+	pending->tail = node;
+
+	switch_core_hash_insert(pending->hash, key, node);
+}
+
+/* send everything that is due, or drop everything held */
+static void presence_pending_run(struct presence_pending *pending, switch_bool_t drop)
+{
+	presence_pending_node_t *node;
+	switch_time_t now = switch_micro_time_now();
+
+	while ((node = pending->head) && (drop || node->due <= now)) {
+		if (!(pending->head = node->next)) {
+			pending->tail = NULL;
+		}
+
+		switch_core_hash_delete(pending->hash, node->key);
+
+		if (drop) {
+			switch_event_destroy(&node->event);
+		} else {
+			presence_dispatch(node->event);
+		}
+
+		free(node->key);
+		free(node);
+	}
+}
+
 void *SWITCH_THREAD_FUNC sofia_presence_event_thread_run(switch_thread_t *thread, void *obj)
 {
 	void *pop;
 	int done = 0;
+	struct presence_pending pending = { 0 };
 
 	switch_mutex_lock(mod_sofia_globals.mutex);
 	if (!EVENT_THREAD_RUNNING) {
@@ -1591,13 +1711,29 @@ void *SWITCH_THREAD_FUNC sofia_presence_event_thread_run(switch_thread_t *thread
 		return NULL;
 	}
 
+	switch_core_hash_init(&pending.hash, NULL);
+
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Event Thread Started\n");
 
 	while (mod_sofia_globals.running == 1) {
 		int count = 0;
+		switch_status_t pstatus;
+
+		if (pending.head) {
+			switch_time_t wait = pending.head->due - switch_micro_time_now();
 
-		if (switch_queue_pop(mod_sofia_globals.presence_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (wait > 0) {
+				pstatus = switch_queue_pop_timeout(mod_sofia_globals.presence_queue, &pop, wait);
+			} else {
+				pstatus = switch_queue_trypop(mod_sofia_globals.presence_queue, &pop);
+			}
+		} else {
+			pstatus = switch_queue_pop(mod_sofia_globals.presence_queue, &pop);
+		}
+
+		if (pstatus == SWITCH_STATUS_SUCCESS) {
 			switch_event_t *event = (switch_event_t *) pop;
+			char *key;
 
 			if (!pop) {
 				break;
@@ -1607,32 +1743,27 @@ void *SWITCH_THREAD_FUNC sofia_presence_event_thread_run(switch_thread_t *thread
 				switch_mutex_lock(mod_sofia_globals.mutex);
 				if (mod_sofia_globals.presence_flush) {
 					do_flush();
+					presence_pending_run(&pending, SWITCH_TRUE);
 					mod_sofia_globals.presence_flush = 0;
 				}
 				switch_mutex_unlock(mod_sofia_globals.mutex);
 			}
 
-			switch(event->event_id) {
-			case SWITCH_EVENT_MESSAGE_WAITING:
-				actual_sofia_presence_mwi_event_handler(event);
-				break;
-			case SWITCH_EVENT_CONFERENCE_DATA:
-				conference_data_event_handler(event);
-				break;
-			default:
-				do {
-					switch_event_t *ievent = event;
-					event = actual_sofia_presence_event_handler(ievent);
-					switch_event_destroy(&ievent);
-				} while (event);
-				break;
+			if ((key = presence_coalesce_key(event))) {
+				presence_pending_add(&pending, key, event);
+			} else {
+				presence_dispatch(event);
 			}
 
-			switch_event_destroy(&event);
 			count++;
 		}
+
+		presence_pending_run(&pending, SWITCH_FALSE);
 	}
 
+	presence_pending_run(&pending, SWITCH_TRUE);
+	switch_core_hash_destroy(&pending.hash);
+
 	do_flush();
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Event Thread Ended\n");
@@ -2291,6 +2422,7 @@ static void _send_presence_notify(sofia_profile_t *profile,
 			   SIPTAG_CSEQ(cseq),
 			   TAG_END());
 
+	profile->pres_notify_total++;
 
 	switch_safe_free(route_uri);
 	switch_safe_free(dcs);
@@ -3814,6 +3946,7 @@ void sofia_presence_handle_sip_i_subscribe(int status,
 
 
 			sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+			sofia_presence_watch_add(profile, to_user);
 			sstr = switch_mprintf("active;expires=%ld", exp_delta);
 		}
 
@@ -4829,12 +4962,112 @@ void sofia_presence_check_subscriptions(sofia_profile_t *profile, time_t now)
 
 			sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
 		}
+
+		sofia_presence_watch_reload(profile);
 	}
 
 
 
 }
 
+/* Watch index
+
+   The users somebody on this profile is subscribed to, so presence events for the
+   rest can skip the subscription joins.  Subscribes add to it as they come, the
+   periodic subscription check rebuilds it from sip_subscriptions to drop the ones
+   that went away.  Until the first rebuild everybody counts as watched. */
+
+void sofia_presence_watch_add(sofia_profile_t *profile, const char *user)
+{
+	if (zstr(user) || !profile->pres_watch_mutex) {
+		return;
+	}
+
+	switch_mutex_lock(profile->pres_watch_mutex);
+	if (profile->pres_watch_hash) {
+		switch_core_hash_insert(profile->pres_watch_hash, user, (void *) (intptr_t) switch_epoch_time_now(NULL));
+	}
+	switch_mutex_unlock(profile->pres_watch_mutex);
+}
+
+static switch_bool_t sofia_presence_watched(sofia_profile_t *profile, const char *user)
+{
+	switch_bool_t r = SWITCH_TRUE;
+
+	if (!profile->pres_watch_mutex) {
+		return r;
+	}
+
+	switch_mutex_lock(profile->pres_watch_mutex);
+	if (profile->pres_watch_loaded && profile->pres_watch_hash && !switch_core_hash_find(profile->pres_watch_hash, user)) {
+		r = SWITCH_FALSE;
+	}
+	switch_mutex_unlock(profile->pres_watch_mutex);
+
+	return r;
+}
+
+static int sofia_presence_watch_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	switch_hash_t *hash = (switch_hash_t *) pArg;
+
+	if (!zstr(argv[0])) {
+		switch_core_hash_insert(hash, argv[0], (void *) (intptr_t) 1);
+	}
+
+	return 0;
+}
+
+static void sofia_presence_watch_reload(sofia_profile_t *profile)
+{
+	switch_hash_t *hash = NULL, *old;
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	time_t started = switch_epoch_time_now(NULL);
+	char *sql;
+
+	if (!profile->pres_watch_mutex) {
+		return;
+	}
+
+	switch_core_hash_init_nocase(&hash, NULL);
+
+	sql = switch_mprintf("select distinct sub_to_user from sip_subscriptions where hostname='%q' and profile_name='%q'",
+						 mod_sofia_globals.hostname, profile->name);
+	sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_presence_watch_callback, hash);
+	switch_safe_free(sql);
+
+	switch_mutex_lock(profile->pres_watch_mutex);
+	if ((old = profile->pres_watch_hash)) {
+		/* keep whoever subscribed while we were reading */
+		for (hi = switch_core_hash_first(old); hi; hi = switch_core_hash_next(hi)) {
+			switch_core_hash_this(hi, &var, NULL, &val);
+			if ((time_t) (intptr_t) val >= started) {
+				switch_core_hash_insert(hash, (const char *) var, val);
+			}
+		}
+		switch_core_hash_destroy(&old);
+	}
+	profile->pres_watch_hash = hash;
+	profile->pres_watch_loaded = 1;
+	switch_mutex_unlock(profile->pres_watch_mutex);
+}
+
+void sofia_presence_watch_destroy(sofia_profile_t *profile)
+{
+	if (!profile->pres_watch_mutex) {
+		return;
+	}
+
+	switch_mutex_lock(profile->pres_watch_mutex);
+	if (profile->pres_watch_hash) {
+		switch_core_hash_destroy(&profile->pres_watch_hash);
+	}
+	profile->pres_watch_loaded = 0;
+	switch_mutex_unlock(profile->pres_watch_mutex);
+}
+
 
 /* For Emacs:
  * Local Variables:
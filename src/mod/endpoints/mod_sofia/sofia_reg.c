@@ -560,23 +560,22 @@ int sofia_reg_find_reg_with_positive_expires_callback(void *pArg, int argc, char
 }
 
 
-int sofia_reg_nat_callback(void *pArg, int argc, char **argv, char **columnNames)
+static void sofia_reg_send_options_ping(sofia_profile_t *profile, const char *reg_call_id, const char *user, const char *host, const char *contact)
 {
-	sofia_profile_t *profile = (sofia_profile_t *) pArg;
 	nua_handle_t *nh;
 	char to[512] = "", call_id[512] = "";
 	sofia_destination_t *dst = NULL;
 	switch_uuid_t uuid;
 
-	switch_snprintf(to, sizeof(to), "sip:%s@%s", argv[1], argv[2]);
+	switch_snprintf(to, sizeof(to), "sip:%s@%s", user, host);
 
 	// create call-id for OPTIONS in the form "<uuid>_<original-register-call-id>"
 	switch_uuid_get(&uuid);
 	switch_uuid_format(call_id, &uuid);
 	strcat(call_id, "_");
-	strncat(call_id, argv[0], sizeof(call_id) - SWITCH_UUID_FORMATTED_LENGTH - 2);
+	strncat(call_id, reg_call_id, sizeof(call_id) - SWITCH_UUID_FORMATTED_LENGTH - 2);
 
-	dst = sofia_glue_get_destination(argv[3]);
+	dst = sofia_glue_get_destination((char *) contact);
 	switch_assert(dst);
 	
 	nh = nua_handle(profile->nua, NULL, SIPTAG_FROM_STR(profile->url), SIPTAG_TO_STR(to), NUTAG_URL(dst->contact), SIPTAG_CONTACT_STR(profile->url),
@@ -588,10 +587,335 @@ int sofia_reg_nat_callback(void *pArg, int argc, char **argv, char **columnNames
 				TAG_IF(dst->route_uri, NUTAG_PROXY(dst->route_uri)), TAG_IF(dst->route, SIPTAG_ROUTE_STR(dst->route)), TAG_END());
 
 	sofia_glue_free_destination(dst);
+}
+
+/* NAT keepalives
+
+   Contacts that get an OPTIONS ping sit on a wheel with one slot per second of the
+   ping interval, a contact always lands in the same slot.  The profile worker turns
+   the wheel once a second and pings what is in the current slot, so lots of
+   registrations make a steady trickle of pings instead of a burst every interval.
+   REGISTER keeps the wheel current and every few rounds it is rebuilt from
+   sip_registrations to pick up anything it missed. */
+
+#define SOFIA_PING_RELOAD_ROUNDS 10
+
+typedef struct sofia_ping_entry_s {
+	char *call_id;
+	char *user;
+	char *host;
+	char *contact;
+	time_t expires;
+	time_t added;
+	uint32_t slot;
+	struct sofia_ping_entry_s *prev;
+	struct sofia_ping_entry_s *next;
+} sofia_ping_entry_t;
+
+struct sofia_ping_wheel_s {
+	switch_hash_t *hash;
+	sofia_ping_entry_t **slots;
+	uint32_t slot_count;
+	uint32_t cursor;
+	uint32_t count;
+	uint32_t reload_in;
+	time_t last;
+};
+
+static void sofia_ping_entry_free(sofia_ping_entry_t *entry)
+{
+	switch_safe_free(entry->call_id);
+	switch_safe_free(entry->user);
+	switch_safe_free(entry->host);
+	switch_safe_free(entry->contact);
+	free(entry);
+}
+
+static sofia_ping_wheel_t *sofia_ping_wheel_create(int seconds)
+{
+	sofia_ping_wheel_t *wheel;
+
+	switch_zmalloc(wheel, sizeof(*wheel));
+	wheel->slot_count = seconds > 0 ? seconds : 1;
+	switch_zmalloc(wheel->slots, wheel->slot_count * sizeof(*wheel->slots));
+	switch_core_hash_init(&wheel->hash, NULL);
+
+	return wheel;
+}
+
+static void sofia_ping_wheel_destroy(sofia_ping_wheel_t **wheelp)
+{
+	sofia_ping_wheel_t *wheel = *wheelp;
+	sofia_ping_entry_t *entry, *next;
+	uint32_t i;
+
+	if (!wheel) {
+		return;
+	}
+
+	for (i = 0; i < wheel->slot_count; i++) {
+		for (entry = wheel->slots[i]; entry; entry = next) {
+			next = entry->next;
+			sofia_ping_entry_free(entry);
+		}
+	}
+
+	switch_core_hash_destroy(&wheel->hash);
+	free(wheel->slots);
+	free(wheel);
+	*wheelp = NULL;
+}
+
+static void sofia_ping_wheel_unlink(sofia_ping_wheel_t *wheel, sofia_ping_entry_t *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		wheel->slots[entry->slot] = entry->next;
+	}
+
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	}
+
+	switch_core_hash_delete(wheel->hash, entry->call_id);
+	wheel->count--;
+	sofia_ping_entry_free(entry);
+}
+
+static void sofia_ping_wheel_insert(sofia_ping_wheel_t *wheel, const char *call_id, const char *user, const char *host,
+									const char *contact, time_t expires, time_t added)
+{
+	sofia_ping_entry_t *entry;
+	const char *p;
+	uint32_t h = 5381;
+
+	if ((entry = switch_core_hash_find(wheel->hash, call_id))) {
+		switch_safe_free(entry->user);
+		switch_safe_free(entry->host);
+		switch_safe_free(entry->contact);
+	} else {
+		switch_zmalloc(entry, sizeof(*entry));
+		entry->call_id = strdup(call_id);
+
+		/* spread by call-id so the slots fill evenly */
+		for (p = call_id; *p; p++) {
+			h = ((h << 5) + h) + (uint8_t) *p;
+		}
+		entry->slot = h % wheel->slot_count;
+
+		if ((entry->next = wheel->slots[entry->slot])) {
+			entry->next->prev = entry;
+		}
+		wheel->slots[entry->slot] = entry;
+		switch_core_hash_insert(wheel->hash, entry->call_id, entry);
+		wheel->count++;
+	}
+
+	entry->user = strdup(user);
+	entry->host = strdup(host);
+	entry->contact = strdup(contact);
+	entry->expires = expires;
+	entry->added = added;
+}
+
+static switch_bool_t sofia_reg_ping_wanted(sofia_profile_t *profile, const char *status, const char *contact)
+{
+	if (sofia_test_pflag(profile, PFLAG_ALL_REG_OPTIONS_PING)) {
+		return SWITCH_TRUE;
+	} else if (sofia_test_pflag(profile, PFLAG_UDP_NAT_OPTIONS_PING)) {
+		return switch_stristr("UDP-NAT", status) ? SWITCH_TRUE : SWITCH_FALSE;
+	} else if (sofia_test_pflag(profile, PFLAG_NAT_OPTIONS_PING)) {
+		return (switch_stristr("NAT", status) || switch_stristr("fs_nat=yes", contact)) ? SWITCH_TRUE : SWITCH_FALSE;
+	}
+
+	return SWITCH_FALSE;
+}
+
+/* a local registration was added or refreshed */
+void sofia_reg_ping_add(sofia_profile_t *profile, const char *call_id, const char *user, const char *host,
+						const char *contact, const char *status, long expires)
+{
+	if (zstr(call_id) || zstr(user) || zstr(host) || zstr(contact) || !sofia_reg_ping_wanted(profile, switch_str_nil(status), contact)) {
+		return;
+	}
+
+	switch_mutex_lock(profile->ping_mutex);
+	if (!profile->ping_wheel) {
+		/* reload_in is 0 so the next turn fills it from the database */
+		profile->ping_wheel = sofia_ping_wheel_create(profile->ireg_seconds);
+	}
+	sofia_ping_wheel_insert(profile->ping_wheel, call_id, user, host, contact, (time_t) expires, switch_epoch_time_now(NULL));
+	switch_mutex_unlock(profile->ping_mutex);
+}
+
+void sofia_reg_ping_del(sofia_profile_t *profile, const char *call_id)
+{
+	sofia_ping_entry_t *entry;
+
+	if (zstr(call_id)) {
+		return;
+	}
+
+	switch_mutex_lock(profile->ping_mutex);
+	if (profile->ping_wheel && (entry = switch_core_hash_find(profile->ping_wheel->hash, call_id))) {
+		sofia_ping_wheel_unlink(profile->ping_wheel, entry);
+	}
+	switch_mutex_unlock(profile->ping_mutex);
+}
+
+void sofia_reg_ping_flush(sofia_profile_t *profile)
+{
+	switch_mutex_lock(profile->ping_mutex);
+	sofia_ping_wheel_destroy(&profile->ping_wheel);
+	switch_mutex_unlock(profile->ping_mutex);
+}
+
+uint32_t sofia_reg_ping_count(sofia_profile_t *profile)
+{
+	uint32_t count = 0;
+
+	switch_mutex_lock(profile->ping_mutex);
+	if (profile->ping_wheel) {
+		count = profile->ping_wheel->count;
+	}
+	switch_mutex_unlock(profile->ping_mutex);
+
+	return count;
+}
+
+static int sofia_reg_ping_load_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	sofia_ping_wheel_t *wheel = (sofia_ping_wheel_t *) pArg;
+
+	if (!zstr(argv[0]) && !zstr(argv[1]) && !zstr(argv[2]) && !zstr(argv[3])) {
+		sofia_ping_wheel_insert(wheel, argv[0], argv[1], argv[2], argv[3], argv[4] ? atol(argv[4]) : 0, 0);
+	}
 
 	return 0;
 }
 
+static void sofia_reg_ping_reload(sofia_profile_t *profile, time_t now)
+{
+	sofia_ping_wheel_t *wheel, *old;
+	sofia_ping_entry_t *entry;
+	char *sql = NULL;
+	uint32_t i;
+
+	wheel = sofia_ping_wheel_create(profile->ireg_seconds);
+
+	if (sofia_test_pflag(profile, PFLAG_ALL_REG_OPTIONS_PING)) {
+		sql = switch_mprintf("select call_id,sip_user,sip_host,contact,expires from sip_registrations "
+							 "where hostname='%q' and profile_name='%q'", mod_sofia_globals.hostname, profile->name);
+	} else if (sofia_test_pflag(profile, PFLAG_UDP_NAT_OPTIONS_PING)) {
+		sql = switch_mprintf("select call_id,sip_user,sip_host,contact,expires from sip_registrations "
+							 "where status like '%%UDP-NAT%%' and hostname='%q' and profile_name='%q'", mod_sofia_globals.hostname, profile->name);
+	} else if (sofia_test_pflag(profile, PFLAG_NAT_OPTIONS_PING)) {
+		sql = switch_mprintf("select call_id,sip_user,sip_host,contact,expires from sip_registrations "
+							 "where (status like '%%NAT%%' or contact like '%%fs_nat=yes%%') and hostname='%q' and profile_name='%q'",
+							 mod_sofia_globals.hostname, profile->name);
+	}
+
+	if (sql) {
+		sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_ping_load_callback, wheel);
+		switch_safe_free(sql);
+	}
+
+	switch_mutex_lock(profile->ping_mutex);
+	if ((old = profile->ping_wheel)) {
+		/* keep whoever registered while we were reading */
+		for (i = 0; i < old->slot_count; i++) {
+			for (entry = old->slots[i]; entry; entry = entry->next) {
+				if (entry->added >= now) {
+					sofia_ping_wheel_insert(wheel, entry->call_id, entry->user, entry->host, entry->contact, entry->expires, entry->added);
+				}
+			}
+		}
+		wheel->cursor = old->cursor % wheel->slot_count;
+		wheel->last = old->last;
+		sofia_ping_wheel_destroy(&old);
+	}
+	wheel->reload_in = wheel->slot_count * SOFIA_PING_RELOAD_ROUNDS;
+	profile->ping_wheel = wheel;
+	switch_mutex_unlock(profile->ping_mutex);
+}
+
+/* called by the profile worker once a second, pings the contacts whose slot came up */
+void sofia_reg_ping_tick(sofia_profile_t *profile, time_t now)
+{
+	sofia_ping_wheel_t *wheel;
+	sofia_ping_entry_t *entry, *next, *batch = NULL;
+	uint32_t turns, reload = 0;
+
+	if (!sofia_test_pflag(profile, PFLAG_ALL_REG_OPTIONS_PING) && !sofia_test_pflag(profile, PFLAG_UDP_NAT_OPTIONS_PING) &&
+		!sofia_test_pflag(profile, PFLAG_NAT_OPTIONS_PING)) {
+		if (profile->ping_wheel) {
+			sofia_reg_ping_flush(profile);
+		}
+		return;
+	}
+
+	switch_mutex_lock(profile->ping_mutex);
+	wheel = profile->ping_wheel;
+	if (!wheel || !wheel->reload_in || wheel->slot_count != (uint32_t) (profile->ireg_seconds > 0 ? profile->ireg_seconds : 1)) {
+		reload = 1;
+	}
+	switch_mutex_unlock(profile->ping_mutex);
+
+	if (reload) {
+		sofia_reg_ping_reload(profile, now);
+	}
+
+	switch_mutex_lock(profile->ping_mutex);
+	if ((wheel = profile->ping_wheel)) {
+		/* catch up on the slots we missed if the worker was late, at most one round */
+		turns = wheel->last && now > wheel->last ? (uint32_t) (now - wheel->last) : 1;
+		if (wheel->last && now <= wheel->last) {
+			turns = 0;
+		}
+		if (turns > wheel->slot_count) {
+			turns = wheel->slot_count;
+		}
+
+		while (turns--) {
+			wheel->cursor = (wheel->cursor + 1) % wheel->slot_count;
+
+			for (entry = wheel->slots[wheel->cursor]; entry; entry = next) {
+				sofia_ping_entry_t *ping;
+
+				next = entry->next;
+
+				if (entry->expires > 0 && entry->expires <= now) {
+					sofia_ping_wheel_unlink(wheel, entry);
+					continue;
+				}
+
+				switch_zmalloc(ping, sizeof(*ping));
+				ping->call_id = strdup(entry->call_id);
+				ping->user = strdup(entry->user);
+				ping->host = strdup(entry->host);
+				ping->contact = strdup(entry->contact);
+				ping->next = batch;
+				batch = ping;
+			}
+
+			if (wheel->reload_in) {
+				wheel->reload_in--;
+			}
+		}
+
+		wheel->last = now;
+	}
+	switch_mutex_unlock(profile->ping_mutex);
+
+	/* send outside the lock so REGISTER never waits on the pings */
+	for (entry = batch; entry; entry = next) {
+		next = entry->next;
+		sofia_reg_send_options_ping(profile, entry->call_id, entry->user, entry->host, entry->contact);
+		sofia_ping_entry_free(entry);
+	}
+}
+
 
 void sofia_reg_send_reboot(sofia_profile_t *profile, const char *callid, const char *user, const char *host, const char *contact, const char *user_agent,
 						   const char *network_ip)
@@ -630,7 +954,7 @@ int sofia_sla_dialog_del_callback(void *pArg, int argc, char **argv, char **colu
 	sofia_profile_t *profile = (sofia_profile_t *) pArg;
 	nua_handle_t *nh = NULL;
 
-	if ((nh = nua_handle_by_call_id(profile->nua, argv[0]))) {
+	if ((nh = sofia_nua_handle_by_call_id(profile, argv[0]))) {
 		nua_handle_destroy(nh);
 	}
 
@@ -737,6 +1061,12 @@ void sofia_reg_expire_call_id(sofia_profile_t *profile, const char *call_id, int
 	sql = switch_mprintf("delete from sip_registrations where call_id='%q' %s", call_id, sqlextra);
 	sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
 
+	sofia_reg_cache_invalidate_call_id(profile, call_id);
+	sofia_reg_ping_del(profile, call_id);
+	if (!zstr(user)) {
+		sofia_reg_cache_invalidate(profile, user);
+	}
+
 	switch_safe_free(sqlextra);
 	switch_safe_free(sql);
 	switch_safe_free(dup);
@@ -766,6 +1096,13 @@ void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot)
 		sql = switch_mprintf("delete from sip_registrations where expires > 0 and hostname='%q'", mod_sofia_globals.hostname);
 	}
 	sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+
+	if (!now) {
+		sofia_reg_cache_invalidate(profile, NULL);
+		sofia_reg_ping_flush(profile);
+	} else {
+		sofia_reg_cache_expire(profile, now);
+	}
 	
 
 
@@ -815,35 +1152,6 @@ void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot)
 	sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
 
 
-	if (now) {
-		if (sofia_test_pflag(profile, PFLAG_ALL_REG_OPTIONS_PING)) {
-			sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,"
-							"expires,user_agent,server_user,server_host,profile_name"
- " from sip_registrations where hostname='%s' and " 
- "profile_name='%s'", mod_sofia_globals.hostname, profile->name); 
-			
-			sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_nat_callback, profile);
-			switch_safe_free(sql);
-		} else if (sofia_test_pflag(profile, PFLAG_UDP_NAT_OPTIONS_PING)) {
-			sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,"
-							"expires,user_agent,server_user,server_host,profile_name"
-							" from sip_registrations where status like '%%UDP-NAT%%' "
- "and hostname='%s' and profile_name='%s'", mod_sofia_globals.hostname, profile->name); 
-			
-			sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_nat_callback, profile);
-			switch_safe_free(sql);
-		} else if (sofia_test_pflag(profile, PFLAG_NAT_OPTIONS_PING)) {
-			sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,"
-							"expires,user_agent,server_user,server_host,profile_name"
-							" from sip_registrations where (status like '%%NAT%%' "
- "or contact like '%%fs_nat=yes%%') and hostname='%s' " 
- "and profile_name='%s'", mod_sofia_globals.hostname, profile->name); 
-			
-			sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_nat_callback, profile);
-			switch_safe_free(sql);
-		}
-	}
-
 }
 
 
@@ -910,6 +1218,8 @@ void sofia_reg_check_sync(sofia_profile_t *profile)
 
 	sql = switch_mprintf("delete from sip_registrations where expires > 0 and hostname='%q'", mod_sofia_globals.hostname);
 	sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+	sofia_reg_cache_invalidate(profile, NULL);
+	sofia_reg_ping_flush(profile);
 
 	sql = switch_mprintf("delete from sip_presence where expires > 0 and hostname='%q'", mod_sofia_globals.hostname);
 	sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
@@ -925,6 +1235,312 @@ void sofia_reg_check_sync(sofia_profile_t *profile)
 
 }
 
+/* Registration cache
+
+   Contacts of a user as found in sip_registrations, so originating to a registered
+   user does not need a query per call.  Entries are keyed by sip_user and hold every
+   row of that user, host matching is done like the SQL does.  An entry is only good
+   until its first contact expires or the cache ttl is over, whichever comes first.
+   Whatever changes the registrations of a user invalidates the entry and keeps it out
+   of the cache for a few seconds so writes still sitting in the sql queue can land
+   before we cache it again.  Nothing listed here means "ask the database".
+   A user with no rows is remembered too, but only briefly, and entries past both their
+   validity and their hold are swept from the expire check so lookups of arbitrary users
+   do not pile up. */
+
+#define SOFIA_REG_CACHE_SETTLE 2
+#define SOFIA_REG_CACHE_EMPTY_TTL 30
+
+typedef struct sofia_reg_cache_row_s {
+	char *contact;
+	char *call_id;
+	char *sip_host;
+	char *presence_hosts;
+	long expires;
+	struct sofia_reg_cache_row_s *next;
+} sofia_reg_cache_row_t;
+
+typedef struct sofia_reg_cache_entry_s {
+	time_t valid_until;
+	time_t hold_until;
+	sofia_reg_cache_row_t *rows;
+	sofia_reg_cache_row_t *tail;
+} sofia_reg_cache_entry_t;
+
+static void sofia_reg_cache_free_entry(sofia_reg_cache_entry_t *entry)
+{
+	sofia_reg_cache_row_t *row, *next;
+
+	if (!entry) {
+		return;
+	}
+
+	for (row = entry->rows; row; row = next) {
+		next = row->next;
+		switch_safe_free(row->contact);
+		switch_safe_free(row->call_id);
+		switch_safe_free(row->sip_host);
+		switch_safe_free(row->presence_hosts);
+		free(row);
+	}
+
+	free(entry);
+}
+
+static int sofia_reg_cache_fill_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	sofia_reg_cache_entry_t *entry = (sofia_reg_cache_entry_t *) pArg;
+	sofia_reg_cache_row_t *row;
+
+	if (zstr(argv[0])) {
+		return 0;
+	}
+
+	switch_zmalloc(row, sizeof(*row));
+	row->contact = strdup(argv[0]);
+	row->sip_host = strdup(switch_str_nil(argv[1]));
+	row->presence_hosts = strdup(switch_str_nil(argv[2]));
+	row->expires = argv[3] ? atol(argv[3]) : 0;
+	row->call_id = strdup(switch_str_nil(argv[4]));
+
+	if (entry->tail) {
+		entry->tail->next = row;
+	} else {
+		entry->rows = row;
+	}
+	entry->tail = row;
+
+	return 0;
+}
+
+/* feed the cached contacts of user matching host to the same callback the SQL lookup uses */
+static switch_bool_t sofia_reg_cache_walk(sofia_reg_cache_entry_t *entry, const char *host, struct callback_t *cbt)
+{
+	sofia_reg_cache_row_t *row;
+
+	for (row = entry->rows; row; row = row->next) {
+		char *argv[1];
+
+		if (host && strcmp(row->sip_host, host) && !switch_stristr(host, row->presence_hosts)) {
+			continue;
+		}
+
+		argv[0] = row->contact;
+		if (sofia_reg_find_callback(cbt, 1, argv, NULL)) {
+			break;
+		}
+	}
+
+	return SWITCH_TRUE;
+}
+
+static switch_bool_t sofia_reg_cache_lookup(sofia_profile_t *profile, const char *user, const char *host, struct callback_t *cbt)
+{
+	sofia_reg_cache_entry_t *entry, *old;
+	time_t now = switch_epoch_time_now(NULL);
+	uint32_t gen;
+	char *sql;
+
+	if (profile->reg_cache_ttl <= 0 || !profile->reg_cache_hash) {
+		return SWITCH_FALSE;
+	}
+
+	switch_thread_rwlock_rdlock(profile->reg_cache_rwlock);
+	if ((entry = switch_core_hash_find(profile->reg_cache_hash, user)) && now < entry->valid_until) {
+		sofia_reg_cache_walk(entry, host, cbt);
+		switch_thread_rwlock_unlock(profile->reg_cache_rwlock);
+		return SWITCH_TRUE;
+	}
+	gen = profile->reg_cache_gen;
+	switch_thread_rwlock_unlock(profile->reg_cache_rwlock);
+
+	/* miss, load every row of the user and answer from that */
+	switch_zmalloc(entry, sizeof(*entry));
+	sql = switch_mprintf("select contact,sip_host,presence_hosts,expires,call_id from sip_registrations where sip_user='%q'", user);
+	sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_cache_fill_callback, entry);
+	switch_safe_free(sql);
+
+	sofia_reg_cache_walk(entry, host, cbt);
+
+	entry->valid_until = now + (entry->rows || profile->reg_cache_ttl < SOFIA_REG_CACHE_EMPTY_TTL ? profile->reg_cache_ttl : SOFIA_REG_CACHE_EMPTY_TTL);
+	for (entry->tail = entry->rows; entry->tail; entry->tail = entry->tail->next) {
+		if (entry->tail->expires > 0 && entry->tail->expires < entry->valid_until) {
+			entry->valid_until = entry->tail->expires;
+		}
+	}
+
+	switch_thread_rwlock_wrlock(profile->reg_cache_rwlock);
+	old = profile->reg_cache_hash ? switch_core_hash_find(profile->reg_cache_hash, user) : NULL;
+	if (profile->reg_cache_hash && gen == profile->reg_cache_gen && entry->valid_until > now && now >= profile->reg_cache_hold && (!old || now >= old->hold_until)) {
+		switch_core_hash_insert(profile->reg_cache_hash, user, entry);
+		sofia_reg_cache_free_entry(old);
+		entry = NULL;
+	}
+	switch_thread_rwlock_unlock(profile->reg_cache_rwlock);
+
+	sofia_reg_cache_free_entry(entry);
+
+	return SWITCH_TRUE;
+}
+
+static void sofia_reg_cache_flush(sofia_profile_t *profile)
+{
+	switch_hash_index_t *hi;
+	void *val;
+
+	for (hi = switch_core_hash_first(profile->reg_cache_hash); hi; hi = switch_core_hash_next(hi)) {
+		switch_core_hash_this(hi, NULL, NULL, &val);
+		sofia_reg_cache_free_entry((sofia_reg_cache_entry_t *) val);
+	}
+
+	switch_core_hash_destroy(&profile->reg_cache_hash);
+}
+
+/* the registrations of user (all users when NULL) changed or are about to */
+void sofia_reg_cache_invalidate(sofia_profile_t *profile, const char *user)
+{
+	sofia_reg_cache_entry_t *entry, *old;
+	time_t hold = switch_epoch_time_now(NULL) + SOFIA_REG_CACHE_SETTLE;
+
+	if (!profile->reg_cache_hash || profile->reg_cache_ttl <= 0) {
+		return;
+	}
+
+	switch_thread_rwlock_wrlock(profile->reg_cache_rwlock);
+	profile->reg_cache_gen++;
+
+	if (zstr(user)) {
+		sofia_reg_cache_flush(profile);
+		switch_core_hash_init(&profile->reg_cache_hash, NULL);
+		profile->reg_cache_hold = hold;
+	} else {
+		/* leave an empty entry behind to remember the hold */
+		switch_zmalloc(entry, sizeof(*entry));
+		entry->hold_until = hold;
+		old = switch_core_hash_find(profile->reg_cache_hash, user);
+		switch_core_hash_insert(profile->reg_cache_hash, user, entry);
+		sofia_reg_cache_free_entry(old);
+	}
+
+	switch_thread_rwlock_unlock(profile->reg_cache_rwlock);
+}
+
+/* same for whoever registered with call_id, for callers that do not know the user */
+void sofia_reg_cache_invalidate_call_id(sofia_profile_t *profile, const char *call_id)
+{
+	switch_hash_index_t *hi;
+	sofia_reg_cache_row_t *row;
+	const void *var;
+	void *val;
+	char *user = NULL;
+
+	if (!profile->reg_cache_hash || profile->reg_cache_ttl <= 0 || zstr(call_id)) {
+		return;
+	}
+
+	switch_thread_rwlock_wrlock(profile->reg_cache_rwlock);
+	for (hi = switch_core_hash_first(profile->reg_cache_hash); hi && !user; hi = switch_core_hash_next(hi)) {
+		switch_core_hash_this(hi, &var, NULL, &val);
+		for (row = ((sofia_reg_cache_entry_t *) val)->rows; row; row = row->next) {
+			if (!strcmp(row->call_id, call_id)) {
+				user = strdup((const char *) var);
+				break;
+			}
+		}
+	}
+	/* a fill in flight may still see the row */
+	profile->reg_cache_gen++;
+	switch_thread_rwlock_unlock(profile->reg_cache_rwlock);
+
+	if (user) {
+		sofia_reg_cache_invalidate(profile, user);
+		free(user);
+	}
+}
+
+/* drop whatever is no longer of any use, called from the periodic expire check */
+void sofia_reg_cache_expire(sofia_profile_t *profile, time_t now)
+{
+	switch_hash_index_t *hi;
+	sofia_reg_cache_entry_t *entry;
+	const void *var;
+	void *val;
+	char **keys = NULL;
+	int count = 0, alloced = 0, i;
+
+	if (!profile->reg_cache_hash || profile->reg_cache_ttl <= 0) {
+		return;
+	}
+
+	switch_thread_rwlock_wrlock(profile->reg_cache_rwlock);
+	for (hi = switch_core_hash_first(profile->reg_cache_hash); hi; hi = switch_core_hash_next(hi)) {
+		switch_core_hash_this(hi, &var, NULL, &val);
+		entry = (sofia_reg_cache_entry_t *) val;
+
+		if (now < entry->valid_until || now < entry->hold_until) {
+			continue;
+		}
+
+		if (count == alloced) {
+			void *mem;
+
+			alloced = alloced ? alloced * 2 : 64;
+			mem = realloc(keys, alloced * sizeof(*keys));
+			switch_assert(mem);
+			keys = mem;
+		}
+		keys[count++] = strdup((const char *) var);
+	}
+
+	for (i = 0; i < count; i++) {
+		if ((entry = switch_core_hash_find(profile->reg_cache_hash, keys[i]))) {
+			switch_core_hash_delete(profile->reg_cache_hash, keys[i]);
+			sofia_reg_cache_free_entry(entry);
+		}
+		free(keys[i]);
+	}
+	switch_thread_rwlock_unlock(profile->reg_cache_rwlock);
+
+	switch_safe_free(keys);
+}
+
+void sofia_reg_cache_destroy(sofia_profile_t *profile)
+{
+	if (!profile->reg_cache_hash) {
+		return;
+	}
+
+	switch_thread_rwlock_wrlock(profile->reg_cache_rwlock);
+	sofia_reg_cache_flush(profile);
+	switch_thread_rwlock_unlock(profile->reg_cache_rwlock);
+}
+
+/* feed the cached contacts of user@host to callback as (contact, profile_name, extra) rows, the way
+   sofia_contact selects them; SWITCH_FALSE when the cache is off and the caller has to run its own query */
+switch_bool_t sofia_reg_cache_contacts(sofia_profile_t *profile, const char *user, const char *host, const char *extra,
+									   switch_core_db_callback_func_t callback, void *pArg)
+{
+	struct callback_t cbt = { 0 };
+	switch_console_callback_match_node_t *m;
+	char *argv[3];
+
+	if (!sofia_reg_cache_lookup(profile, user, host, &cbt)) {
+		return SWITCH_FALSE;
+	}
+
+	if (cbt.list) {
+		for (m = cbt.list->head; m; m = m->next) {
+			argv[0] = m->val;
+			argv[1] = profile->name;
+			argv[2] = (char *) extra;
+			callback(pArg, 3, argv, NULL);
+		}
+		switch_console_free_matches(&cbt.list);
+	}
+
+	return SWITCH_TRUE;
+}
+
 char *sofia_reg_find_reg_url(sofia_profile_t *profile, const char *user, const char *host, char *val, switch_size_t len)
 {
 	struct callback_t cbt = { 0 };
@@ -938,17 +1554,19 @@ char *sofia_reg_find_reg_url(sofia_profile_t *profile, const char *user, const c
 	cbt.val = val;
 	cbt.len = len;
 
-	if (host) {
-		sql = switch_mprintf("select contact from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')",
-						user, host, host);
-	} else {
-		sql = switch_mprintf("select contact from sip_registrations where sip_user='%q'", user);
-	}
+	if (!sofia_reg_cache_lookup(profile, user, host, &cbt)) {
+		if (host) {
+			sql = switch_mprintf("select contact from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')",
+							user, host, host);
+		} else {
+			sql = switch_mprintf("select contact from sip_registrations where sip_user='%q'", user);
+		}
 
 
-	sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_find_callback, &cbt);
+		sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_find_callback, &cbt);
 
-	switch_safe_free(sql);
+		switch_safe_free(sql);
+	}
 
 	if (cbt.list) {
 		switch_console_free_matches(&cbt.list);
@@ -972,6 +1590,10 @@ switch_console_callback_match_t *sofia_reg_find_reg_url_multi(sofia_profile_t *p
 		return NULL;
 	}
 
+	if (sofia_reg_cache_lookup(profile, user, host, &cbt)) {
+		return cbt.list;
+	}
+
 	if (host) {
 		sql = switch_mprintf("select contact from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')",
 						user, host, host);
@@ -1016,11 +1638,193 @@ switch_console_callback_match_t *sofia_reg_find_reg_url_with_positive_expires_mu
 }
 
 
+/* 
+ * Stateless nonces (stateless-nonces=true) are <timestamp><salt><hmac> in hex.  The hmac covers the
+ * timestamp, salt, realm and profile name and is keyed with a key derived from nonce-secret for the
+ * period the timestamp falls in, so any box with the same secret can check a nonce without touching
+ * sip_authentication.  The nc replay state lives in two generations of an in memory hash instead.
+ * A nonce stays valid for nonce-ttl plus the expires of the request that uses it, the generations
+ * must be at least that long or a forgotten nonce could be replayed from nc=1.  The expires counted
+ * is capped so a client asking for a huge one cannot pin the nc state forever, it gets re-challenged.
+ */
+#define SOFIA_NONCE_LEN (8 + 8 + 2 * SU_MD5_DIGEST_SIZE)
+#define SOFIA_NONCE_KEY_PERIOD 3600
+#define SOFIA_NONCE_MAX_EXPIRES 86400
+#define SOFIA_NONCE_SKEW 30
+
+static void sofia_reg_hmac_md5(const void *key, size_t klen, const char *data, uint8_t digest[SU_MD5_DIGEST_SIZE])
+{
+	su_md5_t ctx;
+	uint8_t k[64] = { 0 }, pad[64];
+	int i;
+
+	if (klen > sizeof(k)) {
+		su_md5_init(&ctx);
+		su_md5_update(&ctx, key, klen);
+		su_md5_digest(&ctx, k);
+	} else {
+		memcpy(k, key, klen);
+	}
+
+	for (i = 0; i < 64; i++) {
+		pad[i] = k[i] ^ 0x36;
+	}
+	su_md5_init(&ctx);
+	su_md5_update(&ctx, pad, sizeof(pad));
+	su_md5_strupdate(&ctx, data);
+	su_md5_digest(&ctx, digest);
+
+	for (i = 0; i < 64; i++) {
+		pad[i] = k[i] ^ 0x5c;
+	}
+	su_md5_init(&ctx);
+	su_md5_update(&ctx, pad, sizeof(pad));
+	su_md5_update(&ctx, digest, SU_MD5_DIGEST_SIZE);
+	su_md5_digest(&ctx, digest);
+}
+
+static void sofia_reg_nonce_sign(sofia_profile_t *profile, uint32_t ts, uint32_t salt, const char *realm, char *out)
+{
+	uint8_t key[SU_MD5_DIGEST_SIZE], mac[SU_MD5_DIGEST_SIZE];
+	const char *secret = profile->nonce_secret;
+	char buf[512];
+	int i;
+
+	/* the key rolls over every period, the period comes from the nonce itself so older nonces still check out */
+	switch_snprintf(buf, sizeof(buf), "%u", ts / SOFIA_NONCE_KEY_PERIOD);
+	sofia_reg_hmac_md5(secret, strlen(secret), buf, key);
+
+	switch_snprintf(buf, sizeof(buf), "%08x%08x:%s:%s", ts, salt, realm, profile->name);
+	sofia_reg_hmac_md5(key, sizeof(key), buf, mac);
+
+	for (i = 0; i < SU_MD5_DIGEST_SIZE; i++) {
+		switch_snprintf(out + i * 2, 3, "%02x", mac[i]);
+	}
+}
+
+static void sofia_reg_nonce_create(sofia_profile_t *profile, const char *realm, char *nonce)
+{
+	uint32_t ts = (uint32_t) switch_epoch_time_now(NULL);
+
+	/* the salt keeps two challenges in the same second apart, they key the nc state */
+	switch_snprintf(nonce, 9, "%08x", ts);
+	switch_stun_random_string(nonce + 8, 8, "0123456789abcdef");
+	nonce[16] = '\0';
+
+	sofia_reg_nonce_sign(profile, ts, strtoul(nonce + 8, NULL, 16), switch_str_nil(realm), nonce + 16);
+}
+
+static switch_hash_t *sofia_reg_nonce_cache(sofia_profile_t *profile, time_t now, uint32_t lifetime)
+{
+	/* growing the period only keeps state longer, so it is safe to do it on the fly */
+	if (lifetime > profile->nonce_nc_period) {
+		profile->nonce_nc_period = lifetime;
+	}
+
+	/* an entry lives at least one period past its last use, a generation is dropped as a whole once it is two periods old */
+	if (!profile->nonce_nc_hash[0] || now - profile->nonce_nc_rotated >= (time_t) profile->nonce_nc_period) {
+		if (profile->nonce_nc_hash[1]) {
+			switch_core_hash_destroy(&profile->nonce_nc_hash[1]);
+		}
+		profile->nonce_nc_hash[1] = profile->nonce_nc_hash[0];
+
+		if (profile->nonce_nc_hash[1] && now - profile->nonce_nc_rotated >= 2 * (time_t) profile->nonce_nc_period) {
+			switch_core_hash_destroy(&profile->nonce_nc_hash[1]);
+		}
+
+		switch_core_hash_init(&profile->nonce_nc_hash[0], NULL);
+		profile->nonce_nc_rotated = now;
+	}
+
+	return profile->nonce_nc_hash[0];
+}
+
+void sofia_reg_nonce_cache_destroy(sofia_profile_t *profile)
+{
+	int i;
+
+	switch_mutex_lock(profile->nonce_mutex);
+	for (i = 0; i < 2; i++) {
+		if (profile->nonce_nc_hash[i]) {
+			switch_core_hash_destroy(&profile->nonce_nc_hash[i]);
+		}
+	}
+	switch_mutex_unlock(profile->nonce_mutex);
+}
+
+static auth_res_t sofia_reg_nonce_check(sofia_profile_t *profile, const char *nonce, const char *realm, const char *nc, long exptime, long *last_nc)
+{
+	time_t now = switch_epoch_time_now(NULL);
+	uint32_t ts, salt, ttl = profile->nonce_ttl ? profile->nonce_ttl : DEFAULT_NONCE_TTL;
+	unsigned long ncl = nc ? strtoul(nc, 0, 16) : 0;
+	char mac[2 * SU_MD5_DIGEST_SIZE + 1], tmp[9];
+	uint32_t lifetime = ttl + (uint32_t) (exptime < 0 ? 0 : exptime > SOFIA_NONCE_MAX_EXPIRES ? SOFIA_NONCE_MAX_EXPIRES : exptime);
+	switch_hash_t *hash;
+	intptr_t last = 0;
+	int i, diff = 0;
+
+	if (strlen(nonce) != SOFIA_NONCE_LEN || strspn(nonce, "0123456789abcdef") != SOFIA_NONCE_LEN) {
+		return AUTH_STALE;
+	}
+
+	switch_copy_string(tmp, nonce, sizeof(tmp));
+	ts = strtoul(tmp, NULL, 16);
+	switch_copy_string(tmp, nonce + 8, sizeof(tmp));
+	salt = strtoul(tmp, NULL, 16);
+
+	if ((time_t) ts > now + SOFIA_NONCE_SKEW || now - (time_t) ts > (time_t) lifetime) {
+		return AUTH_STALE;
+	}
+
+	sofia_reg_nonce_sign(profile, ts, salt, realm, mac);
+
+	for (i = 0; i < 2 * SU_MD5_DIGEST_SIZE; i++) {
+		diff |= mac[i] ^ nonce[16 + i];
+	}
+
+	if (diff) {
+		return AUTH_STALE;
+	}
+
+	*last_nc = 0;
+
+	if (!nc) {
+		return AUTH_OK;
+	}
+
+	/* nc must keep growing, values are stored as nc + 1 so an unknown nonce reads back as NULL */
+	switch_mutex_lock(profile->nonce_mutex);
+	hash = sofia_reg_nonce_cache(profile, now, lifetime);
+
+	if (!(last = (intptr_t) switch_core_hash_find(hash, nonce)) && profile->nonce_nc_hash[1]) {
+		last = (intptr_t) switch_core_hash_find(profile->nonce_nc_hash[1], nonce);
+	}
+
+	if (last) {
+		last--;
+	}
+
+	/* an nc past 1 on a nonce we have no state for is either forgotten or replayed somewhere else, make the client start over */
+	if (ncl <= (unsigned long) last || (!last && ncl != 1)) {
+		switch_mutex_unlock(profile->nonce_mutex);
+		return AUTH_STALE;
+	}
+
+	switch_core_hash_insert(hash, nonce, (void *) (intptr_t) (ncl + 1));
+	switch_mutex_unlock(profile->nonce_mutex);
+
+	*last_nc = (long) last;
+
+	return AUTH_OK;
+}
+
 void sofia_reg_auth_challenge(sofia_profile_t *profile, nua_handle_t *nh, sofia_dispatch_event_t *de,
 							  sofia_regtype_t regtype, const char *realm, int stale, long exptime)
 {
 	switch_uuid_t uuid;
 	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	char nonce[SOFIA_NONCE_LEN + 1];
+	const char *nonce_str = uuid_str;
 	char *sql, *auth_str;
 	msg_t *msg = NULL;
 
@@ -1029,17 +1833,22 @@ void sofia_reg_auth_challenge(sofia_profile_t *profile, nua_handle_t *nh, sofia_
 		msg = de->data->e_msg;
 	}
 
-	switch_uuid_get(&uuid);
-	switch_uuid_format(uuid_str, &uuid);
+	if (sofia_test_pflag(profile, PFLAG_STATELESS_NONCE)) {
+		sofia_reg_nonce_create(profile, realm, nonce);
+		nonce_str = nonce;
+	} else {
+		switch_uuid_get(&uuid);
+		switch_uuid_format(uuid_str, &uuid);
 
-	sql = switch_mprintf("insert into sip_authentication (nonce,expires,profile_name,hostname, last_nc) "
-						 "values('%q', %ld, '%q', '%q', 0)", uuid_str,
-						 (long) switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : DEFAULT_NONCE_TTL) + exptime,
-						 profile->name, mod_sofia_globals.hostname);
-	switch_assert(sql != NULL);
-	sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+		sql = switch_mprintf("insert into sip_authentication (nonce,expires,profile_name,hostname, last_nc) "
+							 "values('%q', %ld, '%q', '%q', 0)", uuid_str,
+							 (long) switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : DEFAULT_NONCE_TTL) + exptime,
+							 profile->name, mod_sofia_globals.hostname);
+		switch_assert(sql != NULL);
+		sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+	}
 
-	auth_str = switch_mprintf("Digest realm=\"%q\", nonce=\"%q\",%s algorithm=MD5, qop=\"auth\"", realm, uuid_str, stale ? " stale=true," : "");
+	auth_str = switch_mprintf("Digest realm=\"%q\", nonce=\"%q\",%s algorithm=MD5, qop=\"auth\"", realm, nonce_str, stale ? " stale=true," : "");
 
 	if (regtype == REG_REGISTER) {
 		nua_respond(nh, SIP_401_UNAUTHORIZED, TAG_IF(msg, NUTAG_WITH_THIS_MSG(msg)), SIPTAG_WWW_AUTHENTICATE_STR(auth_str), TAG_END());
@@ -1794,6 +2603,8 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 			sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
 		}
 
+		sofia_reg_ping_add(profile, call_id, to_user, reg_host, contact_str, reg_desc, (long) reg_time + (long) exptime + 60);
+
 		if (!update_registration && sofia_reg_reg_count(profile, to_user, reg_host) == 1) {
 			sql = switch_mprintf("delete from sip_presence where sip_user='%q' and sip_host='%q' and profile_name='%q' and open_closed='closed'", 
 								 to_user, reg_host, profile->name);
@@ -1855,6 +2666,7 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 		}
 
 		sofia_reg_check_socket(profile, call_id, network_ip, network_port_c);
+		sofia_reg_ping_del(profile, call_id);
 
 		if (send && switch_event_create(&event, SWITCH_EVENT_PRESENCE_IN) == SWITCH_STATUS_SUCCESS) {
 			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "proto", SOFIA_CHAT_PROTO);
@@ -1898,6 +2710,10 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 		}
 	}
 
+	if (!zstr(to_user)) {
+		sofia_reg_cache_invalidate(profile, to_user);
+	}
+
   respond_200_ok:
 
 	if (regtype == REG_REGISTER) {
@@ -2557,7 +3373,22 @@ auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 
 	user_agent = (sip && sip->sip_user_agent) ? sip->sip_user_agent->g_string : "unknown";
 
-	if (zstr(np)) {
+	if (zstr(np) && sofia_test_pflag(profile, PFLAG_STATELESS_NONCE)) {
+		long last_nc = 0;
+
+		first = 1;
+
+		if ((ret = sofia_reg_nonce_check(profile, nonce, realm, nc, exptime, &last_nc)) != AUTH_OK) {
+			goto end;
+		}
+
+		switch_copy_string(np, nonce, nplen);
+		ret = AUTH_FORBIDDEN;
+
+		if (reg_count) {
+			*reg_count = last_nc + 1;
+		}
+	} else if (zstr(np)) {
 		nonce_cb_t cb = { 0 };
 		long nc_long = 0;
 
@@ -3017,11 +3848,14 @@ auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 #else
 #define	LL_FMT "l"
 #endif
-		sql = switch_mprintf("update sip_authentication set expires='%" LL_FMT "u',last_nc=%lu where nonce='%s'",
-							 switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : DEFAULT_NONCE_TTL) + exptime, ncl, nonce);
+		/* stateless nonces already recorded their nc when they were checked */
+		if (!sofia_test_pflag(profile, PFLAG_STATELESS_NONCE)) {
+			sql = switch_mprintf("update sip_authentication set expires='%" LL_FMT "u',last_nc=%lu where nonce='%s'",
+								 switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : DEFAULT_NONCE_TTL) + exptime, ncl, nonce);
 
-		switch_assert(sql != NULL);
-		sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+			switch_assert(sql != NULL);
+			sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+		}
 
 		if (ret == AUTH_OK)
 			ret = AUTH_RENEWED;
@@ -164,13 +164,200 @@ static switch_status_t native_file_file_get_string(switch_file_handle_t *handle,
 	return SWITCH_STATUS_FALSE;
 }
 
-/* Registration */
+/* Sibling generation */
 
 static char *supported_formats[SWITCH_MAX_CODECS + 1] = { 0 };
 
+/* encode src into <src minus extension>.<iananame> for playback without any codec work */
+static switch_status_t native_file_encode(const char *src, const char *codec_name, switch_memory_pool_t *pool, switch_stream_handle_t *stream)
+{
+	switch_codec_t codec = { 0 };
+	switch_file_handle_t fh = { 0 };
+	const switch_codec_implementation_t *impl;
+	int16_t decoded[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	uint8_t encoded[SWITCH_RECOMMENDED_BUFFER_SIZE];
+	switch_file_t *out = NULL;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	char *dst, *tmp, *ext, *base;
+	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	uint32_t frames = 0;
+	int ok = 1;
+
+	if (switch_core_codec_init(&codec, codec_name, NULL, 0, 20, 1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE, NULL, pool) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR %s: can't load codec %s\n", src, codec_name);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	impl = codec.implementation;
+
+	/* a native file is just frames glued together, that only works when every frame has the same size */
+	if (!impl->encoded_bytes_per_packet) {
+		stream->write_function(stream, "-ERR %s: %s has no fixed frame size\n", src, impl->iananame);
+		goto end;
+	}
+
+	dst = switch_core_strdup(pool, src);
+	if ((ext = strrchr(dst, '.'))) {
+		*ext = '\0';
+	}
+	dst = switch_core_sprintf(pool, "%s.%s", dst, impl->iananame);
+
+	if (!strcmp(dst, src)) {
+		goto end;
+	}
+
+	/* encode next to the final name and rename at the end so playback never sees a partial file,
+	   the leading dot keeps a directory run from picking it up as a source */
+	base = strrchr(dst, *SWITCH_PATH_SEPARATOR);
+	base = base ? base + 1 : dst;
+	tmp = switch_core_sprintf(pool, "%.*s.%s.%s.tmp", (int) (base - dst), dst, base, switch_uuid_str(uuid_str, sizeof(uuid_str)));
+
+	if (switch_core_file_open(&fh, src, 1, impl->actual_samples_per_second,
+							  SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT | SWITCH_FILE_NO_CACHE, NULL) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR %s: can't open\n", src);
+		goto end;
+	}
+
+	if (switch_file_open(&out, tmp, SWITCH_FOPEN_WRITE | SWITCH_FOPEN_CREATE | SWITCH_FOPEN_TRUNCATE,
+						 SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE | SWITCH_FPROT_GREAD | SWITCH_FPROT_WREAD, pool) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR %s: can't create\n", tmp);
+		switch_core_file_close(&fh);
+		goto end;
+	}
+
+	for (;;) {
+		switch_size_t len = impl->samples_per_packet;
+		uint32_t elen = sizeof(encoded), rate = impl->actual_samples_per_second;
+		unsigned int flag = 0;
+
+		if (switch_core_file_read(&fh, decoded, &len) != SWITCH_STATUS_SUCCESS || !len) {
+			break;
+		}
+
+		/* pad the last frame with silence so every frame is whole */
+		if (len < impl->samples_per_packet) {
+			memset(decoded + len, 0, (impl->samples_per_packet - len) * 2);
+		}
+
+		if (switch_core_codec_encode(&codec, NULL, decoded, impl->decoded_bytes_per_packet, impl->actual_samples_per_second,
+									 encoded, &elen, &rate, &flag) != SWITCH_STATUS_SUCCESS) {
+			stream->write_function(stream, "-ERR %s: encoder error\n", src);
+			ok = 0;
+			break;
+		}
+
+		len = elen;
+		if (switch_file_write(out, encoded, &len) != SWITCH_STATUS_SUCCESS || len != elen) {
+			stream->write_function(stream, "-ERR %s: write error\n", dst);
+			ok = 0;
+			break;
+		}
+		frames++;
+	}
+
+	if (switch_file_close(out) != SWITCH_STATUS_SUCCESS && ok) {
+		stream->write_function(stream, "-ERR %s: write error\n", dst);
+		ok = 0;
+	}
+	switch_core_file_close(&fh);
+
+	if (ok && switch_file_rename(tmp, dst, pool) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR %s: can't rename %s\n", dst, tmp);
+		ok = 0;
+	}
+
+	if (!ok) {
+		switch_file_remove(tmp, pool);
+		goto end;
+	}
+
+	stream->write_function(stream, "+OK %s %u frames\n", dst, frames);
+	status = SWITCH_STATUS_SUCCESS;
+
+  end:
+
+	switch_core_codec_destroy(&codec);
+
+	return status;
+}
+
+static int native_file_is_codec_ext(const char *file)
+{
+	const char *ext = strrchr(file, '.');
+	int x;
+
+	if (!ext++) {
+		return 1;
+	}
+
+	for (x = 0; supported_formats[x]; x++) {
+		if (!strcasecmp(ext, supported_formats[x])) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+#define NATIVE_FILE_ENCODE_SYNTAX "<file>|<dir> <codec>[,<codec>...]"
+SWITCH_STANDARD_API(native_file_encode_function)
+{
+	char *mydata = NULL, *argv[2] = { 0 }, *codecs[16] = { 0 };
+	int argc = 0, ncodecs, x;
+	switch_memory_pool_t *pool;
+	switch_dir_t *dir = NULL;
+
+	if (zstr(cmd) || !(mydata = strdup(cmd)) || (argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])))) < 2) {
+		stream->write_function(stream, "-USAGE: %s\n", NATIVE_FILE_ENCODE_SYNTAX);
+		switch_safe_free(mydata);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	ncodecs = switch_separate_string(argv[1], ',', codecs, (sizeof(codecs) / sizeof(codecs[0])));
+	switch_core_new_memory_pool(&pool);
+
+	if (switch_dir_open(&dir, argv[0], pool) == SWITCH_STATUS_SUCCESS) {
+		char buf[256];
+		const char *fname;
+
+		while ((fname = switch_dir_next_file(dir, buf, sizeof(buf)))) {
+			char *path;
+
+			/* skip the siblings themselves */
+			if (*fname == '.' || native_file_is_codec_ext(fname)) {
+				continue;
+			}
+
+			path = switch_core_sprintf(pool, "%s%s%s", argv[0], SWITCH_PATH_SEPARATOR, fname);
+
+			if (switch_directory_exists(path, pool) == SWITCH_STATUS_SUCCESS) {
+				continue;
+			}
+
+			for (x = 0; x < ncodecs; x++) {
+				native_file_encode(path, codecs[x], pool, stream);
+			}
+		}
+
+		switch_dir_close(dir);
+	} else {
+		for (x = 0; x < ncodecs; x++) {
+			native_file_encode(argv[0], codecs[x], pool, stream);
+		}
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+	switch_safe_free(mydata);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* Registration */
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_native_file_load)
 {
 	switch_file_interface_t *file_interface;
+	switch_api_interface_t *api_interface;
 
 	const switch_codec_implementation_t *codecs[SWITCH_MAX_CODECS];
 	uint32_t num_codecs = switch_loadable_module_get_codecs(codecs, sizeof(codecs) / sizeof(codecs[0]));
@@ -193,6 +380,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_native_file_load)
 	file_interface->file_set_string = native_file_file_set_string;
 	file_interface->file_get_string = native_file_file_get_string;
 
+	SWITCH_ADD_API(api_interface, "native_file_encode", "Pre-encode prompts into per codec native files", native_file_encode_function, NATIVE_FILE_ENCODE_SYNTAX);
+
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -668,6 +668,21 @@ SWITCH_DECLARE(switch_status_t) switch_thread_create(switch_thread_t ** new_thre
 	return apr_thread_create(new_thread, attr, func, data, cont);
 }
 
+SWITCH_DECLARE(switch_status_t) switch_threadkey_private_create(switch_threadkey_t ** key, void (*dest) (void *), switch_memory_pool_t *pool)
+{
+	return apr_threadkey_private_create(key, dest, pool);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_threadkey_private_get(void **new_mem, switch_threadkey_t *key)
+{
+	return apr_threadkey_private_get(new_mem, key);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_threadkey_private_set(void *priv, switch_threadkey_t *key)
+{
+	return apr_threadkey_private_set(priv, key);
+}
+
 /* socket stubs */
 
 SWITCH_DECLARE(switch_status_t) switch_os_sock_get(switch_os_socket_t *thesock, switch_socket_t *sock)
@@ -1211,6 +1226,34 @@ SWITCH_DECLARE(void) switch_atomic_set(volatile switch_atomic_t *mem, uint32_t v
 #endif
 }
 
+SWITCH_DECLARE(uint32_t) switch_atomic_read_acquire(volatile switch_atomic_t *mem)
+{
+#if defined(__ATOMIC_ACQUIRE)
+	return __atomic_load_n((volatile uint32_t *) mem, __ATOMIC_ACQUIRE);
+#elif defined(WIN32)
+	uint32_t val = *(volatile uint32_t *) mem;
+	MemoryBarrier();
+	return val;
+#else
+	uint32_t val = *(volatile uint32_t *) mem;
+	__sync_synchronize();
+	return val;
+#endif
+}
+
+SWITCH_DECLARE(void) switch_atomic_set_release(volatile switch_atomic_t *mem, uint32_t val)
+{
+#if defined(__ATOMIC_RELEASE)
+	__atomic_store_n((volatile uint32_t *) mem, val, __ATOMIC_RELEASE);
+#elif defined(WIN32)
+	MemoryBarrier();
+	*(volatile uint32_t *) mem = val;
+#else
+	__sync_synchronize();
+	*(volatile uint32_t *) mem = val;
+#endif
+}
+
 SWITCH_DECLARE(void) switch_atomic_add(volatile switch_atomic_t *mem, uint32_t val)
 {
 #ifdef apr_atomic_t
@@ -1681,6 +1681,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	switch_console_init(runtime.memory_pool);
 	switch_event_init(runtime.memory_pool);
 	switch_channel_global_init(runtime.memory_pool);
+	switch_ivr_record_async_init(runtime.memory_pool);
 
 	if (switch_xml_init(runtime.memory_pool, err) != SWITCH_STATUS_SUCCESS) {
 		apr_terminate();
@@ -1701,6 +1702,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 
 	switch_load_core_config("switch.conf");
 
+	switch_core_recovery_journal_init();
+
 	switch_core_state_machine_init(runtime.memory_pool);
 
 	if (switch_core_sqldb_start(runtime.memory_pool, switch_test_flag((&runtime), SCF_USE_SQL) ? SWITCH_TRUE : SWITCH_FALSE) != SWITCH_STATUS_SUCCESS) {
@@ -2023,6 +2026,26 @@ static void switch_load_core_config(const char *file)
 				} else if (!strcasecmp(var, "rtp-enable-zrtp")) {
 					switch_core_set_variable("zrtp_enabled", val);
 #endif
+				} else if (!strcasecmp(var, "prompt-cache-dir") && !zstr(val)) {
+					runtime.prompt_cache_dir = switch_core_strdup(runtime.memory_pool, val);
+				} else if (!strcasecmp(var, "prompt-cache-max-seconds") && !zstr(val)) {
+					runtime.prompt_cache_max_sec = (uint32_t) atoi(val);
+				} else if (!strcasecmp(var, "prompt-cache-max-mb") && !zstr(val)) {
+					runtime.prompt_cache_max_mb = (uint32_t) atoi(val);
+				} else if (!strcasecmp(var, "prompt-cache-max-entries") && !zstr(val)) {
+					runtime.prompt_cache_max_entries = (uint32_t) atoi(val);
+				} else if (!strcasecmp(var, "recovery-journal") && !zstr(val)) {
+					runtime.recovery_journal = switch_core_strdup(runtime.memory_pool, val);
+				} else if (!strcasecmp(var, "recovery-journal-size-mb") && !zstr(val)) {
+					runtime.recovery_journal_size_mb = (uint32_t) atoi(val);
+				} else if (!strcasecmp(var, "recovery-journal-listen") && !zstr(val)) {
+					runtime.recovery_journal_listen = switch_core_strdup(runtime.memory_pool, val);
+				} else if (!strcasecmp(var, "recovery-journal-standby") && !zstr(val)) {
+					runtime.recovery_journal_standby = switch_core_strdup(runtime.memory_pool, val);
+				} else if (!strcasecmp(var, "recovery-journal-acl") && !zstr(val)) {
+					runtime.recovery_journal_acl = switch_core_strdup(runtime.memory_pool, val);
+				} else if (!strcasecmp(var, "recovery-journal-secret") && !zstr(val)) {
+					runtime.recovery_journal_secret = switch_core_strdup(runtime.memory_pool, val);
                 } else if (!strcasecmp(var, "switchname") && !zstr(val)) {
 					runtime.switchname = switch_core_strdup(runtime.memory_pool, val);
                     switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Set switchname to %s\n", runtime.switchname);
@@ -2606,6 +2629,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 	if (switch_test_flag((&runtime), SCF_USE_SQL)) {
 		switch_core_sqldb_stop();
 	}
+	switch_core_recovery_journal_shutdown();
 	switch_scheduler_task_thread_stop();
 
 	switch_rtp_shutdown();
@@ -2614,6 +2638,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 		switch_nat_shutdown();
 	}
 	switch_xml_destroy();
+	switch_ivr_record_async_shutdown();
 	switch_core_session_uninit();
 	switch_console_shutdown();
 	switch_channel_global_uninit();
@@ -50,6 +50,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 	char *fp = NULL;
 	switch_event_t *params = NULL;
 	int to = 0;
+	int cached = 0;
+	const char *orig_file_path = NULL;
 
 	if (switch_test_flag(fh, SWITCH_FILE_OPEN)) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Handle already open\n");
@@ -105,6 +107,17 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 		goto fail;
 	}
 
+  resolve:
+
+	/* plain prompts opened for playback go through the prompt cache when it is enabled */
+	if (!cached && (flags & SWITCH_FILE_FLAG_READ) && (flags & SWITCH_FILE_PROMPT) && channels <= 1 &&
+		!(flags & (SWITCH_FILE_NATIVE | SWITCH_FILE_DATA_RAW | SWITCH_FILE_NOMUX | SWITCH_FILE_NO_CACHE)) &&
+		switch_core_prompt_cache_ready() && !strstr(file_path, SWITCH_URL_SEPARATOR)) {
+		orig_file_path = file_path;
+		file_path = switch_core_sprintf(fh->memory_pool, "prompt_cache%s%s", SWITCH_URL_SEPARATOR, file_path);
+		cached = 1;
+	}
+
 	if ((rhs = strstr(file_path, SWITCH_URL_SEPARATOR))) {
 		switch_copy_string(stream_name, file_path, (rhs + 1) - file_path);
 		ext = stream_name;
@@ -186,6 +199,16 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 	}
 
 	if ((status = fh->file_interface->file_open(fh, file_path)) != SWITCH_STATUS_SUCCESS) {
+		if (cached == 1) {
+			/* not cacheable (too long, unreadable ...), open it the normal way */
+			UNPROTECT_INTERFACE(fh->file_interface);
+			fh->file_interface = NULL;
+			file_path = orig_file_path;
+			is_stream = 0;
+			cached = -1;
+			goto resolve;
+		}
+
 		if (fh->spool_path) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Spool dir is set.  Make sure [%s] is also a valid path\n", fh->spool_path);
 		}
@@ -595,6 +618,55 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_truncate(switch_file_handle_t *
 
 }
 
+static switch_bool_t file_is_regular(const char *path)
+{
+	struct stat st;
+
+	return (!stat(path, &st) && S_ISREG(st.st_mode)) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+/* mod_sndfile plays <dir>/<rate>/<file> when it exists, then the highest rate directory it finds, then the
+   plain path; resolve the same way so callers look at the file that would actually be played */
+SWITCH_DECLARE(char *) switch_core_file_resolve_rate_path(const char *path, uint32_t rate)
+{
+	static const uint32_t rates[4] = { 8000, 16000, 32000, 48000 };
+	switch_file_interface_t *file_interface;
+	const char *ext, *last;
+	char *alt;
+	int sndfile = 0, i;
+
+	if ((ext = strrchr(path, '.')) && (file_interface = switch_loadable_module_get_file_interface(ext + 1))) {
+		sndfile = !strcmp(file_interface->interface_name, "mod_sndfile");
+		UNPROTECT_INTERFACE(file_interface);
+	}
+
+	if (!sndfile || !(last = strrchr(path, *SWITCH_PATH_SEPARATOR))) {
+		return strdup(path);
+	}
+#ifdef WIN32
+	if (strrchr(last, '\\')) {
+		last = strrchr(last, '\\');
+	}
+#endif
+	last++;
+
+	alt = switch_mprintf("%.*s%u%s%s", (int) (last - path), path, rate, SWITCH_PATH_SEPARATOR, last);
+	if (file_is_regular(alt)) {
+		return alt;
+	}
+	free(alt);
+
+	for (i = 3; i >= 0; i--) {
+		alt = switch_mprintf("%.*s%u%s%s", (int) (last - path), path, rates[i], SWITCH_PATH_SEPARATOR, last);
+		if (file_is_regular(alt)) {
+			return alt;
+		}
+		free(alt);
+	}
+
+	return strdup(path);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_file_close(switch_file_handle_t *fh)
 {
 	switch_status_t status;
@@ -470,6 +470,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 			switch_set_flag(session, SSF_WARN_TRANSCODE);
 		}
 
+		if (!is_cng && !do_bugs && !do_resample && !session->bugs && !session->plc && !session->read_resampler && read_frame->codec &&
+			switch_core_g711_transcode(read_frame->codec->implementation, session->read_codec->implementation, read_frame, &session->enc_read_frame)) {
+			*frame = &session->enc_read_frame;
+			goto done;
+		}
+
 		if (read_frame->codec || is_cng) {
 			session->raw_read_frame.datalen = session->raw_read_frame.buflen;
 
@@ -697,18 +703,26 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 			switch_media_bug_t *bp;
 			switch_bool_t ok = SWITCH_TRUE;
 			int prune = 0;
+			switch_size_t mark = 0;
 			switch_thread_rwlock_rdlock(session->bug_rwlock);
 
+			if (session->bug_read_ring) {
+				mark = switch_core_media_bug_ring_push(session->bug_read_ring, read_frame->data, read_frame->datalen);
+			}
+
 			for (bp = session->bugs; bp; bp = bp->next) {
 				if (switch_channel_test_flag(session->channel, CF_PAUSE_BUGS) && !switch_core_media_bug_test_flag(bp, SMBF_NO_PAUSE)) {
+					switch_core_media_bug_ring_skip(bp, SMBF_READ_STREAM, mark);
 					continue;
 				}
 
 				if (!switch_channel_test_flag(session->channel, CF_ANSWERED) && switch_core_media_bug_test_flag(bp, SMBF_ANSWER_REQ)) {
+					switch_core_media_bug_ring_skip(bp, SMBF_READ_STREAM, mark);
 					continue;
 				}
 
 				if (!switch_channel_test_flag(session->channel, CF_BRIDGED) && switch_core_media_bug_test_flag(bp, SMBF_BRIDGE_REQ)) {
+					switch_core_media_bug_ring_skip(bp, SMBF_READ_STREAM, mark);
 					continue;
 				}
 
@@ -725,15 +739,17 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 
 						memcpy(data, read_frame->data, read_frame->datalen);
 						switch_unmerge_sln((int16_t *)data, bytes, bp->read_demux_frame->data, bytes);
-						switch_buffer_write(bp->raw_read_buffer, data, read_frame->datalen);
+						switch_core_media_bug_ring_deliver(bp, SMBF_READ_STREAM, mark, data, read_frame->datalen, SWITCH_TRUE);
 					} else {
-						switch_buffer_write(bp->raw_read_buffer, read_frame->data, read_frame->datalen);
+						switch_core_media_bug_ring_deliver(bp, SMBF_READ_STREAM, mark, read_frame->data, read_frame->datalen, SWITCH_FALSE);
 					}
 
 					if (bp->callback) {
 						ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_READ);
 					}
 					switch_mutex_unlock(bp->read_mutex);
+				} else {
+					switch_core_media_bug_ring_skip(bp, SMBF_READ_STREAM, mark);
 				}
 
 				if ((bp->stop_time && bp->stop_time <= switch_epoch_time_now(NULL)) || ok == SWITCH_FALSE) {
@@ -1124,6 +1140,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 		switch_set_flag(session, SSF_WARN_TRANSCODE);
 	}
 
+	if (!do_bugs && !do_resample && !ptime_mismatch && !session->bugs && !session->write_resampler &&
+		switch_core_g711_transcode(frame->codec->implementation, session->write_codec->implementation, frame, &session->enc_write_frame)) {
+		session->enc_write_frame.codec = session->write_codec;
+		write_frame = &session->enc_write_frame;
+		do_write = TRUE;
+		goto done;
+	}
+
 	if (frame->codec) {
 		session->raw_write_frame.datalen = session->raw_write_frame.buflen;
 		frame->codec->cur_frame = frame;
@@ -1233,19 +1257,29 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 	if (session->bugs) {
 		switch_media_bug_t *bp;
 		int prune = 0;
+		switch_size_t mark = 0;
+		switch_bool_t replaced = SWITCH_FALSE;
 
 		switch_thread_rwlock_rdlock(session->bug_rwlock);
+
+		if (session->bug_write_ring) {
+			mark = switch_core_media_bug_ring_push(session->bug_write_ring, write_frame->data, write_frame->datalen);
+		}
+
 		for (bp = session->bugs; bp; bp = bp->next) {
 			switch_bool_t ok = SWITCH_TRUE;
 			if (!bp->ready) {
+				switch_core_media_bug_ring_skip(bp, SMBF_WRITE_STREAM, mark);
 				continue;
 			}
 
 			if (switch_channel_test_flag(session->channel, CF_PAUSE_BUGS) && !switch_core_media_bug_test_flag(bp, SMBF_NO_PAUSE)) {
+				switch_core_media_bug_ring_skip(bp, SMBF_WRITE_STREAM, mark);
 				continue;
 			}
 
 			if (!switch_channel_test_flag(session->channel, CF_ANSWERED) && switch_core_media_bug_test_flag(bp, SMBF_ANSWER_REQ)) {
+				switch_core_media_bug_ring_skip(bp, SMBF_WRITE_STREAM, mark);
 				continue;
 			}
 
@@ -1255,9 +1289,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 			}
 
 			if (switch_test_flag(bp, SMBF_WRITE_STREAM)) {
-				switch_mutex_lock(bp->write_mutex);
-				switch_buffer_write(bp->raw_write_buffer, write_frame->data, write_frame->datalen);
-				switch_mutex_unlock(bp->write_mutex);
+				/* the ring holds the frame as it was before any replace bug ahead of this one touched it */
+				switch_core_media_bug_ring_deliver(bp, SMBF_WRITE_STREAM, mark, write_frame->data, write_frame->datalen, replaced);
 				
 				if (bp->callback) {
 					ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_WRITE);
@@ -1272,6 +1305,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 					if ((ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_WRITE_REPLACE)) == SWITCH_TRUE) {
 						write_frame = bp->write_replace_frame_out;
 					}
+					replaced = SWITCH_TRUE;
 				}
 			}
 
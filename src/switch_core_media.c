@@ -189,9 +189,58 @@ struct switch_media_handle_s {
 
 	char *msid;
 	char *cname;
-
 };
 
+/* Offer templates
+
+   The codec part of an m=audio block (profile, payload list, rtpmap and fmtp lines)
+   only depends on the codec list and a few flags, and most calls use one of a handful
+   of codec lists.  generate_m keeps what it built keyed by all of that and copies it
+   for the next offer, the port, ip, crypto and ice lines are still written per call.
+   Every offer is on a new handle, so the key is hashed straight from the codec
+   fields without allocating and a hit is checked field by field. */
+
+#define SDP_TEMPLATE_MAX 512
+#define SDP_TEMPLATE_BUCKETS 64
+
+typedef struct sdp_template_codec_s {
+	const char *iananame;
+	const char *fmtp;
+	uint32_t rate;
+	uint32_t ptime;
+	int type;
+	int pt;
+	int channels;
+} sdp_template_codec_t;
+
+typedef struct sdp_template_key_s {
+	const char *profile;
+	int cur_ptime;
+	int te;
+	int dtmf_2833;
+	int liberal_dtmf;
+	int webrtc;
+	int cng;
+	int verbose;
+	int num_codecs;
+	sdp_template_codec_t *codecs;
+	uint32_t sum;
+} sdp_template_key_t;
+
+typedef struct sdp_template_s {
+	sdp_template_key_t key;
+	char *body;
+	int ptime;
+	struct sdp_template_s *next;
+} sdp_template_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	sdp_template_t *buckets[SDP_TEMPLATE_BUCKETS];
+	uint32_t count;
+} sdp_templates;
+
 static int get_channels(const switch_codec_implementation_t *imp)
 {
 	if (!strcasecmp(imp->iananame, "opus")) {
@@ -955,6 +1004,7 @@ static void set_stats(switch_core_session_t *session, switch_media_type_t type,
 		add_stat(stats->inbound.packet_count, "in_packet_count");
 		add_stat(stats->inbound.media_packet_count, "in_media_packet_count");
 		add_stat(stats->inbound.skip_packet_count, "in_skip_packet_count");
+		add_stat(stats->inbound.relay_packet_count, "in_relay_packet_count");
 		add_stat(stats->inbound.jb_packet_count, "in_jb_packet_count");
 		add_stat(stats->inbound.dtmf_packet_count, "in_dtmf_packet_count");
 		add_stat(stats->inbound.cng_packet_count, "in_cng_packet_count");
@@ -4392,6 +4442,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_activate_rtp(switch_core_sessi
 				if (maxqlen < qlen) {
 					maxqlen = qlen * 5;
 				}
+				if (switch_true(switch_channel_get_variable(session->channel, "rtp_jitter_buffer_adaptive"))) {
+					switch_rtp_set_flag(a_engine->rtp_session, SWITCH_RTP_FLAG_ADAPTIVE_JB);
+				}
+
 				if (switch_rtp_activate_jitter_buffer(a_engine->rtp_session, qlen, maxqlen,
 													  a_engine->read_impl.samples_per_packet, 
 													  a_engine->read_impl.samples_per_second, max_drift) == SWITCH_STATUS_SUCCESS) {
@@ -4854,6 +4908,124 @@ static const char *get_media_profile_name(switch_core_session_t *session, int se
 }
 
 //?
+static uint32_t sdp_template_hash(uint32_t sum, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len--) {
+		sum = (sum ^ *p++) * 16777619;
+	}
+
+	return sum;
+}
+
+/* fills key from what generate_m is about to write, key->codecs must have room for every codec */
+static void sdp_template_key(switch_core_session_t *session, switch_media_handle_t *smh, int secure, int cur_ptime,
+							 int use_cng, int cng_type, sdp_template_key_t *key)
+{
+	uint32_t sum = 2166136261u;
+	size_t len;
+	int i;
+
+	key->profile = get_media_profile_name(session, secure);
+	key->cur_ptime = cur_ptime;
+	key->te = smh->mparams->te;
+	key->dtmf_2833 = smh->mparams->dtmf_type == DTMF_2833;
+	key->liberal_dtmf = switch_media_handle_test_media_flag(smh, SCMF_LIBERAL_DTMF) || switch_channel_test_flag(session->channel, CF_LIBERAL_DTMF);
+	key->webrtc = !!switch_channel_test_flag(session->channel, CF_WEBRTC);
+	key->cng = (!switch_media_handle_test_media_flag(smh, SCMF_SUPPRESS_CNG) && cng_type && use_cng) ? cng_type : 0;
+	key->verbose = !!switch_channel_test_flag(session->channel, CF_VERBOSE_SDP);
+	key->num_codecs = smh->mparams->num_codecs;
+
+	sum = sdp_template_hash(sum, key->profile, strlen(key->profile));
+	sum = sdp_template_hash(sum, &key->cur_ptime, (char *) &key->num_codecs + sizeof(key->num_codecs) - (char *) &key->cur_ptime);
+
+	for (i = 0; i < key->num_codecs; i++) {
+		const switch_codec_implementation_t *imp = smh->codecs[i];
+		sdp_template_codec_t *c = &key->codecs[i];
+
+		c->iananame = imp->iananame;
+		c->fmtp = switch_str_nil(imp->fmtp);
+		c->rate = imp->samples_per_second;
+		c->ptime = imp->microseconds_per_packet;
+		c->type = imp->codec_type;
+		c->pt = smh->ianacodes[i];
+		c->channels = get_channels(imp);
+
+		/* the fmtp only by length, sdp_template_match compares it in full */
+		len = strlen(c->fmtp);
+		sum = sdp_template_hash(sum, c->iananame, strlen(c->iananame));
+		sum = sdp_template_hash(sum, &len, sizeof(len));
+		sum = sdp_template_hash(sum, &c->rate, (char *) &c->channels + sizeof(c->channels) - (char *) &c->rate);
+	}
+
+	key->sum = sum;
+}
+
+static int sdp_template_match(const sdp_template_key_t *a, const sdp_template_key_t *b)
+{
+	int i;
+
+	if (a->sum != b->sum || a->cur_ptime != b->cur_ptime || a->te != b->te || a->dtmf_2833 != b->dtmf_2833 ||
+		a->liberal_dtmf != b->liberal_dtmf || a->webrtc != b->webrtc || a->cng != b->cng || a->verbose != b->verbose ||
+		a->num_codecs != b->num_codecs || strcmp(a->profile, b->profile)) {
+		return 0;
+	}
+
+	for (i = 0; i < a->num_codecs; i++) {
+		const sdp_template_codec_t *x = &a->codecs[i], *y = &b->codecs[i];
+
+		if (x->rate != y->rate || x->ptime != y->ptime || x->type != y->type || x->pt != y->pt || x->channels != y->channels ||
+			strcmp(x->iananame, y->iananame) || strcmp(x->fmtp, y->fmtp)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* call with sdp_templates.mutex held */
+static sdp_template_t *sdp_template_find(const sdp_template_key_t *key)
+{
+	sdp_template_t *tpl;
+
+	for (tpl = sdp_templates.buckets[key->sum % SDP_TEMPLATE_BUCKETS]; tpl; tpl = tpl->next) {
+		if (sdp_template_match(&tpl->key, key)) {
+			break;
+		}
+	}
+
+	return tpl;
+}
+
+static void sdp_template_store(const sdp_template_key_t *key, const char *body, int ptime)
+{
+	sdp_template_t *tpl;
+	int i;
+
+	switch_mutex_lock(sdp_templates.mutex);
+	if (sdp_templates.count < SDP_TEMPLATE_MAX && !sdp_template_find(key)) {
+		tpl = switch_core_alloc(sdp_templates.pool, sizeof(*tpl));
+		tpl->key = *key;
+		tpl->key.profile = switch_core_strdup(sdp_templates.pool, key->profile);
+		tpl->key.codecs = switch_core_alloc(sdp_templates.pool, sizeof(*key->codecs) * (key->num_codecs ? key->num_codecs : 1));
+
+		/* copied, the implementations go away with their module */
+		for (i = 0; i < key->num_codecs; i++) {
+			tpl->key.codecs[i] = key->codecs[i];
+			tpl->key.codecs[i].iananame = switch_core_strdup(sdp_templates.pool, key->codecs[i].iananame);
+			tpl->key.codecs[i].fmtp = switch_core_strdup(sdp_templates.pool, key->codecs[i].fmtp);
+		}
+
+		tpl->body = switch_core_strdup(sdp_templates.pool, body);
+		tpl->ptime = ptime;
+		tpl->next = sdp_templates.buckets[key->sum % SDP_TEMPLATE_BUCKETS];
+		sdp_templates.buckets[key->sum % SDP_TEMPLATE_BUCKETS] = tpl;
+		sdp_templates.count++;
+	}
+	switch_mutex_unlock(sdp_templates.mutex);
+}
+
 static void generate_m(switch_core_session_t *session, char *buf, size_t buflen, 
 					   switch_port_t port, const char *family, const char *ip,
 					   int cur_ptime, const char *append_audio, const char *sr, int use_cng, int cng_type, switch_event_t *map, int secure)
@@ -4866,6 +5038,10 @@ static void generate_m(switch_core_session_t *session, char *buf, size_t buflen,
 	const char *local_sdp_audio_zrtp_hash;
 	switch_media_handle_t *smh;
 	switch_rtp_engine_t *a_engine;
+	sdp_template_t *tpl = NULL;
+	sdp_template_codec_t tpl_codecs[SWITCH_MAX_CODECS];
+	sdp_template_key_t tpl_key = { 0 };
+	char *body;
 
 	switch_assert(session);
 
@@ -4878,8 +5054,25 @@ static void generate_m(switch_core_session_t *session, char *buf, size_t buflen,
 	//switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "m=audio %d RTP/%sAVP%s", 
 	//port, secure ? "S" : "", switch_channel_test_flag(session->channel, CF_WEBRTC) ? "F" : "");
 
-	switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "m=audio %d %s", port, get_media_profile_name(session, secure));
-	
+	switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "m=audio %d ", port);
+	body = buf + strlen(buf);
+
+	if (!map && sdp_templates.pool) {
+		tpl_key.codecs = tpl_codecs;
+		sdp_template_key(session, smh, secure, cur_ptime, use_cng, cng_type, &tpl_key);
+
+		switch_mutex_lock(sdp_templates.mutex);
+		tpl = sdp_template_find(&tpl_key);
+		switch_mutex_unlock(sdp_templates.mutex);
+	}
+
+	if (tpl) {
+		switch_copy_string(body, tpl->body, buflen - strlen(buf));
+		ptime = tpl->ptime;
+		goto codecs_done;
+	}
+
+	switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "%s", get_media_profile_name(session, secure));
 
 	for (i = 0; i < smh->mparams->num_codecs; i++) {
 		const switch_codec_implementation_t *imp = smh->codecs[i];
@@ -5005,6 +5198,12 @@ static void generate_m(switch_core_session_t *session, char *buf, size_t buflen,
 
 	}
 
+	if (tpl_key.codecs) {
+		sdp_template_store(&tpl_key, body, ptime);
+	}
+
+ codecs_done:
+
 	if (!zstr(a_engine->local_dtls_fingerprint.type) && secure) {
 		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=fingerprint:%s %s\n", a_engine->local_dtls_fingerprint.type, 
 						a_engine->local_dtls_fingerprint.str);
@@ -6645,6 +6844,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_receive_message(switch_core_se
 					if (maxqlen < qlen) {
 						maxqlen = qlen * 5;
 					}
+					if (switch_true(switch_channel_get_variable(session->channel, "rtp_jitter_buffer_adaptive"))) {
+						switch_rtp_set_flag(a_engine->rtp_session, SWITCH_RTP_FLAG_ADAPTIVE_JB);
+					}
+
 					if (switch_rtp_activate_jitter_buffer(a_engine->rtp_session, qlen, maxqlen,
 														  a_engine->read_impl.samples_per_packet, 
 														  a_engine->read_impl.samples_per_second, max_drift) == SWITCH_STATUS_SUCCESS) {
@@ -7169,6 +7372,23 @@ SWITCH_DECLARE(stfu_instance_t *) switch_core_media_get_jb(switch_core_session_t
 	return NULL;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_core_media_set_relay(switch_core_session_t *session, switch_core_session_t *peer_session, switch_media_type_t type)
+{
+	switch_media_handle_t *smh, *peer_smh = NULL;
+
+	switch_assert(session);
+
+	if (!(smh = session->media_handle) || !smh->engines[type].rtp_session) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (peer_session && (!(peer_smh = peer_session->media_handle) || !switch_rtp_ready(peer_smh->engines[type].rtp_session))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return switch_rtp_set_relay(smh->engines[type].rtp_session, peer_smh ? peer_smh->engines[type].rtp_session : NULL);
+}
+
 
 //?
 SWITCH_DECLARE(void) switch_core_media_set_sdp_codec_string(switch_core_session_t *session, const char *r_sdp)
@@ -7760,11 +7980,18 @@ SWITCH_DECLARE (void) switch_core_media_recover_session(switch_core_session_t *s
 SWITCH_DECLARE(void) switch_core_media_init(void)
 {
 	switch_core_gen_certs(DTLS_SRTP_FNAME);	
+
+	switch_core_new_memory_pool(&sdp_templates.pool);
+	switch_mutex_init(&sdp_templates.mutex, SWITCH_MUTEX_NESTED, sdp_templates.pool);
 }
 
 SWITCH_DECLARE(void) switch_core_media_deinit(void)
 {
-	
+	if (sdp_templates.pool) {
+		switch_core_destroy_memory_pool(&sdp_templates.pool);
+	}
+
+	memset(&sdp_templates, 0, sizeof(sdp_templates));
 }
 
 
@@ -35,6 +35,242 @@
 #include "switch.h"
 #include "private/switch_core_pvt.h"
 
+#define MAX_BUG_BUFFER 1024 * 512
+
+
+static switch_media_bug_ring_t *media_bug_ring_create(switch_core_session_t *session, switch_size_t bytes)
+{
+	switch_media_bug_ring_t *ring;
+	switch_size_t size = SWITCH_RECOMMENDED_BUFFER_SIZE * 4;
+
+	while (size < bytes * SWITCH_BUG_RING_FRAMES) {
+		size <<= 1;
+	}
+
+	ring = switch_core_session_alloc(session, sizeof(*ring));
+	ring->data = switch_core_session_alloc(session, size);
+	ring->size = size;
+	switch_mutex_init(&ring->mutex, SWITCH_MUTEX_NESTED, session->pool);
+
+	return ring;
+}
+
+/* caller holds ring->mutex, pos..pos+len must still be inside the ring */
+static void media_bug_ring_copy(switch_media_bug_ring_t *ring, switch_size_t pos, void *data, switch_size_t len)
+{
+	switch_size_t off = pos & (ring->size - 1);
+	switch_size_t first = ring->size - off;
+
+	if (first > len) {
+		first = len;
+	}
+
+	memcpy(data, ring->data + off, first);
+	if (len > first) {
+		memcpy((uint8_t *) data + first, ring->data, len - first);
+	}
+}
+
+switch_size_t switch_core_media_bug_ring_push(switch_media_bug_ring_t *ring, const void *data, switch_size_t len)
+{
+	switch_size_t mark, off, first;
+
+	if (len > ring->size) {
+		len = ring->size;
+	}
+
+	switch_mutex_lock(ring->mutex);
+	mark = ring->head;
+	off = mark & (ring->size - 1);
+	first = ring->size - off;
+
+	if (first > len) {
+		first = len;
+	}
+
+	memcpy(ring->data + off, data, first);
+	if (len > first) {
+		memcpy(ring->data, (const uint8_t *) data + first, len - first);
+	}
+
+	ring->head += len;
+	switch_mutex_unlock(ring->mutex);
+
+	return mark;
+}
+
+static void media_bug_stream(switch_media_bug_t *bug, switch_media_bug_flag_t stream,
+							 switch_media_bug_ring_t **ring, switch_buffer_t ***buffer, switch_size_t **pos, switch_mutex_t **mutex)
+{
+	if (stream == SMBF_WRITE_STREAM) {
+		*ring = bug->session->bug_write_ring;
+		*buffer = &bug->raw_write_buffer;
+		*pos = &bug->write_pos;
+		*mutex = bug->write_mutex;
+	} else {
+		*ring = bug->session->bug_read_ring;
+		*buffer = &bug->raw_read_buffer;
+		*pos = &bug->read_pos;
+		*mutex = bug->read_mutex;
+	}
+}
+
+static switch_size_t media_bug_stream_inuse(switch_media_bug_t *bug, switch_media_bug_flag_t stream)
+{
+	switch_media_bug_ring_t *ring;
+	switch_buffer_t **buffer;
+	switch_size_t *pos, inuse = 0;
+	switch_mutex_t *mutex;
+
+	media_bug_stream(bug, stream, &ring, &buffer, &pos, &mutex);
+
+	switch_mutex_lock(mutex);
+	if (*buffer) {
+		inuse = switch_buffer_inuse(*buffer);
+	} else if (ring) {
+		switch_mutex_lock(ring->mutex);
+		inuse = ring->head - *pos;
+		if (inuse > ring->size) {
+			/* fell a whole ring behind, what was there is gone */
+			*pos = ring->head;
+			inuse = 0;
+		}
+		switch_mutex_unlock(ring->mutex);
+	}
+	switch_mutex_unlock(mutex);
+
+	return inuse;
+}
+
+static switch_size_t media_bug_stream_read(switch_media_bug_t *bug, switch_media_bug_flag_t stream, void *data, switch_size_t len)
+{
+	switch_media_bug_ring_t *ring;
+	switch_buffer_t **buffer;
+	switch_size_t *pos, got = 0;
+	switch_mutex_t *mutex;
+
+	media_bug_stream(bug, stream, &ring, &buffer, &pos, &mutex);
+
+	switch_mutex_lock(mutex);
+	if (*buffer) {
+		got = switch_buffer_read(*buffer, data, len);
+	} else if (ring) {
+		switch_mutex_lock(ring->mutex);
+		if (ring->head - *pos <= ring->size) {
+			got = ring->head - *pos;
+			if (got > len) {
+				got = len;
+			}
+			media_bug_ring_copy(ring, *pos, data, got);
+			*pos += got;
+		}
+		switch_mutex_unlock(ring->mutex);
+	}
+	switch_mutex_unlock(mutex);
+
+	return got;
+}
+
+static void media_bug_stream_zero(switch_media_bug_t *bug, switch_media_bug_flag_t stream)
+{
+	switch_media_bug_ring_t *ring;
+	switch_buffer_t **buffer;
+	switch_size_t *pos;
+	switch_mutex_t *mutex;
+
+	media_bug_stream(bug, stream, &ring, &buffer, &pos, &mutex);
+
+	switch_mutex_lock(mutex);
+	if (*buffer) {
+		switch_buffer_zero(*buffer);
+	} else if (ring) {
+		switch_mutex_lock(ring->mutex);
+		*pos = ring->head;
+		switch_mutex_unlock(ring->mutex);
+	}
+	switch_mutex_unlock(mutex);
+}
+
+/* move a bug off the shared ring onto its own buffer, keeping whatever it
+   had not consumed yet up to mark (the start of the current frame) */
+static void media_bug_stream_detach(switch_media_bug_t *bug, switch_media_bug_ring_t *ring, switch_buffer_t **buffer,
+									switch_size_t *pos, switch_size_t mark, switch_size_t bytes)
+{
+	uint8_t data[SWITCH_RECOMMENDED_BUFFER_SIZE];
+
+	switch_buffer_create_dynamic(buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
+
+	switch_mutex_lock(ring->mutex);
+	if (ring->head - *pos <= ring->size) {
+		while (*pos != mark) {
+			switch_size_t len = mark - *pos;
+
+			if (len > sizeof(data)) {
+				len = sizeof(data);
+			}
+			media_bug_ring_copy(ring, *pos, data, len);
+			switch_buffer_write(*buffer, data, len);
+			*pos += len;
+		}
+	}
+	switch_mutex_unlock(ring->mutex);
+}
+
+/* hand the current frame to a bug; a bug that needs different bytes than the
+   ones pushed to the ring (own) gets its private copy from here on */
+void switch_core_media_bug_ring_deliver(switch_media_bug_t *bug, switch_media_bug_flag_t stream, switch_size_t mark,
+										 const void *data, switch_size_t len, switch_bool_t own)
+{
+	switch_media_bug_ring_t *ring;
+	switch_buffer_t **buffer;
+	switch_size_t *pos;
+	switch_mutex_t *mutex;
+
+	media_bug_stream(bug, stream, &ring, &buffer, &pos, &mutex);
+
+	if (!*buffer && (!own || !ring)) {
+		return;
+	}
+
+	switch_mutex_lock(mutex);
+	if (!*buffer) {
+		media_bug_stream_detach(bug, ring, buffer, pos, mark,
+								stream == SMBF_WRITE_STREAM ? bug->write_impl.decoded_bytes_per_packet : bug->read_impl.decoded_bytes_per_packet);
+	}
+	switch_buffer_write(*buffer, data, len);
+	switch_mutex_unlock(mutex);
+}
+
+/* the bug does not get the current frame (paused, not answered ...) */
+void switch_core_media_bug_ring_skip(switch_media_bug_t *bug, switch_media_bug_flag_t stream, switch_size_t mark)
+{
+	switch_media_bug_ring_t *ring;
+	switch_buffer_t **buffer;
+	switch_size_t *pos;
+	switch_mutex_t *mutex;
+
+	if (!switch_test_flag(bug, stream)) {
+		return;
+	}
+
+	media_bug_stream(bug, stream, &ring, &buffer, &pos, &mutex);
+
+	if (*buffer || !ring) {
+		return;
+	}
+
+	switch_mutex_lock(mutex);
+	if (*pos == mark) {
+		switch_mutex_lock(ring->mutex);
+		*pos = ring->head;
+		switch_mutex_unlock(ring->mutex);
+	} else {
+		media_bug_stream_detach(bug, ring, buffer, pos, mark,
+								stream == SMBF_WRITE_STREAM ? bug->write_impl.decoded_bytes_per_packet : bug->read_impl.decoded_bytes_per_packet);
+	}
+	switch_mutex_unlock(mutex);
+}
+
 static void switch_core_media_bug_destroy(switch_media_bug_t *bug)
 {
 	switch_event_t *event = NULL;
@@ -133,16 +369,12 @@ SWITCH_DECLARE(void) switch_core_media_bug_flush(switch_media_bug_t *bug)
 
 	bug->record_pre_buffer_count = 0;
 
-	if (bug->raw_read_buffer) {
-		switch_mutex_lock(bug->read_mutex);
-		switch_buffer_zero(bug->raw_read_buffer);
-		switch_mutex_unlock(bug->read_mutex);
+	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
+		media_bug_stream_zero(bug, SMBF_READ_STREAM);
 	}
 
-	if (bug->raw_write_buffer) {
-		switch_mutex_lock(bug->write_mutex);
-		switch_buffer_zero(bug->raw_write_buffer);
-		switch_mutex_unlock(bug->write_mutex);
+	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
+		media_bug_stream_zero(bug, SMBF_WRITE_STREAM);
 	}
 
 	bug->record_frame_size = 0;
@@ -152,17 +384,13 @@ SWITCH_DECLARE(void) switch_core_media_bug_flush(switch_media_bug_t *bug)
 SWITCH_DECLARE(void) switch_core_media_bug_inuse(switch_media_bug_t *bug, switch_size_t *readp, switch_size_t *writep)
 {
 	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
-		switch_mutex_lock(bug->read_mutex);
-		*readp = bug->raw_read_buffer ? switch_buffer_inuse(bug->raw_read_buffer) : 0;
-		switch_mutex_unlock(bug->read_mutex);
+		*readp = media_bug_stream_inuse(bug, SMBF_READ_STREAM);
 	} else {
 		*readp = 0;
 	}
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_mutex_lock(bug->write_mutex);
-		*writep = bug->raw_write_buffer ? switch_buffer_inuse(bug->raw_write_buffer) : 0;
-		switch_mutex_unlock(bug->write_mutex);
+		*writep = media_bug_stream_inuse(bug, SMBF_WRITE_STREAM);
 	} else {
 		*writep = 0;
 	}
@@ -199,11 +427,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if ((!bug->raw_read_buffer && (!bug->raw_write_buffer || !switch_test_flag(bug, SMBF_WRITE_STREAM)))) {
+	if (!switch_test_flag(bug, SMBF_READ_STREAM) && !switch_test_flag(bug, SMBF_READ_PING) && !switch_test_flag(bug, SMBF_WRITE_STREAM)) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, 
-				"%s Buffer Error (raw_read_buffer=%p, raw_write_buffer=%p, read=%s, write=%s)\n",
+				"%s Buffer Error (read=%s, write=%s)\n",
 			        switch_channel_get_name(bug->session->channel),
-				(void *)bug->raw_read_buffer, (void *)bug->raw_write_buffer, 
 				switch_test_flag(bug, SMBF_READ_STREAM) ? "yes" : "no",
 				switch_test_flag(bug, SMBF_WRITE_STREAM) ? "yes" : "no");
 		return SWITCH_STATUS_FALSE;
@@ -213,15 +440,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	frame->datalen = 0;
 
 	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
-		switch_mutex_lock(bug->read_mutex);
-		do_read = switch_buffer_inuse(bug->raw_read_buffer);
-		switch_mutex_unlock(bug->read_mutex);
+		do_read = media_bug_stream_inuse(bug, SMBF_READ_STREAM);
 	}
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_mutex_lock(bug->write_mutex);
-		do_write = switch_buffer_inuse(bug->raw_write_buffer);
-		switch_mutex_unlock(bug->write_mutex);
+		do_write = media_bug_stream_inuse(bug, SMBF_WRITE_STREAM);
 	}
 
 	if (bug->record_frame_size && bug->record_pre_buffer_max && (do_read || do_write) && bug->record_pre_buffer_count < bug->record_pre_buffer_max) {
@@ -291,31 +514,24 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	}
 	
 	if (do_read) {
-		switch_mutex_lock(bug->read_mutex);
-		frame->datalen = (uint32_t) switch_buffer_read(bug->raw_read_buffer, frame->data, do_read);
+		frame->datalen = (uint32_t) media_bug_stream_read(bug, SMBF_READ_STREAM, frame->data, do_read);
 		if (frame->datalen != do_read) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, "Framing Error Reading!\n");
 			switch_core_media_bug_flush(bug);
-			switch_mutex_unlock(bug->read_mutex);
 			return SWITCH_STATUS_FALSE;
 		}
-		switch_mutex_unlock(bug->read_mutex);
 	} else if (fill_read) {
 		frame->datalen = bytes;
 		memset(frame->data, 255, frame->datalen);
 	}
 
 	if (do_write) {
-		switch_assert(bug->raw_write_buffer);
-		switch_mutex_lock(bug->write_mutex);
-		datalen = (uint32_t) switch_buffer_read(bug->raw_write_buffer, bug->data, do_write);
+		datalen = (uint32_t) media_bug_stream_read(bug, SMBF_WRITE_STREAM, bug->data, do_write);
 		if (datalen != do_write) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, "Framing Error Writing!\n");
 			switch_core_media_bug_flush(bug);
-			switch_mutex_unlock(bug->write_mutex);
 			return SWITCH_STATUS_FALSE;
 		}
-		switch_mutex_unlock(bug->write_mutex);
 	} else if (fill_write) {
 		datalen = bytes;
 		memset(bug->data, 255, datalen);
@@ -399,7 +615,6 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	return SWITCH_STATUS_SUCCESS;
 }
 
-#define MAX_BUG_BUFFER 1024 * 512
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t *session,
 														  const char *function,
 														  const char *target,
@@ -504,17 +719,34 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 	}
 
 	if (switch_test_flag(bug, SMBF_READ_STREAM) || switch_test_flag(bug, SMBF_READ_PING)) {
-		switch_buffer_create_dynamic(&bug->raw_read_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
 		switch_mutex_init(&bug->read_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	}
 
-	bytes = bug->write_impl.decoded_bytes_per_packet;
-
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_buffer_create_dynamic(&bug->raw_write_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
 		switch_mutex_init(&bug->write_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	}
 
+	if (switch_test_flag(bug, SMBF_READ_STREAM) || switch_test_flag(bug, SMBF_WRITE_STREAM)) {
+		/* every stream bug on the session shares one ring per direction and starts reading at its head */
+		switch_thread_rwlock_wrlock(session->bug_rwlock);
+		if (switch_test_flag(bug, SMBF_READ_STREAM)) {
+			if (!session->bug_read_ring) {
+				session->bug_read_ring = media_bug_ring_create(session, bytes);
+			}
+			bug->read_pos = session->bug_read_ring->head;
+		}
+
+		bytes = bug->write_impl.decoded_bytes_per_packet;
+
+		if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
+			if (!session->bug_write_ring) {
+				session->bug_write_ring = media_bug_ring_create(session, bytes);
+			}
+			bug->write_pos = session->bug_write_ring->head;
+		}
+		switch_thread_rwlock_unlock(session->bug_rwlock);
+	}
+
 	if ((bug->flags & SMBF_THREAD_LOCK)) {
 		bug->thread_id = switch_thread_self();
 	}
@@ -696,7 +928,7 @@ SWITCH_DECLARE(uint32_t) switch_core_media_bug_count(switch_core_session_t *orig
 	if (orig_session->bugs) {
 		switch_thread_rwlock_rdlock(orig_session->bug_rwlock);
 		for (bp = orig_session->bugs; bp; bp = bp->next) {
-			if (!switch_test_flag(bp, SMBF_PRUNE) && !switch_test_flag(bp, SMBF_LOCK) && !strcmp(bp->function, function)) {
+			if (!switch_test_flag(bp, SMBF_PRUNE) && !switch_test_flag(bp, SMBF_LOCK) && (!function || !strcmp(bp->function, function))) {
 				x++;
 			}
 		}
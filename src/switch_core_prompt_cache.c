@@ -0,0 +1,863 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * switch_core_prompt_cache.c -- Pre-decoded prompt cache
+ *
+ * Prompts opened for playback are decoded and resampled once per rate into
+ * <prompt-cache-dir>/<md5>.pcm (a small header followed by signed linear
+ * samples) and mapped into memory, every later playback at that rate just
+ * copies out of the mapping.  The least recently played entries and their
+ * files are dropped once the cache outgrows its byte or entry limit.
+ *
+ */
+
+#include <switch.h>
+#include "private/switch_core_pvt.h"
+#include <sys/stat.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+SWITCH_MODULE_LOAD_FUNCTION(core_prompt_cache_load);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(core_prompt_cache_shutdown);
+SWITCH_MODULE_DEFINITION(CORE_PROMPT_CACHE_MODULE, core_prompt_cache_load, core_prompt_cache_shutdown, NULL);
+
+#define PROMPT_CACHE_MAGIC "FSPC"
+#define PROMPT_CACHE_VERSION 1
+#define PROMPT_CACHE_DEFAULT_MAX_SEC 300
+#define PROMPT_CACHE_DEFAULT_MAX_MB 256
+#define PROMPT_CACHE_DEFAULT_MAX_ENTRIES 2000
+#define PROMPT_CACHE_UNCACHEABLE_TTL 600
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t rate;
+	uint32_t samples;
+	int64_t src_mtime;
+	int64_t src_size;
+} prompt_cache_header_t;
+
+typedef struct prompt_cache_entry {
+	char *key;
+	char *path;
+	char *cache_path;
+	uint32_t rate;
+	uint32_t samples;
+	int16_t *data;
+	void *map;
+	switch_size_t map_len;
+	int64_t src_mtime;
+	int64_t src_size;
+	uint32_t refs;
+	uint32_t hits;
+	int stale;
+	int uncacheable;
+	time_t expires;
+	struct prompt_cache_entry *lru_prev;
+	struct prompt_cache_entry *lru_next;
+} prompt_cache_entry_t;
+
+typedef struct {
+	prompt_cache_entry_t *entry;
+	uint32_t pos;
+} prompt_cache_context_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	char *dir;
+	uint32_t max_sec;
+	switch_size_t max_bytes;
+	uint32_t max_entries;
+	switch_size_t bytes;
+	uint32_t entries;
+	prompt_cache_entry_t *lru_head;
+	prompt_cache_entry_t *lru_tail;
+	uint32_t evicted;
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t skipped;
+	int ready;
+} globals;
+
+switch_bool_t switch_core_prompt_cache_ready(void)
+{
+	return globals.ready ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+static void prompt_cache_entry_free(prompt_cache_entry_t *entry)
+{
+	if (entry->map) {
+#ifndef WIN32
+		munmap(entry->map, entry->map_len);
+#else
+		free(entry->map);
+#endif
+	} else {
+		switch_safe_free(entry->data);
+	}
+
+	switch_safe_free(entry->key);
+	switch_safe_free(entry->path);
+	switch_safe_free(entry->cache_path);
+	free(entry);
+}
+
+static switch_status_t prompt_cache_stat(const char *path, int64_t *mtime, int64_t *size)
+{
+	struct stat st;
+
+	if (stat(path, &st) || !S_ISREG(st.st_mode)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	*mtime = (int64_t) st.st_mtime;
+	*size = (int64_t) st.st_size;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* map a cache file written earlier, possibly by a previous run */
+static switch_status_t prompt_cache_load_file(prompt_cache_entry_t *entry)
+{
+	prompt_cache_header_t *hdr;
+	switch_size_t len;
+	void *map = NULL;
+#ifndef WIN32
+	struct stat st;
+	int fd;
+
+	if ((fd = open(entry->cache_path, O_RDONLY)) < 0) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (fstat(fd, &st) || (switch_size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	len = (switch_size_t) st.st_size;
+	map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		return SWITCH_STATUS_FALSE;
+	}
+#else
+	FILE *f;
+
+	if (!(f = fopen(entry->cache_path, "rb"))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	fseek(f, 0, SEEK_END);
+	len = (switch_size_t) ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	if (len < sizeof(*hdr) || !(map = malloc(len)) || fread(map, 1, len, f) != len) {
+		switch_safe_free(map);
+		fclose(f);
+		return SWITCH_STATUS_FALSE;
+	}
+	fclose(f);
+#endif
+
+	hdr = (prompt_cache_header_t *) map;
+
+	if (memcmp(hdr->magic, PROMPT_CACHE_MAGIC, 4) || hdr->version != PROMPT_CACHE_VERSION || hdr->rate != entry->rate ||
+		hdr->src_mtime != entry->src_mtime || hdr->src_size != entry->src_size || len != sizeof(*hdr) + (switch_size_t) hdr->samples * 2) {
+#ifndef WIN32
+		munmap(map, len);
+#else
+		free(map);
+#endif
+		return SWITCH_STATUS_FALSE;
+	}
+
+	entry->map = map;
+	entry->map_len = len;
+	entry->samples = hdr->samples;
+	entry->data = (int16_t *) (hdr + 1);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* decode the source through the normal file layer at the cached rate,
+   SWITCH_STATUS_NOTIMPL means the source can never be cached and should not be tried again */
+static switch_status_t prompt_cache_decode(prompt_cache_entry_t *entry)
+{
+	switch_file_handle_t fh = { 0 };
+	prompt_cache_header_t hdr = { { 0 } };
+	int16_t *data = NULL;
+	switch_size_t len, have = 0, alloced = 0, max = (switch_size_t) globals.max_sec * entry->rate;
+	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	char *tmp;
+	FILE *f;
+
+	if (switch_core_file_open(&fh, entry->path, 1, entry->rate,
+							  SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT | SWITCH_FILE_NO_CACHE, NULL) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* pre-encoded native files are already as cheap as it gets and are not SLIN anyway */
+	if (switch_test_flag((&fh), SWITCH_FILE_NATIVE)) {
+		switch_core_file_close(&fh);
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	/* most formats know their length up front, don't decode minutes of audio just to throw it away */
+	if (fh.samples > 0 && fh.native_rate && (switch_size_t) fh.samples / fh.native_rate >= globals.max_sec) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s is longer than %u seconds, not caching\n", entry->path, globals.max_sec);
+		switch_core_file_close(&fh);
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	for (;;) {
+		if (have + 1024 > alloced) {
+			void *mem;
+
+			alloced = alloced ? alloced * 2 : entry->rate * 4;
+			mem = realloc(data, alloced * 2);
+			switch_assert(mem);
+			data = mem;
+		}
+
+		len = 1024;
+		if (switch_core_file_read(&fh, data + have, &len) != SWITCH_STATUS_SUCCESS || !len) {
+			break;
+		}
+
+		if ((have += len) > max) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s is longer than %u seconds, not caching\n", entry->path, globals.max_sec);
+			switch_core_file_close(&fh);
+			free(data);
+			return SWITCH_STATUS_NOTIMPL;
+		}
+	}
+
+	switch_core_file_close(&fh);
+
+	entry->data = data;
+	entry->samples = (uint32_t) have;
+
+	memcpy(hdr.magic, PROMPT_CACHE_MAGIC, 4);
+	hdr.version = PROMPT_CACHE_VERSION;
+	hdr.rate = entry->rate;
+	hdr.samples = entry->samples;
+	hdr.src_mtime = entry->src_mtime;
+	hdr.src_size = entry->src_size;
+
+	/* write next to the final name and rename so a reader never maps half a file */
+	tmp = switch_mprintf("%s.%s.tmp", entry->cache_path, switch_uuid_str(uuid_str, sizeof(uuid_str)));
+
+	if ((f = fopen(tmp, "wb"))) {
+		int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 && (!have || fwrite(data, have * 2, 1, f) == 1);
+
+		ok = !fclose(f) && ok;
+
+		if (ok && !rename(tmp, entry->cache_path)) {
+			if (prompt_cache_load_file(entry) == SWITCH_STATUS_SUCCESS) {
+				free(data);
+			} else {
+				entry->data = data;
+			}
+		} else {
+			remove(tmp);
+		}
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot write %s, keeping %s in memory only\n", tmp, entry->path);
+	}
+
+	free(tmp);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* an entry still stands for the source as long as the source is unchanged, negative ones only for a while */
+static int prompt_cache_entry_current(prompt_cache_entry_t *entry, int64_t mtime, int64_t size)
+{
+	return entry->src_mtime == mtime && entry->src_size == size && (!entry->uncacheable || entry->expires > switch_epoch_time_now(NULL));
+}
+
+static switch_size_t prompt_cache_entry_bytes(prompt_cache_entry_t *entry)
+{
+	return entry->uncacheable ? 0 : sizeof(prompt_cache_header_t) + (switch_size_t) entry->samples * 2;
+}
+
+/* caller holds globals.mutex */
+static void prompt_cache_lru_remove(prompt_cache_entry_t *entry)
+{
+	if (entry->lru_prev) {
+		entry->lru_prev->lru_next = entry->lru_next;
+	} else {
+		globals.lru_head = entry->lru_next;
+	}
+
+	if (entry->lru_next) {
+		entry->lru_next->lru_prev = entry->lru_prev;
+	} else {
+		globals.lru_tail = entry->lru_prev;
+	}
+
+	entry->lru_prev = entry->lru_next = NULL;
+}
+
+/* caller holds globals.mutex */
+static void prompt_cache_lru_push(prompt_cache_entry_t *entry)
+{
+	entry->lru_prev = NULL;
+	entry->lru_next = globals.lru_head;
+
+	if (globals.lru_head) {
+		globals.lru_head->lru_prev = entry;
+	} else {
+		globals.lru_tail = entry;
+	}
+
+	globals.lru_head = entry;
+}
+
+static void prompt_cache_release(prompt_cache_entry_t *entry)
+{
+	switch_mutex_lock(globals.mutex);
+	if (!--entry->refs && entry->stale) {
+		prompt_cache_entry_free(entry);
+	}
+	switch_mutex_unlock(globals.mutex);
+}
+
+/* caller holds globals.mutex */
+static void prompt_cache_unlink(prompt_cache_entry_t *entry)
+{
+	switch_core_hash_delete(globals.hash, entry->key);
+	prompt_cache_lru_remove(entry);
+	globals.bytes -= prompt_cache_entry_bytes(entry);
+	globals.entries--;
+	entry->stale = 1;
+
+	if (!entry->refs) {
+		prompt_cache_entry_free(entry);
+	}
+}
+
+/* caller holds globals.mutex; entries still playing keep their mapping until the last close,
+   the file goes right away so the disk use stays within the limit as well */
+static void prompt_cache_trim(prompt_cache_entry_t *keep)
+{
+	prompt_cache_entry_t *entry;
+
+	while ((globals.bytes > globals.max_bytes || globals.entries > globals.max_entries) && (entry = globals.lru_tail) && entry != keep) {
+		if (!entry->uncacheable) {
+			remove(entry->cache_path);
+		}
+		prompt_cache_unlink(entry);
+		globals.evicted++;
+	}
+}
+
+/* caller holds globals.mutex */
+static void prompt_cache_insert(prompt_cache_entry_t *entry)
+{
+	switch_core_hash_insert(globals.hash, entry->key, entry);
+	prompt_cache_lru_push(entry);
+	globals.bytes += prompt_cache_entry_bytes(entry);
+	globals.entries++;
+	prompt_cache_trim(entry);
+}
+
+static prompt_cache_entry_t *prompt_cache_acquire(const char *path, uint32_t rate)
+{
+	prompt_cache_entry_t *entry, *found;
+	char digest[SWITCH_MD5_DIGEST_STRING_SIZE] = { 0 };
+	switch_status_t status;
+	int64_t mtime, size;
+	char *key, *resolved;
+
+	resolved = switch_core_file_resolve_rate_path(path, rate);
+
+	if (prompt_cache_stat(resolved, &mtime, &size) != SWITCH_STATUS_SUCCESS) {
+		free(resolved);
+		return NULL;
+	}
+
+	key = switch_mprintf("%s|%u", resolved, rate);
+
+	switch_mutex_lock(globals.mutex);
+	if ((entry = switch_core_hash_find(globals.hash, key))) {
+		if (prompt_cache_entry_current(entry, mtime, size)) {
+			prompt_cache_lru_remove(entry);
+			prompt_cache_lru_push(entry);
+
+			if (entry->uncacheable) {
+				globals.skipped++;
+				switch_mutex_unlock(globals.mutex);
+				free(resolved);
+				free(key);
+				return NULL;
+			}
+			entry->refs++;
+			entry->hits++;
+			globals.hits++;
+			switch_mutex_unlock(globals.mutex);
+			free(resolved);
+			free(key);
+			return entry;
+		}
+		prompt_cache_unlink(entry);
+	}
+	globals.misses++;
+	switch_mutex_unlock(globals.mutex);
+
+	switch_zmalloc(entry, sizeof(*entry));
+	entry->key = key;
+	entry->path = resolved;
+	entry->rate = rate;
+	entry->src_mtime = mtime;
+	entry->src_size = size;
+
+	switch_md5_string(digest, key, strlen(key));
+	entry->cache_path = switch_mprintf("%s%s%s.pcm", globals.dir, SWITCH_PATH_SEPARATOR, digest);
+
+	if (prompt_cache_load_file(entry) == SWITCH_STATUS_SUCCESS) {
+		status = SWITCH_STATUS_SUCCESS;
+	} else if ((status = prompt_cache_decode(entry)) == SWITCH_STATUS_NOTIMPL) {
+		/* remember it for a while so later opens go straight to the real file */
+		entry->uncacheable = 1;
+		entry->expires = switch_epoch_time_now(NULL) + PROMPT_CACHE_UNCACHEABLE_TTL;
+	} else if (status != SWITCH_STATUS_SUCCESS) {
+		prompt_cache_entry_free(entry);
+		return NULL;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if ((found = switch_core_hash_find(globals.hash, key)) && prompt_cache_entry_current(found, mtime, size)) {
+		/* somebody else got there first */
+		prompt_cache_entry_free(entry);
+		entry = found;
+	} else {
+		if (found) {
+			prompt_cache_unlink(found);
+		}
+		prompt_cache_insert(entry);
+	}
+
+	if (entry->uncacheable) {
+		switch_mutex_unlock(globals.mutex);
+		return NULL;
+	}
+
+	entry->refs++;
+	switch_mutex_unlock(globals.mutex);
+
+	return entry;
+}
+
+static switch_status_t prompt_cache_file_open(switch_file_handle_t *handle, const char *path)
+{
+	prompt_cache_context_t *context;
+	prompt_cache_entry_t *entry;
+	switch_codec_interface_t *codec_interface;
+	const char *ext;
+
+	if (!globals.ready || !switch_test_flag(handle, SWITCH_FILE_FLAG_READ)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* <prompt>.<codec> siblings are played natively, let the caller open them directly */
+	if ((ext = strrchr(path, '.')) && (codec_interface = switch_loadable_module_get_codec_interface(ext + 1))) {
+		UNPROTECT_INTERFACE(codec_interface);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!(entry = prompt_cache_acquire(path, handle->samplerate ? handle->samplerate : 8000))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	context = switch_core_alloc(handle->memory_pool, sizeof(*context));
+	context->entry = entry;
+
+	handle->private_info = context;
+	handle->samplerate = entry->rate;
+	handle->channels = 1;
+	handle->samples = entry->samples;
+	handle->format = 0;
+	handle->sections = 0;
+	handle->seekable = 1;
+	handle->speed = 0;
+	handle->pos = 0;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t prompt_cache_file_close(switch_file_handle_t *handle)
+{
+	prompt_cache_context_t *context = handle->private_info;
+
+	if (context && context->entry) {
+		prompt_cache_release(context->entry);
+		context->entry = NULL;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t prompt_cache_file_read(switch_file_handle_t *handle, void *data, size_t *len)
+{
+	prompt_cache_context_t *context = handle->private_info;
+	prompt_cache_entry_t *entry = context->entry;
+	size_t n = entry->samples - context->pos;
+
+	if (n > *len) {
+		n = *len;
+	}
+
+	if (!n) {
+		*len = 0;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	memcpy(data, entry->data + context->pos, n * 2);
+	context->pos += (uint32_t) n;
+	handle->pos = context->pos;
+	*len = n;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t prompt_cache_file_seek(switch_file_handle_t *handle, unsigned int *cur_sample, int64_t samples, int whence)
+{
+	prompt_cache_context_t *context = handle->private_info;
+	int64_t pos = samples;
+
+	if (whence == SEEK_CUR) {
+		pos += context->pos;
+	} else if (whence == SEEK_END) {
+		pos += context->entry->samples;
+	}
+
+	if (pos < 0) {
+		pos = 0;
+	} else if (pos > context->entry->samples) {
+		pos = context->entry->samples;
+	}
+
+	context->pos = (uint32_t) pos;
+	handle->pos = context->pos;
+	*cur_sample = context->pos;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+typedef struct {
+	char *path;
+	int64_t mtime;
+	int64_t size;
+} prompt_cache_file_t;
+
+static int prompt_cache_file_cmp(const void *a, const void *b)
+{
+	const prompt_cache_file_t *x = a, *y = b;
+
+	return x->mtime < y->mtime ? -1 : x->mtime > y->mtime;
+}
+
+/* cache files that no entry owns yet (left by earlier runs), oldest first until the rest fits in max_bytes and max_files */
+static void prompt_cache_sweep(switch_size_t max_bytes, uint32_t max_files)
+{
+	switch_memory_pool_t *pool;
+	switch_dir_t *dir;
+	prompt_cache_file_t *files = NULL;
+	uint32_t count = 0, alloced = 0, i;
+	switch_size_t bytes = 0;
+	char buf[256];
+	const char *fname;
+
+	switch_core_new_memory_pool(&pool);
+
+	if (switch_dir_open(&dir, globals.dir, pool) == SWITCH_STATUS_SUCCESS) {
+		while ((fname = switch_dir_next_file(dir, buf, sizeof(buf)))) {
+			size_t flen = strlen(fname);
+			int64_t mtime, size;
+			char *full;
+
+			if (flen <= 4 || strcmp(fname + flen - 4, ".pcm")) {
+				continue;
+			}
+
+			full = switch_mprintf("%s%s%s", globals.dir, SWITCH_PATH_SEPARATOR, fname);
+
+			if (prompt_cache_stat(full, &mtime, &size) != SWITCH_STATUS_SUCCESS) {
+				free(full);
+				continue;
+			}
+
+			if (count == alloced) {
+				void *mem;
+
+				alloced = alloced ? alloced * 2 : 64;
+				mem = realloc(files, alloced * sizeof(*files));
+				switch_assert(mem);
+				files = mem;
+			}
+
+			files[count].path = full;
+			files[count].mtime = mtime;
+			files[count].size = size;
+			bytes += (switch_size_t) size;
+			count++;
+		}
+		switch_dir_close(dir);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+
+	if (files) {
+		qsort(files, count, sizeof(*files), prompt_cache_file_cmp);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (bytes > max_bytes || count - i > max_files) {
+			remove(files[i].path);
+			bytes -= (switch_size_t) files[i].size;
+		}
+		free(files[i].path);
+	}
+
+	switch_safe_free(files);
+}
+
+static const char *prompt_cache_usage = "status|list|warm <file> [<rate>[,<rate>...]]|evict <file>|all";
+
+SWITCH_STANDARD_API(prompt_cache_function)
+{
+	char *mydata = NULL, *argv[3] = { 0 };
+	int argc = 0;
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+
+	if (!globals.ready) {
+		stream->write_function(stream, "-ERR prompt cache disabled, set prompt-cache-dir in switch.conf\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!zstr(cmd) && (mydata = strdup(cmd))) {
+		argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	if (!argc || !strcasecmp(argv[0], "status")) {
+		uint32_t entries = 0, uncacheable = 0;
+		switch_size_t bytes = 0;
+
+		switch_mutex_lock(globals.mutex);
+		for (hi = switch_hash_first(NULL, globals.hash); hi; hi = switch_hash_next(hi)) {
+			prompt_cache_entry_t *entry;
+
+			switch_hash_this(hi, &var, NULL, &val);
+			entry = (prompt_cache_entry_t *) val;
+			if (entry->uncacheable) {
+				uncacheable++;
+				continue;
+			}
+			entries++;
+			bytes += (switch_size_t) entry->samples * 2;
+		}
+		stream->write_function(stream, "dir: %s\nentries: %u\nuncacheable: %u\nbytes: %" SWITCH_SIZE_T_FMT "\nmax-bytes: %" SWITCH_SIZE_T_FMT
+							   "\nmax-entries: %u\nhits: %u\nmisses: %u\nskipped: %u\nevicted: %u\n",
+							   globals.dir, entries, uncacheable, bytes, globals.max_bytes, globals.max_entries, globals.hits, globals.misses,
+							   globals.skipped, globals.evicted);
+		switch_mutex_unlock(globals.mutex);
+	} else if (!strcasecmp(argv[0], "list")) {
+		switch_mutex_lock(globals.mutex);
+		stream->write_function(stream, "path,rate,samples,refs,hits,mapped,uncacheable\n");
+		for (hi = switch_hash_first(NULL, globals.hash); hi; hi = switch_hash_next(hi)) {
+			prompt_cache_entry_t *entry;
+
+			switch_hash_this(hi, &var, NULL, &val);
+			entry = (prompt_cache_entry_t *) val;
+			stream->write_function(stream, "%s,%u,%u,%u,%u,%s,%s\n", entry->path, entry->rate, entry->samples, entry->refs, entry->hits,
+								   entry->map ? "true" : "false", entry->uncacheable ? "true" : "false");
+		}
+		switch_mutex_unlock(globals.mutex);
+	} else if (!strcasecmp(argv[0], "warm") && argc > 1) {
+		char *rates[16] = { 0 };
+		int nrates = 0, i;
+
+		if (argc > 2) {
+			nrates = switch_separate_string(argv[2], ',', rates, (sizeof(rates) / sizeof(rates[0])));
+		} else {
+			rates[nrates++] = "8000";
+		}
+
+		for (i = 0; i < nrates; i++) {
+			prompt_cache_entry_t *entry;
+			int rate = atoi(rates[i]);
+
+			if (rate <= 0 || !(entry = prompt_cache_acquire(argv[1], (uint32_t) rate))) {
+				stream->write_function(stream, "-ERR %s@%s\n", argv[1], rates[i]);
+				continue;
+			}
+
+			stream->write_function(stream, "+OK %s@%d %u samples\n", argv[1], rate, entry->samples);
+			prompt_cache_release(entry);
+		}
+	} else if (!strcasecmp(argv[0], "evict") && argc > 1) {
+		prompt_cache_entry_t *victims = NULL;
+		char **keys = NULL;
+		int count = 0, alloced = 0, all = !strcasecmp(argv[1], "all"), i;
+
+		switch_mutex_lock(globals.mutex);
+		for (hi = switch_hash_first(NULL, globals.hash); hi; hi = switch_hash_next(hi)) {
+			prompt_cache_entry_t *entry;
+
+			switch_hash_this(hi, &var, NULL, &val);
+			entry = (prompt_cache_entry_t *) val;
+
+			if (!all && strcmp(entry->path, argv[1])) {
+				/* the entry may have been resolved into a rate directory */
+				char *resolved = switch_core_file_resolve_rate_path(argv[1], entry->rate);
+				int match = !strcmp(entry->path, resolved);
+
+				free(resolved);
+				if (!match) {
+					continue;
+				}
+			}
+
+			if (count == alloced) {
+				void *mem;
+
+				alloced = alloced ? alloced * 2 : 16;
+				mem = realloc(keys, alloced * sizeof(*keys));
+				switch_assert(mem);
+				keys = mem;
+			}
+			keys[count++] = entry->key;
+		}
+
+		for (i = 0; i < count; i++) {
+			if ((victims = switch_core_hash_find(globals.hash, keys[i]))) {
+				remove(victims->cache_path);
+				prompt_cache_unlink(victims);
+			}
+		}
+
+		/* files left behind by earlier runs have no entry, sweep the whole directory */
+		if (all) {
+			prompt_cache_sweep(0, 0);
+		}
+		switch_mutex_unlock(globals.mutex);
+
+		switch_safe_free(keys);
+		stream->write_function(stream, "+OK %d evicted\n", count);
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", prompt_cache_usage);
+	}
+
+	switch_safe_free(mydata);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static char *supported_formats[] = { "prompt_cache", NULL };
+
+SWITCH_MODULE_LOAD_FUNCTION(core_prompt_cache_load)
+{
+	switch_file_interface_t *file_interface;
+	switch_api_interface_t *api_interface;
+
+	memset(&globals, 0, sizeof(globals));
+	globals.pool = pool;
+	globals.max_sec = runtime.prompt_cache_max_sec ? runtime.prompt_cache_max_sec : PROMPT_CACHE_DEFAULT_MAX_SEC;
+	globals.max_bytes = (switch_size_t) (runtime.prompt_cache_max_mb ? runtime.prompt_cache_max_mb : PROMPT_CACHE_DEFAULT_MAX_MB) * 1024 * 1024;
+	globals.max_entries = runtime.prompt_cache_max_entries ? runtime.prompt_cache_max_entries : PROMPT_CACHE_DEFAULT_MAX_ENTRIES;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.hash, pool);
+
+	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
+	file_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_FILE_INTERFACE);
+	file_interface->interface_name = modname;
+	file_interface->extens = supported_formats;
+	file_interface->file_open = prompt_cache_file_open;
+	file_interface->file_close = prompt_cache_file_close;
+	file_interface->file_read = prompt_cache_file_read;
+	file_interface->file_seek = prompt_cache_file_seek;
+
+	SWITCH_ADD_API(api_interface, "prompt_cache", "Pre-decoded prompt cache", prompt_cache_function, prompt_cache_usage);
+
+	if (!zstr(runtime.prompt_cache_dir)) {
+		if (switch_dir_make_recursive(runtime.prompt_cache_dir, SWITCH_DEFAULT_DIR_PERMS, pool) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create prompt cache dir %s\n", runtime.prompt_cache_dir);
+		} else {
+			globals.dir = switch_core_strdup(pool, runtime.prompt_cache_dir);
+			/* what earlier runs left is reused on demand, but only up to the same limits */
+			prompt_cache_sweep(globals.max_bytes, globals.max_entries);
+			globals.ready = 1;
+		}
+	}
+
+	/* indicate that the module should continue to be loaded */
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_MODULE_SHUTDOWN_FUNCTION(core_prompt_cache_shutdown)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+
+	globals.ready = 0;
+
+	switch_mutex_lock(globals.mutex);
+	while ((hi = switch_hash_first(NULL, globals.hash))) {
+		prompt_cache_entry_t *entry;
+
+		switch_hash_this(hi, &var, NULL, &val);
+		entry = (prompt_cache_entry_t *) val;
+		prompt_cache_unlink(entry);
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	switch_core_hash_destroy(&globals.hash);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -0,0 +1,1492 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * switch_core_recovery_journal.c -- Append only recovery journal
+ *
+ * With recovery-journal set in switch.conf the recovery calls stop writing channel xml
+ * to the recovery table and append small binary records to a memory mapped file
+ * instead: the xml cdr once when a call is first tracked, after that only the channel
+ * variables that changed.  With recovery-journal-standby the records are also streamed
+ * to another box listening on recovery-journal-listen, which keeps them in
+ * <recovery-journal>.replica.  Recovery replays both files.
+ *
+ * A journal past its compaction point is rewritten by a background thread into
+ * <file>.compact, one record per call still up, and renamed over the original, so a
+ * crash at any point leaves one complete journal behind.
+ *
+ * The standby only takes primaries recovery-journal-acl allows, loopback unless set,
+ * and that answer an md5 challenge over recovery-journal-secret: the stream carries
+ * channel variables, and with them whatever the recovered calls will execute.
+ *
+ */
+
+#include <switch.h>
+#include "private/switch_core_pvt.h"
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define RJ_MAGIC "FSRJ"
+#define RJ_VERSION 1
+#define RJ_RECORD_MAGIC 0x43524a46
+#define RJ_DELETED 0xffffffff
+#define RJ_PRIVATE "__recovery_journal"
+#define RJ_DEFAULT_SIZE_MB 64
+#define RJ_SEND_CHUNK 65536
+#define RJ_HELLO_LEN (4 + 32)
+#define RJ_HANDSHAKE_TIMEOUT 5000000
+#define RJ_DEFAULT_ACL "loopback.auto"
+
+typedef enum {
+	RJ_TRACK = 1,
+	RJ_VARS,
+	RJ_UNTRACK,
+	RJ_FLUSH,
+	RJ_PURGE,
+	RJ_RESET
+} rj_type_t;
+
+/* start of the file */
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint64_t size;
+	uint64_t head;
+	uint64_t generation;
+} rj_header_t;
+
+#define RJ_DATA_START sizeof(rj_header_t)
+
+/* every record, followed by its fields: uint32 key len, uint32 value len, key, value */
+typedef struct {
+	uint32_t magic;
+	uint32_t len;
+	uint16_t type;
+	uint16_t fields;
+	uint32_t reserved;
+} rj_record_t;
+
+typedef struct {
+	const char *name;
+	rj_header_t *hdr;
+	uint8_t *map;
+	uint64_t size;
+	uint64_t compact_at;
+	uint32_t dropped;
+	int fd;
+} rj_file_t;
+
+typedef struct {
+	uint8_t *data;
+	switch_size_t len;
+	switch_size_t alloc;
+	uint16_t fields;
+} rj_buf_t;
+
+/* what was last written for one channel variable */
+typedef struct {
+	const char *name;
+	uint32_t name_hash;
+	uint32_t seen;
+	uint64_t val_hash;
+	int live;
+} rj_var_t;
+
+/* per channel, hangs off the channel as a private */
+typedef struct {
+	switch_mutex_t *mutex;
+	rj_var_t *vars;
+	rj_var_t *spare;
+	uint32_t size;
+	uint32_t used;
+	uint32_t pass;
+	switch_caller_profile_t *profile;
+	switch_caller_extension_t *extension;
+	int written;
+} rj_chan_t;
+
+/* a call rebuilt from the journal */
+typedef struct rj_call_s {
+	char *uuid;
+	char *technology;
+	char *profile_name;
+	char *hostname;
+	char *runtime_uuid;
+	switch_xml_t xml;
+	int dead;
+	struct rj_call_s *next;
+} rj_call_t;
+
+typedef struct {
+	switch_hash_t *hash;
+	rj_call_t *calls;
+} rj_state_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_thread_cond_t *compact_cond;
+	rj_file_t local;
+	rj_file_t replica;
+	char *standby_host;
+	switch_port_t standby_port;
+	char *listen_host;
+	switch_port_t listen_port;
+	char *acl;
+	char *secret;
+	switch_thread_t *sender;
+	switch_thread_t *receiver;
+	switch_thread_t *compactor;
+	int running;
+	int ready;
+} globals;
+
+static uint64_t rj_hash(const char *s, switch_size_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+	switch_size_t i;
+
+	for (i = 0; i < len; i++) {
+		h = (h ^ (uint8_t) s[i]) * 1099511628211ULL;
+	}
+
+	return h;
+}
+
+static void rj_buf_need(rj_buf_t *b, switch_size_t n)
+{
+	if (b->len + n > b->alloc) {
+		b->alloc = b->len + n > b->alloc * 2 ? b->len + n + 1024 : b->alloc * 2;
+		b->data = realloc(b->data, b->alloc);
+		switch_assert(b->data);
+	}
+}
+
+static void rj_buf_begin(rj_buf_t *b, rj_type_t type)
+{
+	rj_record_t *rec;
+
+	b->len = 0;
+	b->fields = 0;
+	rj_buf_need(b, sizeof(*rec));
+	rec = (rj_record_t *) b->data;
+	memset(rec, 0, sizeof(*rec));
+	rec->type = (uint16_t) type;
+	b->len = sizeof(*rec);
+}
+
+/* a NULL val records the variable as gone */
+static void rj_buf_add(rj_buf_t *b, const char *key, const char *val, uint32_t vlen)
+{
+	uint32_t klen = (uint32_t) strlen(key);
+	uint32_t dlen = val ? vlen : 0;
+
+	if (!val) {
+		vlen = RJ_DELETED;
+	}
+
+	rj_buf_need(b, 8 + klen + dlen);
+	memcpy(b->data + b->len, &klen, 4);
+	memcpy(b->data + b->len + 4, &vlen, 4);
+	memcpy(b->data + b->len + 8, key, klen);
+	if (dlen) {
+		memcpy(b->data + b->len + 8 + klen, val, dlen);
+	}
+	b->len += 8 + klen + dlen;
+	b->fields++;
+}
+
+static void rj_buf_add_str(rj_buf_t *b, const char *key, const char *val)
+{
+	val = switch_str_nil(val);
+	rj_buf_add(b, key, val, (uint32_t) strlen(val));
+}
+
+static void rj_buf_end(rj_buf_t *b)
+{
+	rj_record_t *rec;
+	switch_size_t pad = (8 - (b->len & 7)) & 7;
+
+	rj_buf_need(b, pad);
+	memset(b->data + b->len, 0, pad);
+	b->len += pad;
+
+	rec = (rj_record_t *) b->data;
+	rec->magic = RJ_RECORD_MAGIC;
+	rec->len = (uint32_t) b->len;
+	rec->fields = b->fields;
+}
+
+/* walk the fields of a record, returns 0 at the end or on a field that runs past it */
+static int rj_next_field(rj_record_t *rec, switch_size_t *pos, const char **key, uint32_t *klen, const char **val, uint32_t *vlen)
+{
+	const uint8_t *p = (const uint8_t *) rec;
+	uint32_t dlen;
+
+	if (*pos + 8 > rec->len) {
+		return 0;
+	}
+
+	memcpy(klen, p + *pos, 4);
+	memcpy(vlen, p + *pos + 4, 4);
+	dlen = *vlen == RJ_DELETED ? 0 : *vlen;
+
+	if ((uint64_t) *pos + 8 + *klen + dlen > rec->len) {
+		return 0;
+	}
+
+	*key = (const char *) p + *pos + 8;
+	*val = *vlen == RJ_DELETED ? NULL : (const char *) p + *pos + 8 + *klen;
+	*pos += 8 + *klen + dlen;
+
+	return 1;
+}
+
+static int rj_key_is(const char *key, uint32_t klen, const char *name)
+{
+	return strlen(name) == klen && !strncmp(key, name, klen);
+}
+
+static char *rj_strndup(const char *s, uint32_t len)
+{
+	char *r = malloc(len + 1);
+
+	switch_assert(r);
+	if (len) {
+		memcpy(r, s, len);
+	}
+	r[len] = '\0';
+
+	return r;
+}
+
+#ifndef WIN32
+static switch_status_t rj_file_open(rj_file_t *file, const char *path, uint64_t size)
+{
+	struct stat st;
+	void *map;
+
+	if ((file->fd = open(path, O_RDWR | O_CREAT, 0640)) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot open recovery journal %s: %s\n", path, strerror(errno));
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (fstat(file->fd, &st) || ((uint64_t) st.st_size < size && ftruncate(file->fd, (off_t) size))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot size recovery journal %s: %s\n", path, strerror(errno));
+		close(file->fd);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* never shrink a journal that still holds calls */
+	if ((uint64_t) st.st_size > size) {
+		size = (uint64_t) st.st_size;
+	}
+
+	if ((map = mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0)) == MAP_FAILED) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot map recovery journal %s: %s\n", path, strerror(errno));
+		close(file->fd);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	file->name = switch_core_strdup(globals.pool, path);
+	file->map = map;
+	file->size = size;
+	file->hdr = (rj_header_t *) map;
+
+	if (memcmp(file->hdr->magic, RJ_MAGIC, 4) || file->hdr->version != RJ_VERSION ||
+		file->hdr->head < RJ_DATA_START || file->hdr->head > size) {
+		memcpy(file->hdr->magic, RJ_MAGIC, 4);
+		file->hdr->version = RJ_VERSION;
+		file->hdr->head = RJ_DATA_START;
+		file->hdr->generation = 0;
+	}
+
+	file->hdr->size = size;
+	file->compact_at = file->hdr->head + (size - file->hdr->head) / 2;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void rj_file_close(rj_file_t *file)
+{
+	if (file->map) {
+		msync(file->map, (size_t) file->size, MS_SYNC);
+		munmap(file->map, (size_t) file->size);
+		close(file->fd);
+		file->map = NULL;
+		file->hdr = NULL;
+	}
+}
+#endif
+
+static void rj_call_free(rj_call_t *call)
+{
+	switch_safe_free(call->uuid);
+	switch_safe_free(call->technology);
+	switch_safe_free(call->profile_name);
+	switch_safe_free(call->hostname);
+	switch_safe_free(call->runtime_uuid);
+	if (call->xml) {
+		switch_xml_free(call->xml);
+	}
+	free(call);
+}
+
+static void rj_state_destroy(rj_state_t *state)
+{
+	rj_call_t *call, *next;
+
+	for (call = state->calls; call; call = next) {
+		next = call->next;
+		rj_call_free(call);
+	}
+
+	switch_core_hash_destroy(&state->hash);
+}
+
+static void rj_state_kill(rj_state_t *state, rj_call_t *call)
+{
+	if (!call->dead) {
+		call->dead = 1;
+		switch_core_hash_delete(state->hash, call->uuid);
+	}
+}
+
+static void rj_apply_track(rj_state_t *state, rj_record_t *rec)
+{
+	rj_call_t *call, *old;
+	switch_size_t pos = sizeof(*rec);
+	const char *key, *val;
+	uint32_t klen, vlen;
+	char *xml_text = NULL;
+
+	switch_zmalloc(call, sizeof(*call));
+
+	while (rj_next_field(rec, &pos, &key, &klen, &val, &vlen)) {
+		if (!val) {
+			continue;
+		}
+		if (rj_key_is(key, klen, "uuid")) {
+			call->uuid = rj_strndup(val, vlen);
+		} else if (rj_key_is(key, klen, "technology")) {
+			call->technology = rj_strndup(val, vlen);
+		} else if (rj_key_is(key, klen, "profile")) {
+			call->profile_name = rj_strndup(val, vlen);
+		} else if (rj_key_is(key, klen, "hostname")) {
+			call->hostname = rj_strndup(val, vlen);
+		} else if (rj_key_is(key, klen, "runtime")) {
+			call->runtime_uuid = rj_strndup(val, vlen);
+		} else if (rj_key_is(key, klen, "xml")) {
+			switch_safe_free(xml_text);
+			xml_text = rj_strndup(val, vlen);
+		}
+	}
+
+	if (xml_text && !(call->xml = switch_xml_parse_str_dynamic(xml_text, SWITCH_FALSE))) {
+		free(xml_text);
+	}
+
+	if (!call->uuid || !call->technology || !call->runtime_uuid || !call->xml) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Skipping incomplete recovery journal record\n");
+		rj_call_free(call);
+		return;
+	}
+
+	if ((old = switch_core_hash_find(state->hash, call->uuid))) {
+		rj_state_kill(state, old);
+	}
+
+	call->next = state->calls;
+	state->calls = call;
+	switch_core_hash_insert(state->hash, call->uuid, call);
+}
+
+static void rj_apply_vars(rj_state_t *state, rj_record_t *rec)
+{
+	switch_size_t pos = sizeof(*rec);
+	const char *key, *val;
+	uint32_t klen, vlen;
+	rj_call_t *call = NULL;
+	switch_xml_t variables = NULL, x;
+	char name[256];
+
+	if (!rj_next_field(rec, &pos, &key, &klen, &val, &vlen) || !val || !rj_key_is(key, klen, "uuid")) {
+		return;
+	}
+
+	switch_snprintf(name, sizeof(name), "%.*s", (int) vlen, val);
+
+	if (!(call = switch_core_hash_find(state->hash, name)) || !(variables = switch_xml_child(call->xml, "variables"))) {
+		return;
+	}
+
+	while (rj_next_field(rec, &pos, &key, &klen, &val, &vlen)) {
+		if (klen >= sizeof(name)) {
+			continue;
+		}
+
+		switch_snprintf(name, sizeof(name), "%.*s", (int) klen, key);
+
+		while ((x = switch_xml_child(variables, name))) {
+			switch_xml_remove(x);
+		}
+
+		if (val && (x = switch_xml_add_child_d(variables, name, 0))) {
+			switch_size_t dlen = (switch_size_t) vlen * 3 + 1;
+			char *raw = rj_strndup(val, vlen);
+			char *data = malloc(dlen);
+
+			switch_assert(data);
+			memset(data, 0, dlen);
+			switch_url_encode(raw, data, dlen);
+			switch_xml_set_txt_d(x, data);
+			free(data);
+			free(raw);
+		}
+	}
+}
+
+/* RJ_UNTRACK, RJ_FLUSH and RJ_PURGE, the last two match on technology and profile, empty matches all */
+static void rj_apply_remove(rj_state_t *state, rj_record_t *rec)
+{
+	switch_size_t pos = sizeof(*rec);
+	const char *key, *val;
+	uint32_t klen, vlen;
+	char *technology = NULL, *profile_name = NULL, *runtime_uuid = NULL;
+	rj_call_t *call;
+
+	while (rj_next_field(rec, &pos, &key, &klen, &val, &vlen)) {
+		if (!val) {
+			continue;
+		}
+		if (rj_key_is(key, klen, "uuid")) {
+			char *uuid = rj_strndup(val, vlen);
+
+			if ((call = switch_core_hash_find(state->hash, uuid))) {
+				rj_state_kill(state, call);
+			}
+			free(uuid);
+		} else if (rj_key_is(key, klen, "technology") && !technology) {
+			technology = rj_strndup(val, vlen);
+		} else if (rj_key_is(key, klen, "profile") && !profile_name) {
+			profile_name = rj_strndup(val, vlen);
+		} else if (rj_key_is(key, klen, "runtime") && !runtime_uuid) {
+			runtime_uuid = rj_strndup(val, vlen);
+		}
+	}
+
+	if (rec->type != RJ_UNTRACK) {
+		for (call = state->calls; call; call = call->next) {
+			if ((zstr(technology) || !strcasecmp(technology, call->technology)) &&
+				(zstr(profile_name) || !strcasecmp(profile_name, switch_str_nil(call->profile_name))) &&
+				(rec->type != RJ_PURGE || zstr(runtime_uuid) || strcmp(runtime_uuid, call->runtime_uuid))) {
+				rj_state_kill(state, call);
+			}
+		}
+	}
+
+	switch_safe_free(technology);
+	switch_safe_free(profile_name);
+	switch_safe_free(runtime_uuid);
+}
+
+/* rebuild the calls the first end bytes of a journal describe */
+static void rj_replay_to(rj_file_t *file, uint64_t end, rj_state_t *state)
+{
+	uint64_t off = RJ_DATA_START;
+
+	while (off + sizeof(rj_record_t) <= end) {
+		rj_record_t *rec = (rj_record_t *) (file->map + off);
+
+		if (rec->magic != RJ_RECORD_MAGIC || rec->len < sizeof(*rec) || off + rec->len > end) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Recovery journal %s is damaged at offset %" SWITCH_UINT64_T_FMT
+							  ", ignoring the rest\n", file->name, off);
+			break;
+		}
+
+		switch (rec->type) {
+		case RJ_TRACK:
+			rj_apply_track(state, rec);
+			break;
+		case RJ_VARS:
+			rj_apply_vars(state, rec);
+			break;
+		case RJ_UNTRACK:
+		case RJ_FLUSH:
+		case RJ_PURGE:
+			rj_apply_remove(state, rec);
+			break;
+		default:
+			break;
+		}
+
+		off += rec->len;
+	}
+}
+
+/* the whole journal, called with globals.mutex held */
+static void rj_replay(rj_file_t *file, rj_state_t *state)
+{
+	if (file->map) {
+		rj_replay_to(file, file->hdr->head, state);
+	}
+}
+
+static switch_status_t rj_write(rj_file_t *file, const uint8_t *data, switch_size_t len)
+{
+	if (!file->map || file->hdr->head + len > file->size) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	memcpy(file->map + file->hdr->head, data, len);
+	file->hdr->head += len;
+
+	if (file == &globals.local && globals.cond) {
+		switch_thread_cond_signal(globals.cond);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void rj_append_to(rj_file_t *file, rj_buf_t *b)
+{
+	switch_mutex_lock(globals.mutex);
+
+	if (file->map) {
+		if (rj_write(file, b->data, b->len) != SWITCH_STATUS_SUCCESS) {
+			file->dropped++;
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Recovery journal %s is full, %" SWITCH_SIZE_T_FMT
+							  " byte record dropped (%u so far), the calls it belongs to may not be recoverable\n", file->name, b->len, file->dropped);
+		}
+
+		if (file->hdr->head >= file->compact_at || file->dropped) {
+			switch_thread_cond_signal(globals.compact_cond);
+		}
+	}
+
+	switch_mutex_unlock(globals.mutex);
+}
+
+static rj_var_t *rj_chan_var(switch_core_session_t *session, rj_chan_t *rc, const char *name)
+{
+	uint32_t hash = (uint32_t) rj_hash(name, strlen(name));
+	uint32_t i;
+
+	if ((rc->used + 1) * 2 > rc->size) {
+		rj_var_t *old = rc->vars;
+		uint32_t old_size = rc->size, live = 0;
+
+		for (i = 0; i < old_size; i++) {
+			if (old[i].name && old[i].live) {
+				live++;
+			}
+		}
+
+		/* mostly names that went away, rehash at the same size and swap with the spare instead of growing */
+		if (old_size && (live + 1) * 4 <= old_size) {
+			if (rc->spare) {
+				memset(rc->spare, 0, sizeof(rj_var_t) * old_size);
+			} else {
+				rc->spare = switch_core_session_alloc(session, sizeof(rj_var_t) * old_size);
+			}
+			rc->vars = rc->spare;
+			rc->spare = old;
+		} else {
+			/* a spare of the old size is no use any more */
+			rc->size = rc->size ? rc->size * 2 : 256;
+			rc->vars = switch_core_session_alloc(session, sizeof(rj_var_t) * rc->size);
+			rc->spare = NULL;
+		}
+		rc->used = 0;
+
+		/* variables that went away are not carried over */
+		for (i = 0; i < old_size; i++) {
+			if (old[i].name && old[i].live) {
+				uint32_t x = old[i].name_hash & (rc->size - 1);
+
+				while (rc->vars[x].name) {
+					x = (x + 1) & (rc->size - 1);
+				}
+				rc->vars[x] = old[i];
+				rc->used++;
+			}
+		}
+	}
+
+	for (i = hash & (rc->size - 1); rc->vars[i].name; i = (i + 1) & (rc->size - 1)) {
+		if (rc->vars[i].name_hash == hash && !strcmp(rc->vars[i].name, name)) {
+			return &rc->vars[i];
+		}
+	}
+
+	rc->vars[i].name = switch_core_session_strdup(session, name);
+	rc->vars[i].name_hash = hash;
+	rc->used++;
+
+	return &rc->vars[i];
+}
+
+/* compare the channel variables with what was last written, add what changed to b when it is set */
+static void rj_chan_diff(switch_core_session_t *session, rj_chan_t *rc, rj_buf_t *b)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	switch_event_header_t *hi;
+	uint32_t pass = ++rc->pass;
+	uint32_t i;
+
+	if ((hi = switch_channel_variable_first(channel))) {
+		for (; hi; hi = hi->next) {
+			switch_stream_handle_t stream = { 0 };
+			const char *val = hi->value;
+			rj_var_t *var;
+			uint64_t vh;
+			int x;
+
+			if (hi->idx) {
+				SWITCH_STANDARD_STREAM(stream);
+				stream.write_function(&stream, "ARRAY::");
+				for (x = 0; x < hi->idx; x++) {
+					stream.write_function(&stream, "%s%s", x ? "|:" : "", hi->array[x]);
+				}
+				val = (char *) stream.data;
+			}
+
+			val = switch_str_nil(val);
+			vh = rj_hash(val, strlen(val));
+			var = rj_chan_var(session, rc, hi->name);
+
+			if (!var->live || var->val_hash != vh) {
+				if (b) {
+					rj_buf_add(b, hi->name, val, (uint32_t) strlen(val));
+				}
+				var->val_hash = vh;
+				var->live = 1;
+			}
+
+			var->seen = pass;
+			switch_safe_free(stream.data);
+		}
+
+		switch_channel_variable_last(channel);
+	}
+
+	for (i = 0; i < rc->size; i++) {
+		rj_var_t *var = &rc->vars[i];
+
+		if (var->name && var->live && var->seen != pass) {
+			if (b) {
+				rj_buf_add(b, var->name, NULL, 0);
+			}
+			var->live = 0;
+		}
+	}
+}
+
+switch_bool_t switch_core_recovery_journal_ready(void)
+{
+	return globals.ready ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+void switch_core_recovery_journal_track(switch_core_session_t *session, const char *technology, const char *profile_name)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	switch_caller_profile_t *cp = switch_channel_get_caller_profile(channel);
+	switch_caller_extension_t *extension = switch_channel_get_caller_extension(channel);
+	rj_chan_t *rc;
+	rj_buf_t b = { 0 };
+
+	if (!(rc = switch_channel_get_private(channel, RJ_PRIVATE))) {
+		switch_mutex_lock(globals.mutex);
+		if (!(rc = switch_channel_get_private(channel, RJ_PRIVATE))) {
+			rc = switch_core_session_alloc(session, sizeof(*rc));
+			switch_mutex_init(&rc->mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
+			switch_channel_set_private(channel, RJ_PRIVATE, rc);
+		}
+		switch_mutex_unlock(globals.mutex);
+	}
+
+	switch_mutex_lock(rc->mutex);
+
+	/* the whole cdr the first time and whenever the callflow moved on, a transfer for one */
+	if (!rc->written || rc->profile != cp || rc->extension != extension) {
+		switch_xml_t cdr = NULL;
+		char *xml_text = NULL;
+
+		/* remember the variables first, anything that changes before the cdr is built just gets written twice */
+		rj_chan_diff(session, rc, NULL);
+
+		if (switch_ivr_generate_xml_cdr(session, &cdr) == SWITCH_STATUS_SUCCESS) {
+			xml_text = switch_xml_toxml_nolock(cdr, SWITCH_FALSE);
+			switch_xml_free(cdr);
+		}
+
+		if (xml_text) {
+			rj_buf_begin(&b, RJ_TRACK);
+			rj_buf_add_str(&b, "uuid", switch_core_session_get_uuid(session));
+			rj_buf_add_str(&b, "technology", technology);
+			rj_buf_add_str(&b, "profile", profile_name);
+			rj_buf_add_str(&b, "hostname", switch_core_get_switchname());
+			rj_buf_add_str(&b, "runtime", switch_core_get_uuid());
+			rj_buf_add_str(&b, "xml", xml_text);
+			rj_buf_end(&b);
+			free(xml_text);
+
+			rc->written = 1;
+			rc->profile = cp;
+			rc->extension = extension;
+		}
+	} else {
+		rj_buf_begin(&b, RJ_VARS);
+		rj_buf_add_str(&b, "uuid", switch_core_session_get_uuid(session));
+		rj_chan_diff(session, rc, &b);
+
+		if (b.fields > 1) {
+			rj_buf_end(&b);
+		} else {
+			b.len = 0;
+		}
+	}
+
+	switch_mutex_unlock(rc->mutex);
+
+	if (b.len) {
+		rj_append_to(&globals.local, &b);
+		switch_channel_set_flag(channel, CF_TRACKED);
+	}
+
+	switch_safe_free(b.data);
+}
+
+void switch_core_recovery_journal_untrack(switch_core_session_t *session)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	rj_chan_t *rc;
+	rj_buf_t b = { 0 };
+
+	if ((rc = switch_channel_get_private(channel, RJ_PRIVATE))) {
+		switch_mutex_lock(rc->mutex);
+		rc->written = 0;
+		switch_mutex_unlock(rc->mutex);
+	}
+
+	rj_buf_begin(&b, RJ_UNTRACK);
+	rj_buf_add_str(&b, "uuid", switch_core_session_get_uuid(session));
+	rj_buf_end(&b);
+	rj_append_to(&globals.local, &b);
+	switch_safe_free(b.data);
+
+	switch_channel_clear_flag(channel, CF_TRACKED);
+}
+
+static void rj_remove(rj_type_t type, const char *technology, const char *profile_name, const char *runtime_uuid)
+{
+	rj_buf_t b = { 0 };
+
+	rj_buf_begin(&b, type);
+	rj_buf_add_str(&b, "technology", technology);
+	rj_buf_add_str(&b, "profile", profile_name);
+	if (runtime_uuid) {
+		rj_buf_add_str(&b, "runtime", runtime_uuid);
+	}
+	rj_buf_end(&b);
+
+	rj_append_to(&globals.local, &b);
+	if (globals.replica.map) {
+		rj_append_to(&globals.replica, &b);
+	}
+
+	switch_safe_free(b.data);
+}
+
+void switch_core_recovery_journal_flush(const char *technology, const char *profile_name)
+{
+	if (zstr(technology) && !zstr(profile_name)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "INVALID\n");
+		return;
+	}
+
+	rj_remove(RJ_FLUSH, technology, profile_name, NULL);
+}
+
+int switch_core_recovery_journal_recover(const char *technology, const char *profile_name)
+{
+	rj_state_t state = { 0 };
+	rj_call_t *call;
+	const char *runtime_uuid = switch_core_get_uuid();
+	int r = 0;
+
+	switch_core_hash_init(&state.hash, NULL);
+
+	switch_mutex_lock(globals.mutex);
+	rj_replay(&globals.local, &state);
+	/* whatever the standby got from the other box comes after our own history */
+	rj_replay(&globals.replica, &state);
+	switch_mutex_unlock(globals.mutex);
+
+	for (call = state.calls; call; call = call->next) {
+		if (call->dead || !strcmp(call->runtime_uuid, runtime_uuid)) {
+			continue;
+		}
+
+		if ((zstr(technology) || !strcasecmp(technology, call->technology)) &&
+			(zstr(profile_name) || !strcasecmp(profile_name, switch_str_nil(call->profile_name)))) {
+			r += switch_core_recovery_resurrect(call->technology, call->xml);
+		}
+	}
+
+	rj_state_destroy(&state);
+
+	/* the recovered calls get tracked again under this runtime */
+	rj_remove(RJ_PURGE, technology, profile_name, runtime_uuid);
+
+	return r;
+}
+
+/* copy whole records from off on, so a reset always lands on a record boundary */
+static switch_size_t rj_copy_records(rj_file_t *file, uint64_t off, rj_buf_t *b)
+{
+	b->len = 0;
+
+	while (off + sizeof(rj_record_t) <= file->hdr->head && b->len < RJ_SEND_CHUNK) {
+		rj_record_t *rec = (rj_record_t *) (file->map + off);
+
+		if (rec->magic != RJ_RECORD_MAGIC || rec->len < sizeof(*rec) || off + rec->len > file->hdr->head) {
+			break;
+		}
+
+		rj_buf_need(b, rec->len);
+		memcpy(b->data + b->len, rec, rec->len);
+		b->len += rec->len;
+		off += rec->len;
+	}
+
+	return b->len;
+}
+
+#ifndef WIN32
+static void rj_file_discard(rj_file_t *file, const char *path)
+{
+	munmap(file->map, (size_t) file->size);
+	close(file->fd);
+	unlink(path);
+}
+
+/* rewrite a journal as one RJ_TRACK per call still up followed by whatever got appended meanwhile,
+   only the swap at the end is done under globals.mutex */
+static void rj_compact(rj_file_t *file)
+{
+	rj_state_t state = { 0 };
+	rj_buf_t b = { 0 }, out = { 0 };
+	rj_file_t tmp = { 0 }, old;
+	rj_call_t *call;
+	uint64_t upto, generation, before, size, tail;
+	uint32_t live = 0, dropped;
+	char *path = NULL;
+
+	switch_mutex_lock(globals.mutex);
+	if (file->hdr->head < file->compact_at && !file->dropped) {
+		/* reset since the compactor looked, the standby is refilling it from scratch */
+		switch_mutex_unlock(globals.mutex);
+		return;
+	}
+	upto = file->hdr->head;
+	generation = file->hdr->generation;
+	switch_mutex_unlock(globals.mutex);
+
+	/* nothing below upto is written again unless the journal is reset, which moves the generation */
+	switch_core_hash_init(&state.hash, NULL);
+	rj_replay_to(file, upto, &state);
+
+	for (call = state.calls; call; call = call->next) {
+		char *xml_text;
+
+		if (call->dead || !(xml_text = switch_xml_toxml_nolock(call->xml, SWITCH_FALSE))) {
+			continue;
+		}
+
+		rj_buf_begin(&b, RJ_TRACK);
+		rj_buf_add_str(&b, "uuid", call->uuid);
+		rj_buf_add_str(&b, "technology", call->technology);
+		rj_buf_add_str(&b, "profile", call->profile_name);
+		rj_buf_add_str(&b, "hostname", call->hostname);
+		rj_buf_add_str(&b, "runtime", call->runtime_uuid);
+		rj_buf_add_str(&b, "xml", xml_text);
+		rj_buf_end(&b);
+		free(xml_text);
+
+		rj_buf_need(&out, b.len);
+		memcpy(out.data + out.len, b.data, b.len);
+		out.len += b.len;
+		live++;
+	}
+
+	rj_state_destroy(&state);
+
+	/* room for the calls up twice over and for anything that lands before the swap, never smaller than now */
+	size = file->size;
+	if (size < (RJ_DATA_START + out.len) * 2) {
+		size = (RJ_DATA_START + out.len) * 2;
+	}
+	if (size < RJ_DATA_START + out.len + (file->size - upto)) {
+		size = RJ_DATA_START + out.len + (file->size - upto);
+	}
+	size = (size + 1048575) & ~(uint64_t) 1048575;
+
+	if (size > file->size) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Recovery journal %s grows from %" SWITCH_UINT64_T_FMT " to %"
+						  SWITCH_UINT64_T_FMT " bytes to hold %u calls, raise recovery-journal-size-mb\n", file->name, file->size, size, live);
+	}
+
+	path = switch_mprintf("%s.compact", file->name);
+	unlink(path);
+
+	if (rj_file_open(&tmp, path, size) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Recovery journal %s cannot be compacted\n", file->name);
+		goto end;
+	}
+
+	if (out.len) {
+		memcpy(tmp.map + RJ_DATA_START, out.data, out.len);
+	}
+	tmp.hdr->head = RJ_DATA_START + out.len;
+	tmp.hdr->generation = generation + 1;
+	msync(tmp.map, (size_t) tmp.hdr->head, MS_SYNC);
+
+	switch_mutex_lock(globals.mutex);
+
+	if (file->hdr->generation != generation) {
+		/* the standby was reset under us, what we built is stale */
+		switch_mutex_unlock(globals.mutex);
+		rj_file_discard(&tmp, path);
+		goto end;
+	}
+
+	/* whatever was appended while we worked applies on top of the snapshot */
+	tail = file->hdr->head - upto;
+	memcpy(tmp.map + tmp.hdr->head, file->map + upto, (size_t) tail);
+	tmp.hdr->head += tail;
+
+	if (rename(path, file->name)) {
+		switch_mutex_unlock(globals.mutex);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Recovery journal %s cannot be replaced: %s\n", file->name, strerror(errno));
+		rj_file_discard(&tmp, path);
+		goto end;
+	}
+
+	old = *file;
+	before = old.hdr->head;
+	dropped = old.dropped;
+	tmp.name = old.name;
+	tmp.compact_at = tmp.hdr->head + (tmp.size - tmp.hdr->head) / 2;
+	*file = tmp;
+
+	if (file == &globals.local) {
+		switch_thread_cond_signal(globals.cond);
+	}
+
+	switch_mutex_unlock(globals.mutex);
+
+	munmap(old.map, (size_t) old.size);
+	close(old.fd);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, dropped ? SWITCH_LOG_CRIT : SWITCH_LOG_NOTICE, "Compacted recovery journal %s from %" SWITCH_UINT64_T_FMT
+					  " to %" SWITCH_UINT64_T_FMT " bytes, %u calls, %u records were dropped before\n", file->name, before, tmp.hdr->head, live, dropped);
+
+  end:
+
+	switch_safe_free(path);
+	switch_safe_free(b.data);
+	switch_safe_free(out.data);
+}
+
+static void *SWITCH_THREAD_FUNC rj_compactor_run(switch_thread_t *thread, void *obj)
+{
+	while (globals.running) {
+		int local, replica;
+
+		switch_mutex_lock(globals.mutex);
+		switch_thread_cond_timedwait(globals.compact_cond, globals.mutex, 1000000);
+		local = globals.local.map && (globals.local.hdr->head >= globals.local.compact_at || globals.local.dropped);
+		replica = globals.replica.map && (globals.replica.hdr->head >= globals.replica.compact_at || globals.replica.dropped);
+		switch_mutex_unlock(globals.mutex);
+
+		if (local && globals.running) {
+			rj_compact(&globals.local);
+		}
+
+		if (replica && globals.running) {
+			rj_compact(&globals.replica);
+		}
+	}
+
+	return NULL;
+}
+#endif
+
+/* RJ_MAGIC and a 32 digit challenge, answered with md5(<challenge>:<recovery-journal-secret>) */
+static void rj_handshake_digest(const char *challenge, char digest[SWITCH_MD5_DIGEST_STRING_SIZE])
+{
+	char *input = switch_mprintf("%.32s:%s", challenge, switch_str_nil(globals.secret));
+
+	switch_md5_string(digest, input, strlen(input));
+	free(input);
+}
+
+static switch_status_t rj_recv_all(switch_socket_t *sock, switch_pollfd_t *pollfd, char *data, switch_size_t len)
+{
+	switch_time_t until = switch_micro_time_now() + RJ_HANDSHAKE_TIMEOUT;
+
+	while (len) {
+		switch_size_t n = len;
+		switch_status_t status;
+
+		if (pollfd && !switch_socket_waitfor(pollfd, 500000)) {
+			if (switch_micro_time_now() > until || !globals.running) {
+				return SWITCH_STATUS_FALSE;
+			}
+			continue;
+		}
+
+		status = switch_socket_recv(sock, data, &n);
+
+		if (SWITCH_STATUS_IS_BREAK(status) && switch_micro_time_now() <= until) {
+			continue;
+		}
+
+		if (status != SWITCH_STATUS_SUCCESS || !n) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		data += n;
+		len -= n;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t rj_send_all(switch_socket_t *sock, const uint8_t *data, switch_size_t len)
+{
+	while (len) {
+		switch_size_t n = len;
+
+		if (switch_socket_send(sock, (const char *) data, &n) != SWITCH_STATUS_SUCCESS || !n) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		data += n;
+		len -= n;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* primary side, streams the local journal to the standby and starts over after a compaction */
+static void *SWITCH_THREAD_FUNC rj_sender_run(switch_thread_t *thread, void *obj)
+{
+	rj_buf_t b = { 0 }, reset = { 0 };
+	int connected_once = 0;
+
+	rj_buf_begin(&reset, RJ_RESET);
+	rj_buf_end(&reset);
+
+	while (globals.running) {
+		switch_memory_pool_t *pool = NULL;
+		switch_sockaddr_t *sa;
+		switch_socket_t *sock = NULL;
+		uint64_t sent = RJ_DATA_START, generation;
+
+		switch_core_new_memory_pool(&pool);
+
+		if (switch_sockaddr_info_get(&sa, globals.standby_host, SWITCH_UNSPEC, globals.standby_port, 0, pool) != SWITCH_STATUS_SUCCESS ||
+			switch_socket_create(&sock, switch_sockaddr_get_family(sa), SOCK_STREAM, SWITCH_PROTO_TCP, pool) != SWITCH_STATUS_SUCCESS ||
+			switch_socket_connect(sock, sa) != SWITCH_STATUS_SUCCESS) {
+			if (sock) {
+				switch_socket_close(sock);
+			}
+			switch_core_destroy_memory_pool(&pool);
+			if (connected_once) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Recovery journal standby %s:%d unreachable\n",
+								  globals.standby_host, globals.standby_port);
+				connected_once = 0;
+			}
+			switch_yield(1000000);
+			continue;
+		}
+
+		switch_socket_opt_set(sock, SWITCH_SO_TCP_NODELAY, 1);
+
+		{
+			char hello[RJ_HELLO_LEN], digest[SWITCH_MD5_DIGEST_STRING_SIZE];
+
+			switch_socket_timeout_set(sock, RJ_HANDSHAKE_TIMEOUT);
+
+			if (rj_recv_all(sock, NULL, hello, sizeof(hello)) != SWITCH_STATUS_SUCCESS || memcmp(hello, RJ_MAGIC, 4)) {
+				if (connected_once) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Recovery journal standby %s:%d did not greet us, check recovery-journal-acl there\n",
+									  globals.standby_host, globals.standby_port);
+					connected_once = 0;
+				}
+				switch_socket_close(sock);
+				switch_core_destroy_memory_pool(&pool);
+				switch_yield(1000000);
+				continue;
+			}
+
+			rj_handshake_digest(hello + 4, digest);
+			switch_socket_timeout_set(sock, -1);
+
+			if (rj_send_all(sock, (const uint8_t *) digest, 32) != SWITCH_STATUS_SUCCESS) {
+				goto next;
+			}
+		}
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Recovery journal streaming to %s:%d\n", globals.standby_host, globals.standby_port);
+		connected_once = 1;
+
+		switch_mutex_lock(globals.mutex);
+		generation = globals.local.hdr->generation;
+		switch_mutex_unlock(globals.mutex);
+
+		if (rj_send_all(sock, reset.data, reset.len) != SWITCH_STATUS_SUCCESS) {
+			goto next;
+		}
+
+		while (globals.running) {
+			int restart = 0;
+
+			switch_mutex_lock(globals.mutex);
+
+			if (globals.local.hdr->generation != generation) {
+				generation = globals.local.hdr->generation;
+				sent = RJ_DATA_START;
+				restart = 1;
+				b.len = 0;
+			} else if (sent >= globals.local.hdr->head) {
+				switch_thread_cond_timedwait(globals.cond, globals.mutex, 100000);
+				b.len = 0;
+			} else {
+				sent += rj_copy_records(&globals.local, sent, &b);
+			}
+
+			switch_mutex_unlock(globals.mutex);
+
+			if (restart && rj_send_all(sock, reset.data, reset.len) != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
+
+			if (b.len && rj_send_all(sock, b.data, b.len) != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
+		}
+
+	  next:
+		switch_socket_close(sock);
+		switch_core_destroy_memory_pool(&pool);
+	}
+
+	switch_safe_free(b.data);
+	switch_safe_free(reset.data);
+
+	return NULL;
+}
+
+/* standby side, takes one primary at a time and keeps what it sends in the replica */
+static void *SWITCH_THREAD_FUNC rj_receiver_run(switch_thread_t *thread, void *obj)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_sockaddr_t *sa;
+	switch_socket_t *listen_sock = NULL;
+	rj_buf_t b = { 0 };
+
+	switch_core_new_memory_pool(&pool);
+
+	if (switch_sockaddr_info_get(&sa, globals.listen_host, SWITCH_UNSPEC, globals.listen_port, 0, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_create(&listen_sock, switch_sockaddr_get_family(sa), SOCK_STREAM, SWITCH_PROTO_TCP, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_opt_set(listen_sock, SWITCH_SO_REUSEADDR, 1) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_bind(listen_sock, sa) != SWITCH_STATUS_SUCCESS || switch_socket_listen(listen_sock, 1) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Recovery journal cannot listen on %s:%d\n", globals.listen_host, globals.listen_port);
+		goto end;
+	}
+
+	switch_socket_timeout_set(listen_sock, 500000);
+
+	while (globals.running) {
+		switch_socket_t *sock = NULL;
+		switch_memory_pool_t *cpool = NULL;
+		switch_pollfd_t *pollfd = NULL;
+
+		switch_core_new_memory_pool(&cpool);
+
+		if (switch_socket_accept(&sock, listen_sock, cpool) != SWITCH_STATUS_SUCCESS) {
+			switch_core_destroy_memory_pool(&cpool);
+			continue;
+		}
+
+		switch_socket_create_pollset(&pollfd, sock, SWITCH_POLLIN | SWITCH_POLLERR, cpool);
+
+		{
+			switch_sockaddr_t *remote = NULL;
+			char ip[80] = "", hello[RJ_HELLO_LEN], reply[32], digest[SWITCH_MD5_DIGEST_STRING_SIZE], uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+			int i, diff = 0;
+
+			switch_socket_addr_get(&remote, SWITCH_TRUE, sock);
+			if (remote) {
+				switch_get_addr(ip, sizeof(ip), remote);
+			}
+
+			if (zstr(ip) || !switch_check_network_list_ip(ip, globals.acl)) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Recovery journal connection from %s denied by %s\n", ip, globals.acl);
+				goto drop_quiet;
+			}
+
+			memcpy(hello, RJ_MAGIC, 4);
+			switch_md5_string(digest, switch_uuid_str(uuid_str, sizeof(uuid_str)), strlen(uuid_str));
+			memcpy(hello + 4, digest, 32);
+			rj_handshake_digest(hello + 4, digest);
+
+			if (rj_send_all(sock, (const uint8_t *) hello, sizeof(hello)) != SWITCH_STATUS_SUCCESS ||
+				rj_recv_all(sock, pollfd, reply, sizeof(reply)) != SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Recovery journal connection from %s did not answer the challenge\n", ip);
+				goto drop_quiet;
+			}
+
+			for (i = 0; i < 32; i++) {
+				diff |= reply[i] ^ digest[i];
+			}
+
+			if (diff) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Recovery journal connection from %s failed the challenge, check recovery-journal-secret\n", ip);
+				goto drop_quiet;
+			}
+
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Recovery journal primary %s connected\n", ip);
+		}
+
+		b.len = 0;
+
+		while (globals.running) {
+			char tmp[RJ_SEND_CHUNK];
+			switch_size_t n = sizeof(tmp), off = 0;
+			switch_status_t status;
+
+			/* wake up now and then to notice a shutdown */
+			if (!switch_socket_waitfor(pollfd, 500000)) {
+				continue;
+			}
+
+			status = switch_socket_recv(sock, tmp, &n);
+
+			if (SWITCH_STATUS_IS_BREAK(status)) {
+				continue;
+			}
+
+			if (status != SWITCH_STATUS_SUCCESS || !n) {
+				break;
+			}
+
+			rj_buf_need(&b, n);
+			memcpy(b.data + b.len, tmp, n);
+			b.len += n;
+
+			while (b.len - off >= sizeof(rj_record_t)) {
+				rj_record_t rec;
+				rj_buf_t one;
+
+				memcpy(&rec, b.data + off, sizeof(rec));
+
+				if (rec.magic != RJ_RECORD_MAGIC || rec.len < sizeof(rec) || rec.len > globals.replica.size - RJ_DATA_START) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Recovery journal stream out of sync, dropping the primary\n");
+					goto drop;
+				}
+
+				if (b.len - off < rec.len) {
+					break;
+				}
+
+				if (rec.type == RJ_RESET) {
+					switch_mutex_lock(globals.mutex);
+					globals.replica.hdr->head = RJ_DATA_START;
+					globals.replica.hdr->generation++;
+					switch_mutex_unlock(globals.mutex);
+				} else {
+					one.data = b.data + off;
+					one.len = rec.len;
+					rj_append_to(&globals.replica, &one);
+				}
+
+				off += rec.len;
+			}
+
+			memmove(b.data, b.data + off, b.len - off);
+			b.len -= off;
+		}
+
+	  drop:
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Recovery journal primary gone\n");
+	  drop_quiet:
+		switch_socket_close(sock);
+		switch_core_destroy_memory_pool(&cpool);
+	}
+
+  end:
+
+	if (listen_sock) {
+		switch_socket_close(listen_sock);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+	switch_safe_free(b.data);
+
+	return NULL;
+}
+
+static switch_status_t rj_parse_host_port(const char *str, char **host, switch_port_t *port)
+{
+	char *p;
+
+	*host = switch_core_strdup(globals.pool, str);
+
+	if (!(p = strrchr(*host, ':')) || !(*port = (switch_port_t) atoi(p + 1))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid recovery journal address %s, want host:port\n", str);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	*p = '\0';
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+void switch_core_recovery_journal_init(void)
+{
+#ifdef WIN32
+	if (runtime.recovery_journal) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "The recovery journal is not available on this platform, using the recovery table\n");
+	}
+#else
+	switch_threadattr_t *thd_attr = NULL;
+	uint64_t size = (uint64_t) (runtime.recovery_journal_size_mb ? runtime.recovery_journal_size_mb : RJ_DEFAULT_SIZE_MB) * 1024 * 1024;
+
+	if (zstr(runtime.recovery_journal)) {
+		return;
+	}
+
+	memset(&globals, 0, sizeof(globals));
+	switch_core_new_memory_pool(&globals.pool);
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_thread_cond_create(&globals.cond, globals.pool);
+	switch_thread_cond_create(&globals.compact_cond, globals.pool);
+	globals.acl = switch_core_strdup(globals.pool, zstr(runtime.recovery_journal_acl) ? RJ_DEFAULT_ACL : runtime.recovery_journal_acl);
+	if (!zstr(runtime.recovery_journal_secret)) {
+		globals.secret = switch_core_strdup(globals.pool, runtime.recovery_journal_secret);
+	}
+
+	if (rj_file_open(&globals.local, runtime.recovery_journal, size) != SWITCH_STATUS_SUCCESS) {
+		switch_core_destroy_memory_pool(&globals.pool);
+		return;
+	}
+
+	globals.running = 1;
+	switch_threadattr_create(&thd_attr, globals.pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	if (!zstr(runtime.recovery_journal_listen) &&
+		rj_parse_host_port(runtime.recovery_journal_listen, &globals.listen_host, &globals.listen_port) == SWITCH_STATUS_SUCCESS) {
+		char *path = switch_core_sprintf(globals.pool, "%s.replica", runtime.recovery_journal);
+
+		if (!globals.secret) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "recovery-journal-listen without recovery-journal-secret, "
+							  "only recovery-journal-acl (%s) keeps strangers from feeding calls to this box\n", globals.acl);
+		}
+
+		if (rj_file_open(&globals.replica, path, size) == SWITCH_STATUS_SUCCESS) {
+			switch_thread_create(&globals.receiver, thd_attr, rj_receiver_run, NULL, globals.pool);
+		}
+	}
+
+	if (!zstr(runtime.recovery_journal_standby) &&
+		rj_parse_host_port(runtime.recovery_journal_standby, &globals.standby_host, &globals.standby_port) == SWITCH_STATUS_SUCCESS) {
+		switch_thread_create(&globals.sender, thd_attr, rj_sender_run, NULL, globals.pool);
+	}
+
+	switch_thread_create(&globals.compactor, thd_attr, rj_compactor_run, NULL, globals.pool);
+
+	globals.ready = 1;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Recovery journal %s, %" SWITCH_UINT64_T_FMT " of %" SWITCH_UINT64_T_FMT " bytes used\n",
+					  globals.local.name, globals.local.hdr->head, globals.local.size);
+#endif
+}
+
+void switch_core_recovery_journal_shutdown(void)
+{
+#ifndef WIN32
+	switch_status_t st;
+
+	if (!globals.ready) {
+		return;
+	}
+
+	globals.ready = 0;
+	globals.running = 0;
+
+	switch_mutex_lock(globals.mutex);
+	switch_thread_cond_signal(globals.cond);
+	switch_thread_cond_signal(globals.compact_cond);
+	switch_mutex_unlock(globals.mutex);
+
+	if (globals.compactor) {
+		switch_thread_join(&st, globals.compactor);
+	}
+
+	if (globals.sender) {
+		switch_thread_join(&st, globals.sender);
+	}
+
+	if (globals.receiver) {
+		switch_thread_join(&st, globals.receiver);
+	}
+
+	rj_file_close(&globals.local);
+	rj_file_close(&globals.replica);
+	switch_core_destroy_memory_pool(&globals.pool);
+#endif
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
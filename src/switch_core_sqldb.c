@@ -2659,6 +2659,11 @@ SWITCH_DECLARE(void) switch_core_recovery_flush(const char *technology, const ch
 	char *sql = NULL;
 	switch_cache_db_handle_t *dbh;
 
+	if (switch_core_recovery_journal_ready()) {
+		switch_core_recovery_journal_flush(technology, profile_name);
+		return;
+	}
+
 	if (switch_core_db_handle(&dbh) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening DB!\n");
 		return;
@@ -2689,23 +2694,13 @@ SWITCH_DECLARE(void) switch_core_recovery_flush(const char *technology, const ch
 }
 
 
-static int recover_callback(void *pArg, int argc, char **argv, char **columnNames)
+int switch_core_recovery_resurrect(const char *technology, switch_xml_t xml)
 {
-	int *rp = (int *) pArg;
-	switch_xml_t xml;
 	switch_endpoint_interface_t *ep;
 	switch_core_session_t *session;
+	int r = 0;
 
-	if (argc < 4) {
-		return 0;
-	}
-	
-	if (!(xml = switch_xml_parse_str_dynamic(argv[4], SWITCH_TRUE))) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "XML ERROR\n");
-		return 0;
-	}
-
-	if (!(ep = switch_loadable_module_get_endpoint_interface(argv[0]))) {
+	if (!(ep = switch_loadable_module_get_endpoint_interface(technology))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "EP ERROR\n");
 		return 0;
 	}
@@ -2749,12 +2744,12 @@ static int recover_callback(void *pArg, int argc, char **argv, char **columnName
 							  "Resurrecting fallen channel %s\n", switch_channel_get_name(channel));
 			switch_core_session_thread_launch(session);
 
-			*rp = (*rp) + 1;
+			r++;
 			
 		}
 
 	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Endpoint %s has no recovery function\n", argv[0]);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Endpoint %s has no recovery function\n", technology);
 	}
 
 
@@ -2762,6 +2757,25 @@ static int recover_callback(void *pArg, int argc, char **argv, char **columnName
 
 	UNPROTECT_INTERFACE(ep);
 
+	return r;
+}
+
+static int recover_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	int *rp = (int *) pArg;
+	switch_xml_t xml;
+
+	if (argc < 4) {
+		return 0;
+	}
+	
+	if (!(xml = switch_xml_parse_str_dynamic(argv[4], SWITCH_TRUE))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "XML ERROR\n");
+		return 0;
+	}
+
+	*rp += switch_core_recovery_resurrect(argv[0], xml);
+
 	switch_xml_free(xml);
 
 	return 0;
@@ -2775,6 +2789,10 @@ SWITCH_DECLARE(int) switch_core_recovery_recover(const char *technology, const c
 	switch_cache_db_handle_t *dbh;
 	int r = 0;
 
+	if (switch_core_recovery_journal_ready()) {
+		return switch_core_recovery_journal_recover(technology, profile_name);
+	}
+
 	if (!sql_manager.manage) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "DATABASE NOT AVAIALBLE, REVCOVERY NOT POSSIBLE\n");
 		return 0;
@@ -2879,7 +2897,7 @@ SWITCH_DECLARE(void) switch_core_recovery_untrack(switch_core_session_t *session
 	char *sql = NULL;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 
-	if (!sql_manager.manage) {
+	if (!sql_manager.manage && !switch_core_recovery_journal_ready()) {
 		return;
 	}
 
@@ -2897,6 +2915,11 @@ SWITCH_DECLARE(void) switch_core_recovery_untrack(switch_core_session_t *session
 
 	if (switch_channel_test_flag(channel, CF_TRACKED) || force) {
 
+		if (switch_core_recovery_journal_ready()) {
+			switch_core_recovery_journal_untrack(session);
+			return;
+		}
+
 		if (force) {
 			sql = switch_mprintf("delete from recovery where uuid='%q'", switch_core_session_get_uuid(session));
 			
@@ -2921,7 +2944,7 @@ SWITCH_DECLARE(void) switch_core_recovery_track(switch_core_session_t *session)
 	const char *profile_name;
 	const char *technology;
 
-	if (!sql_manager.manage) {
+	if (!sql_manager.manage && !switch_core_recovery_journal_ready()) {
 		return;
 	}
 
@@ -2936,6 +2959,11 @@ SWITCH_DECLARE(void) switch_core_recovery_track(switch_core_session_t *session)
 	profile_name = switch_channel_get_variable_dup(channel, "recovery_profile_name", SWITCH_FALSE, -1);
 	technology = session->endpoint_interface->interface_name;
 
+	if (switch_core_recovery_journal_ready()) {
+		switch_core_recovery_journal_track(session, technology, profile_name);
+		return;
+	}
+
 	if (switch_ivr_generate_xml_cdr(session, &cdr) == SWITCH_STATUS_SUCCESS) {
 		xml_cdr_text = switch_xml_toxml_nolock(cdr, SWITCH_FALSE);
 		switch_xml_free(cdr);
@@ -44,10 +44,9 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_sound_test(switch_core_session_t *ses
 
 	switch_codec_implementation_t imp = { 0 };
 	switch_codec_t codec = { 0 };
-	int16_t peak = 0;
+	uint32_t peak = 0;
 	int16_t *data;
 	switch_frame_t *read_frame = NULL;
-	uint32_t i;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 	int64_t global_total = 0, global_sum = 0, period_sum = 0;
@@ -86,17 +85,8 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_sound_test(switch_core_session_t *ses
 
 
 		data = (int16_t *) read_frame->data;
-		peak = 0;
-		avg = 0;
-		for (i = 0; i < read_frame->samples; i++) {
-			const int16_t s = (int16_t) abs(data[i]);
-			if (s > peak) {
-				peak = s;
-			}
-			avg += s;
-		}
-
-		avg /= read_frame->samples;
+		peak = switch_sln_peak(data, read_frame->samples, 1);
+		avg = switch_sln_energy(data, read_frame->samples, 1) / read_frame->samples;
 
 		period_sum += peak;
 		global_sum += peak;
@@ -107,7 +97,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_sound_test(switch_core_session_t *ses
 		period_avg = (int) (period_sum / period_total);
 
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CONSOLE,
-						  "\npacket_avg=%d packet_peak=%d period_avg=%d global_avg=%d\n\n", avg, peak, period_avg, global_avg);
+						  "\npacket_avg=%d packet_peak=%u period_avg=%d global_avg=%d\n\n", avg, peak, period_avg, global_avg);
 
 		if (period_total >= period_len) {
 			global_avg = (int) (global_sum / global_total);
@@ -34,6 +34,7 @@
  */
 
 #include <switch.h>
+#include "private/switch_core_pvt.h"
 #include <speex/speex_preprocess.h>
 #include <speex/speex_echo.h>
 
@@ -1014,6 +1015,280 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_displace_session(switch_core_session_
 }
 
 
+#define RECORD_ASYNC_WRITERS 4
+#define RECORD_ASYNC_CHUNK (64 * 1024)
+#define RECORD_ASYNC_BUFFER_MS 2000
+
+/* RECORD_ASYNC: the media thread only copies PCM into a single producer /
+   single consumer ring, one of the writer threads coalesces it and does the
+   encoding and the disk (or NFS) io */
+typedef struct record_async_writer_s record_async_writer_t;
+
+typedef struct record_async_s {
+	switch_file_handle_t *fh;
+	uint8_t *data;
+	uint32_t size;
+	uint32_t chunk;
+	uint32_t bytes_per_ms;
+	volatile switch_atomic_t head;
+	volatile switch_atomic_t tail;
+	volatile switch_atomic_t closing;
+	volatile switch_atomic_t done;
+	volatile switch_atomic_t error;
+	uint32_t dropped;
+	uint32_t max_backlog;
+	record_async_writer_t *writer;
+	struct record_async_s *next;
+} record_async_t;
+
+struct record_async_writer_s {
+	switch_thread_t *thread;
+	switch_mutex_t *mutex;
+	record_async_t *pending;
+	record_async_t *list;
+	volatile switch_atomic_t running;
+	uint8_t buf[RECORD_ASYNC_CHUNK];
+};
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	record_async_writer_t writers[RECORD_ASYNC_WRITERS];
+	uint32_t next;
+	volatile switch_atomic_t running;
+} record_async_globals;
+
+/* producer side, the media thread; acquire on tail so the copy cannot overtake the writer still reading
+   those bytes, release on head so the writer never sees the new head before the bytes */
+static void record_async_push(record_async_t *ra, const void *data, uint32_t len)
+{
+	uint32_t head = ra->head;
+	uint32_t used = head - switch_atomic_read_acquire(&ra->tail);
+	uint32_t off = head & (ra->size - 1), first = ra->size - off;
+
+	if (len > ra->size - used) {
+		ra->dropped++;
+		return;
+	}
+
+	if (first > len) {
+		first = len;
+	}
+
+	memcpy(ra->data + off, data, first);
+	if (len > first) {
+		memcpy(ra->data, (const uint8_t *) data + first, len - first);
+	}
+
+	switch_atomic_set_release(&ra->head, head + len);
+
+	if ((used += len) > ra->max_backlog) {
+		ra->max_backlog = used;
+	}
+}
+
+/* consumer side, only ever run by one thread at a time for a given ring */
+static void record_async_drain(record_async_t *ra, uint8_t *buf, uint32_t buflen, int flush)
+{
+	uint32_t used, off, first, n;
+	switch_size_t len;
+
+	while ((used = switch_atomic_read_acquire(&ra->head) - ra->tail) && (flush || used >= ra->chunk)) {
+		n = used > buflen ? buflen : used;
+		off = ra->tail & (ra->size - 1);
+		first = ra->size - off;
+
+		if (first > n) {
+			first = n;
+		}
+
+		memcpy(buf, ra->data + off, first);
+		if (n > first) {
+			memcpy(buf + first, ra->data, n - first);
+		}
+
+		switch_atomic_set_release(&ra->tail, ra->tail + n);
+
+		if (!switch_atomic_read(&ra->error)) {
+			len = n / 2;
+			if (switch_core_file_write(ra->fh, buf, &len) != SWITCH_STATUS_SUCCESS) {
+				switch_atomic_inc(&ra->error);
+			}
+		}
+	}
+}
+
+static void *SWITCH_THREAD_FUNC record_async_writer_thread(switch_thread_t *thread, void *obj)
+{
+	record_async_writer_t *writer = (record_async_writer_t *) obj;
+	record_async_t *ra, *next, *last;
+	int linger = 250;
+
+	for (;;) {
+		switch_mutex_lock(writer->mutex);
+		while ((ra = writer->pending)) {
+			writer->pending = ra->next;
+			ra->next = writer->list;
+			writer->list = ra;
+		}
+		switch_mutex_unlock(writer->mutex);
+
+		if (!switch_atomic_read(&record_async_globals.running) && (!writer->list || --linger <= 0)) {
+			break;
+		}
+
+		last = NULL;
+		for (ra = writer->list; ra; ra = next) {
+			int closing = switch_atomic_read(&ra->closing);
+
+			next = ra->next;
+			record_async_drain(ra, writer->buf, sizeof(writer->buf), closing);
+
+			if (closing) {
+				if (last) {
+					last->next = next;
+				} else {
+					writer->list = next;
+				}
+				switch_atomic_inc(&ra->done);
+			} else {
+				last = ra;
+			}
+		}
+
+		switch_yield(20000);
+	}
+
+	writer->list = NULL;
+	switch_atomic_set(&writer->running, 0);
+
+	return NULL;
+}
+
+void switch_ivr_record_async_init(switch_memory_pool_t *pool)
+{
+	int i;
+
+	memset(&record_async_globals, 0, sizeof(record_async_globals));
+	record_async_globals.pool = pool;
+	switch_mutex_init(&record_async_globals.mutex, SWITCH_MUTEX_NESTED, pool);
+
+	for (i = 0; i < RECORD_ASYNC_WRITERS; i++) {
+		switch_mutex_init(&record_async_globals.writers[i].mutex, SWITCH_MUTEX_NESTED, pool);
+	}
+
+	switch_atomic_set(&record_async_globals.running, 1);
+}
+
+void switch_ivr_record_async_shutdown(void)
+{
+	switch_status_t st;
+	int i;
+
+	if (!record_async_globals.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(record_async_globals.mutex);
+	switch_atomic_set(&record_async_globals.running, 0);
+	switch_mutex_unlock(record_async_globals.mutex);
+
+	for (i = 0; i < RECORD_ASYNC_WRITERS; i++) {
+		if (record_async_globals.writers[i].thread) {
+			switch_thread_join(&st, record_async_globals.writers[i].thread);
+			record_async_globals.writers[i].thread = NULL;
+		}
+	}
+}
+
+static record_async_t *record_async_start(switch_core_session_t *session, switch_file_handle_t *fh)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	record_async_writer_t *writer;
+	record_async_t *ra;
+	uint32_t bytes_per_ms, want, size = 4096;
+	int ms = RECORD_ASYNC_BUFFER_MS;
+	const char *p;
+
+	if (!record_async_globals.mutex) {
+		return NULL;
+	}
+
+	if ((p = switch_channel_get_variable(channel, "RECORD_ASYNC_BUFFER_MS"))) {
+		int tmp = atoi(p);
+		if (tmp > 0) {
+			ms = tmp;
+		}
+	}
+
+	bytes_per_ms = ((fh->samplerate ? fh->samplerate : 8000) / 1000) * (fh->channels ? fh->channels : 1) * 2;
+	want = bytes_per_ms * ms;
+
+	while (size < want) {
+		size <<= 1;
+	}
+
+	ra = switch_core_session_alloc(session, sizeof(*ra));
+	ra->data = switch_core_session_alloc(session, size);
+	ra->size = size;
+	ra->chunk = size / 2 < RECORD_ASYNC_CHUNK ? size / 2 : RECORD_ASYNC_CHUNK;
+	ra->bytes_per_ms = bytes_per_ms;
+	ra->fh = fh;
+
+	switch_mutex_lock(record_async_globals.mutex);
+
+	if (!switch_atomic_read(&record_async_globals.running)) {
+		switch_mutex_unlock(record_async_globals.mutex);
+		return NULL;
+	}
+
+	writer = &record_async_globals.writers[record_async_globals.next++ % RECORD_ASYNC_WRITERS];
+
+	if (!switch_atomic_read(&writer->running)) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		if (writer->thread) {
+			switch_status_t st;
+			switch_thread_join(&st, writer->thread);
+		}
+
+		switch_atomic_set(&writer->running, 1);
+		switch_threadattr_create(&thd_attr, record_async_globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		if (switch_thread_create(&writer->thread, thd_attr, record_async_writer_thread, writer, record_async_globals.pool) != SWITCH_STATUS_SUCCESS) {
+			switch_atomic_set(&writer->running, 0);
+			writer->thread = NULL;
+			switch_mutex_unlock(record_async_globals.mutex);
+			return NULL;
+		}
+	}
+
+	ra->writer = writer;
+	switch_mutex_lock(writer->mutex);
+	ra->next = writer->pending;
+	writer->pending = ra;
+	switch_mutex_unlock(writer->mutex);
+
+	switch_mutex_unlock(record_async_globals.mutex);
+
+	return ra;
+}
+
+/* hand the rest of the ring to the writer and wait until it is on disk */
+static void record_async_stop(record_async_t *ra)
+{
+	switch_atomic_inc(&ra->closing);
+
+	while (!switch_atomic_read_acquire(&ra->done) && switch_atomic_read(&ra->writer->running)) {
+		switch_yield(10000);
+	}
+
+	if (!switch_atomic_read_acquire(&ra->done)) {
+		uint8_t buf[SWITCH_RECOMMENDED_BUFFER_SIZE];
+		record_async_drain(ra, buf, sizeof(buf), 1);
+	}
+}
+
 struct record_helper {
 	char *file;
 	switch_file_handle_t *fh;
@@ -1033,6 +1308,8 @@ struct record_helper {
 	switch_time_t last_write_time;
 	switch_bool_t hangup_on_error;
 	switch_codec_implementation_t read_impl;
+	switch_bool_t async;
+	record_async_t *ra;
 };
 
 
@@ -1049,13 +1326,10 @@ static switch_bool_t is_silence_frame(switch_frame_t *frame, int silence_thresho
 	}
 
 	/* is silence only if every channel is silent */
+	samples /= codec_impl->number_of_channels;
+
 	for (channel_num = 0; channel_num < codec_impl->number_of_channels && is_silence; channel_num++) {
-		uint32_t count = 0, j = channel_num;
-		double energy = 0;
-		for (count = 0; count < samples; count++) {
-			energy += abs(fdata[j]);
-			j += codec_impl->number_of_channels;
-		}
+		double energy = switch_sln_energy(fdata + channel_num, samples, codec_impl->number_of_channels);
 		is_silence &= (uint32_t) ((energy / (samples / divisor)) < silence_threshold);
 	}
 
@@ -1086,6 +1360,12 @@ static switch_bool_t record_callback(switch_media_bug_t *bug, void *user_data, s
 
 		switch_core_session_get_read_impl(session, &rh->read_impl);
 
+		if (rh->async && rh->fh && !rh->native) {
+			if (!(rh->ra = record_async_start(session, rh->fh))) {
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "No async writer for %s, recording inline\n", rh->file);
+			}
+		}
+
 		break;
 	case SWITCH_ABC_TYPE_TAP_NATIVE_READ:
 		{
@@ -1186,6 +1466,18 @@ static switch_bool_t record_callback(switch_media_bug_t *bug, void *user_data, s
 				frame.data = data;
 				frame.buflen = SWITCH_RECOMMENDED_BUFFER_SIZE;
 
+				if (rh->ra) {
+					record_async_stop(rh->ra);
+
+					if (switch_atomic_read(&rh->ra->error)) {
+						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Error writing %s\n", rh->file);
+					}
+
+					switch_channel_set_variable_printf(channel, "record_async_dropped_frames", "%u", rh->ra->dropped);
+					switch_channel_set_variable_printf(channel, "record_async_max_backlog_ms", "%u", rh->ra->max_backlog / rh->ra->bytes_per_ms);
+					rh->ra = NULL;
+				}
+
 				while (switch_core_media_bug_read(bug, &frame, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS) {
 					len = (switch_size_t) frame.datalen / 2;
 
@@ -1265,7 +1557,25 @@ static switch_bool_t record_callback(switch_media_bug_t *bug, void *user_data, s
 				
 				len = (switch_size_t) frame.datalen / 2;
 
-				if (len && switch_core_file_write(rh->fh, mask ? null_data : data, &len) != SWITCH_STATUS_SUCCESS && rh->hangup_on_error) {
+				if (rh->ra) {
+					if (switch_atomic_read(&rh->ra->error) && rh->hangup_on_error) {
+						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Error writing %s\n", rh->file);
+						switch_channel_hangup(channel, SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER);
+						switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
+						return SWITCH_FALSE;
+					}
+
+					if (len) {
+						uint32_t dropped = rh->ra->dropped;
+
+						record_async_push(rh->ra, mask ? null_data : data, frame.datalen);
+
+						if (dropped != rh->ra->dropped && !dropped) {
+							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING,
+											  "Writer for %s is falling behind, dropping frames\n", rh->file);
+						}
+					}
+				} else if (len && switch_core_file_write(rh->fh, mask ? null_data : data, &len) != SWITCH_STATUS_SUCCESS && rh->hangup_on_error) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Error writing %s\n", rh->file);
 					switch_channel_hangup(channel, SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER);
 					switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
@@ -1342,6 +1652,12 @@ static void* switch_ivr_record_user_data_dup(switch_core_session_t *session, voi
 {
 	struct record_helper *rh = (struct record_helper *) user_data, *dup = NULL;
 
+	if (rh->ra) {
+		/* the writer must be done with the old handle before it is copied, INIT starts a new one */
+		record_async_stop(rh->ra);
+		rh->ra = NULL;
+	}
+
 	dup = switch_core_session_alloc(session, sizeof(*dup));
 	memcpy(dup, rh, sizeof(*rh));
 	dup->file = switch_core_session_strdup(session, rh->file);
@@ -2186,6 +2502,10 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_record_session(switch_core_session_t
 	}
 
 	rh->hangup_on_error = hangup_on_error;
+
+	if ((p = switch_channel_get_variable(channel, "RECORD_ASYNC"))) {
+		rh->async = switch_true(p);
+	}
 	
 	if ((status = switch_core_media_bug_add(session, "session_record", file,
 											record_callback, rh, to, flags, &bug)) != SWITCH_STATUS_SUCCESS) {
@@ -192,6 +192,46 @@ SWITCH_DECLARE(void) switch_ivr_bridge_display(switch_core_session_t *session, s
 
 }
 
+/* audio from a can skip the core and go straight out b's rtp only while nothing needs to see or touch it */
+static switch_bool_t bridge_can_relay(switch_core_session_t *session_a, switch_core_session_t *session_b)
+{
+	switch_channel_t *chan_a = switch_core_session_get_channel(session_a);
+	switch_channel_t *chan_b = switch_core_session_get_channel(session_b);
+	switch_codec_implementation_t read_impl = { 0 }, write_impl = { 0 };
+
+	if (!switch_channel_test_flag(chan_a, CF_ANSWERED) || !switch_channel_test_flag(chan_b, CF_ANSWERED) ||
+		!switch_channel_media_ack(chan_a) || !switch_channel_media_ack(chan_b) || !switch_channel_test_flag(chan_b, CF_BRIDGED)) {
+		return SWITCH_FALSE;
+	}
+
+	if (switch_channel_test_flag(chan_a, CF_HOLD) || switch_channel_test_flag(chan_b, CF_HOLD) ||
+		switch_channel_test_flag(chan_a, CF_SUSPEND) || switch_channel_test_flag(chan_b, CF_SUSPEND) ||
+		switch_channel_test_flag(chan_a, CF_BROADCAST) || switch_channel_test_flag(chan_b, CF_BROADCAST) ||
+		switch_channel_test_flag(chan_a, CF_PROXY_MODE) || switch_channel_test_flag(chan_b, CF_PROXY_MODE) ||
+		switch_channel_test_flag(chan_a, CF_PROXY_MEDIA) || switch_channel_test_flag(chan_b, CF_PROXY_MEDIA) ||
+		switch_channel_test_flag(chan_a, CF_BRIDGE_NOWRITE) || switch_channel_test_flag(chan_a, CF_JITTERBUFFER) ||
+		switch_channel_test_flag(chan_b, CF_ACCEPT_CNG)) {
+		return SWITCH_FALSE;
+	}
+
+	/* recordings, eavesdrop, inband dtmf detection and generation all hang off media bugs */
+	if (switch_core_media_bug_count(session_a, NULL) || switch_core_media_bug_count(session_b, NULL)) {
+		return SWITCH_FALSE;
+	}
+
+	switch_core_session_get_read_impl(session_a, &read_impl);
+	switch_core_session_get_write_impl(session_b, &write_impl);
+
+	if (!read_impl.iananame || !write_impl.iananame || strcasecmp(read_impl.iananame, write_impl.iananame) ||
+		read_impl.samples_per_second != write_impl.samples_per_second ||
+		read_impl.microseconds_per_packet != write_impl.microseconds_per_packet ||
+		read_impl.number_of_channels != write_impl.number_of_channels) {
+		return SWITCH_FALSE;
+	}
+
+	return SWITCH_TRUE;
+}
+
 struct switch_ivr_bridge_data {
 	switch_core_session_t *session;
 	char b_uuid[SWITCH_UUID_FORMATTED_LENGTH + 1];
@@ -225,6 +265,7 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 	time_t answer_limit = 0;
 	const char *exec_app = NULL;
 	const char *exec_data = NULL;
+	switch_bool_t media_relay = SWITCH_FALSE, relaying = SWITCH_FALSE, relay_ok;
 
 #ifdef SWITCH_VIDEO_IN_THREADS
 	switch_thread_t *vid_thread = NULL;
@@ -253,6 +294,8 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 	bypass_media_after_bridge = switch_channel_test_flag(chan_a, CF_BYPASS_MEDIA_AFTER_BRIDGE);
 	switch_channel_clear_flag(chan_a, CF_BYPASS_MEDIA_AFTER_BRIDGE);
 
+	media_relay = switch_true(switch_channel_get_variable(chan_a, "bridge_media_relay"));
+
 	ans_a = switch_channel_test_flag(chan_a, CF_ANSWERED);
 
 	if ((originator = switch_channel_test_flag(chan_a, CF_BRIDGE_ORIGINATOR))) {
@@ -390,6 +433,17 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 
 		switch_ivr_parse_all_messages(session_a);
 
+		if (media_relay) {
+			relay_ok = !silence_val && read_frame_count >= DEFAULT_LEAD_FRAMES && bridge_can_relay(session_a, session_b);
+
+			if (relay_ok != relaying &&
+				switch_core_media_set_relay(session_a, relay_ok ? session_b : NULL, SWITCH_MEDIA_TYPE_AUDIO) == SWITCH_STATUS_SUCCESS) {
+				relaying = relay_ok;
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session_a), SWITCH_LOG_DEBUG, "%s media relay to %s %s\n",
+								  switch_channel_get_name(chan_a), switch_channel_get_name(chan_b), relaying ? "on" : "off");
+			}
+		}
+
 		if (!inner_bridge && (switch_channel_test_flag(chan_a, CF_SUSPEND) || switch_channel_test_flag(chan_b, CF_SUSPEND))) {
 			status = switch_core_session_read_frame(session_a, &read_frame, SWITCH_IO_FLAG_NONE, stream_id);
 
@@ -576,6 +630,10 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 
   end_of_bridge_loop:
 
+	if (relaying) {
+		switch_core_media_set_relay(session_a, NULL, SWITCH_MEDIA_TYPE_AUDIO);
+	}
+
 #ifdef SWITCH_VIDEO_IN_THREADS
 	if (vid_thread) {
 		vh.up = -1;
@@ -722,15 +722,9 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_record_file(switch_core_session_t *se
 
 		if (!asis && fh->thresh) {
 			int16_t *fdata = (int16_t *) read_frame->data;
-			uint32_t samples = read_frame->datalen / sizeof(*fdata);
-			uint32_t score, count = 0, j = 0;
-			double energy = 0;
-
-
-			for (count = 0; count < samples; count++) {
-				energy += abs(fdata[j]);
-				j += read_impl.number_of_channels;
-			}
+			uint32_t samples = read_frame->datalen / sizeof(*fdata) / read_impl.number_of_channels;
+			uint32_t score;
+			double energy = switch_sln_energy(fdata, samples, read_impl.number_of_channels);
 
 			score = (uint32_t) (energy / (samples / divisor));
 
@@ -1004,6 +998,72 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_release_file_handle(switch_core_sessi
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* prefer <file>.<codec> when a current one sits next to the prompt so it plays without transcoding,
+   the prompt is looked up in the <dir>/<rate>/ layout first just like mod_sndfile would play it */
+static const char *play_file_native_sibling(switch_core_session_t *session, const char *file, const char *ext,
+											const switch_codec_implementation_t *impl)
+{
+	switch_file_interface_t *file_interface;
+	struct stat src_st, dst_st;
+	char *resolved, *dot, *sibling = NULL;
+
+	/* native files are raw frames back to back, only fixed size frames can be read back */
+	if (!impl->encoded_bytes_per_packet || impl->number_of_channels != 1 || zstr(impl->iananame)) {
+		return NULL;
+	}
+
+	if (*file == '[' || *file == '{' || !strcasecmp(ext, impl->iananame)) {
+		return NULL;
+	}
+
+	resolved = switch_core_file_resolve_rate_path(file, impl->actual_samples_per_second);
+
+	if ((dot = strrchr(resolved, '.'))) {
+		sibling = switch_core_session_sprintf(session, "%.*s.%s", (int) (dot - resolved), resolved, impl->iananame);
+	}
+
+	if (!sibling || stat(sibling, &dst_st) || stat(resolved, &src_st) || dst_st.st_mtime < src_st.st_mtime) {
+		free(resolved);
+		return NULL;
+	}
+	free(resolved);
+
+	if (!(file_interface = switch_loadable_module_get_file_interface(impl->iananame))) {
+		return NULL;
+	}
+	UNPROTECT_INTERFACE(file_interface);
+
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Playing native %s instead of %s\n", sibling, file);
+
+	return sibling;
+}
+
+/* files from the sound prefix or the sounds dir are prompts, everything else (messages, recordings ...) is
+   played once or twice and is not worth keeping in the prompt cache */
+static switch_bool_t play_file_is_prompt(switch_channel_t *channel, const char *file)
+{
+	const char *dirs[2];
+	size_t len;
+	int i;
+
+	dirs[0] = switch_channel_get_variable(channel, "sound_prefix");
+	dirs[1] = SWITCH_GLOBAL_dirs.sounds_dir;
+
+	for (i = 0; i < 2; i++) {
+		if (zstr(dirs[i])) {
+			continue;
+		}
+
+		len = strlen(dirs[i]);
+
+		if (!strncmp(file, dirs[i], len) && (dirs[i][len - 1] == *SWITCH_PATH_SEPARATOR || file[len] == *SWITCH_PATH_SEPARATOR)) {
+			return SWITCH_TRUE;
+		}
+	}
+
+	return SWITCH_FALSE;
+}
+
 #define FILE_STARTSAMPLES 1024 * 32
 #define FILE_BLOCKSIZE 1024 * 8
 #define FILE_BUFSIZE 1024 * 64
@@ -1230,6 +1290,15 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 				ext = read_impl.iananame;
 				file = switch_core_session_sprintf(session, "%s.%s", file, ext);
 			}
+
+			if (ext != read_impl.iananame && !switch_false(switch_channel_get_variable(channel, "playback_native_siblings"))) {
+				const char *sibling;
+
+				if ((sibling = play_file_native_sibling(session, file, ext, &read_impl))) {
+					file = sibling;
+					ext = read_impl.iananame;
+				}
+			}
 		}
 
 		if ((prebuf = switch_channel_get_variable(channel, "stream_prebuffer"))) {
@@ -1247,7 +1316,9 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 		if (switch_core_file_open(fh,
 								  file,
 								  read_impl.number_of_channels,
-								  read_impl.actual_samples_per_second, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL) != SWITCH_STATUS_SUCCESS) {
+								  read_impl.actual_samples_per_second,
+								  SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT | (play_file_is_prompt(channel, file) ? SWITCH_FILE_PROMPT : 0),
+								  NULL) != SWITCH_STATUS_SUCCESS) {
 			switch_core_session_reset(session, SWITCH_TRUE, SWITCH_FALSE);
 			status = SWITCH_STATUS_NOTFOUND;
 			continue;
@@ -1785,7 +1856,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 SWITCH_DECLARE(switch_status_t) switch_ivr_wait_for_silence(switch_core_session_t *session, uint32_t thresh,
 															uint32_t silence_hits, uint32_t listen_hits, uint32_t timeout_ms, const char *file)
 {
-	uint32_t score, count = 0, j = 0;
+	uint32_t score;
 	double energy = 0;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	int divisor = 0;
@@ -1881,10 +1952,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_wait_for_silence(switch_core_session_
 
 		data = (int16_t *) read_frame->data;
 
-		for (energy = 0, j = 0, count = 0; count < read_frame->samples; count++) {
-			energy += abs(data[j++]);
-			j += channels;
-		}
+		energy = switch_sln_energy(data, read_frame->samples, channels);
 
 		score = (uint32_t) (energy / (read_frame->samples / divisor));
 
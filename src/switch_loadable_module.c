@@ -1736,6 +1736,7 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 
 	switch_loadable_module_load_module("", "CORE_SOFTTIMER_MODULE", SWITCH_FALSE, &err);
 	switch_loadable_module_load_module("", "CORE_PCM_MODULE", SWITCH_FALSE, &err);
+	switch_loadable_module_load_module("", "CORE_PROMPT_CACHE_MODULE", SWITCH_FALSE, &err);
 
 
 	if ((xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
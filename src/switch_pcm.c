@@ -126,6 +126,44 @@ static switch_status_t switch_proxy_destroy(switch_codec_t *codec)
 }
 
 
+/* PCMU <-> PCMA is a byte for byte table translation, so when nothing in between needs linear audio
+   the frame skips the decode to L16 and encode back entirely.  Returns SWITCH_TRUE when dst was filled in. */
+switch_bool_t switch_core_g711_transcode(const switch_codec_implementation_t *src_impl, const switch_codec_implementation_t *dst_impl,
+										  switch_frame_t *src, switch_frame_t *dst)
+{
+	int src_ulaw, dst_ulaw;
+
+	if (!src->datalen || src->datalen > dst->buflen || src_impl->samples_per_packet != dst_impl->samples_per_packet ||
+		src_impl->number_of_channels != 1 || dst_impl->number_of_channels != 1 || !src_impl->iananame || !dst_impl->iananame) {
+		return SWITCH_FALSE;
+	}
+
+	src_ulaw = !strcasecmp(src_impl->iananame, "PCMU");
+	dst_ulaw = !strcasecmp(dst_impl->iananame, "PCMU");
+
+	if (src_ulaw && !strcasecmp(dst_impl->iananame, "PCMA")) {
+		ulaw_to_alaw_block(src->data, dst->data, src->datalen);
+	} else if (dst_ulaw && !strcasecmp(src_impl->iananame, "PCMA")) {
+		alaw_to_ulaw_block(src->data, dst->data, src->datalen);
+	} else {
+		return SWITCH_FALSE;
+	}
+
+	dst->datalen = src->datalen;
+	dst->samples = src->datalen;
+	dst->rate = src->rate;
+	dst->timestamp = src->timestamp;
+	dst->m = src->m;
+	dst->ssrc = src->ssrc;
+	dst->seq = src->seq;
+	dst->payload = dst_impl->ianacode;
+	/* keep SFF_CNG, SFF_PLC and friends, but not the flags that point at the source packet or buffer */
+	dst->flags = src->flags & ~(SFF_RAW_RTP | SFF_PROXY_PACKET | SFF_UDPTL_PACKET | SFF_DYNAMIC);
+
+	return SWITCH_TRUE;
+}
+
+
 static switch_status_t switch_g711u_init(switch_codec_t *codec, switch_codec_flag_t flags, const switch_codec_settings_t *codec_settings)
 {
 	int encoding, decoding;
@@ -154,9 +192,8 @@ static switch_status_t switch_g711u_encode(switch_codec_t *codec,
 	dbuf = decoded_data;
 	ebuf = encoded_data;
 
-	for (i = 0; i < decoded_data_len / sizeof(short); i++) {
-		ebuf[i] = linear_to_ulaw(dbuf[i]);
-	}
+	i = decoded_data_len / sizeof(short);
+	ulaw_encode_block(dbuf, ebuf, i);
 
 	*encoded_data_len = i;
 
@@ -181,9 +218,8 @@ static switch_status_t switch_g711u_decode(switch_codec_t *codec,
 		memset(dbuf, 0, codec->implementation->decoded_bytes_per_packet);
 		*decoded_data_len = codec->implementation->decoded_bytes_per_packet;
 	} else {
-		for (i = 0; i < encoded_data_len; i++) {
-			dbuf[i] = ulaw_to_linear(ebuf[i]);
-		}
+		i = encoded_data_len;
+		ulaw_decode_block(ebuf, dbuf, i);
 
 		*decoded_data_len = i * 2;
 	}
@@ -225,9 +261,8 @@ static switch_status_t switch_g711a_encode(switch_codec_t *codec,
 	dbuf = decoded_data;
 	ebuf = encoded_data;
 
-	for (i = 0; i < decoded_data_len / sizeof(short); i++) {
-		ebuf[i] = linear_to_alaw(dbuf[i]);
-	}
+	i = decoded_data_len / sizeof(short);
+	alaw_encode_block(dbuf, ebuf, i);
 
 	*encoded_data_len = i;
 
@@ -252,9 +287,8 @@ static switch_status_t switch_g711a_decode(switch_codec_t *codec,
 		memset(dbuf, 0, codec->implementation->decoded_bytes_per_packet);
 		*decoded_data_len = codec->implementation->decoded_bytes_per_packet;
 	} else {
-		for (i = 0; i < encoded_data_len; i++) {
-			dbuf[i] = alaw_to_linear(ebuf[i]);
-		}
+		i = encoded_data_len;
+		alaw_decode_block(ebuf, dbuf, i);
 
 		*decoded_data_len = i * 2;
 	}
@@ -273,6 +307,8 @@ static void mod_g711_load(switch_loadable_module_interface_t ** module_interface
 	switch_codec_interface_t *codec_interface;
 	int mpf = 10000, spf = 80, bpf = 160, ebpf = 80, count;
 
+	g711_tables_init();
+
 	SWITCH_ADD_CODEC(codec_interface, "G.711 ulaw");
 	for (count = 12; count > 0; count--) {
 		switch_core_codec_add_implementation(pool, codec_interface, SWITCH_CODEC_TYPE_AUDIO,	/* enumeration defining the type of the codec */
@@ -36,6 +36,16 @@
 #include <switch_private.h>
 #endif
 #include <speex/speex_resampler.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 #define NORMFACT (float)0x8000
 #define MAXSAMPLE (float)0x7FFF
@@ -52,6 +62,214 @@
 
 #define resample_buffer(a, b, c) a > b ? ((a / 1000) / 2) * c : ((b / 1000) / 2) * c
 
+/* Fixed point polyphase resampler used for integer rate ratios (8k<->16k, 16k<->48k, 8k<->48k and the like).
+   Anything else still goes to the speex resampler. */
+#define POLY_TAPS 32			/* taps per phase, a multiple of 8 for the simd kernels */
+#define POLY_MAX_RATIO 6
+#define POLY_SHIFT 14			/* coefficients are Q14, an interpolation phase can reach 1.0 */
+#define POLY_KAISER_BETA 7.0
+
+typedef struct {
+	int up;						/* interpolating when non zero, decimating otherwise */
+	uint32_t ratio;
+	uint32_t taps;				/* total filter length, ratio * POLY_TAPS */
+	uint32_t hist_len;			/* history samples carried between calls */
+	uint32_t phase;				/* decimation: input samples to skip before the next output */
+	int16_t *coef;				/* time reversed; interpolation stores POLY_TAPS per phase */
+	int16_t *work;				/* history followed by the current input */
+	uint32_t work_size;
+} switch_polyphase_t;
+
+static double poly_bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0, k;
+
+	for (k = 1.0; k < 50.0; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12) {
+			break;
+		}
+	}
+
+	return sum;
+}
+
+static inline int32_t poly_dot(const int16_t *coef, const int16_t *x, uint32_t len)
+{
+#if defined(__SSE2__)
+	__m128i acc = _mm_setzero_si128();
+	uint32_t i;
+
+	for (i = 0; i < len; i += 8) {
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (coef + i)), _mm_loadu_si128((const __m128i *) (x + i))));
+	}
+
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	int32x4_t acc = vdupq_n_s32(0);
+	int32x2_t sum;
+	uint32_t i;
+
+	for (i = 0; i < len; i += 8) {
+		int16x8_t c = vld1q_s16(coef + i), s = vld1q_s16(x + i);
+		acc = vmlal_s16(acc, vget_low_s16(c), vget_low_s16(s));
+		acc = vmlal_s16(acc, vget_high_s16(c), vget_high_s16(s));
+	}
+
+	sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	return vget_lane_s32(vpadd_s32(sum, sum), 0);
+#else
+	int32_t acc = 0;
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		acc += (int32_t) coef[i] * x[i];
+	}
+
+	return acc;
+#endif
+}
+
+static inline int16_t poly_round(int32_t acc)
+{
+	acc = (acc + (1 << (POLY_SHIFT - 1))) >> POLY_SHIFT;
+
+	if (acc > 32767) {
+		acc = 32767;
+	} else if (acc < -32768) {
+		acc = -32768;
+	}
+
+	return (int16_t) acc;
+}
+
+static switch_polyphase_t *polyphase_create(uint32_t from_rate, uint32_t to_rate)
+{
+	switch_polyphase_t *pp;
+	double *h, sum = 0, fc, c;
+	uint32_t ratio, n, p, k;
+	int up;
+
+	if (!from_rate || !to_rate || from_rate == to_rate) {
+		return NULL;
+	}
+
+	if (to_rate > from_rate) {
+		if (to_rate % from_rate) {
+			return NULL;
+		}
+		ratio = to_rate / from_rate;
+		up = 1;
+	} else {
+		if (from_rate % to_rate) {
+			return NULL;
+		}
+		ratio = from_rate / to_rate;
+		up = 0;
+	}
+
+	if (ratio > POLY_MAX_RATIO) {
+		return NULL;
+	}
+
+	switch_zmalloc(pp, sizeof(*pp));
+	pp->up = up;
+	pp->ratio = ratio;
+	pp->taps = ratio * POLY_TAPS;
+	pp->hist_len = up ? POLY_TAPS - 1 : pp->taps - 1;
+	switch_zmalloc(pp->coef, pp->taps * sizeof(int16_t));
+	switch_zmalloc(h, pp->taps * sizeof(double));
+
+	/* Kaiser windowed sinc low pass at the lower of the two nyquist rates */
+	fc = 0.5 / ratio;
+	c = (pp->taps - 1) / 2.0;
+
+	for (n = 0; n < pp->taps; n++) {
+		double t = n - c, r = t / c, s;
+
+		s = t == 0 ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+		h[n] = s * poly_bessel_i0(POLY_KAISER_BETA * sqrt(1.0 - r * r)) / poly_bessel_i0(POLY_KAISER_BETA);
+		sum += h[n];
+	}
+
+	/* unity gain through the decimator, and through every phase of the interpolator */
+	for (n = 0; n < pp->taps; n++) {
+		h[n] = h[n] * (up ? ratio : 1) / sum;
+	}
+
+	if (up) {
+		/* phase p produces output n * ratio + p from h[p], h[p + ratio], ... applied to x[n], x[n - 1], ... */
+		for (p = 0; p < ratio; p++) {
+			for (k = 0; k < POLY_TAPS; k++) {
+				pp->coef[p * POLY_TAPS + (POLY_TAPS - 1 - k)] = (int16_t) floor(h[p + k * ratio] * (1 << POLY_SHIFT) + 0.5);
+			}
+		}
+	} else {
+		for (n = 0; n < pp->taps; n++) {
+			pp->coef[pp->taps - 1 - n] = (int16_t) floor(h[n] * (1 << POLY_SHIFT) + 0.5);
+		}
+	}
+
+	free(h);
+
+	return pp;
+}
+
+static void polyphase_destroy(switch_polyphase_t **pp)
+{
+	if (pp && *pp) {
+		switch_safe_free((*pp)->coef);
+		switch_safe_free((*pp)->work);
+		free(*pp);
+		*pp = NULL;
+	}
+}
+
+static uint32_t polyphase_process(switch_polyphase_t *pp, const int16_t *src, uint32_t srclen, int16_t *dst, uint32_t dstlen)
+{
+	uint32_t need = pp->hist_len + srclen, out = 0, i, p;
+
+	if (need > pp->work_size) {
+		int16_t *work;
+
+		if (!(work = realloc(pp->work, need * sizeof(int16_t)))) {
+			return 0;
+		}
+
+		if (!pp->work) {
+			memset(work, 0, pp->hist_len * sizeof(int16_t));
+		}
+
+		pp->work = work;
+		pp->work_size = need;
+	}
+
+	memcpy(pp->work + pp->hist_len, src, srclen * sizeof(int16_t));
+
+	if (pp->up) {
+		for (i = pp->hist_len; i < need && out + pp->ratio <= dstlen; i++) {
+			const int16_t *x = pp->work + i - (POLY_TAPS - 1);
+
+			for (p = 0; p < pp->ratio; p++) {
+				dst[out++] = poly_round(poly_dot(pp->coef + p * POLY_TAPS, x, POLY_TAPS));
+			}
+		}
+	} else {
+		for (i = pp->hist_len + pp->phase; i < need && out < dstlen; i += pp->ratio) {
+			dst[out++] = poly_round(poly_dot(pp->coef, pp->work + i - (pp->taps - 1), pp->taps));
+		}
+
+		pp->phase = i >= need ? i - need : 0;
+	}
+
+	memmove(pp->work, pp->work + srclen, pp->hist_len * sizeof(int16_t));
+
+	return out;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resampler_t **new_resampler,
 															   uint32_t from_rate, uint32_t to_rate,
 															   uint32_t to_size,
@@ -63,18 +281,20 @@ SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resa
 
 	switch_zmalloc(resampler, sizeof(*resampler));
 
-	resampler->resampler = speex_resampler_init(channels ? channels : 1, from_rate, to_rate, quality, &err);
+	if (channels > 1 || !(resampler->polyphase = polyphase_create(from_rate, to_rate))) {
+		resampler->resampler = speex_resampler_init(channels ? channels : 1, from_rate, to_rate, quality, &err);
 
-	if (!resampler->resampler) {
-		free(resampler);
-		return SWITCH_STATUS_GENERR;
+		if (!resampler->resampler) {
+			free(resampler);
+			return SWITCH_STATUS_GENERR;
+		}
 	}
 
 	*new_resampler = resampler;
-	lto_rate = (double) resampler->to_rate;
-	lfrom_rate = (double) resampler->from_rate;
 	resampler->from_rate = from_rate;
 	resampler->to_rate = to_rate;
+	lto_rate = (double) resampler->to_rate;
+	lfrom_rate = (double) resampler->from_rate;
 	resampler->factor = (lto_rate / lfrom_rate);
 	resampler->rfactor = (lfrom_rate / lto_rate);
 	resampler->to_size = resample_buffer(to_rate, from_rate, (uint32_t) to_size);
@@ -86,6 +306,11 @@ SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resa
 
 SWITCH_DECLARE(uint32_t) switch_resample_process(switch_audio_resampler_t *resampler, int16_t *src, uint32_t srclen)
 {
+	if (resampler->polyphase) {
+		resampler->to_len = polyphase_process(resampler->polyphase, src, srclen, resampler->to, resampler->to_size);
+		return resampler->to_len;
+	}
+
 	resampler->to_len = resampler->to_size;
 	speex_resampler_process_interleaved_int(resampler->resampler, src, &srclen, resampler->to, &resampler->to_len);
 	return resampler->to_len;
@@ -98,6 +323,7 @@ SWITCH_DECLARE(void) switch_resample_destroy(switch_audio_resampler_t **resample
 		if ((*resampler)->resampler) {
 			speex_resampler_destroy((*resampler)->resampler);
 		}
+		polyphase_destroy((switch_polyphase_t **) &(*resampler)->polyphase);
 		free((*resampler)->to);
 		free(*resampler);
 		*resampler = NULL;
@@ -286,6 +512,247 @@ SWITCH_DECLARE(void) switch_mux_channels(int16_t *data, switch_size_t samples, u
 	}
 }
 
+SWITCH_DECLARE(uint32_t) switch_sln_energy(const int16_t *data, uint32_t samples, uint32_t stride)
+{
+	uint32_t sum = 0, i = 0;
+
+	if (stride > 1) {
+		for (i = 0; i < samples; i++, data += stride) {
+			sum += abs(*data);
+		}
+		return sum;
+	}
+
+#if defined(__SSE2__)
+	{
+		__m128i acc = _mm_setzero_si128(), neg = _mm_setzero_si128(), one = _mm_set1_epi16(1);
+
+		for (; i + 8 <= samples; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+			__m128i s = _mm_srai_epi16(v, 15);
+
+			/* v ^ s is |v| - 1 for negative samples, which keeps -32768 in range; the 1 is added back from s */
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_xor_si128(v, s), one));
+			neg = _mm_sub_epi32(neg, _mm_madd_epi16(s, one));
+		}
+
+		acc = _mm_add_epi32(acc, neg);
+
+		acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+		acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum = (uint32_t) _mm_cvtsi128_si32(acc);
+	}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	{
+		uint32x4_t acc = vdupq_n_u32(0);
+		uint64x2_t total;
+
+		for (; i + 8 <= samples; i += 8) {
+			acc = vpadalq_u16(acc, vreinterpretq_u16_s16(vabsq_s16(vld1q_s16(data + i))));
+		}
+
+		total = vpaddlq_u32(acc);
+		sum = (uint32_t) (vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1));
+	}
+#endif
+
+	for (; i < samples; i++) {
+		sum += abs(data[i]);
+	}
+
+	return sum;
+}
+
+SWITCH_DECLARE(uint32_t) switch_sln_peak(const int16_t *data, uint32_t samples, uint32_t stride)
+{
+	uint32_t peak = 0, i = 0, a;
+
+	if (stride > 1) {
+		for (i = 0; i < samples; i++, data += stride) {
+			if ((a = abs(*data)) > peak) {
+				peak = a;
+			}
+		}
+		return peak;
+	}
+
+#if defined(__SSE2__)
+	if (samples >= 8) {
+		__m128i hi = _mm_setzero_si128(), lo = _mm_setzero_si128();
+		int16_t h[8], l[8];
+		int x;
+
+		for (; i + 8 <= samples; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+			hi = _mm_max_epi16(hi, v);
+			lo = _mm_min_epi16(lo, v);
+		}
+
+		_mm_storeu_si128((__m128i *) h, hi);
+		_mm_storeu_si128((__m128i *) l, lo);
+
+		for (x = 0; x < 8; x++) {
+			if ((uint32_t) h[x] > peak) {
+				peak = h[x];
+			}
+			if ((a = (uint32_t) -l[x]) > peak) {
+				peak = a;
+			}
+		}
+	}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	if (samples >= 8) {
+		uint16x8_t acc = vdupq_n_u16(0);
+		uint16x4_t m;
+
+		for (; i + 8 <= samples; i += 8) {
+			acc = vmaxq_u16(acc, vreinterpretq_u16_s16(vabsq_s16(vld1q_s16(data + i))));
+		}
+
+		m = vpmax_u16(vget_low_u16(acc), vget_high_u16(acc));
+		m = vpmax_u16(m, m);
+		m = vpmax_u16(m, m);
+		peak = vget_lane_u16(m, 0);
+	}
+#endif
+
+	for (; i < samples; i++) {
+		if ((a = abs(data[i])) > peak) {
+			peak = a;
+		}
+	}
+
+	return peak;
+}
+
+SWITCH_DECLARE(uint32_t) switch_sln_rms(const int16_t *data, uint32_t samples, uint32_t stride)
+{
+	uint64_t sum = 0;
+	uint32_t i = 0;
+
+	if (!samples) {
+		return 0;
+	}
+
+	if (stride > 1) {
+		for (i = 0; i < samples; i++, data += stride) {
+			sum += (uint32_t) (*data * *data);
+		}
+		return (uint32_t) sqrt((double) sum / samples);
+	}
+
+#if defined(__SSE2__)
+	{
+		__m128i acc = _mm_setzero_si128(), zero = _mm_setzero_si128();
+		uint64_t lanes[2];
+
+		for (; i + 8 <= samples; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+			/* a pair of squares can reach 2^31, so widen before it is read as signed */
+			__m128i sq = _mm_madd_epi16(v, v);
+
+			acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+			acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+		}
+
+		_mm_storeu_si128((__m128i *) lanes, acc);
+		sum = lanes[0] + lanes[1];
+	}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	{
+		int64x2_t acc = vdupq_n_s64(0);
+
+		for (; i + 8 <= samples; i += 8) {
+			int16x8_t v = vld1q_s16(data + i);
+			acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(v), vget_low_s16(v)));
+			acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(v), vget_high_s16(v)));
+		}
+
+		sum = (uint64_t) (vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1));
+	}
+#endif
+
+	for (; i < samples; i++) {
+		sum += (uint32_t) (data[i] * data[i]);
+	}
+
+	return (uint32_t) sqrt((double) sum / samples);
+}
+
+SWITCH_DECLARE(uint32_t) switch_sln_zero_crossings(const int16_t *data, uint32_t samples, uint32_t stride)
+{
+	uint32_t count = 0, i = 1;
+
+	if (samples < 2) {
+		return 0;
+	}
+
+	if (stride > 1) {
+		const int16_t *last = data;
+
+		for (data += stride; i < samples; i++, last = data, data += stride) {
+			count += ((*last ^ *data) < 0);
+		}
+		return count;
+	}
+
+#if defined(__SSE2__)
+	{
+		__m128i acc = _mm_setzero_si128(), neg = _mm_set1_epi16(-1);
+
+		for (; i + 8 <= samples; i += 8) {
+			__m128i cur = _mm_loadu_si128((const __m128i *) (data + i));
+			__m128i prev = _mm_loadu_si128((const __m128i *) (data + i - 1));
+
+			/* -1 in every lane where the sign flips, folded into 32 bit counters */
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_srai_epi16(_mm_xor_si128(cur, prev), 15), neg));
+		}
+
+		acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+		acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+		count = (uint32_t) _mm_cvtsi128_si32(acc);
+	}
+#endif
+
+	for (; i < samples; i++) {
+		count += ((data[i - 1] ^ data[i]) < 0);
+	}
+
+	return count;
+}
+
+SWITCH_DECLARE(void) switch_sln_scale(int16_t *data, uint32_t samples, double factor)
+{
+	uint32_t i = 0;
+	int32_t tmp;
+
+#if defined(__SSE2__)
+	{
+		__m128d f = _mm_set1_pd(factor);
+
+		/* same double multiply and truncation as the scalar loop, the saturating pack does the clamp */
+		for (; i + 8 <= samples; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+			lo = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtepi32_pd(lo), f)),
+									_mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2))), f)));
+			hi = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtepi32_pd(hi), f)),
+									_mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2))), f)));
+
+			_mm_storeu_si128((__m128i *) (data + i), _mm_packs_epi32(lo, hi));
+		}
+	}
+#endif
+
+	for (; i < samples; i++) {
+		tmp = (int32_t) (data[i] * factor);
+		switch_normalize_to_16bit(tmp);
+		data[i] = (int16_t) tmp;
+	}
+}
+
 SWITCH_DECLARE(void) switch_change_sln_volume_granular(int16_t *data, uint32_t samples, int32_t vol)
 {
 	double newrate = 0;
@@ -311,15 +778,7 @@ SWITCH_DECLARE(void) switch_change_sln_volume_granular(int16_t *data, uint32_t s
 	newrate = chart[i];
 
 	if (newrate) {
-		int32_t tmp;
-		uint32_t x;
-		int16_t *fp = data;
-
-		for (x = 0; x < samples; x++) {
-			tmp = (int32_t) (fp[x] * newrate);
-			switch_normalize_to_16bit(tmp);
-			fp[x] = (int16_t) tmp;
-		}
+		switch_sln_scale(data, samples, newrate);
 	}
 }
 
@@ -348,15 +807,7 @@ SWITCH_DECLARE(void) switch_change_sln_volume(int16_t *data, uint32_t samples, i
 	newrate = chart[i];
 
 	if (newrate) {
-		int32_t tmp;
-		uint32_t x;
-		int16_t *fp = data;
-
-		for (x = 0; x < samples; x++) {
-			tmp = (int32_t) (fp[x] * newrate);
-			switch_normalize_to_16bit(tmp);
-			fp[x] = (int16_t) tmp;
-		}
+		switch_sln_scale(data, samples, newrate);
 	}
 }
 
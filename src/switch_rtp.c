@@ -73,6 +73,7 @@
 static switch_port_t START_PORT = RTP_START_PORT;
 static switch_port_t END_PORT = RTP_END_PORT;
 static switch_mutex_t *port_lock = NULL;
+static switch_mutex_t *relay_lock = NULL;
 static void do_flush(switch_rtp_t *rtp_session, int force);
 
 typedef srtp_hdr_t rtp_hdr_t;
@@ -398,6 +399,9 @@ struct switch_rtp {
 	switch_size_t last_flush_packet_count;
 	uint32_t interdigit_delay;
 	switch_core_session_t *session;
+	switch_mutex_t *relay_mutex;
+	struct switch_rtp *relay_peer;
+	struct switch_rtp *relay_src;
 #ifdef ENABLE_ZRTP
 	zrtp_session_t *zrtp_session;
 	zrtp_profile_t *zrtp_profile;
@@ -1303,6 +1307,7 @@ SWITCH_DECLARE(void) switch_rtp_init(switch_memory_pool_t *pool)
 	srtp_init();
 #endif
 	switch_mutex_init(&port_lock, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&relay_lock, SWITCH_MUTEX_NESTED, pool);
 	global_init = 1;
 }
 
@@ -2824,6 +2829,7 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_create(switch_rtp_t **new_rtp_session
 	switch_mutex_init(&rtp_session->flag_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&rtp_session->read_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&rtp_session->write_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&rtp_session->relay_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&rtp_session->dtmf_data.dtmf_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_queue_create(&rtp_session->dtmf_data.dtmf_queue, 100, rtp_session->pool);
 	switch_queue_create(&rtp_session->dtmf_data.dtmf_inqueue, 100, rtp_session->pool);
@@ -3109,6 +3115,77 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_pause_jitter_buffer(switch_rtp_t *rtp
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* relay links are only changed under relay_lock; the forwarding side only needs its own relay_mutex */
+static void rtp_relay_unlink(switch_rtp_t *rtp_session)
+{
+	switch_rtp_t *src;
+
+	if (rtp_session->relay_peer) {
+		switch_mutex_lock(rtp_session->relay_mutex);
+		rtp_session->relay_peer->relay_src = NULL;
+		rtp_session->relay_peer = NULL;
+		switch_mutex_unlock(rtp_session->relay_mutex);
+	}
+
+	if ((src = rtp_session->relay_src)) {
+		switch_mutex_lock(src->relay_mutex);
+		src->relay_peer = NULL;
+		rtp_session->relay_src = NULL;
+		switch_mutex_unlock(src->relay_mutex);
+	}
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_set_relay(switch_rtp_t *rtp_session, switch_rtp_t *peer)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	if (!rtp_session) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(relay_lock);
+
+	if (rtp_session->relay_peer != peer) {
+		if (rtp_session->relay_peer) {
+			switch_mutex_lock(rtp_session->relay_mutex);
+			rtp_session->relay_peer->relay_src = NULL;
+			rtp_session->relay_peer = NULL;
+			switch_mutex_unlock(rtp_session->relay_mutex);
+		}
+
+		if (peer) {
+			if (peer == rtp_session || peer->relay_src || !switch_rtp_ready(rtp_session) || !switch_rtp_ready(peer)) {
+				status = SWITCH_STATUS_FALSE;
+			} else {
+				switch_mutex_lock(rtp_session->relay_mutex);
+				rtp_session->relay_peer = peer;
+				peer->relay_src = rtp_session;
+				switch_mutex_unlock(rtp_session->relay_mutex);
+			}
+		}
+	}
+
+	switch_mutex_unlock(relay_lock);
+
+	return status;
+}
+
+/* hand a received media packet straight to the peer's write side, which stamps its own ssrc, seq and ts */
+static int rtp_relay_packet(switch_rtp_t *rtp_session, switch_size_t bytes)
+{
+	switch_frame_flag_t frame_flags = SFF_NONE;
+	int r = 0;
+
+	switch_mutex_lock(rtp_session->relay_mutex);
+	if (rtp_session->relay_peer && switch_rtp_ready(rtp_session->relay_peer)) {
+		r = rtp_common_write(rtp_session->relay_peer, NULL, RTP_BODY(rtp_session), (uint32_t) (bytes - rtp_header_len),
+							 rtp_session->relay_peer->payload, 0, &frame_flags) > 0;
+	}
+	switch_mutex_unlock(rtp_session->relay_mutex);
+
+	return r;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_rtp_deactivate_jitter_buffer(switch_rtp_t *rtp_session)
 {
 	
@@ -3177,6 +3254,10 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_activate_jitter_buffer(switch_rtp_t *
 	} else {
 		rtp_session->jb = stfu_n_init(queue_frames, max_queue_frames ? max_queue_frames : 50, samples_per_packet, samples_per_second, max_drift);
 	}
+
+	if (rtp_session->jb && stfu_n_set_adaptive(rtp_session->jb, rtp_session->flags[SWITCH_RTP_FLAG_ADAPTIVE_JB]) != STFU_IT_WORKED) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "Adaptive jitter buffer unavailable, using the fixed one\n");
+	}
 	READ_DEC(rtp_session);
 	
 	if (rtp_session->jb) {
@@ -3456,6 +3537,10 @@ SWITCH_DECLARE(void) switch_rtp_destroy(switch_rtp_t **rtp_session)
 	READ_DEC((*rtp_session));
 	WRITE_DEC((*rtp_session));
 
+	switch_mutex_lock(relay_lock);
+	rtp_relay_unlink(*rtp_session);
+	switch_mutex_unlock(relay_lock);
+
 	switch_mutex_lock((*rtp_session)->flag_mutex);
 
 	switch_rtp_kill_socket(*rtp_session);
@@ -4492,6 +4577,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 	int rtcp_fdr = 0;
 	int hot_socket = 0;
 	int read_loops = 0;
+	int relayed = 0;
 
 	if (!switch_rtp_ready(rtp_session)) {
 		return -1;
@@ -5043,7 +5129,9 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 			*flags |= SFF_CNG;
 			*payload_type = (switch_payload_t) rtp_session->recv_msg.header.pt;
 			ret = 2 + rtp_header_len;
-			rtp_session->stats.inbound.skip_packet_count++;
+			if (!relayed) {
+				rtp_session->stats.inbound.skip_packet_count++;
+			}
 			goto end;
 		}
 
@@ -5070,6 +5158,14 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 			rtp_session->recv_msg.header.pt = 97;
 		}
 
+		if (rtp_session->relay_peer && !rtp_session->jb && bytes > rtp_header_len &&
+			rtp_session->recv_msg.header.pt == rtp_session->rpayload && rtp_relay_packet(rtp_session, bytes)) {
+			/* the packet already went out the other leg, the caller only gets a tick */
+			rtp_session->stats.inbound.relay_packet_count++;
+			relayed = 1;
+			return_cng_frame();
+		}
+
 		break;
 
 	do_continue:
@@ -5575,7 +5671,8 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 									 decoded, &len, &rate, &codec_flags) == SWITCH_STATUS_SUCCESS) {
 
 			uint32_t energy = 0;
-			uint32_t x, y = 0, z = len / sizeof(int16_t);
+			uint32_t channels = rtp_session->vad_data.read_codec->implementation->number_of_channels;
+			uint32_t z = len / sizeof(int16_t) / channels;
 			uint32_t score = 0;
 			int divisor = 0;
 			if (z) {
@@ -5584,10 +5681,7 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 					divisor = 1;
 				}
 
-				for (x = 0; x < z; x++) {
-					energy += abs(decoded[y]);
-					y += rtp_session->vad_data.read_codec->implementation->number_of_channels;
-				}
+				energy = switch_sln_energy(decoded, z, channels);
 
 				if (++rtp_session->vad_data.start_count < rtp_session->vad_data.start) {
 					send = 1;
@@ -0,0 +1,217 @@
+/*
+ * Compares the polyphase path of switch_resample with the speex resampler it replaced
+ * for integer ratios: quality on test tones and time per 20ms frame.
+ */
+#include <switch.h>
+#include <speex/speex_resampler.h>
+#include <math.h>
+#include <time.h>
+
+#define SECONDS 2
+#define SETTLE_MS 100
+#define TIMED 20000
+
+typedef struct {
+	uint32_t from;
+	uint32_t to;
+} ratio_t;
+
+static const ratio_t ratios[] = {
+	{8000, 16000}, {16000, 8000}, {16000, 48000}, {48000, 16000}, {8000, 48000}, {48000, 8000}
+};
+
+typedef struct {
+	switch_audio_resampler_t *poly;
+	SpeexResamplerState *speex;
+	int16_t *out;
+	uint32_t out_size;
+} engine_t;
+
+static int engine_create(engine_t *e, int speex, uint32_t from, uint32_t to)
+{
+	int err = 0;
+
+	memset(e, 0, sizeof(*e));
+
+	/* sized the way the core sizes its resamplers */
+	if (switch_resample_create(&e->poly, from, to, SWITCH_RECOMMENDED_BUFFER_SIZE, SWITCH_RESAMPLE_QUALITY, 1) != SWITCH_STATUS_SUCCESS || !e->poly->polyphase) {
+		return -1;
+	}
+
+	if (speex) {
+		e->speex = speex_resampler_init(1, from, to, SWITCH_RESAMPLE_QUALITY, &err);
+		e->out_size = e->poly->to_size;
+		e->out = malloc(e->out_size * sizeof(int16_t));
+	}
+
+	return 0;
+}
+
+static uint32_t engine_process(engine_t *e, int16_t *src, uint32_t srclen, int16_t **out)
+{
+	uint32_t len;
+
+	if (!e->speex) {
+		len = switch_resample_process(e->poly, src, srclen);
+		*out = e->poly->to;
+		return len;
+	}
+
+	/* what switch_resample_process did before */
+	len = e->out_size;
+	speex_resampler_process_interleaved_int(e->speex, src, &srclen, e->out, &len);
+	*out = e->out;
+	return len;
+}
+
+static void engine_destroy(engine_t *e)
+{
+	if (e->speex) {
+		speex_resampler_destroy(e->speex);
+	}
+	switch_resample_destroy(&e->poly);
+	switch_safe_free(e->out);
+}
+
+/* Runs SECONDS of a tone at freq through the engine in 20ms frames and returns the output. */
+static int16_t *run_tone(int speex, const ratio_t *r, double freq, uint32_t *outlen)
+{
+	uint32_t frame = r->from / 50, total = r->from * SECONDS, i, n = 0;
+	int16_t *in = malloc(total * sizeof(int16_t)), *res = malloc((r->to * SECONDS + r->to / 50) * sizeof(int16_t)), *out;
+	engine_t e;
+
+	for (i = 0; i < total; i++) {
+		in[i] = (int16_t) (16384 * sin(2 * M_PI * freq * i / r->from));
+	}
+
+	engine_create(&e, speex, r->from, r->to);
+
+	for (i = 0; i + frame <= total; i += frame) {
+		uint32_t len = engine_process(&e, in + i, frame, &out);
+		memcpy(res + n, out, len * sizeof(int16_t));
+		n += len;
+	}
+
+	engine_destroy(&e);
+	free(in);
+	*outlen = n;
+
+	return res;
+}
+
+/* Least squares fit of a tone at freq, returns the signal to residual ratio in dB. */
+static double sinad(const int16_t *x, uint32_t len, uint32_t rate, double freq)
+{
+	uint32_t start = rate * SETTLE_MS / 1000, i;
+	double ss = 0, cc = 0, sc = 0, sx = 0, cx = 0, a, b, det, sig = 0, err = 0;
+
+	for (i = start; i < len; i++) {
+		double s = sin(2 * M_PI * freq * i / rate), c = cos(2 * M_PI * freq * i / rate);
+		ss += s * s;
+		cc += c * c;
+		sc += s * c;
+		sx += s * x[i];
+		cx += c * x[i];
+	}
+
+	det = ss * cc - sc * sc;
+	a = (sx * cc - cx * sc) / det;
+	b = (cx * ss - sx * sc) / det;
+
+	for (i = start; i < len; i++) {
+		double fit = a * sin(2 * M_PI * freq * i / rate) + b * cos(2 * M_PI * freq * i / rate);
+		sig += fit * fit;
+		err += (x[i] - fit) * (x[i] - fit);
+	}
+
+	return 10 * log10(sig / (err ? err : 1));
+}
+
+/* Level of the output relative to the input tone, for tones the output rate cannot carry. */
+static double level(const int16_t *x, uint32_t len, uint32_t rate)
+{
+	uint32_t start = rate * SETTLE_MS / 1000, i;
+	double sum = 0;
+
+	for (i = start; i < len; i++) {
+		sum += (double) x[i] * x[i];
+	}
+
+	return 10 * log10((sum / (len - start) + 1e-9) / (16384.0 * 16384.0 / 2));
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double frame_ns(int speex, const ratio_t *r)
+{
+	uint32_t frame = r->from / 50, i;
+	int16_t in[960], *out;
+	engine_t e;
+	double t0;
+	int round;
+
+	for (i = 0; i < frame; i++) {
+		in[i] = (int16_t) rand();
+	}
+
+	engine_create(&e, speex, r->from, r->to);
+
+	t0 = now();
+	for (round = 0; round < TIMED; round++) {
+		engine_process(&e, in, frame, &out);
+	}
+	t0 = now() - t0;
+
+	engine_destroy(&e);
+
+	return t0 / TIMED * 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t i;
+	int engine;
+
+	printf("%-12s %-8s %9s %9s %9s %9s\n", "ratio", "engine", "1k dB", "3k dB", "alias dB", "ns/frame");
+
+	for (i = 0; i < sizeof(ratios) / sizeof(ratios[0]); i++) {
+		const ratio_t *r = &ratios[i];
+
+		for (engine = 0; engine < 2; engine++) {
+			int16_t *out;
+			uint32_t len;
+			double q1, q3, alias = 0;
+			char name[32];
+
+			out = run_tone(engine, r, 1000, &len);
+			q1 = sinad(out, len, r->to, 1000);
+			free(out);
+
+			out = run_tone(engine, r, 3000, &len);
+			q3 = sinad(out, len, r->to, 3000);
+			free(out);
+
+			if (r->from > r->to) {
+				/* 3/4 of the way to the input nyquist, folds back into the output band */
+				out = run_tone(engine, r, r->from * 3 / 8.0, &len);
+				alias = level(out, len, r->to);
+				free(out);
+			}
+
+			snprintf(name, sizeof(name), "%u->%u", r->from / 1000, r->to / 1000);
+			if (r->from > r->to) {
+				printf("%-12s %-8s %9.1f %9.1f %9.1f %9.0f\n", name, engine ? "speex" : "poly", q1, q3, alias, frame_ns(engine, r));
+			} else {
+				printf("%-12s %-8s %9.1f %9.1f %9s %9.0f\n", name, engine ? "speex" : "poly", q1, q3, "-", frame_ns(engine, r));
+			}
+		}
+	}
+
+	return 0;
+}
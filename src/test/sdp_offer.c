@@ -0,0 +1,170 @@
+/*
+ * Times switch_core_media_gen_local_sdp for an audio offer with and without the m=audio
+ * templates, and checks that both produce the same body.
+ */
+#include <switch.h>
+#include <time.h>
+
+#define CALLS 2000
+#define ROUNDS 10
+#define CODECS "opus@48000h@20i,G722,PCMU,PCMA,L16"
+
+static switch_endpoint_interface_t *bench_endpoint;
+static switch_io_routines_t bench_io_routines = { 0 };
+static switch_state_handler_table_t bench_state_handlers = { 0 };
+
+static switch_status_t bench_codec_init(switch_codec_t *codec, switch_codec_flag_t flags, const switch_codec_settings_t *codec_settings)
+{
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t bench_codec_destroy(switch_codec_t *codec)
+{
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* an endpoint to hang the sessions on and two codecs with the fmtp and rate quirks of the real ones */
+static switch_status_t bench_load(switch_loadable_module_interface_t **module_interface, switch_memory_pool_t *pool)
+{
+	switch_codec_interface_t *codec_interface;
+
+	*module_interface = switch_loadable_module_create_module_interface(pool, "sdp_offer");
+
+	bench_endpoint = switch_loadable_module_create_interface(*module_interface, SWITCH_ENDPOINT_INTERFACE);
+	bench_endpoint->interface_name = "bench";
+	bench_endpoint->io_routines = &bench_io_routines;
+	bench_endpoint->state_handler = &bench_state_handlers;
+
+	SWITCH_ADD_CODEC(codec_interface, "bench opus");
+	switch_core_codec_add_implementation(pool, codec_interface, SWITCH_CODEC_TYPE_AUDIO, 116, "opus",
+										 "useinbandfec=1; maxaveragebitrate=30000; maxplaybackrate=48000; ptime=20; minptime=10; maxptime=40",
+										 48000, 48000, 30000, 20000, 960, 1920, 0, 1, 1,
+										 bench_codec_init, NULL, NULL, bench_codec_destroy);
+
+	SWITCH_ADD_CODEC(codec_interface, "bench G722");
+	switch_core_codec_add_implementation(pool, codec_interface, SWITCH_CODEC_TYPE_AUDIO, 9, "G722", NULL,
+										 8000, 16000, 64000, 20000, 160, 640, 160, 1, 1,
+										 bench_codec_init, NULL, NULL, bench_codec_destroy);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Runs CALLS offers, each on a new session the way a profile would, and keeps the time of each one. */
+static void offers(switch_core_media_params_t *mparams, double *times, char **last)
+{
+	int i;
+
+	for (i = 0; i < CALLS; i++) {
+		switch_core_session_t *session;
+		switch_media_handle_t *smh;
+		double t0;
+
+		if (!(session = switch_core_session_request(bench_endpoint, SWITCH_CALL_DIRECTION_OUTBOUND, SOF_NO_LIMITS, NULL))) {
+			fprintf(stderr, "Cannot create session\n");
+			exit(1);
+		}
+
+		switch_media_handle_create(&smh, session, mparams);
+		switch_channel_set_variable(switch_core_session_get_channel(session), "absolute_codec_string", CODECS);
+		switch_core_media_prepare_codecs(session, SWITCH_TRUE);
+
+		t0 = now();
+		switch_core_media_gen_local_sdp(session, "192.0.2.10", 20000 + (i % 10000) * 2, NULL, 0);
+		times[i] = (now() - t0) * 1e9;
+
+		if (i == CALLS - 1) {
+			/* the o= line carries the session version, leave it out of the comparison */
+			const char *body = strstr(mparams->local_sdp_str, "s=");
+			switch_safe_free(*last);
+			*last = strdup(body ? body : "");
+		}
+
+		switch_core_session_destroy(&session);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	switch_core_media_params_t mparams = { 0 };
+	char base[] = "/tmp/sdp_offer.XXXXXX", path[256];
+	const char *err = NULL;
+	char *plain = NULL, *tpl = NULL;
+	double *plain_ns = malloc(sizeof(double) * CALLS * ROUNDS), *tpl_ns = malloc(sizeof(double) * CALLS * ROUNDS);
+	int pause = 0, round;
+	FILE *fp;
+
+	if (!mkdtemp(base)) {
+		return 1;
+	}
+
+	/* the core writes the preprocessed config to the log dir */
+	SWITCH_GLOBAL_dirs.base_dir = strdup(base);
+	switch_snprintf(path, sizeof(path), "%s/conf", base);
+	mkdir(path, 0700);
+	switch_snprintf(path, sizeof(path), "%s/log", base);
+	mkdir(path, 0700);
+	switch_snprintf(path, sizeof(path), "%s/conf/freeswitch.xml", base);
+
+	if (!(fp = fopen(path, "w"))) {
+		return 1;
+	}
+	fprintf(fp, "<document type=\"freeswitch/xml\"><section name=\"configuration\"/></document>\n");
+	fclose(fp);
+
+	if (switch_core_init(SCF_MINIMAL, SWITCH_FALSE, &err) != SWITCH_STATUS_SUCCESS) {
+		fprintf(stderr, "Cannot init core [%s]\n", err);
+		return 1;
+	}
+
+	/* session destroy drops its scheduler tasks */
+	switch_scheduler_task_thread_start();
+	switch_loadable_module_init(SWITCH_FALSE);
+	switch_loadable_module_load_module("", "CORE_PCM_MODULE", SWITCH_TRUE, &err);
+	switch_loadable_module_build_dynamic("sdp_offer", bench_load, NULL, NULL, SWITCH_FALSE);
+	switch_core_session_ctl(SCSC_PAUSE_ALL, &pause);
+
+	mparams.sdp_username = "FreeSWITCH";
+	mparams.te = 101;
+	mparams.dtmf_type = DTMF_2833;
+	mparams.cng_pt = 13;
+
+	/* a minimal core leaves the templates off, which is the old generate_m; the rounds
+	   alternate so both see the same background noise, and the medians filter out the rest */
+	for (round = 0; round < ROUNDS; round++) {
+		offers(&mparams, plain_ns + round * CALLS, &plain);
+
+		switch_core_media_init();
+		offers(&mparams, tpl_ns + round * CALLS, &tpl);
+		switch_core_media_deinit();
+	}
+
+	qsort(plain_ns, CALLS * ROUNDS, sizeof(double), cmp_double);
+	qsort(tpl_ns, CALLS * ROUNDS, sizeof(double), cmp_double);
+
+	printf("%d offers of %s, ns per offer\n", CALLS * ROUNDS, CODECS);
+	printf("               median      p90\n");
+	printf("  built       %7.0f  %7.0f\n", plain_ns[CALLS * ROUNDS / 2], plain_ns[CALLS * ROUNDS * 9 / 10]);
+	printf("  template    %7.0f  %7.0f\n", tpl_ns[CALLS * ROUNDS / 2], tpl_ns[CALLS * ROUNDS * 9 / 10]);
+	printf("  bodies %s\n", strcmp(plain, tpl) ? "DIFFER" : "match");
+
+	if (strcmp(plain, tpl)) {
+		printf("--- built\n%s--- template\n%s", plain, tpl);
+	}
+
+	return strcmp(plain, tpl) != 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Checks the signed linear energy, peak, rms, zero crossing and gain helpers against
+ * the plain loops they replaced, then times both on a 20ms frame.
+ */
+#include <switch.h>
+#include <math.h>
+#include <time.h>
+
+#define FRAME 160
+#define ROUNDS 200000
+#define TIMED 2000000
+
+static uint32_t ref_energy(const int16_t *data, uint32_t samples, uint32_t stride)
+{
+	uint32_t sum = 0, i;
+
+	for (i = 0; i < samples; i++) {
+		sum += abs(data[i * stride]);
+	}
+
+	return sum;
+}
+
+static uint32_t ref_peak(const int16_t *data, uint32_t samples, uint32_t stride)
+{
+	uint32_t peak = 0, i;
+
+	for (i = 0; i < samples; i++) {
+		if ((uint32_t) abs(data[i * stride]) > peak) {
+			peak = abs(data[i * stride]);
+		}
+	}
+
+	return peak;
+}
+
+static uint32_t ref_rms(const int16_t *data, uint32_t samples, uint32_t stride)
+{
+	uint64_t sum = 0;
+	uint32_t i;
+
+	if (!samples) {
+		return 0;
+	}
+
+	for (i = 0; i < samples; i++) {
+		sum += (uint32_t) (data[i * stride] * data[i * stride]);
+	}
+
+	return (uint32_t) sqrt((double) sum / samples);
+}
+
+static uint32_t ref_zero_crossings(const int16_t *data, uint32_t samples, uint32_t stride)
+{
+	uint32_t count = 0, i;
+
+	for (i = 1; i < samples; i++) {
+		count += ((data[(i - 1) * stride] ^ data[i * stride]) < 0);
+	}
+
+	return count;
+}
+
+static void ref_scale(int16_t *data, uint32_t samples, double factor)
+{
+	uint32_t i;
+	int32_t tmp;
+
+	for (i = 0; i < samples; i++) {
+		tmp = (int32_t) (data[i] * factor);
+		switch_normalize_to_16bit(tmp);
+		data[i] = (int16_t) tmp;
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the volume table factors plus a few odd ones */
+static const double factors[] = { 1.25, 1.5, 1.75, 2, 2.25, 2.5, 2.75, 3, 3.25, 3.5, 3.75, 4,
+	.917, .834, .751, .668, .585, .502, .419, .336, .253, .017, .087, .004, 1.3, 2.3, 3.3, 4.3, .8, .6, .4, .2
+};
+
+static int check(void)
+{
+	int16_t buf[4000], a[4000], b[4000];
+	int round, bad = 0;
+
+	srand(1);
+
+	for (round = 0; round < ROUNDS; round++) {
+		uint32_t samples = rand() % 1000, stride = 1 + (rand() % 3 == 0 ? rand() % 3 : 0), i;
+		double factor = factors[rand() % (sizeof(factors) / sizeof(factors[0]))];
+
+		/* lots of full scale samples, -32768 is where the sign tricks go wrong */
+		for (i = 0; i < 4000; i++) {
+			int m = rand() % 4;
+			buf[i] = m == 0 ? -32768 : m == 1 ? 32767 : (int16_t) (rand() >> (rand() % 16));
+		}
+
+		bad += switch_sln_energy(buf, samples, stride) != ref_energy(buf, samples, stride);
+		bad += switch_sln_peak(buf, samples, stride) != ref_peak(buf, samples, stride);
+		bad += switch_sln_rms(buf, samples, stride) != ref_rms(buf, samples, stride);
+		bad += switch_sln_zero_crossings(buf, samples, stride) != ref_zero_crossings(buf, samples, stride);
+
+		memcpy(a, buf, sizeof(a));
+		memcpy(b, buf, sizeof(b));
+		switch_sln_scale(a, samples, factor);
+		ref_scale(b, samples, factor);
+		bad += memcmp(a, b, sizeof(a)) != 0;
+	}
+
+	printf("%d random frames, %d mismatches\n", ROUNDS, bad);
+
+	return bad;
+}
+
+#define TIME(_name, _expr) do { \
+		double t0 = now(); \
+		for (round = 0; round < TIMED; round++) { \
+			sink += _expr; \
+			__asm__ volatile("" :: "r"(buf) : "memory"); \
+		} \
+		printf("  %-14s %7.1f ns\n", _name, (now() - t0) / TIMED * 1e9); \
+	} while (0)
+
+static void bench(void)
+{
+	int16_t buf[FRAME];
+	volatile uint32_t sink = 0;
+	int round, i;
+
+	for (i = 0; i < FRAME; i++) {
+		buf[i] = (int16_t) rand();
+	}
+
+	printf("%d samples per frame\n", FRAME);
+	TIME("energy", switch_sln_energy(buf, FRAME, 1));
+	TIME("energy loop", ref_energy(buf, FRAME, 1));
+	TIME("peak", switch_sln_peak(buf, FRAME, 1));
+	TIME("peak loop", ref_peak(buf, FRAME, 1));
+	TIME("rms", switch_sln_rms(buf, FRAME, 1));
+	TIME("rms loop", ref_rms(buf, FRAME, 1));
+	TIME("zero cross", switch_sln_zero_crossings(buf, FRAME, 1));
+	TIME("zero loop", ref_zero_crossings(buf, FRAME, 1));
+	TIME("scale", (switch_sln_scale(buf, FRAME, .917), 0));
+	TIME("scale loop", (ref_scale(buf, FRAME, .917), 0));
+}
+
+int main(int argc, char *argv[])
+{
+	if (check()) {
+		return 1;
+	}
+
+	bench();
+
+	return 0;
+}